@@ -0,0 +1,171 @@
+#ifdef HAVE_ARROW
+
+#include "arrowstudentwriter.h"
+#include <QFile>
+
+namespace {
+// Rows per record batch or Parquet row group
+const int64_t BatchRows = 64 * 1024;
+
+std::string utf8(const QString& text)
+{
+    return text.toStdString();
+}
+}
+
+ArrowStudentWriter::ArrowStudentWriter(const QString& filePath, Container container)
+    : m_filePath(filePath)
+    , m_partPath(filePath + ".part")
+    , m_container(container)
+    , m_lastUpdateTime(std::make_unique<arrow::TimestampBuilder>(
+          arrow::timestamp(arrow::TimeUnit::MILLI, "UTC"), arrow::default_memory_pool()))
+    , m_pendingRows(0)
+{
+}
+
+ArrowStudentWriter::~ArrowStudentWriter()
+{
+    if (m_output && !m_output->closed()) {
+        discard();
+    }
+}
+
+bool ArrowStudentWriter::check(const arrow::Status& status)
+{
+    if (!status.ok()) {
+        m_error = QString::fromStdString(status.ToString());
+        return false;
+    }
+    return true;
+}
+
+bool ArrowStudentWriter::open()
+{
+    m_schema = arrow::schema({
+        arrow::field("id", arrow::utf8(), false),
+        arrow::field("name", arrow::utf8()),
+        arrow::field("email", arrow::utf8()),
+        arrow::field("description", arrow::utf8()),
+        arrow::field("field", arrow::utf8()),
+        arrow::field("school", arrow::utf8()),
+        arrow::field("number", arrow::utf8()),
+        arrow::field("year", arrow::int32()),
+        arrow::field("graduation", arrow::boolean()),
+        arrow::field("photoURL", arrow::utf8()),
+        arrow::field("lastUpdateTime", arrow::timestamp(arrow::TimeUnit::MILLI, "UTC"))
+    });
+    
+    auto output = arrow::io::FileOutputStream::Open(m_partPath.toStdString());
+    if (!check(output.status())) {
+        return false;
+    }
+    m_output = *output;
+    
+    if (m_container == Parquet) {
+        auto writer = parquet::arrow::FileWriter::Open(*m_schema, arrow::default_memory_pool(), m_output);
+        if (!check(writer.status())) {
+            return false;
+        }
+        m_parquetWriter = std::move(*writer);
+    } else {
+        auto writer = arrow::ipc::MakeFileWriter(m_output, m_schema);
+        if (!check(writer.status())) {
+            return false;
+        }
+        m_ipcWriter = *writer;
+    }
+    return true;
+}
+
+bool ArrowStudentWriter::write(const Student& student)
+{
+    const QString strings[StringColumnCount] = {
+        student.getId(), student.getName(), student.getEmail(), student.getDescription(),
+        student.getField(), student.getSchool(), student.getNumber(), student.getPhotoURL()
+    };
+    for (int column = 0; column < StringColumnCount; ++column) {
+        if (!check(m_strings[column].Append(utf8(strings[column])))) {
+            return false;
+        }
+    }
+    
+    const QDateTime updated = student.getLastUpdateTime();
+    bool appended = check(m_year.Append(student.getYear()))
+        && check(m_graduation.Append(student.getGraduation()))
+        && check(updated.isValid() ? m_lastUpdateTime->Append(updated.toMSecsSinceEpoch())
+                                   : m_lastUpdateTime->AppendNull());
+    if (!appended) {
+        return false;
+    }
+    
+    return ++m_pendingRows < BatchRows || flushBatch();
+}
+
+bool ArrowStudentWriter::flushBatch()
+{
+    if (m_pendingRows == 0) {
+        return true;
+    }
+    
+    // Finishing a builder resets it for the next batch
+    std::shared_ptr<arrow::Array> arrays[StringColumnCount];
+    for (int column = 0; column < StringColumnCount; ++column) {
+        if (!check(m_strings[column].Finish(&arrays[column]))) {
+            return false;
+        }
+    }
+    std::shared_ptr<arrow::Array> year, graduation, lastUpdateTime;
+    if (!check(m_year.Finish(&year)) || !check(m_graduation.Finish(&graduation))
+        || !check(m_lastUpdateTime->Finish(&lastUpdateTime))) {
+        return false;
+    }
+    
+    // Schema order: the string columns with year and graduation before
+    // photoURL, then lastUpdateTime
+    std::vector<std::shared_ptr<arrow::Array>> columns = {
+        arrays[Id], arrays[Name], arrays[Email], arrays[Description], arrays[Field],
+        arrays[School], arrays[Number], year, graduation, arrays[PhotoURL], lastUpdateTime
+    };
+    int64_t rows = m_pendingRows;
+    m_pendingRows = 0;
+    
+    if (m_parquetWriter) {
+        std::shared_ptr<arrow::Table> table = arrow::Table::Make(m_schema, columns, rows);
+        return check(m_parquetWriter->WriteTable(*table, rows));
+    }
+    std::shared_ptr<arrow::RecordBatch> batch = arrow::RecordBatch::Make(m_schema, rows, columns);
+    return check(m_ipcWriter->WriteRecordBatch(*batch));
+}
+
+bool ArrowStudentWriter::close()
+{
+    if (!flushBatch()) {
+        discard();
+        return false;
+    }
+    
+    arrow::Status status = m_parquetWriter ? m_parquetWriter->Close() : m_ipcWriter->Close();
+    if (!check(status) || !check(m_output->Close())) {
+        discard();
+        return false;
+    }
+    
+    // Replace the target only now, like QSaveFile does for the other formats
+    QFile::remove(m_filePath);
+    if (!QFile::rename(m_partPath, m_filePath)) {
+        m_error = QString("Could not rename %1 to %2").arg(m_partPath, m_filePath);
+        QFile::remove(m_partPath);
+        return false;
+    }
+    return true;
+}
+
+void ArrowStudentWriter::discard()
+{
+    if (m_output && !m_output->closed()) {
+        (void)m_output->Close();
+    }
+    QFile::remove(m_partPath);
+}
+
+#endif // HAVE_ARROW
@@ -0,0 +1,64 @@
+#ifndef ARROWSTUDENTWRITER_H
+#define ARROWSTUDENTWRITER_H
+
+#include "studentwriter.h"
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <arrow/ipc/writer.h>
+#include <parquet/arrow/writer.h>
+#include <array>
+#include <memory>
+
+/**
+ * ArrowStudentWriter - Columnar export as Arrow IPC or Parquet
+ *
+ * Students are appended to one builder per column and written out as a
+ * record batch (IPC) or row group (Parquet) every few tens of thousands of
+ * rows, so memory stays bounded. The columns are typed and named after the
+ * Firestore fields: year is int32, graduation boolean and lastUpdateTime a
+ * UTC millisecond timestamp. Only built with HAVE_ARROW.
+ */
+class ArrowStudentWriter : public StudentWriter
+{
+public:
+    enum Container {
+        Ipc,
+        Parquet
+    };
+    
+    ArrowStudentWriter(const QString& filePath, Container container);
+    ~ArrowStudentWriter() override;
+    
+    bool open() override;
+    bool write(const Student& student) override;
+    bool close() override;
+    void discard() override;
+    QString errorString() const override { return m_error; }
+
+private:
+    enum StringColumn {
+        Id, Name, Email, Description, Field, School, Number, PhotoURL,
+        StringColumnCount
+    };
+    
+    bool flushBatch();
+    bool check(const arrow::Status& status);
+    
+    QString m_filePath;
+    QString m_partPath; // Written here, renamed over m_filePath by close()
+    Container m_container;
+    QString m_error;
+    
+    std::shared_ptr<arrow::Schema> m_schema;
+    std::shared_ptr<arrow::io::FileOutputStream> m_output;
+    std::shared_ptr<arrow::ipc::RecordBatchWriter> m_ipcWriter;
+    std::unique_ptr<parquet::arrow::FileWriter> m_parquetWriter;
+    
+    std::array<arrow::StringBuilder, StringColumnCount> m_strings;
+    arrow::Int32Builder m_year;
+    arrow::BooleanBuilder m_graduation;
+    std::unique_ptr<arrow::TimestampBuilder> m_lastUpdateTime;
+    int64_t m_pendingRows;
+};
+
+#endif // ARROWSTUDENTWRITER_H
@@ -0,0 +1,261 @@
+#include "changefeed.h"
+#include "firestoreservice.h"
+#include "firestorequery.h"
+#include "studentstore.h"
+#include "writeoutbox.h"
+#include <QTimeZone>
+
+Q_LOGGING_CATEGORY(changeFeedLog, "firestore.changefeed")
+
+namespace {
+const char* const DeltaTag = "changefeed:delta";
+const char* const KeysTag = "changefeed:keys";
+
+// Documents per delta page; a full page is followed by the next one at once
+const int DeltaPageSize = 500;
+
+// Keys-only scan for deletions every N polls, in pages of this many keys
+const int RemovalCheckEvery = 10;
+const int KeysPageSize = 1000;
+
+// lastUpdateTime is written by clients, so a late writer with a slightly
+// behind clock can land just before the token. Re-read this window on every
+// poll; unchanged documents are dropped by the store merge.
+const int ClockSkewSeconds = 120;
+
+const int MaxBackoff = 5 * 60 * 1000;
+}
+
+ChangeFeed::ChangeFeed(FirestoreService* firestoreService, StudentStore* store, QObject *parent)
+    : QObject(parent)
+    , m_firestoreService(firestoreService)
+    , m_store(store)
+    , m_outbox(nullptr)
+    , m_pollTimer(new QTimer(this))
+    , m_interval(30000)
+    , m_currentDelay(30000)
+    , m_pollCount(0)
+    , m_running(false)
+    , m_requestInFlight(false)
+{
+    m_pollTimer->setSingleShot(true);
+    connect(m_pollTimer, &QTimer::timeout, this, &ChangeFeed::poll);
+    connect(m_firestoreService, &FirestoreService::queryResultsReceived,
+            this, &ChangeFeed::onQueryResultsReceived);
+    connect(m_firestoreService, &FirestoreService::queryFailed,
+            this, &ChangeFeed::onQueryFailed);
+}
+
+void ChangeFeed::setInterval(int milliseconds)
+{
+    m_interval = qMax(1000, milliseconds);
+    m_currentDelay = m_interval;
+}
+
+void ChangeFeed::start(const QDateTime& resumeToken)
+{
+    m_resumeToken = resumeToken.isValid() ? resumeToken : m_store->latestUpdateTime();
+    m_running = true;
+    m_pollCount = 0;
+    m_currentDelay = m_interval;
+    qCInfo(changeFeedLog) << "Change feed started, interval:" << m_interval << "ms, resume token:" << m_resumeToken;
+    scheduleNextPoll(m_interval);
+}
+
+void ChangeFeed::stop()
+{
+    m_running = false;
+    m_pollTimer->stop();
+    qCInfo(changeFeedLog) << "Change feed stopped";
+}
+
+void ChangeFeed::scheduleNextPoll(int delay)
+{
+    if (m_running) {
+        m_pollTimer->start(delay);
+    }
+}
+
+void ChangeFeed::poll()
+{
+    if (!m_running || m_requestInFlight) {
+        return;
+    }
+    
+    m_requestInFlight = true;
+    m_pollCount++;
+    
+    if (m_pollCount % RemovalCheckEvery == 0) {
+        qCDebug(changeFeedLog) << "Scanning document keys for deletions";
+        m_remoteIds.clear();
+        m_keysCursor.clear();
+        m_keysReadTime = QDateTime();
+        requestKeysPage();
+        return;
+    }
+    
+    m_deltaSince = m_resumeToken.isValid()
+        ? m_resumeToken.addSecs(-ClockSkewSeconds)
+        : QDateTime::fromSecsSinceEpoch(0, QTimeZone::utc());
+    m_deltaCursorId.clear();
+    
+    qCDebug(changeFeedLog) << "Polling changes since" << m_deltaSince;
+    requestDeltaPage();
+}
+
+void ChangeFeed::requestDeltaPage()
+{
+    // lastUpdateTime has whole seconds, so one value can hold more than a
+    // page of documents; the document name breaks the tie for the cursor
+    FirestoreQuery deltaQuery;
+    deltaQuery.where("lastUpdateTime", FirestoreQuery::GreaterThan, m_deltaSince.toUTC().toString(Qt::ISODate))
+              .orderBy("lastUpdateTime", FirestoreQuery::Ascending)
+              .orderBy("__name__", FirestoreQuery::Ascending)
+              .limit(DeltaPageSize)
+              .select(FirestoreService::listProjection());
+    if (!m_deltaCursorId.isEmpty()) {
+        QJsonObject reference;
+        reference["referenceValue"] = m_firestoreService->documentName(m_deltaCursorId);
+        QJsonObject cursor;
+        cursor["values"] = QJsonArray{FirestoreQuery::encodeValue(m_deltaCursorTime), reference};
+        deltaQuery.startAfter(cursor);
+    }
+    m_firestoreService->runQuery(deltaQuery, DeltaTag);
+}
+
+void ChangeFeed::requestKeysPage()
+{
+    // Keys-only query: documents come back with a name and no fields
+    FirestoreQuery keysQuery;
+    keysQuery.select({"__name__"})
+             .orderBy("__name__", FirestoreQuery::Ascending)
+             .limit(KeysPageSize);
+    if (!m_keysCursor.isEmpty()) {
+        QJsonObject reference;
+        reference["referenceValue"] = m_firestoreService->documentName(m_keysCursor);
+        QJsonObject cursor;
+        cursor["values"] = QJsonArray{reference};
+        keysQuery.startAfter(cursor);
+    }
+    m_firestoreService->runQuery(keysQuery, KeysTag);
+}
+
+void ChangeFeed::finishKeysScan()
+{
+    // Without a readTime a fresh local create cannot be told from a deletion
+    if (!m_keysReadTime.isValid()) {
+        qCWarning(changeFeedLog) << "Key scan returned no readTime, skipping deletions";
+        m_remoteIds.clear();
+        return;
+    }
+    
+    QStringList removed;
+    const QSet<QString> localIds = m_store->ids();
+    const QSet<QString> pendingIds = m_outbox ? m_outbox->pendingIds() : QSet<QString>();
+    for (const QString& localId : localIds) {
+        if (m_remoteIds.contains(localId) || pendingIds.contains(localId)) {
+            continue;
+        }
+        // Written after the server evaluated the scan: not in it, but not deleted
+        QDateTime updated = QDateTime::fromString(m_store->student(localId).getUpdateTime(), Qt::ISODateWithMs);
+        if (updated.isValid() && updated >= m_keysReadTime) {
+            continue;
+        }
+        removed.append(localId);
+    }
+    m_remoteIds.clear();
+    
+    if (!removed.isEmpty()) {
+        qCInfo(changeFeedLog) << "Removing" << removed.size() << "documents deleted on the server";
+        m_store->removeMany(removed);
+        emit changesApplied(0, removed.size());
+    }
+}
+
+void ChangeFeed::onQueryResultsReceived(const QString& tag, const QList<Student>& students, const QDateTime& readTime)
+{
+    if (tag != DeltaTag && tag != KeysTag) {
+        return;
+    }
+    
+    m_currentDelay = m_interval;
+    
+    if (tag == KeysTag) {
+        for (const Student& student : students) {
+            m_remoteIds.insert(student.getId());
+        }
+        // Pages are read at different times; the earliest bounds them all
+        if (readTime.isValid() && (!m_keysReadTime.isValid() || readTime < m_keysReadTime)) {
+            m_keysReadTime = readTime;
+        }
+        if (students.size() >= KeysPageSize) {
+            if (!m_running) {
+                // Stopped halfway; an incomplete scan must not remove anything
+                m_requestInFlight = false;
+                m_remoteIds.clear();
+                return;
+            }
+            m_keysCursor = students.last().getId();
+            requestKeysPage();
+            return;
+        }
+        
+        m_requestInFlight = false;
+        finishKeysScan();
+        scheduleNextPoll(m_interval);
+        return;
+    }
+    
+    // Only documents that differ from the local copy count as changes
+    QList<Student> changed;
+    for (const Student& student : students) {
+        if (student.getLastUpdateTime() > m_resumeToken) {
+            m_resumeToken = student.getLastUpdateTime();
+        }
+        if (m_outbox && m_outbox->hasPendingWrite(student.getId())) {
+            continue;
+        }
+        if (!m_store->contains(student.getId()) ||
+            m_store->student(student.getId()).getLastUpdateTime() != student.getLastUpdateTime()) {
+            changed.append(student);
+        }
+    }
+    
+    if (!changed.isEmpty()) {
+        qCInfo(changeFeedLog) << "Applying" << changed.size() << "remote changes, resume token now" << m_resumeToken;
+        m_store->upsertMany(changed);
+        emit changesApplied(changed.size(), 0);
+    }
+    
+    // A full page means more changes are waiting: continue after its last
+    // document until a short page comes back
+    if (students.size() >= DeltaPageSize && m_running) {
+        const Student& last = students.last();
+        m_deltaCursorTime = last.getLastUpdateTime().toString(Qt::ISODate);
+        m_deltaCursorId = last.getId();
+        requestDeltaPage();
+        return;
+    }
+    
+    m_requestInFlight = false;
+    scheduleNextPoll(m_interval);
+}
+
+void ChangeFeed::onQueryFailed(const QString& tag, const QString& error)
+{
+    if (tag != DeltaTag && tag != KeysTag) {
+        return;
+    }
+    
+    m_requestInFlight = false;
+    if (tag == KeysTag) {
+        // Retry the whole deletion scan on the next poll
+        m_pollCount--;
+        m_remoteIds.clear();
+    }
+    
+    m_currentDelay = qMin(m_currentDelay * 2, MaxBackoff);
+    qCWarning(changeFeedLog) << "Change feed poll failed:" << error << "- retrying in" << m_currentDelay << "ms";
+    emit feedError(error);
+    scheduleNextPoll(m_currentDelay);
+}
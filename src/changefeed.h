@@ -0,0 +1,90 @@
+#ifndef CHANGEFEED_H
+#define CHANGEFEED_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QSet>
+#include <QTimer>
+#include <QLoggingCategory>
+#include "student.h"
+
+Q_DECLARE_LOGGING_CATEGORY(changeFeedLog)
+
+class FirestoreService;
+class StudentStore;
+class WriteOutbox;
+
+/**
+ * ChangeFeed - Pushes other operators' edits into the local StudentStore
+ *
+ * The Firestore Listen/WebChannel protocol is only available to the gRPC
+ * and JavaScript SDKs, so this is a long-poll delta loop over runQuery:
+ *   - every interval, fetch documents with lastUpdateTime past the resume
+ *     token (list projection, ordered by lastUpdateTime and document name)
+ *     and upsert them, paging with a (lastUpdateTime, name) cursor until a
+ *     short page comes back;
+ *   - every few polls, page through a keys-only query and drop local
+ *     records whose document no longer exists. Only records last written
+ *     before the scan's readTime are dropped, so a create that commits
+ *     while the scan runs is not mistaken for a deletion.
+ * The resume token is the newest lastUpdateTime seen, so reconnecting after
+ * a network error continues from there instead of refetching the collection.
+ */
+class ChangeFeed : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ChangeFeed(FirestoreService* firestoreService, StudentStore* store, QObject *parent = nullptr);
+    
+    void setInterval(int milliseconds);
+    int interval() const { return m_interval; }
+    
+    // Starts polling from resumeToken; an invalid token resumes from the store contents
+    void start(const QDateTime& resumeToken = QDateTime());
+    void stop();
+    bool isRunning() const { return m_running; }
+    
+    QDateTime resumeToken() const { return m_resumeToken; }
+    
+    // Students with queued local writes keep their local version
+    void setOutbox(const WriteOutbox* outbox) { m_outbox = outbox; }
+
+signals:
+    void changesApplied(int changedCount, int removedCount);
+    void feedError(const QString& error);
+
+private slots:
+    void poll();
+    void onQueryResultsReceived(const QString& tag, const QList<Student>& students, const QDateTime& readTime);
+    void onQueryFailed(const QString& tag, const QString& error);
+
+private:
+    void scheduleNextPoll(int delay);
+    void requestDeltaPage();
+    void requestKeysPage();
+    void finishKeysScan();
+    
+    FirestoreService* m_firestoreService;
+    StudentStore* m_store;
+    const WriteOutbox* m_outbox;
+    QTimer* m_pollTimer;
+    QDateTime m_resumeToken;
+    int m_interval;
+    int m_currentDelay;
+    int m_pollCount;
+    bool m_running;
+    bool m_requestInFlight;
+    
+    // Delta poll in progress
+    QDateTime m_deltaSince; // Lower bound, fixed for all pages of one poll
+    QString m_deltaCursorTime; // lastUpdateTime and ID of the previous page's last document
+    QString m_deltaCursorId;
+    
+    // Deletion scan in progress
+    QSet<QString> m_remoteIds;
+    QString m_keysCursor; // Last document ID of the previous page
+    QDateTime m_keysReadTime; // Earliest readTime of the pages so far
+};
+
+#endif // CHANGEFEED_H
@@ -0,0 +1,188 @@
+#include "csvstream.h"
+
+namespace {
+// Encoded bytes collected before they are written out
+const int WriteBufferSize = 64 * 1024;
+
+// Bytes decoded from the file at a time
+const int ReadChunkSize = 64 * 1024;
+
+const char Separator = ',';
+}
+
+CsvWriter::CsvWriter(const QString& filePath)
+    : m_file(filePath)
+{
+}
+
+bool CsvWriter::open()
+{
+    if (!m_file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    m_buffer.reserve(WriteBufferSize + 4096);
+    m_buffer.append("\xEF\xBB\xBF");
+    return true;
+}
+
+bool CsvWriter::writeRow(const QStringList& fields)
+{
+    for (int i = 0; i < fields.size(); ++i) {
+        if (i > 0) {
+            m_buffer.append(Separator);
+        }
+        const QString& field = fields.at(i);
+        bool needsQuotes = field.contains(Separator) || field.contains('"') || field.contains('\n')
+            || field.contains('\r') || field.contains(';');
+        if (needsQuotes) {
+            QString quoted = field;
+            quoted.replace('"', "\"\"");
+            m_buffer.append('"').append(quoted.toUtf8()).append('"');
+        } else {
+            m_buffer.append(field.toUtf8());
+        }
+    }
+    m_buffer.append("\r\n");
+    
+    return m_buffer.size() < WriteBufferSize || flushBuffer();
+}
+
+bool CsvWriter::flushBuffer()
+{
+    if (m_file.write(m_buffer) != m_buffer.size()) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    m_buffer.clear();
+    return true;
+}
+
+bool CsvWriter::close()
+{
+    return flushBuffer() && m_file.commit();
+}
+
+void CsvWriter::discard()
+{
+    m_file.cancelWriting();
+    m_file.commit();
+}
+
+CsvReader::CsvReader(const QString& filePath)
+    : m_file(filePath)
+    , m_decoder(QStringConverter::Utf8)
+    , m_position(0)
+    , m_record(0)
+    , m_separator(',')
+{
+}
+
+bool CsvReader::open()
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    fill();
+    m_separator = detectSeparator(m_buffer);
+    return !hasError();
+}
+
+QChar CsvReader::detectSeparator(const QString& text)
+{
+    // Whichever of , ; or tab occurs most in the first line, outside quotes
+    int commas = 0;
+    int semicolons = 0;
+    int tabs = 0;
+    bool quoted = false;
+    for (QChar ch : text) {
+        if (ch == '"') {
+            quoted = !quoted;
+        } else if (!quoted && (ch == '\n' || ch == '\r')) {
+            break;
+        } else if (!quoted && ch == ',') {
+            ++commas;
+        } else if (!quoted && ch == ';') {
+            ++semicolons;
+        } else if (!quoted && ch == '\t') {
+            ++tabs;
+        }
+    }
+    if (semicolons > commas && semicolons >= tabs) {
+        return ';';
+    }
+    return tabs > commas ? QChar('\t') : QChar(',');
+}
+
+bool CsvReader::fill()
+{
+    // Keeps the unread tail, so m_position stays valid after the call
+    if (m_file.atEnd()) {
+        return false;
+    }
+    QByteArray bytes = m_file.read(ReadChunkSize);
+    if (bytes.isEmpty()) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    m_buffer = m_buffer.mid(m_position) + m_decoder.decode(bytes);
+    m_position = 0;
+    if (m_decoder.hasError()) {
+        m_error = "Invalid UTF-8";
+        return false;
+    }
+    return true;
+}
+
+bool CsvReader::readRow(int* rowNumber, QVariantList* cells)
+{
+    cells->clear();
+    QString field;
+    bool quoted = false;
+    bool started = false; // Anything of this record read yet
+    
+    while (true) {
+        if (m_position >= m_buffer.size() && !fill()) {
+            if (hasError()) {
+                return false;
+            }
+            if (!started) {
+                return false; // End of file after the last line break
+            }
+            cells->append(field);
+            *rowNumber = ++m_record;
+            return true;
+        }
+        
+        QChar ch = m_buffer.at(m_position++);
+        started = true;
+        
+        if (quoted) {
+            if (ch != '"') {
+                field += ch;
+                continue;
+            }
+            // A doubled quote is a literal one; a single quote ends the field
+            if (m_position >= m_buffer.size()) {
+                fill();
+            }
+            if (m_position < m_buffer.size() && m_buffer.at(m_position) == '"') {
+                field += '"';
+                ++m_position;
+            } else {
+                quoted = false;
+            }
+        } else if (ch == '"' && field.isEmpty()) {
+            quoted = true;
+        } else if (ch == m_separator) {
+            cells->append(field);
+            field.clear();
+        } else if (ch == '\n') {
+            cells->append(field);
+            *rowNumber = ++m_record;
+            return true;
+        } else if (ch != '\r') {
+            field += ch;
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef CSVSTREAM_H
+#define CSVSTREAM_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QSaveFile>
+#include <QString>
+#include <QStringList>
+#include <QStringDecoder>
+#include <QVariantList>
+
+/**
+ * CsvWriter - Writes RFC 4180 CSV through a buffer
+ *
+ * Fields containing the separator, quotes or line breaks are quoted, with
+ * quotes doubled; records end in CRLF. The file starts with a UTF-8 byte
+ * order mark so Excel shows Turkish letters correctly. Like the XLSX
+ * writer, the target is only replaced once close() succeeds.
+ */
+class CsvWriter
+{
+public:
+    explicit CsvWriter(const QString& filePath);
+    
+    bool open();
+    bool writeRow(const QStringList& fields);
+    bool close();
+    void discard(); // Leaves the target untouched
+    
+    QString errorString() const { return m_error.isEmpty() ? m_file.errorString() : m_error; }
+
+private:
+    bool flushBuffer();
+    
+    QSaveFile m_file;
+    QByteArray m_buffer;
+    QString m_error;
+};
+
+/**
+ * CsvReader - Reads RFC 4180 CSV one record at a time
+ *
+ * Quoted fields may contain separators, doubled quotes and line breaks.
+ * The separator is taken from the first line: Excel in a Turkish locale
+ * saves with ';', most other tools with ','. Only a small window of the
+ * file is decoded at a time. Records are numbered from 1 like sheet rows.
+ */
+class CsvReader
+{
+public:
+    explicit CsvReader(const QString& filePath);
+    
+    bool open();
+    bool readRow(int* rowNumber, QVariantList* cells);
+    
+    QChar separator() const { return m_separator; }
+    bool hasError() const { return !m_error.isEmpty(); }
+    QString errorString() const { return m_error; }
+
+private:
+    bool fill();
+    static QChar detectSeparator(const QString& text);
+    
+    QFile m_file;
+    QStringDecoder m_decoder;
+    QString m_buffer;
+    int m_position;
+    int m_record;
+    QChar m_separator;
+    QString m_error;
+};
+
+#endif // CSVSTREAM_H
@@ -0,0 +1,396 @@
+#include "datasetgenerator.h"
+#include "networkaccess.h"
+#include "studentfilter.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QUrl>
+#include <QUuid>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace {
+struct Weighted {
+    const char* text;
+    double weight;
+};
+
+// Rough frequencies among people born in the 1990s and 2000s
+const Weighted FemaleNames[] = {
+    {"ZEYNEP", 60}, {"ELİF", 55}, {"MERVE", 35}, {"AYŞE", 30}, {"ESRA", 30}, {"BÜŞRA", 30},
+    {"FATMA", 28}, {"KÜBRA", 25}, {"DEFNE", 25}, {"AZRA", 22}, {"ECRİN", 20}, {"YAĞMUR", 20},
+    {"ZEHRA", 20}, {"EMİNE", 18}, {"EYLÜL", 18}, {"İREM", 18}, {"BEYZA", 18}, {"SUDE", 15},
+    {"NİSA", 15}, {"HATİCE", 15}, {"SENA", 15}, {"MELİKE", 12}, {"CEREN", 12}, {"DİLARA", 12},
+    {"GİZEM", 12}, {"TUĞBA", 12}, {"RABİA", 12}, {"SELİN", 11}, {"ECE", 10}, {"DAMLA", 10},
+    {"ŞEVVAL", 10}, {"HİLAL", 10}, {"BUSE", 10}, {"ASLI", 8}, {"İLAYDA", 8}, {"NAZLI", 6}
+};
+
+const Weighted MaleNames[] = {
+    {"MEHMET", 60}, {"YUSUF", 50}, {"MUSTAFA", 50}, {"AHMET", 45}, {"ALİ", 35}, {"EMRE", 30},
+    {"MUHAMMED", 30}, {"BURAK", 28}, {"ENES", 25}, {"FURKAN", 25}, {"ÖMER", 25}, {"HÜSEYİN", 25},
+    {"EREN", 22}, {"HASAN", 20}, {"EMİR", 18}, {"İBRAHİM", 18}, {"KEREM", 15}, {"ARDA", 15},
+    {"MURAT", 15}, {"MERT", 15}, {"EFE", 12}, {"BATUHAN", 12}, {"YİĞİT", 12}, {"CAN", 12},
+    {"OĞUZHAN", 10}, {"ONUR", 10}, {"BERK", 10}, {"KAAN", 10}, {"UĞUR", 10}, {"BERAT", 10},
+    {"SERKAN", 6}, {"GÖKHAN", 6}, {"TOLGA", 5}, {"SİNAN", 5}
+};
+
+// Second part of two-part given names
+const char* const FemaleSecondNames[] = {"NUR", "SU", "NAZ", "GÜL", "SENA"};
+const char* const MaleSecondNames[] = {"ALİ", "EMİN", "CAN", "HAN", "EFE"};
+
+const Weighted Surnames[] = {
+    {"YILMAZ", 40}, {"KAYA", 28}, {"DEMİR", 27}, {"ÇELİK", 25}, {"ŞAHİN", 24}, {"YILDIZ", 23},
+    {"YILDIRIM", 21}, {"ÖZTÜRK", 20}, {"AYDIN", 19}, {"ÖZDEMİR", 18}, {"ARSLAN", 17}, {"DOĞAN", 17},
+    {"KILIÇ", 15}, {"ASLAN", 14}, {"ÇETİN", 13}, {"KARA", 13}, {"KOÇ", 12}, {"KURT", 12},
+    {"ÖZKAN", 11}, {"ŞİMŞEK", 11}, {"POLAT", 10}, {"ÖZ", 10}, {"KORKMAZ", 9}, {"ÇAKIR", 9},
+    {"ERDOĞAN", 9}, {"YAVUZ", 8}, {"CAN", 8}, {"ACAR", 8}, {"ŞEN", 7}, {"AKTAŞ", 7},
+    {"GÜLER", 7}, {"YALÇIN", 7}, {"GÜNEŞ", 6}, {"BOZKURT", 6}, {"BULUT", 6}, {"KESKİN", 6},
+    {"ÜNAL", 6}, {"TURAN", 5}, {"GÜL", 5}, {"ÖZER", 5}, {"IŞIK", 5}, {"KAPLAN", 5},
+    {"AVCI", 5}, {"SARI", 5}, {"TEKİN", 4}, {"TAŞ", 4}, {"KÖSE", 4}, {"YÜKSEL", 4},
+    {"ATEŞ", 4}, {"AKSOY", 4}, {"UYSAL", 3}, {"DURMAZ", 3}, {"EROL", 3}, {"KARACA", 3}
+};
+
+// Most popular first; ranks are Zipf-weighted
+const char* const Fields[] = {
+    "BİLGİSAYAR MÜHENDİSLİĞİ", "TIP", "HUKUK", "İŞLETME", "PSİKOLOJİ", "HEMŞİRELİK",
+    "ELEKTRİK-ELEKTRONİK MÜHENDİSLİĞİ", "MAKİNE MÜHENDİSLİĞİ", "İNŞAAT MÜHENDİSLİĞİ",
+    "ENDÜSTRİ MÜHENDİSLİĞİ", "İKTİSAT", "SINIF ÖĞRETMENLİĞİ", "İNGİLİZCE ÖĞRETMENLİĞİ",
+    "MİMARLIK", "DİŞ HEKİMLİĞİ", "ECZACILIK", "ULUSLARARASI İLİŞKİLER",
+    "SİYASET BİLİMİ VE KAMU YÖNETİMİ", "İLAHİYAT", "FİZYOTERAPİ VE REHABİLİTASYON",
+    "MOLEKÜLER BİYOLOJİ VE GENETİK", "BESLENME VE DİYETETİK", "GRAFİK TASARIM", "MATEMATİK",
+    "TÜRK DİLİ VE EDEBİYATI", "TARİH", "SOSYOLOJİ", "FİZİK", "KİMYA", "VETERİNER",
+    "GASTRONOMİ VE MUTFAK SANATLARI", "YAZILIM MÜHENDİSLİĞİ"
+};
+
+const char* const Descriptions[] = {
+    "Burs alıyor", "Yurtta kalıyor", "Çift anadal yapıyor", "Erasmus ile yurt dışında",
+    "Yüksek lisansa devam ediyor", "Mezuniyet sonrası iş arıyor", "Derneğin etkinliklerinde gönüllü",
+    "Hazırlık sınıfında"
+};
+
+// The largest universities by enrolment lead the ranking; the others
+// follow in an order drawn from the seed
+const char* const LargeSchools[] = {
+    "ANADOLU ÜNİVERSİTESİ", "İSTANBUL ÜNİVERSİTESİ", "ATATÜRK ÜNİVERSİTESİ", "ANKARA ÜNİVERSİTESİ",
+    "GAZİ ÜNİVERSİTESİ", "MARMARA ÜNİVERSİTESİ", "EGE ÜNİVERSİTESİ", "SELÇUK ÜNİVERSİTESİ",
+    "DOKUZ EYLÜL ÜNİVERSİTESİ", "SAKARYA ÜNİVERSİTESİ", "HACETTEPE ÜNİVERSİTESİ",
+    "İSTANBUL TEKNİK ÜNİVERSİTESİ", "ORTA DOĞU TEKNİK ÜNİVERSİTESİ", "YILDIZ TEKNİK ÜNİVERSİTESİ",
+    "ÇUKUROVA ÜNİVERSİTESİ", "BURSA ULUDAĞ ÜNİVERSİTESİ", "KOCAELİ ÜNİVERSİTESİ",
+    "KARADENİZ TEKNİK ÜNİVERSİTESİ", "ONDOKUZ MAYIS ÜNİVERSİTESİ", "ERCİYES ÜNİVERSİTESİ"
+};
+
+const Weighted EmailDomains[] = {
+    {"gmail.com", 60}, {"hotmail.com", 20}, {"outlook.com", 8}, {"yahoo.com", 4},
+    {"icloud.com", 3}, {"yandex.com", 2}
+};
+
+// Mobile prefixes after the leading 0: Turkcell 53x, Vodafone 54x,
+// Türk Telekom 50x and 55x, weighted roughly by subscribers
+const Weighted PhonePrefixes[] = {
+    {"530", 5}, {"531", 4}, {"532", 6}, {"533", 5}, {"534", 4}, {"535", 5}, {"536", 4},
+    {"537", 3}, {"538", 3}, {"539", 3}, {"541", 3}, {"542", 5}, {"543", 4}, {"544", 4},
+    {"545", 4}, {"546", 3}, {"547", 3}, {"548", 2}, {"549", 2}, {"501", 3}, {"505", 4},
+    {"506", 4}, {"507", 3}, {"551", 2}, {"552", 2}, {"553", 2}, {"554", 2}, {"555", 3}
+};
+
+// Weight of 0, 1, 2, ... years since high school
+const double YearWeights[] = {12, 14, 14, 13, 12, 10, 8, 6, 5, 4, 3, 2, 2, 1, 1};
+
+const double TwoPartNameRate = 0.1;
+const double MissingEmailRate = 0.03;
+const double MissingPhoneRate = 0.04;
+const double NoFieldRate = 0.08; // Did not go to university
+const double DescriptionRate = 0.15;
+const int UpdateWindowDays = 730;
+
+template<size_t N>
+QList<double> weightsOf(const Weighted (&table)[N])
+{
+    QList<double> weights;
+    weights.reserve(N);
+    for (const Weighted& entry : table) {
+        weights.append(entry.weight);
+    }
+    return weights;
+}
+
+// Lower-case ASCII for e-mail addresses: Ç->c, Ğ->g, İ/I->i, Ö->o, Ş->s, Ü->u
+QString asciiFold(const QString& upper)
+{
+    QString folded;
+    folded.reserve(upper.size());
+    for (QChar ch : upper) {
+        switch (ch.unicode()) {
+        case 0x00C7: folded += 'c'; break;
+        case 0x011E: folded += 'g'; break;
+        case 0x0130: folded += 'i'; break;
+        case 0x00D6: folded += 'o'; break;
+        case 0x015E: folded += 's'; break;
+        case 0x00DC: folded += 'u'; break;
+        case ' ': case '-': break;
+        default: folded += ch.toLower();
+        }
+    }
+    return folded;
+}
+}
+
+DatasetGenerator::DatasetGenerator(quint32 seed)
+    : m_random(seed)
+    , m_seed(seed)
+    , m_skew(1.0)
+    , m_photoRate(0.7)
+    , m_referenceTime(QDateTime::currentDateTimeUtc())
+    , m_sequence(0)
+{
+    m_femaleNameDistribution.setWeights(weightsOf(FemaleNames));
+    m_maleNameDistribution.setWeights(weightsOf(MaleNames));
+    m_surnameDistribution.setWeights(weightsOf(Surnames));
+    m_domainDistribution.setWeights(weightsOf(EmailDomains));
+    m_phonePrefixDistribution.setWeights(weightsOf(PhonePrefixes));
+    m_yearDistribution.setWeights(QList<double>(std::begin(YearWeights), std::end(YearWeights)));
+    m_fieldDistribution.setZipf(int(std::size(Fields)), m_skew);
+    setProjectId("demo");
+    
+    QStringList schools;
+    for (const char* school : LargeSchools) {
+        schools.append(QString::fromUtf8(school));
+    }
+    setSchools(schools);
+}
+
+bool DatasetGenerator::loadSchools(const QString& filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    
+    QStringList schools;
+    const QJsonArray array = QJsonDocument::fromJson(file.readAll()).array();
+    for (const QJsonValue& value : array) {
+        if (value.isString()) {
+            schools.append(value.toString());
+        }
+    }
+    if (schools.isEmpty()) {
+        return false;
+    }
+    setSchools(schools);
+    return true;
+}
+
+void DatasetGenerator::setSchools(const QStringList& schools)
+{
+    m_schools = schools;
+    rankSchools();
+}
+
+void DatasetGenerator::setSkew(double exponent)
+{
+    m_skew = qMax(0.0, exponent);
+    m_fieldDistribution.setZipf(int(std::size(Fields)), m_skew);
+    m_schoolDistribution.setZipf(m_schools.size(), m_skew);
+}
+
+void DatasetGenerator::setPhotoRate(double rate)
+{
+    m_photoRate = qBound(0.0, rate, 1.0);
+}
+
+void DatasetGenerator::setProjectId(const QString& projectId, const QString& origin)
+{
+    // Same form as FirebaseStorageService download URLs
+    m_photoBaseUrl = (origin.isEmpty() ? NetworkAccess::origin(NetworkAccess::Storage) : origin)
+                     + QString("/v0/b/%1.appspot.com/o").arg(projectId);
+}
+
+void DatasetGenerator::setReferenceTime(const QDateTime& time)
+{
+    m_referenceTime = time.toUTC();
+}
+
+QString DatasetGenerator::photoPath(const QString& studentId)
+{
+    return QString("student_photos/%1.jpg").arg(studentId);
+}
+
+void DatasetGenerator::rankSchools()
+{
+    // Known large universities first, the rest shuffled with their own
+    // generator so the ranking does not shift the record stream
+    QStringList ranked;
+    for (const char* school : LargeSchools) {
+        QString name = QString::fromUtf8(school);
+        if (m_schools.contains(name)) {
+            ranked.append(name);
+        }
+    }
+    QStringList others;
+    for (const QString& school : std::as_const(m_schools)) {
+        if (!ranked.contains(school)) {
+            others.append(school);
+        }
+    }
+    QRandomGenerator shuffle(m_seed);
+    for (int i = others.size() - 1; i > 0; --i) {
+        others.swapItemsAt(i, shuffle.bounded(i + 1));
+    }
+    
+    m_schools = ranked + others;
+    m_schoolDistribution.setZipf(m_schools.size(), m_skew);
+}
+
+Student DatasetGenerator::next()
+{
+    m_sequence++;
+    Student student;
+    student.setId(nextId());
+    
+    bool female = m_random.bounded(2) == 0;
+    QString givenName = female ? QString::fromUtf8(FemaleNames[m_femaleNameDistribution.sample(m_random)].text)
+                               : QString::fromUtf8(MaleNames[m_maleNameDistribution.sample(m_random)].text);
+    if (m_random.generateDouble() < TwoPartNameRate) {
+        QString second = female ? QString::fromUtf8(FemaleSecondNames[m_random.bounded(int(std::size(FemaleSecondNames)))])
+                                : QString::fromUtf8(MaleSecondNames[m_random.bounded(int(std::size(MaleSecondNames)))]);
+        if (second != givenName) {
+            givenName += " " + second;
+        }
+    }
+    QString surname = QString::fromUtf8(Surnames[m_surnameDistribution.sample(m_random)].text);
+    student.setName(givenName + " " + surname);
+    
+    if (m_random.generateDouble() >= MissingEmailRate) {
+        student.setEmail(nextEmail(givenName, surname));
+    }
+    if (m_random.generateDouble() >= MissingPhoneRate) {
+        student.setNumber(nextPhone());
+    }
+    
+    QString school = m_schools.at(m_schoolDistribution.sample(m_random));
+    
+    // Recent high-school graduates are still at university; most of
+    // those five or more years out have graduated
+    int yearsSince = m_yearDistribution.sample(m_random);
+    student.setYear(m_referenceTime.date().year() - yearsSince);
+    bool studying = m_random.generateDouble() >= NoFieldRate;
+    if (studying) {
+        student.setSchool(school);
+        student.setField(QString::fromUtf8(Fields[m_fieldDistribution.sample(m_random)]));
+        double graduated = yearsSince < 4 ? 0.01 : yearsSince == 4 ? 0.25 : yearsSince == 5 ? 0.55 : 0.85;
+        student.setGraduation(m_random.generateDouble() < graduated);
+    } else {
+        // Stored the way the dialog stores "did not go to university"
+        student.setSchool(StudentFilter::NoUniversitySchool);
+        student.setGraduation(false);
+    }
+    
+    if (m_random.generateDouble() < DescriptionRate) {
+        student.setDescription(QString::fromUtf8(Descriptions[m_random.bounded(int(std::size(Descriptions)))]));
+    }
+    
+    if (m_random.generateDouble() < m_photoRate) {
+        student.setPhotoURL(QString("%1/%2?alt=media&token=%3")
+                                .arg(m_photoBaseUrl,
+                                     QString::fromLatin1(QUrl::toPercentEncoding(photoPath(student.getId()))),
+                                     nextToken()));
+    }
+    
+    // Edits cluster in the recent past
+    double age = m_random.generateDouble();
+    qint64 secondsAgo = qint64(age * age * UpdateWindowDays * 24 * 3600);
+    student.setLastUpdateTime(m_referenceTime.addSecs(-secondsAgo));
+    
+    // A fresh record, not an edit of one
+    student.clearDirty();
+    return student;
+}
+
+QList<Student> DatasetGenerator::generate(int count)
+{
+    QList<Student> students;
+    students.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        students.append(next());
+    }
+    return students;
+}
+
+QString DatasetGenerator::nextId()
+{
+    // The Firestore auto-ID alphabet, from the seeded generator
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+    QString id;
+    id.reserve(20);
+    for (int i = 0; i < 20; ++i) {
+        id += QLatin1Char(alphabet[m_random.bounded(62)]);
+    }
+    return id;
+}
+
+QString DatasetGenerator::nextPhone()
+{
+    // 05XX XXX XX XX
+    QString prefix = QString::fromLatin1(PhonePrefixes[m_phonePrefixDistribution.sample(m_random)].text);
+    return QString("0%1 %2 %3 %4")
+        .arg(prefix)
+        .arg(m_random.bounded(1000), 3, 10, QChar('0'))
+        .arg(m_random.bounded(100), 2, 10, QChar('0'))
+        .arg(m_random.bounded(100), 2, 10, QChar('0'));
+}
+
+QString DatasetGenerator::nextEmail(const QString& givenName, const QString& surname)
+{
+    // The sequence number keeps addresses unique, as the duplicate check
+    // on import expects of real data
+    QString first = asciiFold(givenName.section(' ', 0, 0));
+    QString last = asciiFold(surname);
+    QString local;
+    switch (m_random.bounded(3)) {
+    case 0: local = QString("%1.%2%3").arg(first, last).arg(m_sequence); break;
+    case 1: local = QString("%1%2%3").arg(first, last).arg(m_sequence); break;
+    default: local = QString("%1_%2%3").arg(first, last).arg(m_sequence); break;
+    }
+    return local + "@" + QString::fromLatin1(EmailDomains[m_domainDistribution.sample(m_random)].text);
+}
+
+QString DatasetGenerator::nextToken()
+{
+    // Storage download tokens are UUIDs
+    quint32 parts[4];
+    m_random.fillRange(parts);
+    QUuid uuid(parts[0], quint16(parts[1] >> 16), quint16(parts[1]),
+               uchar(parts[2] >> 24), uchar(parts[2] >> 16), uchar(parts[2] >> 8), uchar(parts[2]),
+               uchar(parts[3] >> 24), uchar(parts[3] >> 16), uchar(parts[3] >> 8), uchar(parts[3]));
+    return uuid.toString(QUuid::WithoutBraces);
+}
+
+void DatasetGenerator::Distribution::setWeights(const QList<double>& weights)
+{
+    cumulative.clear();
+    cumulative.reserve(weights.size());
+    double total = 0;
+    for (double weight : weights) {
+        total += weight;
+        cumulative.append(total);
+    }
+}
+
+void DatasetGenerator::Distribution::setZipf(int count, double exponent)
+{
+    // Rank k (from 1) has weight 1/k^s
+    QList<double> weights;
+    weights.reserve(count);
+    for (int rank = 1; rank <= count; ++rank) {
+        weights.append(1.0 / std::pow(rank, exponent));
+    }
+    setWeights(weights);
+}
+
+int DatasetGenerator::Distribution::sample(QRandomGenerator& random) const
+{
+    double point = random.generateDouble() * cumulative.last();
+    auto it = std::upper_bound(cumulative.begin(), cumulative.end(), point);
+    return qMin(int(it - cumulative.begin()), int(cumulative.size()) - 1);
+}
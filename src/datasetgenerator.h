@@ -0,0 +1,85 @@
+#ifndef DATASETGENERATOR_H
+#define DATASETGENERATOR_H
+
+#include <QDateTime>
+#include <QList>
+#include <QRandomGenerator>
+#include <QString>
+#include <QStringList>
+#include "student.h"
+
+/**
+ * DatasetGenerator - Synthetic but plausible students for benchmarks
+ *
+ * Given names and surnames come from frequency-weighted Turkish lists, with
+ * a share of two-part given names, so common names repeat as they do in
+ * real data. Schools (universities.json) and fields follow a Zipf law: a few
+ * large universities and popular departments hold most students. The year
+ * is the high-school graduation year, mostly the last few years, and
+ * university graduation follows from it. Phone numbers use real mobile
+ * operator prefixes in the dialog's 05XX XXX XX XX form, e-mails are built
+ * from the name, and some students get a Storage download URL as photo.
+ * Names and fields are upper case with Turkish rules, as the dialog stores
+ * them.
+ *
+ * The same seed gives the same students, IDs included; only lastUpdateTime
+ * moves with the reference time. Not thread-safe; use a generator (and
+ * seed) per thread.
+ */
+class DatasetGenerator
+{
+public:
+    explicit DatasetGenerator(quint32 seed = 1);
+    
+    bool loadSchools(const QString& filePath); // universities.json
+    void setSchools(const QStringList& schools);
+    QStringList schools() const { return m_schools; }
+    
+    void setSkew(double exponent);  // Zipf exponent for schools and fields, default 1.0
+    void setPhotoRate(double rate); // Share of students with a photo, default 0.7
+    // Bucket of the photo URLs; origin defaults to NetworkAccess::origin()
+    void setProjectId(const QString& projectId, const QString& origin = QString());
+    void setReferenceTime(const QDateTime& time); // Latest lastUpdateTime, default now
+    
+    Student next();
+    QList<Student> generate(int count);
+    
+    // student_photos/<id>.jpg, as the dialog and photo import store them
+    static QString photoPath(const QString& studentId);
+
+private:
+    // Cumulative weights, sampled by binary search
+    struct Distribution {
+        QList<double> cumulative;
+        
+        void setWeights(const QList<double>& weights);
+        void setZipf(int count, double exponent);
+        int sample(QRandomGenerator& random) const;
+    };
+    
+    QString nextId();
+    QString nextPhone();
+    QString nextEmail(const QString& givenName, const QString& surname);
+    QString nextToken();
+    void rankSchools();
+    
+    QRandomGenerator m_random;
+    quint32 m_seed;
+    QStringList m_schools; // Most popular first
+    double m_skew;
+    double m_photoRate;
+    QString m_photoBaseUrl;
+    QDateTime m_referenceTime;
+    qint64 m_sequence;
+    
+    Distribution m_femaleNameDistribution;
+    Distribution m_maleNameDistribution;
+    Distribution m_surnameDistribution;
+    Distribution m_schoolDistribution;
+    Distribution m_fieldDistribution;
+    Distribution m_yearDistribution;
+    Distribution m_domainDistribution;
+    Distribution m_phonePrefixDistribution;
+};
+
+#endif // DATASETGENERATOR_H
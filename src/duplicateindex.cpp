@@ -0,0 +1,214 @@
+#include "duplicateindex.h"
+#include <QLocale>
+#include <QRegularExpression>
+#include <QSet>
+#include <QVector>
+#include <algorithm>
+
+namespace {
+// Folded letters of the name that go into the blocking key
+const int BlockPrefixLength = 3;
+}
+
+DuplicateIndex::DuplicateIndex(const QList<Student>& students)
+{
+    m_students.reserve(students.size());
+    for (const Student& student : students) {
+        add(student);
+    }
+}
+
+QString DuplicateIndex::foldText(const QString& text)
+{
+    static const QLocale turkish(QLocale::Turkish, QLocale::Turkey);
+    QString key = turkish.toLower(text.trimmed());
+    
+    static const QHash<QChar, QChar> folds = {
+        {QChar(0x00E7), 'c'}, {QChar(0x011F), 'g'}, {QChar(0x0131), 'i'},
+        {QChar(0x00F6), 'o'}, {QChar(0x015F), 's'}, {QChar(0x00FC), 'u'},
+        {QChar(0x00E2), 'a'}, {QChar(0x00EE), 'i'}, {QChar(0x00FB), 'u'}
+    };
+    for (QChar& ch : key) {
+        ch = folds.value(ch, ch);
+    }
+    
+    static const QRegularExpression separators("[\\s_.\\-]+");
+    key.replace(separators, " ");
+    return key.trimmed();
+}
+
+QString DuplicateIndex::emailKey(const QString& email)
+{
+    return email.trimmed().toLower();
+}
+
+QString DuplicateIndex::phoneKey(const QString& phone)
+{
+    QString key;
+    key.reserve(phone.size());
+    for (QChar ch : phone) {
+        if (ch >= '0' && ch <= '9') {
+            key.append(ch);
+        }
+    }
+    
+    // Trunk prefix 0 (or 00 before the country code), then the country code
+    int zeros = 0;
+    while (zeros < key.size() && key.at(zeros) == '0') {
+        ++zeros;
+    }
+    key.remove(0, zeros);
+    if (key.size() == 12 && key.startsWith("90")) {
+        key.remove(0, 2);
+    }
+    return key;
+}
+
+QString DuplicateIndex::blockKey(const QString& foldedName, int year)
+{
+    QString compact = foldedName;
+    compact.remove(' ');
+    return compact.left(BlockPrefixLength) + '|' + QString::number(year);
+}
+
+bool DuplicateIndex::conflicts(const QString& a, const QString& b)
+{
+    return !a.isEmpty() && !b.isEmpty() && a != b;
+}
+
+bool DuplicateIndex::similarNames(const QString& a, const QString& b)
+{
+    if (a == b) {
+        return true;
+    }
+    
+    // One typo in a short name, two in a longer one
+    int allowed = qMin(a.size(), b.size()) < 8 ? 1 : 2;
+    if (qAbs(a.size() - b.size()) > allowed) {
+        return false;
+    }
+    
+    // Levenshtein distance, stopping once a row exceeds the allowance
+    QVector<int> previous(b.size() + 1);
+    QVector<int> current(b.size() + 1);
+    for (int j = 0; j <= b.size(); ++j) {
+        previous[j] = j;
+    }
+    for (int i = 1; i <= a.size(); ++i) {
+        current[0] = i;
+        int rowMinimum = current[0];
+        for (int j = 1; j <= b.size(); ++j) {
+            int substitution = previous[j - 1] + (a.at(i - 1) == b.at(j - 1) ? 0 : 1);
+            current[j] = std::min({previous[j] + 1, current[j - 1] + 1, substitution});
+            rowMinimum = qMin(rowMinimum, current[j]);
+        }
+        if (rowMinimum > allowed) {
+            return false;
+        }
+        std::swap(previous, current);
+    }
+    return previous[b.size()] <= allowed;
+}
+
+void DuplicateIndex::add(const Student& student)
+{
+    m_students.insert(student.getId(), student);
+    
+    QString email = emailKey(student.getEmail());
+    if (!email.isEmpty()) {
+        m_byEmail.insert(email, student.getId());
+    }
+    QString phone = phoneKey(student.getNumber());
+    if (!phone.isEmpty()) {
+        m_byPhone.insert(phone, student.getId());
+    }
+    QString name = foldText(student.getName());
+    if (!name.isEmpty()) {
+        m_byBlock.insert(blockKey(name, student.getYear()), student.getId());
+    }
+}
+
+DuplicateIndex::Match DuplicateIndex::classify(const Student& candidate) const
+{
+    Match match;
+    QString email = emailKey(candidate.getEmail());
+    QString phone = phoneKey(candidate.getNumber());
+    
+    // E-mail and phone number identify a student outright
+    QList<QString> ids;
+    if (!email.isEmpty()) {
+        ids = m_byEmail.values(email);
+        match.matchedBy = "email";
+    }
+    if (ids.isEmpty() && !phone.isEmpty()) {
+        ids = m_byPhone.values(phone);
+        match.matchedBy = "phone";
+    }
+    
+    // Otherwise a near-identical name in the same year, unless the two
+    // records carry different e-mails or phone numbers
+    if (ids.isEmpty()) {
+        match.matchedBy = "name";
+        QString name = foldText(candidate.getName());
+        const QList<QString> block = m_byBlock.values(blockKey(name, candidate.getYear()));
+        for (const QString& id : block) {
+            const Student existing = m_students.value(id);
+            if (conflicts(email, emailKey(existing.getEmail()))
+                || conflicts(phone, phoneKey(existing.getNumber()))) {
+                continue;
+            }
+            if (similarNames(name, foldText(existing.getName()))) {
+                ids.append(id);
+            }
+        }
+    }
+    
+    if (ids.isEmpty()) {
+        match.matchedBy.clear();
+        return match;
+    }
+    if (QSet<QString>(ids.begin(), ids.end()).size() > 1) {
+        match.status = Ambiguous;
+        return match;
+    }
+    
+    match.studentId = ids.first();
+    if (match.matchedBy == "name" && foldText(m_students.value(match.studentId).getName()) != foldText(candidate.getName())) {
+        match.status = Similar;
+        return match;
+    }
+    match.changedFields = diff(m_students.value(match.studentId), candidate);
+    match.status = match.changedFields.isEmpty() ? Identical : Changed;
+    return match;
+}
+
+QStringList DuplicateIndex::diff(const Student& existing, const Student& incoming)
+{
+    QStringList fields;
+    if (existing.getName() != incoming.getName()) {
+        fields.append("name");
+    }
+    if (existing.getEmail() != incoming.getEmail()) {
+        fields.append("email");
+    }
+    if (!existing.isPartial() && existing.getDescription() != incoming.getDescription()) {
+        fields.append("description");
+    }
+    if (existing.getField() != incoming.getField()) {
+        fields.append("field");
+    }
+    if (existing.getSchool() != incoming.getSchool()) {
+        fields.append("school");
+    }
+    // The same phone number written another way is not a change
+    if (phoneKey(existing.getNumber()) != phoneKey(incoming.getNumber())) {
+        fields.append("number");
+    }
+    if (existing.getYear() != incoming.getYear()) {
+        fields.append("year");
+    }
+    if (existing.getGraduation() != incoming.getGraduation()) {
+        fields.append("graduation");
+    }
+    return fields;
+}
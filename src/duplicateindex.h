@@ -0,0 +1,77 @@
+#ifndef DUPLICATEINDEX_H
+#define DUPLICATEINDEX_H
+
+#include <QHash>
+#include <QMultiHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include "student.h"
+
+/**
+ * DuplicateIndex - Finds the existing record an imported row stands for
+ *
+ * Students are hashed by normalized e-mail and phone number (the number
+ * field), and blocked by the first letters of their folded name plus their
+ * year. classify() tries the exact keys first and only then compares names
+ * inside the one block, so each row costs a few hash lookups whatever the
+ * size of the dataset. Names match when they are equal after folding or at
+ * most an edit or two apart, and neither e-mail nor phone number
+ * contradicts the match. A name that is only close may belong to someone
+ * else, so that match is Similar and left for a person to review.
+ *
+ * The index is not modified by classify(), so one index can be shared by
+ * several threads once it is built.
+ */
+class DuplicateIndex
+{
+public:
+    enum Status {
+        New,        // No existing record fits
+        Identical,  // Same record, nothing to update
+        Changed,    // Same record, some imported fields differ
+        Similar,    // Only a near name fits, which needs review
+        Ambiguous   // Several existing records fit
+    };
+    
+    struct Match {
+        Status status = New;
+        QString studentId;          // Existing record, for Identical, Changed and Similar
+        QString matchedBy;          // "email", "phone" or "name"
+        QStringList changedFields;  // Changed: fields whose imported value differs
+    };
+    
+    DuplicateIndex() = default;
+    explicit DuplicateIndex(const QList<Student>& students);
+    
+    void add(const Student& student);
+    Match classify(const Student& candidate) const;
+    
+    Student student(const QString& studentId) const { return m_students.value(studentId); }
+    int size() const { return m_students.size(); }
+    
+    // Imported fields of incoming that differ from existing. Descriptions
+    // of records loaded through the list projection are not known, so they
+    // are left out.
+    static QStringList diff(const Student& existing, const Student& incoming);
+    
+    // "Çağla_Şen-Öztürk" and "çağla şen öztürk" give the same text
+    static QString foldText(const QString& text);
+    
+    // "0532 123 45 67", "+90 532 1234567" and 5321234567 from a numeric
+    // cell all give "5321234567": digits only, without 0, 90 or +90
+    static QString phoneKey(const QString& phone);
+
+private:
+    static QString emailKey(const QString& email);
+    static QString blockKey(const QString& foldedName, int year);
+    static bool similarNames(const QString& a, const QString& b);
+    static bool conflicts(const QString& a, const QString& b);
+    
+    QHash<QString, Student> m_students;
+    QMultiHash<QString, QString> m_byEmail;  // emailKey -> student ID
+    QMultiHash<QString, QString> m_byPhone;  // phoneKey -> student ID
+    QMultiHash<QString, QString> m_byBlock;  // blockKey -> student ID
+};
+
+#endif // DUPLICATEINDEX_H
@@ -1,4 +1,5 @@
 #include "firebaseauthservice.h"
+#include "networkaccess.h"
 #include <QUrl>
 #include <QUrlQuery>
 #include <QJsonParseError>
@@ -12,28 +13,30 @@
 Q_LOGGING_CATEGORY(authServiceLog, "auth.service")
 Q_DECLARE_LOGGING_CATEGORY(networkLog)
 
+namespace {
+// Renew this long before the token expires
+const int RefreshMarginSeconds = 5 * 60;
+// Lifetime assumed when the server does not report expiresIn
+const int DefaultTokenLifetimeSeconds = 3600;
+// Delay and attempts for refreshes that did not reach the server
+const int RefreshRetryMs = 30 * 1000;
+const int MaxRefreshRetries = 3;
+}
+
 FirebaseAuthService::FirebaseAuthService(QObject *parent)
     : QObject(parent)
-    , m_networkManager(new QNetworkAccessManager(this))
+    , m_networkManager(NetworkAccess::shared())
     , m_refreshTimer(new QTimer(this))
+    , m_refreshInFlight(false)
+    , m_refreshRetries(0)
 {
     qCInfo(authServiceLog) << "Initializing Firebase Auth Service";
     
-    connect(m_networkManager, &QNetworkAccessManager::finished,
-            this, &FirebaseAuthService::onNetworkReply);
-    
-    // Connect SSL error handler
-    connect(m_networkManager, &QNetworkAccessManager::sslErrors,
-            this, &FirebaseAuthService::onSslErrors);
-    
     connect(m_refreshTimer, &QTimer::timeout,
             this, &FirebaseAuthService::onTokenRefreshTimer);
     
-    // Set refresh timer to 50 minutes (tokens expire in 1 hour)
-    m_refreshTimer->setInterval(50 * 60 * 1000);
-    
-    // Configure network manager timeouts
-    m_networkManager->setTransferTimeout(30000); // 30 seconds timeout
+    // Re-armed from each token's expiresIn
+    m_refreshTimer->setSingleShot(true);
     
     qCInfo(authServiceLog) << "Firebase Auth Service initialized successfully";
 }
@@ -52,7 +55,7 @@ void FirebaseAuthService::setProjectId(const QString& projectId)
 
 QString FirebaseAuthService::buildAuthUrl(const QString& endpoint) const
 {
-    QString baseUrl = "https://identitytoolkit.googleapis.com/v1/accounts:";
+    QString baseUrl = NetworkAccess::origin(NetworkAccess::IdentityToolkit) + "/v1/accounts:";
     QString url = baseUrl + endpoint;
     
     if (!m_apiKey.isEmpty()) {
@@ -74,6 +77,7 @@ QNetworkRequest FirebaseAuthService::createAuthRequest(const QString& url) const
     
     // Add User-Agent header
     request.setRawHeader("User-Agent", "StudentManager/1.0");
+    NetworkAccess::prepare(request, 30000); // 30 seconds timeout
     
     // Set SSL configuration for better compatibility
     QSslConfiguration sslConfig = request.sslConfiguration();
@@ -91,6 +95,18 @@ QNetworkRequest FirebaseAuthService::createAuthRequest(const QString& url) const
     return request;
 }
 
+void FirebaseAuthService::watchReply(QNetworkReply* reply)
+{
+    // SSL errors and completion are taken from the reply itself because
+    // the manager is shared with the other services
+    connect(reply, &QNetworkReply::sslErrors, this, [this, reply](const QList<QSslError>& errors) {
+        onSslErrors(reply, errors);
+    });
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        onNetworkReply(reply);
+    });
+}
+
 void FirebaseAuthService::signInWithEmailAndPassword(const QString& email, const QString& password)
 {
     qCInfo(authServiceLog) << "Starting sign-in process for email:" << email;
@@ -119,6 +135,8 @@ void FirebaseAuthService::signInWithEmailAndPassword(const QString& email, const
     qCDebug(networkLog) << "Request payload:" << doc.toJson(QJsonDocument::Compact);
     
     QNetworkReply* reply = m_networkManager->post(request, data);
+    
+    watchReply(reply);
     m_pendingRequests[reply] = SignIn;
     
     qCInfo(authServiceLog) << "Sign-in request sent, waiting for response";
@@ -145,6 +163,8 @@ void FirebaseAuthService::createUserWithEmailAndPassword(const QString& email, c
     QByteArray data = doc.toJson();
     
     QNetworkReply* reply = m_networkManager->post(request, data);
+    
+    watchReply(reply);
     m_pendingRequests[reply] = SignUp;
 }
 
@@ -155,7 +175,16 @@ void FirebaseAuthService::refreshToken()
         return;
     }
     
-    QString url = QString("https://securetoken.googleapis.com/v1/token?key=%1").arg(m_apiKey);
+    // Several 401s arriving together must not start several refreshes
+    if (m_refreshInFlight) {
+        qCDebug(authServiceLog) << "Token refresh already in progress";
+        return;
+    }
+    m_refreshInFlight = true;
+    m_refreshTimer->stop();
+    qCInfo(authServiceLog) << "Refreshing ID token, current one expires at" << m_tokenExpiry.toString(Qt::ISODate);
+    
+    QString url = NetworkAccess::origin(NetworkAccess::SecureToken) + QString("/v1/token?key=%1").arg(m_apiKey);
     QNetworkRequest request = createAuthRequest(url);
     
     QJsonObject requestData;
@@ -166,11 +195,32 @@ void FirebaseAuthService::refreshToken()
     QByteArray data = doc.toJson();
     
     QNetworkReply* reply = m_networkManager->post(request, data);
+    
+    watchReply(reply);
     m_pendingRequests[reply] = RefreshToken;
 }
 
+void FirebaseAuthService::restoreSession(const QString& savedRefreshToken, const QString& userId, const QString& email)
+{
+    qCInfo(authServiceLog) << "Restoring saved session for user:" << email;
+    clearAuthData();
+    m_refreshToken = savedRefreshToken;
+    m_userId = userId;
+    m_userEmail = email;
+    refreshToken();
+}
+
 void FirebaseAuthService::signOut()
 {
+    // A refresh still on its way would bring the tokens back and emit
+    // tokenRefreshed; aborted replies are no longer pending, so ignored
+    const QList<QNetworkReply*> refreshReplies = m_pendingRequests.keys(RefreshToken);
+    for (QNetworkReply* reply : refreshReplies) {
+        m_pendingRequests.remove(reply);
+        reply->abort();
+    }
+    m_refreshInFlight = false;
+    m_refreshRetries = 0;
     clearAuthData();
     stopTokenRefresh();
     emit signedOut();
@@ -179,10 +229,26 @@ void FirebaseAuthService::signOut()
 void FirebaseAuthService::startTokenRefresh()
 {
     if (isAuthenticated()) {
-        m_refreshTimer->start();
+        scheduleTokenRefresh();
     }
 }
 
+void FirebaseAuthService::setTokenLifetime(int expiresInSeconds)
+{
+    if (expiresInSeconds <= 0) {
+        expiresInSeconds = DefaultTokenLifetimeSeconds;
+    }
+    m_tokenExpiry = QDateTime::currentDateTimeUtc().addSecs(expiresInSeconds);
+}
+
+void FirebaseAuthService::scheduleTokenRefresh()
+{
+    qint64 secondsLeft = QDateTime::currentDateTimeUtc().secsTo(m_tokenExpiry);
+    qint64 delaySeconds = qMax<qint64>(0, secondsLeft - RefreshMarginSeconds);
+    m_refreshTimer->start(static_cast<int>(delaySeconds * 1000));
+    qCInfo(authServiceLog) << "Next token refresh in" << delaySeconds << "seconds";
+}
+
 void FirebaseAuthService::stopTokenRefresh()
 {
     m_refreshTimer->stop();
@@ -283,10 +349,22 @@ void FirebaseAuthService::onNetworkReply(QNetworkReply* reply)
         case SignUp:
             emit userCreationFailed(errorMessage);
             break;
-        case RefreshToken:
+        case RefreshToken: {
+            m_refreshInFlight = false;
+            // Offline for a moment: try again before giving up, so requests
+            // waiting for the new token are not failed by a short outage
+            bool reachedServer = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).isValid();
+            if (!reachedServer && m_refreshRetries < MaxRefreshRetries && !m_refreshToken.isEmpty()) {
+                m_refreshRetries++;
+                qCWarning(authServiceLog) << "Token refresh did not reach the server, retry" << m_refreshRetries << "of" << MaxRefreshRetries;
+                m_refreshTimer->start(RefreshRetryMs);
+                break;
+            }
+            m_refreshRetries = 0;
             emit tokenRefreshFailed(errorMessage);
             break;
         }
+        }
         return;
     }
     
@@ -372,6 +450,7 @@ void FirebaseAuthService::handleRefreshTokenReply(QNetworkReply* reply)
     QJsonDocument doc = QJsonDocument::fromJson(data, &error);
     
     if (error.error != QJsonParseError::NoError) {
+        m_refreshInFlight = false;
         emit tokenRefreshFailed(QString("JSON parse error: %1").arg(error.errorString()));
         return;
     }
@@ -382,6 +461,11 @@ void FirebaseAuthService::handleRefreshTokenReply(QNetworkReply* reply)
     m_idToken = response["id_token"].toString();
     m_refreshToken = response["refresh_token"].toString();
     m_userId = response["user_id"].toString();
+    setTokenLifetime(response["expires_in"].toString().toInt());
+    
+    m_refreshInFlight = false;
+    m_refreshRetries = 0;
+    scheduleTokenRefresh();
     
     emit tokenRefreshed();
 }
@@ -392,6 +476,7 @@ void FirebaseAuthService::parseAuthResponse(const QJsonObject& response)
     m_refreshToken = response["refreshToken"].toString();
     m_userId = response["localId"].toString();
     m_userEmail = response["email"].toString();
+    setTokenLifetime(response["expiresIn"].toString().toInt());
 }
 
 void FirebaseAuthService::clearAuthData()
@@ -400,6 +485,7 @@ void FirebaseAuthService::clearAuthData()
     m_refreshToken.clear();
     m_userId.clear();
     m_userEmail.clear();
+    m_tokenExpiry = QDateTime();
 }
 
 bool FirebaseAuthService::checkNetworkAccessibility() const
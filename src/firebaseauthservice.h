@@ -8,6 +8,7 @@
 #include <QJsonObject>
 #include <QJsonDocument>
 #include <QTimer>
+#include <QDateTime>
 
 class FirebaseAuthService : public QObject
 {
@@ -23,6 +24,13 @@ public:
     void signInWithEmailAndPassword(const QString& email, const QString& password);
     void createUserWithEmailAndPassword(const QString& email, const QString& password);
     void signOut();
+    
+    // Resumes a saved session: the refresh token is exchanged for an ID token
+    // in the background, ending in tokenRefreshed or tokenRefreshFailed
+    void restoreSession(const QString& savedRefreshToken, const QString& userId, const QString& email);
+    
+    // Single flight: while a refresh is in progress further calls only wait
+    // for its tokenRefreshed/tokenRefreshFailed
     void refreshToken();
     
     // Token management
@@ -31,8 +39,11 @@ public:
     QString getUserId() const { return m_userId; }
     QString getUserEmail() const { return m_userEmail; }
     bool isAuthenticated() const { return !m_idToken.isEmpty(); }
+    QDateTime getTokenExpiry() const { return m_tokenExpiry; }
+    bool isRefreshing() const { return m_refreshInFlight; }
     
-    // Auto-refresh setup
+    // Auto-refresh setup: the ID token is renewed shortly before the
+    // expiresIn reported with it runs out
     void startTokenRefresh();
     void stopTokenRefresh();
 
@@ -51,12 +62,15 @@ private slots:
     void onSslErrors(QNetworkReply* reply, const QList<QSslError>& errors);
 
 private:
+    void watchReply(QNetworkReply* reply);
     QString buildAuthUrl(const QString& endpoint) const;
     QNetworkRequest createAuthRequest(const QString& url) const;
     void handleSignInReply(QNetworkReply* reply);
     void handleSignUpReply(QNetworkReply* reply);
     void handleRefreshTokenReply(QNetworkReply* reply);
     void parseAuthResponse(const QJsonObject& response);
+    void setTokenLifetime(int expiresInSeconds);
+    void scheduleTokenRefresh();
     void clearAuthData();
     bool checkNetworkAccessibility() const;
     
@@ -68,6 +82,9 @@ private:
     QString m_userId;
     QString m_userEmail;
     QTimer* m_refreshTimer;
+    QDateTime m_tokenExpiry;
+    bool m_refreshInFlight;
+    int m_refreshRetries; // Consecutive refreshes that failed without reaching the server
     
     enum RequestType {
         SignIn,
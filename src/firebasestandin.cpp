@@ -0,0 +1,1261 @@
+#include "firebasestandin.h"
+#include "firestoreservice.h"
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QPointer>
+#include <QTimer>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QJsonDocument>
+#include <QRegularExpression>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <algorithm>
+
+Q_LOGGING_CATEGORY(standInLog, "standin")
+
+namespace {
+const char* const Collection = "People";
+const int MaxCommitWrites = 500;
+const int DefaultPageSize = 20;
+const int MaxPageSize = 1000;
+const int MaxHeaderSize = 64 * 1024;
+const int UploadChunkGranularity = 256 * 1024;
+
+QByteArray reasonPhrase(int status)
+{
+    switch (status) {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 409: return "Conflict";
+    case 429: return "Too Many Requests";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default: return "Unknown";
+    }
+}
+
+QString statusName(int status)
+{
+    switch (status) {
+    case 400: return "INVALID_ARGUMENT";
+    case 401: return "UNAUTHENTICATED";
+    case 404: return "NOT_FOUND";
+    case 409: return "ALREADY_EXISTS";
+    case 429: return "RESOURCE_EXHAUSTED";
+    case 503: return "UNAVAILABLE";
+    default: return "INTERNAL";
+    }
+}
+
+// Position of a value type in Firestore's cross-type ordering
+int typeRank(const QJsonObject& value)
+{
+    if (value.contains("nullValue")) return 0;
+    if (value.contains("booleanValue")) return 1;
+    if (value.contains("integerValue") || value.contains("doubleValue")) return 2;
+    if (value.contains("timestampValue")) return 3;
+    if (value.contains("stringValue")) return 4;
+    if (value.contains("bytesValue")) return 5;
+    if (value.contains("referenceValue")) return 6;
+    if (value.contains("geoPointValue")) return 7;
+    if (value.contains("arrayValue")) return 8;
+    return 9;
+}
+
+double numberOf(const QJsonObject& value)
+{
+    return value.contains("integerValue") ? value["integerValue"].toString().toDouble()
+                                          : value["doubleValue"].toDouble();
+}
+
+QString documentId(const QString& documentName)
+{
+    return documentName.section('/', -1);
+}
+
+QString collectionOf(const QString& documentName)
+{
+    return documentName.section('/', -2, -2);
+}
+
+template<typename T>
+int compare(const T& a, const T& b)
+{
+    return a < b ? -1 : (b < a ? 1 : 0);
+}
+}
+
+FirebaseStandIn::FirebaseStandIn(QObject *parent)
+    : QObject(parent)
+    , m_server(new QTcpServer(this))
+    , m_tokenLifetime(3600)
+    , m_requireAuth(true)
+    , m_latency(0)
+    , m_jitter(0)
+    , m_errorRate(0)
+    , m_errorStatuses({429, 503})
+    , m_failNextCount(0)
+    , m_failNextStatus(503)
+    , m_random(1)
+    , m_lastTimestampMicros(0)
+    , m_requestCount(0)
+    , m_injectedErrors(0)
+{
+    connect(m_server, &QTcpServer::newConnection, this, &FirebaseStandIn::onNewConnection);
+}
+
+FirebaseStandIn::~FirebaseStandIn()
+{
+    m_server->close();
+}
+
+bool FirebaseStandIn::listen(const QHostAddress& address, quint16 port)
+{
+    if (!m_server->listen(address, port)) {
+        qCWarning(standInLog) << "Could not listen:" << m_server->errorString();
+        return false;
+    }
+    qCInfo(standInLog) << "Listening on" << origin();
+    return true;
+}
+
+quint16 FirebaseStandIn::port() const
+{
+    return m_server->serverPort();
+}
+
+QString FirebaseStandIn::origin() const
+{
+    QHostAddress address = m_server->serverAddress();
+    if (address == QHostAddress::Any || address == QHostAddress::AnyIPv4 || address == QHostAddress::AnyIPv6) {
+        address = QHostAddress::LocalHost;
+    }
+    QString host = address.protocol() == QAbstractSocket::IPv6Protocol
+                   ? QString("[%1]").arg(address.toString()) : address.toString();
+    return QString("http://%1:%2").arg(host).arg(port());
+}
+
+QString FirebaseStandIn::errorString() const
+{
+    return m_server->errorString();
+}
+
+void FirebaseStandIn::setStudents(const QList<Student>& students)
+{
+    m_documents.clear();
+    addStudents(students);
+}
+
+void FirebaseStandIn::addStudents(const QList<Student>& students)
+{
+    for (const Student& student : students) {
+        QString id = student.getId().isEmpty() ? FirestoreService::generateDocumentId() : student.getId();
+        Document document;
+        document.fields = FirestoreService::studentToDocument(student)["fields"].toObject();
+        document.createTime = nextTimestamp();
+        document.updateTime = document.createTime;
+        m_documents.insert(id, document);
+    }
+    qCInfo(standInLog) << "Collection holds" << m_documents.size() << "documents";
+}
+
+QList<Student> FirebaseStandIn::students() const
+{
+    QList<Student> students;
+    students.reserve(m_documents.size());
+    for (auto it = m_documents.constBegin(); it != m_documents.constEnd(); ++it) {
+        students.append(FirestoreService::documentToStudent(toJson("standin", it.key(), it.value())));
+    }
+    return students;
+}
+
+void FirebaseStandIn::putObject(const QString& storagePath, const QByteArray& data, const QString& contentType,
+                                const QString& token)
+{
+    StoredObject object;
+    object.data = data;
+    object.contentType = contentType;
+    object.token = token.isEmpty() ? QString::number(m_random.generate64(), 16) : token;
+    object.updated = nextTimestamp();
+    m_objects.insert(storagePath, object);
+}
+
+void FirebaseStandIn::addUser(const QString& email, const QString& password)
+{
+    m_users.insert(email.toLower(), password);
+}
+
+void FirebaseStandIn::setLatency(int latencyMs, int jitterMs)
+{
+    m_latency = qMax(0, latencyMs);
+    m_jitter = qMax(0, jitterMs);
+}
+
+void FirebaseStandIn::setErrorRate(double rate, const QList<int>& statuses)
+{
+    m_errorRate = qBound(0.0, rate, 1.0);
+    m_errorStatuses = statuses.isEmpty() ? QList<int>{503} : statuses;
+}
+
+void FirebaseStandIn::failNext(int count, int status)
+{
+    m_failNextCount = qMax(0, count);
+    m_failNextStatus = status;
+}
+
+// --- HTTP ---------------------------------------------------------------
+
+void FirebaseStandIn::onNewConnection()
+{
+    while (m_server->hasPendingConnections()) {
+        QTcpSocket* socket = m_server->nextPendingConnection();
+        m_connections.insert(socket, Connection());
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            m_connections[socket].buffer.append(socket->readAll());
+            processBuffer(socket);
+        });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            m_connections.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void FirebaseStandIn::processBuffer(QTcpSocket* socket)
+{
+    // One request at a time per connection, answered in order
+    auto it = m_connections.find(socket);
+    if (it == m_connections.end() || it->busy) {
+        return;
+    }
+    
+    Request request;
+    bool malformed = false;
+    if (!takeRequest(it->buffer, &request, &malformed)) {
+        if (malformed) {
+            Response response = errorResponse(400, "Malformed or unsupported HTTP request");
+            request.headers["connection"] = "close";
+            send(socket, request, response);
+        }
+        return;
+    }
+    
+    it->busy = true;
+    Response response = route(request);
+    int delay = m_latency + (m_jitter > 0 ? int(m_random.bounded(m_jitter + 1)) : 0);
+    if (delay == 0) {
+        send(socket, request, response);
+        return;
+    }
+    QPointer<QTcpSocket> guard(socket);
+    QTimer::singleShot(delay, this, [this, guard, request, response]() {
+        if (guard) {
+            send(guard, request, response);
+        }
+    });
+}
+
+bool FirebaseStandIn::takeRequest(QByteArray& buffer, Request* request, bool* malformed) const
+{
+    int headerEnd = buffer.indexOf("\r\n\r\n");
+    if (headerEnd < 0) {
+        *malformed = buffer.size() > MaxHeaderSize;
+        return false;
+    }
+    
+    const QList<QByteArray> lines = buffer.left(headerEnd).split('\n');
+    const QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+    if (requestLine.size() != 3) {
+        *malformed = true;
+        return false;
+    }
+    
+    QHash<QByteArray, QByteArray> headers;
+    for (int i = 1; i < lines.size(); ++i) {
+        int colon = lines[i].indexOf(':');
+        if (colon > 0) {
+            headers.insert(lines[i].left(colon).trimmed().toLower(), lines[i].mid(colon + 1).trimmed());
+        }
+    }
+    if (headers.contains("transfer-encoding")) {
+        *malformed = true; // Qt sends bodies with a Content-Length
+        return false;
+    }
+    
+    qint64 bodyLength = headers.value("content-length", "0").toLongLong();
+    qint64 total = headerEnd + 4 + bodyLength;
+    if (buffer.size() < total) {
+        return false;
+    }
+    
+    request->method = requestLine[0];
+    QByteArray target = requestLine[1];
+    int queryStart = target.indexOf('?');
+    request->rawPath = QString::fromUtf8(queryStart < 0 ? target : target.left(queryStart));
+    request->path = QUrl::fromPercentEncoding(request->rawPath.toUtf8());
+    if (queryStart >= 0) {
+        QUrlQuery query(QString::fromUtf8(target.mid(queryStart + 1)));
+        const auto items = query.queryItems(QUrl::FullyDecoded);
+        for (const auto& item : items) {
+            request->query[item.first].append(item.second);
+        }
+    }
+    request->headers = headers;
+    request->body = buffer.mid(headerEnd + 4, bodyLength);
+    buffer.remove(0, total);
+    return true;
+}
+
+void FirebaseStandIn::send(QTcpSocket* socket, const Request& request, const Response& response)
+{
+    auto it = m_connections.find(socket);
+    if (it == m_connections.end()) {
+        return;
+    }
+    
+    QByteArray head = "HTTP/1.1 " + QByteArray::number(response.status) + " " + reasonPhrase(response.status) + "\r\n";
+    if (!response.body.isEmpty()) {
+        head += "Content-Type: " + response.contentType + "\r\n";
+    }
+    head += "Content-Length: " + QByteArray::number(response.body.size()) + "\r\n";
+    for (const auto& header : response.headers) {
+        head += header.first + ": " + header.second + "\r\n";
+    }
+    bool keepAlive = request.headers.value("connection").toLower() != "close";
+    head += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    
+    socket->write(head);
+    socket->write(response.body);
+    emit requestHandled(QString::fromLatin1(request.method), request.path, response.status);
+    qCDebug(standInLog) << request.method << request.path << "->" << response.status;
+    
+    if (!keepAlive) {
+        socket->disconnectFromHost();
+        return;
+    }
+    it->busy = false;
+    if (!it->buffer.isEmpty()) {
+        processBuffer(socket);
+    }
+}
+
+FirebaseStandIn::Response FirebaseStandIn::route(const Request& request)
+{
+    static const QRegularExpression firestorePath("^/v1/projects/([^/]+)/databases/\\(default\\)/documents(.*)$");
+    static const QRegularExpression storagePath("^/v0/b/([^/]+)/o(?:/(.+))?$");
+    
+    // Auth is never failed on purpose; the services recover from data
+    // request errors by refreshing the token through it
+    if (request.method == "POST" && request.path == "/v1/accounts:signInWithPassword") {
+        return signIn(request, false);
+    }
+    if (request.method == "POST" && request.path == "/v1/accounts:signUp") {
+        return signIn(request, true);
+    }
+    if (request.method == "POST" && request.path == "/v1/token") {
+        return refreshToken(request);
+    }
+    
+    QRegularExpressionMatch firestore = firestorePath.match(request.path);
+    QRegularExpressionMatch storage = storagePath.match(request.rawPath);
+    if (!firestore.hasMatch() && !storage.hasMatch()) {
+        return errorResponse(404, QString("No such endpoint: %1").arg(request.path));
+    }
+    
+    m_requestCount++;
+    if (m_failNextCount > 0 || (m_errorRate > 0 && m_random.generateDouble() < m_errorRate)) {
+        return injectedError();
+    }
+    
+    bool download = request.query.value("alt").value(0) == "media";
+    if (!authorized(request) && !download) {
+        return errorResponse(401, "Request had invalid authentication credentials.");
+    }
+    
+    if (firestore.hasMatch()) {
+        return handleFirestore(request, firestore.captured(1), firestore.captured(2));
+    }
+    return handleStorage(request, storage.captured(1), QUrl::fromPercentEncoding(storage.captured(2).toUtf8()));
+}
+
+FirebaseStandIn::Response FirebaseStandIn::injectedError()
+{
+    int status;
+    if (m_failNextCount > 0) {
+        m_failNextCount--;
+        status = m_failNextStatus;
+    } else {
+        status = m_errorStatuses.at(m_random.bounded(int(m_errorStatuses.size())));
+    }
+    m_injectedErrors++;
+    qCDebug(standInLog) << "Injecting" << status;
+    
+    switch (status) {
+    case 401:
+        return errorResponse(401, "Request had invalid authentication credentials.");
+    case 429:
+        return errorResponse(429, "Quota exceeded.");
+    case 503:
+        return errorResponse(503, "The service is currently unavailable.");
+    default:
+        return errorResponse(status, "Injected error");
+    }
+}
+
+bool FirebaseStandIn::authorized(const Request& request) const
+{
+    if (!m_requireAuth) {
+        return true;
+    }
+    QByteArray header = request.headers.value("authorization");
+    if (!header.startsWith("Bearer ")) {
+        return false;
+    }
+    auto it = m_idTokens.constFind(QString::fromUtf8(header.mid(7)));
+    return it != m_idTokens.constEnd() && it.value() > QDateTime::currentMSecsSinceEpoch();
+}
+
+FirebaseStandIn::Response FirebaseStandIn::jsonResponse(const QJsonValue& json, int status)
+{
+    Response response;
+    response.status = status;
+    response.body = json.isArray() ? QJsonDocument(json.toArray()).toJson(QJsonDocument::Compact)
+                                   : QJsonDocument(json.toObject()).toJson(QJsonDocument::Compact);
+    return response;
+}
+
+FirebaseStandIn::Response FirebaseStandIn::errorResponse(int status, const QString& message, const QString& name)
+{
+    // { "error": { "code": 400, "message": "...", "status": "INVALID_ARGUMENT" } }
+    QJsonObject error;
+    error["code"] = status;
+    error["message"] = message;
+    error["status"] = name.isEmpty() ? statusName(status) : name;
+    QJsonObject root;
+    root["error"] = error;
+    return jsonResponse(root, status);
+}
+
+// --- Firestore ----------------------------------------------------------
+
+FirebaseStandIn::Response FirebaseStandIn::handleFirestore(const Request& request, const QString& project, const QString& rest)
+{
+    QString collectionPath = QString("/%1").arg(Collection);
+    QJsonObject body = QJsonDocument::fromJson(request.body).object();
+    
+    if (request.method == "POST") {
+        if (rest == ":runQuery") return runQuery(body, project);
+        if (rest == ":runAggregationQuery") return runAggregationQuery(body, project);
+        if (rest == ":partitionQuery") return partitionQuery(body, project);
+        if (rest == ":batchGet") return batchGet(body, project);
+        if (rest == ":commit") return commit(body, project);
+        if (rest == collectionPath) return createDocument(request, project);
+    } else if (rest == collectionPath) {
+        if (request.method == "GET") return listDocuments(request, project);
+    } else if (rest.startsWith(collectionPath + "/")) {
+        QString id = rest.mid(collectionPath.size() + 1);
+        if (request.method == "GET") return getDocument(project, id);
+        if (request.method == "PATCH") return patchDocument(request, project, id);
+        if (request.method == "DELETE") return deleteDocument(project, id);
+    }
+    return errorResponse(404, QString("Unsupported Firestore request: %1 %2")
+                                  .arg(QString::fromLatin1(request.method), rest));
+}
+
+FirebaseStandIn::Response FirebaseStandIn::listDocuments(const Request& request, const QString& project)
+{
+    int pageSize = request.query.value("pageSize").value(0).toInt();
+    pageSize = pageSize > 0 ? qMin(pageSize, MaxPageSize) : DefaultPageSize;
+    const QStringList mask = request.query.value("mask.fieldPaths");
+    
+    // The page token is the last ID of the previous page
+    QString after = QString::fromUtf8(QByteArray::fromBase64(request.query.value("pageToken").value(0).toLatin1()));
+    auto it = after.isEmpty() ? m_documents.constBegin() : m_documents.upperBound(after);
+    
+    QJsonArray documents;
+    QString lastId;
+    for (; it != m_documents.constEnd() && documents.size() < pageSize; ++it) {
+        documents.append(toJson(project, it.key(), it.value(), mask.isEmpty() ? nullptr : &mask));
+        lastId = it.key();
+    }
+    
+    QJsonObject root;
+    if (!documents.isEmpty()) {
+        root["documents"] = documents;
+    }
+    if (it != m_documents.constEnd()) {
+        root["nextPageToken"] = QString::fromLatin1(lastId.toUtf8().toBase64());
+    }
+    return jsonResponse(root);
+}
+
+FirebaseStandIn::Response FirebaseStandIn::getDocument(const QString& project, const QString& id)
+{
+    auto it = m_documents.constFind(id);
+    if (it == m_documents.constEnd()) {
+        return errorResponse(404, QString("Document \"%1\" not found.").arg(id));
+    }
+    return jsonResponse(toJson(project, id, it.value()));
+}
+
+FirebaseStandIn::Response FirebaseStandIn::createDocument(const Request& request, const QString& project)
+{
+    QString id = request.query.value("documentId").value(0);
+    if (id.isEmpty()) {
+        id = FirestoreService::generateDocumentId();
+    }
+    if (m_documents.contains(id)) {
+        return errorResponse(409, QString("Document already exists: %1").arg(id));
+    }
+    
+    QJsonObject body = QJsonDocument::fromJson(request.body).object();
+    applyUpdate(id, body["fields"].toObject(), QJsonArray(), nextTimestamp());
+    return jsonResponse(toJson(project, id, m_documents.value(id)));
+}
+
+FirebaseStandIn::Response FirebaseStandIn::patchDocument(const Request& request, const QString& project, const QString& id)
+{
+    QJsonObject precondition;
+    if (request.query.contains("currentDocument.updateTime")) {
+        precondition["updateTime"] = request.query.value("currentDocument.updateTime").value(0);
+    }
+    if (request.query.contains("currentDocument.exists")) {
+        precondition["exists"] = request.query.value("currentDocument.exists").value(0) == "true";
+    }
+    QString error;
+    if (!checkPrecondition(id, precondition, &error)) {
+        return errorResponse(400, error, "FAILED_PRECONDITION");
+    }
+    
+    QJsonObject body = QJsonDocument::fromJson(request.body).object();
+    applyUpdate(id, body["fields"].toObject(), QJsonArray::fromStringList(request.query.value("updateMask.fieldPaths")),
+                nextTimestamp());
+    return jsonResponse(toJson(project, id, m_documents.value(id)));
+}
+
+FirebaseStandIn::Response FirebaseStandIn::deleteDocument(const QString& project, const QString& id)
+{
+    Q_UNUSED(project);
+    m_documents.remove(id);
+    return jsonResponse(QJsonObject());
+}
+
+FirebaseStandIn::Response FirebaseStandIn::runQuery(const QJsonObject& body, const QString& project)
+{
+    QJsonObject query = body["structuredQuery"].toObject();
+    QString error;
+    const QList<QString> ids = evaluateQuery(query, &error);
+    if (!error.isEmpty()) {
+        return errorResponse(400, error);
+    }
+    
+    // A select of only __name__ returns documents without fields
+    bool projected = query.contains("select");
+    QStringList mask;
+    const QJsonArray selected = query["select"].toObject()["fields"].toArray();
+    for (const QJsonValue& field : selected) {
+        QString fieldPath = field.toObject()["fieldPath"].toString();
+        if (fieldPath != "__name__") {
+            mask.append(fieldPath);
+        }
+    }
+    
+    // [{ "document": ..., "readTime": ... }, ...]; an empty result is a
+    // single entry with only readTime
+    QString readTime = nextTimestamp();
+    QJsonArray results;
+    for (const QString& id : ids) {
+        QJsonObject result;
+        result["document"] = toJson(project, id, m_documents.value(id), projected ? &mask : nullptr);
+        result["readTime"] = readTime;
+        results.append(result);
+    }
+    if (results.isEmpty()) {
+        QJsonObject result;
+        result["readTime"] = readTime;
+        results.append(result);
+    }
+    return jsonResponse(results);
+}
+
+FirebaseStandIn::Response FirebaseStandIn::runAggregationQuery(const QJsonObject& body, const QString& project)
+{
+    Q_UNUSED(project);
+    QJsonObject aggregationQuery = body["structuredAggregationQuery"].toObject();
+    QString error;
+    qint64 count = evaluateQuery(aggregationQuery["structuredQuery"].toObject(), &error).size();
+    if (!error.isEmpty()) {
+        return errorResponse(400, error);
+    }
+    
+    QJsonObject aggregateFields;
+    const QJsonArray aggregations = aggregationQuery["aggregations"].toArray();
+    for (const QJsonValue& value : aggregations) {
+        QJsonObject aggregation = value.toObject();
+        if (!aggregation.contains("count")) {
+            return errorResponse(400, "Only count aggregations are supported");
+        }
+        QJsonObject result;
+        result["integerValue"] = QString::number(count);
+        aggregateFields[aggregation["alias"].toString()] = result;
+    }
+    
+    QJsonObject result;
+    result["aggregateFields"] = aggregateFields;
+    QJsonObject entry;
+    entry["result"] = result;
+    entry["readTime"] = nextTimestamp();
+    return jsonResponse(QJsonArray{entry});
+}
+
+FirebaseStandIn::Response FirebaseStandIn::partitionQuery(const QJsonObject& body, const QString& project)
+{
+    qint64 partitionCount = body["partitionCount"].toVariant().toLongLong();
+    if (partitionCount <= 0) {
+        return errorResponse(400, "partitionCount must be positive");
+    }
+    // As in Firestore, only collection-group queries can be partitioned
+    QJsonObject structuredQuery = body["structuredQuery"].toObject();
+    const QJsonArray from = structuredQuery["from"].toArray();
+    if (from.size() != 1 || !from.first().toObject()["allDescendants"].toBool()) {
+        return errorResponse(400, "Partition queries are only supported for collection group queries");
+    }
+    QString error;
+    const QList<QString> ids = evaluateQuery(structuredQuery, &error);
+    if (!error.isEmpty()) {
+        return errorResponse(400, error);
+    }
+    
+    // partitionCount split points spread evenly over the ordered IDs;
+    // fewer when the collection is small
+    QJsonArray partitions;
+    QString previous;
+    for (qint64 i = 1; i <= partitionCount; ++i) {
+        qint64 index = i * ids.size() / (partitionCount + 1);
+        if (index <= 0 || index >= ids.size() || ids.at(index) == previous) {
+            continue;
+        }
+        previous = ids.at(index);
+        QJsonObject reference;
+        reference["referenceValue"] = QString("projects/%1/databases/(default)/documents/%2/%3")
+                                          .arg(project, Collection, previous);
+        QJsonObject cursor;
+        cursor["values"] = QJsonArray{reference};
+        partitions.append(cursor);
+    }
+    
+    // pageSize caps the split points per reply; the page token is the
+    // offset of the next one
+    int pageSize = body["pageSize"].toInt();
+    int offset = qMax(0, QByteArray::fromBase64(body["pageToken"].toString().toLatin1()).toInt());
+    int end = pageSize > 0 ? qMin(offset + pageSize, int(partitions.size())) : int(partitions.size());
+    QJsonArray page;
+    for (int i = offset; i < end; ++i) {
+        page.append(partitions.at(i));
+    }
+    
+    QJsonObject root;
+    root["partitions"] = page;
+    if (end < partitions.size()) {
+        root["nextPageToken"] = QString::fromLatin1(QByteArray::number(end).toBase64());
+    }
+    return jsonResponse(root);
+}
+
+FirebaseStandIn::Response FirebaseStandIn::batchGet(const QJsonObject& body, const QString& project)
+{
+    QStringList mask;
+    const QJsonArray maskPaths = body["mask"].toObject()["fieldPaths"].toArray();
+    for (const QJsonValue& fieldPath : maskPaths) {
+        mask.append(fieldPath.toString());
+    }
+    
+    QString readTime = nextTimestamp();
+    QJsonArray results;
+    const QJsonArray names = body["documents"].toArray();
+    for (const QJsonValue& value : names) {
+        QString name = value.toString();
+        QString id = documentId(name);
+        QJsonObject result;
+        auto it = m_documents.constFind(id);
+        if (collectionOf(name) == Collection && it != m_documents.constEnd()) {
+            result["found"] = toJson(project, id, it.value(), mask.isEmpty() ? nullptr : &mask);
+        } else {
+            result["missing"] = name;
+        }
+        result["readTime"] = readTime;
+        results.append(result);
+    }
+    return jsonResponse(results);
+}
+
+FirebaseStandIn::Response FirebaseStandIn::commit(const QJsonObject& body, const QString& project)
+{
+    Q_UNUSED(project);
+    const QJsonArray writes = body["writes"].toArray();
+    if (writes.size() > MaxCommitWrites) {
+        return errorResponse(400, QString("A maximum of %1 writes allowed per request").arg(MaxCommitWrites));
+    }
+    
+    // All preconditions are checked before anything is applied, so a
+    // refused commit changes nothing
+    QSet<QString> touched;
+    for (const QJsonValue& value : writes) {
+        QJsonObject write = value.toObject();
+        QString name = write.contains("update") ? write["update"].toObject()["name"].toString()
+                                                : write["delete"].toString();
+        QString id = documentId(name);
+        if (id.isEmpty() || collectionOf(name) != Collection) {
+            return errorResponse(400, QString("Invalid document name: %1").arg(name));
+        }
+        if (touched.contains(id)) {
+            return errorResponse(400, QString("Cannot have multiple writes to the same document: %1").arg(name));
+        }
+        touched.insert(id);
+        
+        QString error;
+        if (!checkPrecondition(id, write["currentDocument"].toObject(), &error)) {
+            return errorResponse(400, error, "FAILED_PRECONDITION");
+        }
+    }
+    
+    QString commitTime = nextTimestamp();
+    QJsonArray writeResults;
+    for (const QJsonValue& value : writes) {
+        QJsonObject write = value.toObject();
+        QJsonObject result;
+        if (write.contains("update")) {
+            QJsonObject update = write["update"].toObject();
+            applyUpdate(documentId(update["name"].toString()), update["fields"].toObject(),
+                        write["updateMask"].toObject()["fieldPaths"].toArray(), commitTime);
+            result["updateTime"] = commitTime;
+        } else {
+            m_documents.remove(documentId(write["delete"].toString()));
+        }
+        writeResults.append(result);
+    }
+    
+    QJsonObject root;
+    root["writeResults"] = writeResults;
+    root["commitTime"] = commitTime;
+    return jsonResponse(root);
+}
+
+QList<QString> FirebaseStandIn::evaluateQuery(const QJsonObject& query, QString* error) const
+{
+    const QJsonArray from = query["from"].toArray();
+    if (from.size() != 1 || from.first().toObject()["collectionId"].toString() != Collection) {
+        return QList<QString>(); // Only the one collection exists
+    }
+    
+    // Explicit orderBy, then __name__ in the direction of the last one
+    struct Order {
+        QString fieldPath;
+        bool descending;
+    };
+    QList<Order> orders;
+    const QJsonArray orderBy = query["orderBy"].toArray();
+    for (const QJsonValue& value : orderBy) {
+        QJsonObject order = value.toObject();
+        orders.append({order["field"].toObject()["fieldPath"].toString(),
+                       order["direction"].toString() == "DESCENDING"});
+    }
+    if (orders.isEmpty() || orders.last().fieldPath != "__name__") {
+        orders.append({"__name__", !orders.isEmpty() && orders.last().descending});
+    }
+    
+    QJsonObject where = query["where"].toObject();
+    struct Row {
+        QString id;
+        QList<QJsonValue> keys;
+    };
+    QList<Row> rows;
+    for (auto it = m_documents.constBegin(); it != m_documents.constEnd(); ++it) {
+        if (!where.isEmpty() && !matchesFilter(it.key(), it.value(), where)) {
+            continue;
+        }
+        // Documents without an ordered field are left out, as in Firestore
+        Row row{it.key(), {}};
+        bool complete = true;
+        for (const Order& order : std::as_const(orders)) {
+            QJsonValue key = fieldValue(it.key(), it.value(), order.fieldPath);
+            if (key.isUndefined()) {
+                complete = false;
+                break;
+            }
+            row.keys.append(key);
+        }
+        if (complete) {
+            rows.append(row);
+        }
+    }
+    
+    // Compares a row with a cursor over the cursor's values, honouring
+    // each order's direction
+    auto compareKeys = [&orders](const QList<QJsonValue>& keys, const QJsonArray& values) {
+        for (int i = 0; i < values.size() && i < keys.size(); ++i) {
+            int result = compareValues(keys[i], values[i]);
+            if (result != 0) {
+                return orders[i].descending ? -result : result;
+            }
+        }
+        return 0;
+    };
+    
+    std::sort(rows.begin(), rows.end(), [&orders](const Row& a, const Row& b) {
+        for (int i = 0; i < orders.size(); ++i) {
+            int result = compareValues(a.keys[i], b.keys[i]);
+            if (result != 0) {
+                return orders[i].descending ? result > 0 : result < 0;
+            }
+        }
+        return false;
+    });
+    
+    QJsonObject startAt = query["startAt"].toObject();
+    QJsonObject endAt = query["endAt"].toObject();
+    if (startAt["values"].toArray().size() > orders.size() || endAt["values"].toArray().size() > orders.size()) {
+        *error = "Cursor has too many values";
+        return QList<QString>();
+    }
+    
+    int offset = query["offset"].toInt();
+    QJsonValue limitValue = query["limit"];
+    int limit = limitValue.isObject() ? limitValue.toObject()["value"].toInt() : limitValue.toInt();
+    
+    QList<QString> ids;
+    for (const Row& row : std::as_const(rows)) {
+        if (!startAt.isEmpty()) {
+            int position = compareKeys(row.keys, startAt["values"].toArray());
+            if (startAt["before"].toBool() ? position < 0 : position <= 0) {
+                continue;
+            }
+        }
+        if (!endAt.isEmpty()) {
+            int position = compareKeys(row.keys, endAt["values"].toArray());
+            if (endAt["before"].toBool() ? position >= 0 : position > 0) {
+                break;
+            }
+        }
+        if (offset > 0) {
+            offset--;
+            continue;
+        }
+        ids.append(row.id);
+        if (limit > 0 && ids.size() >= limit) {
+            break;
+        }
+    }
+    return ids;
+}
+
+bool FirebaseStandIn::matchesFilter(const QString& id, const Document& document, const QJsonObject& filter) const
+{
+    if (filter.contains("compositeFilter")) {
+        QJsonObject composite = filter["compositeFilter"].toObject();
+        bool any = composite["op"].toString() == "OR";
+        const QJsonArray filters = composite["filters"].toArray();
+        for (const QJsonValue& value : filters) {
+            if (matchesFilter(id, document, value.toObject()) == any) {
+                return any;
+            }
+        }
+        return !any;
+    }
+    
+    if (filter.contains("unaryFilter")) {
+        QJsonObject unary = filter["unaryFilter"].toObject();
+        QJsonValue value = fieldValue(id, document, unary["field"].toObject()["fieldPath"].toString());
+        bool isNull = value.isObject() && value.toObject().contains("nullValue");
+        QString op = unary["op"].toString();
+        if (op == "IS_NULL") return isNull;
+        if (op == "IS_NOT_NULL") return !value.isUndefined() && !isNull;
+        return false;
+    }
+    
+    QJsonObject fieldFilter = filter["fieldFilter"].toObject();
+    QJsonValue value = fieldValue(id, document, fieldFilter["field"].toObject()["fieldPath"].toString());
+    if (value.isUndefined()) {
+        return false;
+    }
+    QString op = fieldFilter["op"].toString();
+    QJsonObject operand = fieldFilter["value"].toObject();
+    
+    if (op == "IN" || op == "NOT_IN") {
+        bool found = false;
+        const QJsonArray candidates = operand["arrayValue"].toObject()["values"].toArray();
+        for (const QJsonValue& candidate : candidates) {
+            if (compareValues(value, candidate) == 0) {
+                found = true;
+                break;
+            }
+        }
+        return op == "IN" ? found : !found;
+    }
+    
+    // Comparisons only match values of the same type
+    if (typeRank(value.toObject()) != typeRank(operand)) {
+        return op == "NOT_EQUAL";
+    }
+    int result = compareValues(value, operand);
+    if (op == "EQUAL") return result == 0;
+    if (op == "NOT_EQUAL") return result != 0;
+    if (op == "LESS_THAN") return result < 0;
+    if (op == "LESS_THAN_OR_EQUAL") return result <= 0;
+    if (op == "GREATER_THAN") return result > 0;
+    if (op == "GREATER_THAN_OR_EQUAL") return result >= 0;
+    return false;
+}
+
+QJsonValue FirebaseStandIn::fieldValue(const QString& id, const Document& document, const QString& fieldPath) const
+{
+    if (fieldPath == "__name__") {
+        QJsonObject reference;
+        reference["referenceValue"] = id;
+        return reference;
+    }
+    return document.fields.value(fieldPath);
+}
+
+int FirebaseStandIn::compareValues(const QJsonValue& a, const QJsonValue& b)
+{
+    QJsonObject left = a.toObject();
+    QJsonObject right = b.toObject();
+    int rank = compare(typeRank(left), typeRank(right));
+    if (rank != 0) {
+        return rank;
+    }
+    
+    switch (typeRank(left)) {
+    case 0:
+        return 0;
+    case 1:
+        return compare(left["booleanValue"].toBool(), right["booleanValue"].toBool());
+    case 2:
+        return compare(numberOf(left), numberOf(right));
+    case 3:
+        return compare(left["timestampValue"].toString(), right["timestampValue"].toString());
+    case 4:
+        // Strings sort by their UTF-8 bytes
+        return compare(left["stringValue"].toString().toUtf8(), right["stringValue"].toString().toUtf8());
+    case 6:
+        // Single collection: the document ID decides
+        return compare(documentId(left["referenceValue"].toString()), documentId(right["referenceValue"].toString()));
+    default:
+        return compare(QJsonDocument(left).toJson(), QJsonDocument(right).toJson());
+    }
+}
+
+bool FirebaseStandIn::checkPrecondition(const QString& id, const QJsonObject& precondition, QString* error) const
+{
+    auto it = m_documents.constFind(id);
+    if (precondition.contains("exists")) {
+        bool exists = precondition["exists"].toBool();
+        if (exists != (it != m_documents.constEnd())) {
+            *error = exists ? QString("No document to update: %1").arg(id)
+                            : QString("Document already exists: %1").arg(id);
+            return false;
+        }
+    }
+    if (precondition.contains("updateTime")) {
+        if (it == m_documents.constEnd() || it->updateTime != precondition["updateTime"].toString()) {
+            *error = QString("The stored version of %1 does not match the required base version.").arg(id);
+            return false;
+        }
+    }
+    return true;
+}
+
+void FirebaseStandIn::applyUpdate(const QString& id, const QJsonObject& fields, const QJsonArray& mask, const QString& time)
+{
+    auto it = m_documents.find(id);
+    if (it == m_documents.end()) {
+        Document document;
+        document.createTime = time;
+        it = m_documents.insert(id, document);
+    }
+    
+    // With a mask only the listed fields change; listed fields missing
+    // from the update are removed
+    if (mask.isEmpty()) {
+        it->fields = fields;
+    } else {
+        for (const QJsonValue& value : mask) {
+            QString fieldPath = value.toString();
+            if (fields.contains(fieldPath)) {
+                it->fields[fieldPath] = fields[fieldPath];
+            } else {
+                it->fields.remove(fieldPath);
+            }
+        }
+    }
+    it->updateTime = time;
+}
+
+QJsonObject FirebaseStandIn::toJson(const QString& project, const QString& id, const Document& document,
+                                    const QStringList* mask) const
+{
+    QJsonObject json;
+    json["name"] = QString("projects/%1/databases/(default)/documents/%2/%3").arg(project, Collection, id);
+    if (!mask) {
+        json["fields"] = document.fields;
+    } else if (!mask->isEmpty()) {
+        QJsonObject fields;
+        for (const QString& fieldPath : *mask) {
+            if (document.fields.contains(fieldPath)) {
+                fields[fieldPath] = document.fields[fieldPath];
+            }
+        }
+        json["fields"] = fields;
+    }
+    json["createTime"] = document.createTime;
+    json["updateTime"] = document.updateTime;
+    return json;
+}
+
+QString FirebaseStandIn::nextTimestamp()
+{
+    // Microsecond timestamps that never repeat, like Firestore update times
+    qint64 micros = qMax(QDateTime::currentMSecsSinceEpoch() * 1000, m_lastTimestampMicros + 1);
+    m_lastTimestampMicros = micros;
+    QDateTime time = QDateTime::fromMSecsSinceEpoch(micros / 1000).toUTC();
+    return time.toString("yyyy-MM-ddTHH:mm:ss") + QString(".%1Z").arg(micros % 1000000, 6, 10, QChar('0'));
+}
+
+// --- Storage ------------------------------------------------------------
+
+FirebaseStandIn::Response FirebaseStandIn::handleStorage(const Request& request, const QString& bucket, const QString& objectPath)
+{
+    if (objectPath.isEmpty()) {
+        if (request.method == "GET") return listObjects(request, bucket);
+        if (request.method == "POST") return handleUpload(request, bucket);
+        return errorResponse(405, "Unsupported bucket request");
+    }
+    
+    auto it = m_objects.constFind(objectPath);
+    if (it == m_objects.constEnd()) {
+        return errorResponse(404, "Not Found.");
+    }
+    
+    if (request.method == "DELETE") {
+        m_objects.remove(objectPath);
+        Response response;
+        response.status = 204;
+        return response;
+    }
+    if (request.method != "GET") {
+        return errorResponse(405, "Unsupported object request");
+    }
+    
+    if (request.query.value("alt").value(0) == "media") {
+        // Download URLs carry the object's token instead of an ID token
+        if (request.query.value("token").value(0) != it->token && !authorized(request)) {
+            return errorResponse(401, "Permission denied.");
+        }
+        Response response;
+        response.contentType = it->contentType.toUtf8();
+        response.body = it->data;
+        return response;
+    }
+    return jsonResponse(objectMetadata(bucket, objectPath, it.value()));
+}
+
+FirebaseStandIn::Response FirebaseStandIn::listObjects(const Request& request, const QString& bucket)
+{
+    QString prefix = request.query.value("prefix").value(0);
+    int maxResults = request.query.value("maxResults").value(0).toInt();
+    maxResults = maxResults > 0 ? qMin(maxResults, MaxPageSize) : MaxPageSize;
+    
+    QString after = QString::fromUtf8(QByteArray::fromBase64(request.query.value("pageToken").value(0).toLatin1()));
+    auto it = after.isEmpty() ? m_objects.lowerBound(prefix) : m_objects.upperBound(after);
+    
+    QJsonArray items;
+    QString lastPath;
+    for (; it != m_objects.constEnd() && it.key().startsWith(prefix) && items.size() < maxResults; ++it) {
+        QJsonObject item;
+        item["name"] = it.key();
+        item["bucket"] = bucket;
+        items.append(item);
+        lastPath = it.key();
+    }
+    
+    QJsonObject root;
+    root["prefixes"] = QJsonArray();
+    root["items"] = items;
+    if (it != m_objects.constEnd() && it.key().startsWith(prefix)) {
+        root["nextPageToken"] = QString::fromLatin1(lastPath.toUtf8().toBase64());
+    }
+    return jsonResponse(root);
+}
+
+FirebaseStandIn::Response FirebaseStandIn::handleUpload(const Request& request, const QString& bucket)
+{
+    QByteArray command = request.headers.value("x-goog-upload-command");
+    QString uploadId = request.query.value("upload_id").value(0);
+    Response response;
+    
+    if (uploadId.isEmpty()) {
+        if (command != "start") {
+            return errorResponse(400, "Only resumable uploads are supported");
+        }
+        UploadSession session;
+        session.storagePath = request.query.value("name").value(0);
+        QJsonObject metadata = QJsonDocument::fromJson(request.body).object();
+        if (session.storagePath.isEmpty()) {
+            session.storagePath = metadata["name"].toString();
+        }
+        session.contentType = QString::fromUtf8(request.headers.value("x-goog-upload-header-content-type"));
+        if (session.contentType.isEmpty()) {
+            session.contentType = metadata["contentType"].toString("application/octet-stream");
+        }
+        if (session.storagePath.isEmpty()) {
+            return errorResponse(400, "Object name missing");
+        }
+        
+        uploadId = QString::number(m_random.generate64(), 16);
+        m_uploads.insert(uploadId, session);
+        
+        QUrlQuery query;
+        query.addQueryItem("name", QUrl::toPercentEncoding(session.storagePath));
+        query.addQueryItem("upload_id", uploadId);
+        QString sessionUrl = origin() + request.rawPath + "?" + query.toString(QUrl::FullyEncoded);
+        response.headers.append({"X-Goog-Upload-Status", "active"});
+        response.headers.append({"X-Goog-Upload-URL", sessionUrl.toUtf8()});
+        response.headers.append({"X-Goog-Upload-Chunk-Granularity", QByteArray::number(UploadChunkGranularity)});
+        return response;
+    }
+    
+    auto it = m_uploads.find(uploadId);
+    if (it == m_uploads.end()) {
+        // The client starts over when the session is gone
+        response.headers.append({"X-Goog-Upload-Status", "cancelled"});
+        return command.contains("query") ? response : errorResponse(404, "Upload session not found");
+    }
+    
+    if (command.contains("upload")) {
+        // A chunk may repeat bytes the server already has after a retry
+        qint64 offset = request.headers.value("x-goog-upload-offset").toLongLong();
+        if (offset > it->data.size()) {
+            return errorResponse(400, "Upload offset beyond received data");
+        }
+        it->data.truncate(offset);
+        it->data.append(request.body);
+    }
+    
+    if (command.contains("finalize")) {
+        UploadSession session = m_uploads.take(uploadId);
+        putObject(session.storagePath, session.data, session.contentType);
+        response = jsonResponse(objectMetadata(bucket, session.storagePath, m_objects.value(session.storagePath)));
+        response.headers.append({"X-Goog-Upload-Status", "final"});
+        return response;
+    }
+    
+    response.headers.append({"X-Goog-Upload-Status", "active"});
+    response.headers.append({"X-Goog-Upload-Size-Received", QByteArray::number(it->data.size())});
+    return response;
+}
+
+QJsonObject FirebaseStandIn::objectMetadata(const QString& bucket, const QString& storagePath, const StoredObject& object) const
+{
+    QJsonObject metadata;
+    metadata["name"] = storagePath;
+    metadata["bucket"] = bucket;
+    metadata["generation"] = QString::number(QDateTime::fromString(object.updated.left(23) + "Z", Qt::ISODateWithMs).toMSecsSinceEpoch());
+    metadata["metageneration"] = "1";
+    metadata["contentType"] = object.contentType;
+    metadata["size"] = QString::number(object.data.size());
+    metadata["timeCreated"] = object.updated;
+    metadata["updated"] = object.updated;
+    metadata["md5Hash"] = QString::fromLatin1(QCryptographicHash::hash(object.data, QCryptographicHash::Md5).toBase64());
+    metadata["downloadTokens"] = object.token;
+    return metadata;
+}
+
+// --- Auth ---------------------------------------------------------------
+
+FirebaseStandIn::Response FirebaseStandIn::signIn(const Request& request, bool signUp)
+{
+    // Auth errors carry the Identity Toolkit codes in the message
+    QJsonObject body = QJsonDocument::fromJson(request.body).object();
+    QString email = body["email"].toString().trimmed().toLower();
+    QString password = body["password"].toString();
+    if (!email.contains('@')) {
+        return errorResponse(400, "INVALID_EMAIL");
+    }
+    if (password.isEmpty()) {
+        return errorResponse(400, "MISSING_PASSWORD");
+    }
+    
+    if (signUp) {
+        if (m_users.contains(email)) {
+            return errorResponse(400, "EMAIL_EXISTS");
+        }
+        m_users.insert(email, password);
+    } else if (!m_users.isEmpty() && m_users.value(email) != password) {
+        return errorResponse(400, "INVALID_LOGIN_CREDENTIALS");
+    }
+    
+    QString userId = QString::fromLatin1(QCryptographicHash::hash(email.toUtf8(), QCryptographicHash::Sha1).toHex().left(28));
+    QString refresh;
+    QJsonObject tokens = issueTokens(userId, email, &refresh);
+    
+    QJsonObject response;
+    response["kind"] = signUp ? "identitytoolkit#SignupNewUserResponse" : "identitytoolkit#VerifyPasswordResponse";
+    response["localId"] = userId;
+    response["email"] = email;
+    response["idToken"] = tokens["idToken"];
+    response["refreshToken"] = refresh;
+    response["expiresIn"] = tokens["expiresIn"];
+    response["registered"] = true;
+    return jsonResponse(response);
+}
+
+FirebaseStandIn::Response FirebaseStandIn::refreshToken(const Request& request)
+{
+    // The service sends JSON; the REST docs show a form body
+    QJsonObject body = QJsonDocument::fromJson(request.body).object();
+    QString token = body["refresh_token"].toString();
+    if (token.isEmpty()) {
+        token = QUrlQuery(QString::fromUtf8(request.body)).queryItemValue("refresh_token", QUrl::FullyDecoded);
+    }
+    auto it = m_refreshTokens.constFind(token);
+    if (it == m_refreshTokens.constEnd()) {
+        return errorResponse(400, "INVALID_REFRESH_TOKEN");
+    }
+    
+    QString email = it.value();
+    QString userId = QString::fromLatin1(QCryptographicHash::hash(email.toUtf8(), QCryptographicHash::Sha1).toHex().left(28));
+    QString refresh = token;
+    QJsonObject tokens = issueTokens(userId, email, &refresh);
+    
+    QJsonObject response;
+    response["access_token"] = tokens["idToken"];
+    response["id_token"] = tokens["idToken"];
+    response["expires_in"] = tokens["expiresIn"];
+    response["token_type"] = "Bearer";
+    response["refresh_token"] = refresh;
+    response["user_id"] = userId;
+    return jsonResponse(response);
+}
+
+QJsonObject FirebaseStandIn::issueTokens(const QString& userId, const QString& email, QString* refreshToken)
+{
+    QString idToken = QString("standin.%1.%2").arg(userId).arg(m_random.generate64(), 0, 16);
+    m_idTokens.insert(idToken, QDateTime::currentMSecsSinceEpoch() + qint64(m_tokenLifetime) * 1000);
+    
+    // A refresh keeps its refresh token; a sign-in gets a new one
+    if (refreshToken->isEmpty()) {
+        *refreshToken = QString("refresh.%1").arg(m_random.generate64(), 0, 16);
+    }
+    m_refreshTokens.insert(*refreshToken, email);
+    
+    QJsonObject tokens;
+    tokens["idToken"] = idToken;
+    tokens["expiresIn"] = QString::number(m_tokenLifetime);
+    return tokens;
+}
@@ -0,0 +1,204 @@
+#ifndef FIREBASESTANDIN_H
+#define FIREBASESTANDIN_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QHostAddress>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QList>
+#include <QLoggingCategory>
+#include <QMap>
+#include <QRandomGenerator>
+#include <QSet>
+#include <QString>
+#include "student.h"
+
+Q_DECLARE_LOGGING_CATEGORY(standInLog)
+
+class QTcpServer;
+class QTcpSocket;
+
+/**
+ * FirebaseStandIn - Local HTTP server answering like Firestore, Storage and Auth
+ *
+ * Implements the part of the REST APIs the services use, so they can be
+ * run, tested and benchmarked without a Google project. Point them at it
+ * with NetworkAccess::setOriginOverride(standIn.origin()), or with
+ * origin= under [endpoints] in config.ini.
+ *   - Firestore: list with paging and field masks, get, create, patch
+ *     and delete with preconditions, runQuery (filters, orderBy, cursors,
+ *     select, limit), runAggregationQuery (count), partitionQuery
+ *     (collection-group queries only, paged with pageSize), batchGet
+ *     and atomic commit of up to 500 writes.
+ *   - Storage: resumable uploads (start, upload, query, finalize),
+ *     metadata, downloads, deletes and prefix listing.
+ *   - Auth: signInWithPassword, signUp and token refresh. Without users
+ *     added by addUser() any e-mail and password are accepted. ID tokens
+ *     expire after tokenLifetime and are then refused with 401.
+ * All documents live in one "People" collection under whatever project
+ * the request names.
+ *
+ * For testing retry and backoff paths, every response can be delayed and
+ * Firestore and Storage requests can fail on purpose: failNext() for a
+ * deterministic sequence, setErrorRate() for random 429/503/401 replies.
+ * Randomness comes from a seeded generator, so runs can be repeated.
+ *
+ * Plain HTTP/1.1 with keep-alive; QHttpServer is not used to keep the
+ * dependency on QtNetwork alone. Runs on the thread it was created on.
+ */
+class FirebaseStandIn : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FirebaseStandIn(QObject *parent = nullptr);
+    ~FirebaseStandIn();
+    
+    bool listen(const QHostAddress& address = QHostAddress::LocalHost, quint16 port = 0);
+    quint16 port() const;
+    QString origin() const; // "http://127.0.0.1:<port>"
+    QString errorString() const;
+    
+    // Dataset
+    void setStudents(const QList<Student>& students); // Replaces the collection
+    void addStudents(const QList<Student>& students);
+    QList<Student> students() const;
+    int documentCount() const { return m_documents.size(); }
+    void putObject(const QString& storagePath, const QByteArray& data, const QString& contentType,
+                   const QString& token = QString()); // Download token, generated when empty
+    int objectCount() const { return m_objects.size(); }
+    
+    // Auth
+    void addUser(const QString& email, const QString& password);
+    void setTokenLifetime(int seconds) { m_tokenLifetime = seconds; }
+    void setRequireAuth(bool required) { m_requireAuth = required; }
+    
+    // Faults. Latency applies to every response: latencyMs plus up to
+    // jitterMs more, drawn at random.
+    void setLatency(int latencyMs, int jitterMs = 0);
+    void setErrorRate(double rate, const QList<int>& statuses = {429, 503});
+    void failNext(int count, int status); // Before any random errors
+    void setSeed(quint32 seed) { m_random.seed(seed); }
+    
+    qint64 requestCount() const { return m_requestCount; }
+    qint64 injectedErrorCount() const { return m_injectedErrors; }
+
+signals:
+    void requestHandled(const QString& method, const QString& path, int status);
+
+private:
+    struct Request {
+        QByteArray method;
+        QString path;    // Decoded, without the query
+        QString rawPath; // As sent, still percent-encoded
+        QHash<QString, QStringList> query;
+        QHash<QByteArray, QByteArray> headers; // Lowercase names
+        QByteArray body;
+    };
+    
+    struct Response {
+        int status = 200;
+        QByteArray contentType = "application/json; charset=UTF-8";
+        QList<QPair<QByteArray, QByteArray>> headers;
+        QByteArray body;
+    };
+    
+    struct Document {
+        QJsonObject fields;
+        QString createTime;
+        QString updateTime;
+    };
+    
+    struct StoredObject {
+        QByteArray data;
+        QString contentType;
+        QString token;
+        QString updated;
+    };
+    
+    struct UploadSession {
+        QString storagePath;
+        QString contentType;
+        QByteArray data;
+    };
+    
+    struct Connection {
+        QByteArray buffer;
+        bool busy = false; // A response is being delayed; later requests wait
+    };
+    
+    void onNewConnection();
+    void processBuffer(QTcpSocket* socket);
+    bool takeRequest(QByteArray& buffer, Request* request, bool* malformed) const;
+    void send(QTcpSocket* socket, const Request& request, const Response& response);
+    
+    Response route(const Request& request);
+    Response injectedError();
+    bool authorized(const Request& request) const;
+    
+    // Firestore
+    Response handleFirestore(const Request& request, const QString& project, const QString& rest);
+    Response listDocuments(const Request& request, const QString& project);
+    Response getDocument(const QString& project, const QString& id);
+    Response createDocument(const Request& request, const QString& project);
+    Response patchDocument(const Request& request, const QString& project, const QString& id);
+    Response deleteDocument(const QString& project, const QString& id);
+    Response runQuery(const QJsonObject& body, const QString& project);
+    Response runAggregationQuery(const QJsonObject& body, const QString& project);
+    Response partitionQuery(const QJsonObject& body, const QString& project);
+    Response batchGet(const QJsonObject& body, const QString& project);
+    Response commit(const QJsonObject& body, const QString& project);
+    
+    QList<QString> evaluateQuery(const QJsonObject& query, QString* error) const; // Matching IDs, in order
+    bool matchesFilter(const QString& id, const Document& document, const QJsonObject& filter) const;
+    QJsonValue fieldValue(const QString& id, const Document& document, const QString& fieldPath) const;
+    bool checkPrecondition(const QString& id, const QJsonObject& precondition, QString* error) const;
+    void applyUpdate(const QString& id, const QJsonObject& fields, const QJsonArray& mask, const QString& time);
+    QJsonObject toJson(const QString& project, const QString& id, const Document& document,
+                       const QStringList* mask = nullptr) const; // No mask: all fields
+    QString nextTimestamp();
+    
+    // Storage
+    Response handleStorage(const Request& request, const QString& bucket, const QString& objectPath);
+    Response listObjects(const Request& request, const QString& bucket);
+    Response handleUpload(const Request& request, const QString& bucket);
+    QJsonObject objectMetadata(const QString& bucket, const QString& storagePath, const StoredObject& object) const;
+    
+    // Auth
+    Response signIn(const Request& request, bool signUp);
+    Response refreshToken(const Request& request);
+    QJsonObject issueTokens(const QString& userId, const QString& email, QString* refreshToken);
+    
+    static Response jsonResponse(const QJsonValue& json, int status = 200);
+    static Response errorResponse(int status, const QString& message, const QString& statusName = QString());
+    static int compareValues(const QJsonValue& a, const QJsonValue& b);
+    
+    QTcpServer* m_server;
+    QHash<QTcpSocket*, Connection> m_connections;
+    
+    QMap<QString, Document> m_documents; // Sorted by ID, which is document name order
+    QMap<QString, StoredObject> m_objects; // Sorted by path, like bucket listings
+    QHash<QString, UploadSession> m_uploads; // Upload ID -> session
+    
+    QHash<QString, QString> m_users;       // E-mail -> password
+    QHash<QString, qint64> m_idTokens;     // Token -> expiry (ms since epoch)
+    QHash<QString, QString> m_refreshTokens; // Token -> e-mail
+    int m_tokenLifetime;
+    bool m_requireAuth;
+    
+    int m_latency;
+    int m_jitter;
+    double m_errorRate;
+    QList<int> m_errorStatuses;
+    int m_failNextCount;
+    int m_failNextStatus;
+    QRandomGenerator m_random;
+    
+    qint64 m_lastTimestampMicros;
+    qint64 m_requestCount;
+    qint64 m_injectedErrors;
+};
+
+#endif // FIREBASESTANDIN_H
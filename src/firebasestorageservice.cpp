@@ -1,4 +1,5 @@
 #include "firebasestorageservice.h"
+#include "networkaccess.h"
 #include <QUuid>
 #include <QFileInfo>
 #include <QMimeDatabase>
@@ -7,23 +8,35 @@
 #include <QJsonArray>
 #include <QUrlQuery>
 #include <QDebug>
+#include <QFile>
+#include <QDir>
+#include <QSaveFile>
+#include <QTimer>
 
 Q_LOGGING_CATEGORY(storageLog, "firebase.storage")
 
+namespace {
+// Resumable upload chunks must be multiples of 256 KiB; they start there and
+// double after each successful chunk
+const qint64 UploadChunkGranularity = 256 * 1024;
+const qint64 MaxUploadChunkSize = 8 * 1024 * 1024;
+const int MaxUploadAttempts = 6;
+const int UploadRetryBaseMs = 1000;
+const int UploadRetryMaxMs = 32000;
+}
+
 FirebaseStorageService::FirebaseStorageService(QObject *parent)
     : QObject(parent)
-    , m_networkManager(new QNetworkAccessManager(this))
+    , m_networkManager(NetworkAccess::shared())
+    , m_uploadSerial(0)
 {
-    connect(m_networkManager, &QNetworkAccessManager::finished, 
-            this, &FirebaseStorageService::onNetworkReply);
-    
     qCInfo(storageLog) << "Firebase Storage service initialized";
 }
 
 void FirebaseStorageService::setProjectId(const QString& projectId)
 {
     m_projectId = projectId;
-    m_baseUrl = QString("https://firebasestorage.googleapis.com/v0/b/%1.appspot.com/o").arg(projectId);
+    m_baseUrl = NetworkAccess::origin(NetworkAccess::Storage) + QString("/v0/b/%1.appspot.com/o").arg(projectId);
     qCInfo(storageLog) << "Project ID set:" << projectId;
 }
 
@@ -37,6 +50,10 @@ void FirebaseStorageService::setAuthToken(const QString& authToken)
 {
     m_authToken = authToken;
     qCDebug(storageLog) << "Auth token updated";
+    
+    if (!m_authToken.isEmpty() && !m_parkedReplies.isEmpty()) {
+        replayParkedRequests();
+    }
 }
 
 void FirebaseStorageService::uploadFile(const QString& localFilePath, const QString& storagePath)
@@ -55,6 +72,7 @@ void FirebaseStorageService::uploadFile(const QString& localFilePath, const QStr
     if (!fileInfo.exists() || !fileInfo.isReadable()) {
         QString error = QString("File does not exist or is not readable: %1").arg(localFilePath);
         qCCritical(storageLog) << error;
+        emit uploadFailed(storagePath, error);
         emit errorOccurred(error);
         return;
     }
@@ -75,36 +93,210 @@ void FirebaseStorageService::uploadFile(const QString& localFilePath, const QStr
     
     qCInfo(storageLog) << "Final storage path:" << finalStoragePath;
     
-    // Build upload URL
-    QString uploadUrl = buildUploadUrl(finalStoragePath);
-    qCDebug(storageLog) << "Upload URL:" << uploadUrl;
+    // A new upload of the same object replaces one still in progress
+    Upload upload;
+    upload.storagePath = finalStoragePath;
+    upload.localPath = fileInfo.absoluteFilePath();
+    upload.contentType = contentType;
+    upload.size = fileInfo.size();
+    upload.modified = fileInfo.lastModified();
+    upload.serial = ++m_uploadSerial;
+    m_uploads[finalStoragePath] = upload;
+    
+    startUpload(finalStoragePath);
+}
+
+void FirebaseStorageService::setUploadStatePath(const QString& filePath)
+{
+    m_uploadStatePath = filePath;
+}
+
+void FirebaseStorageService::resumeInterruptedUploads()
+{
+    QFile file(m_uploadStatePath);
+    if (m_uploadStatePath.isEmpty() || !file.open(QIODevice::ReadOnly)) {
+        return;
+    }
     
-    // Create request
-    QNetworkRequest request = createUploadRequest(uploadUrl, contentType);
+    const QJsonArray saved = QJsonDocument::fromJson(file.readAll()).array();
+    for (const QJsonValue& value : saved) {
+        QJsonObject json = value.toObject();
+        Upload upload;
+        upload.storagePath = json["storagePath"].toString();
+        upload.localPath = json["localPath"].toString();
+        upload.contentType = json["contentType"].toString();
+        upload.size = json["size"].toInteger();
+        upload.modified = QDateTime::fromString(json["modified"].toString(), Qt::ISODateWithMs);
+        upload.sessionUrl = json["sessionUrl"].toString();
+        upload.resumed = true;
+        upload.serial = ++m_uploadSerial;
+        
+        // Bytes already on the server are only valid for the same file
+        QFileInfo fileInfo(upload.localPath);
+        if (upload.storagePath.isEmpty() || m_uploads.contains(upload.storagePath) || !fileInfo.exists()
+            || fileInfo.size() != upload.size || fileInfo.lastModified() != upload.modified) {
+            qCInfo(storageLog) << "Dropping interrupted upload, file changed or missing:" << upload.localPath;
+            continue;
+        }
+        
+        qCInfo(storageLog) << "Resuming interrupted upload:" << upload.storagePath;
+        m_uploads[upload.storagePath] = upload;
+        if (upload.sessionUrl.isEmpty()) {
+            startUpload(upload.storagePath);
+        } else {
+            queryUpload(upload.storagePath);
+        }
+    }
+    saveUploadState();
+}
+
+void FirebaseStorageService::startUpload(const QString& storagePath)
+{
+    Upload& upload = m_uploads[storagePath];
+    upload.sessionUrl.clear();
+    upload.offset = 0;
+    upload.chunkSize = UploadChunkGranularity;
+    
+    // Resumable protocol: the start request carries the metadata and
+    // returns the session URL the data is sent to
+    QNetworkRequest request = createUploadRequest(buildUploadUrl(storagePath), "application/json; charset=utf-8");
+    request.setRawHeader("X-Goog-Upload-Protocol", "resumable");
+    request.setRawHeader("X-Goog-Upload-Command", "start");
+    request.setRawHeader("X-Goog-Upload-Header-Content-Length", QByteArray::number(upload.size));
+    request.setRawHeader("X-Goog-Upload-Header-Content-Type", upload.contentType.toUtf8());
+    
+    QJsonObject metadata;
+    metadata["name"] = storagePath;
+    metadata["contentType"] = upload.contentType;
+    QByteArray data = QJsonDocument(metadata).toJson(QJsonDocument::Compact);
+    
+    qCInfo(storageLog) << "Starting resumable upload," << upload.size << "bytes";
+    QNetworkReply* reply = m_networkManager->post(request, data);
+    watchReply(reply, data);
+    m_pendingRequests[reply] = StartUpload;
+    m_requestPaths[reply] = storagePath;
+    m_uploadSerials[reply] = upload.serial;
+}
+
+void FirebaseStorageService::uploadNextChunk(const QString& storagePath)
+{
+    Upload& upload = m_uploads[storagePath];
     
-    // Read file data
-    QFile file(localFilePath);
-    if (!file.open(QIODevice::ReadOnly)) {
-        QString error = QString("Failed to open file for reading: %1").arg(localFilePath);
-        qCCritical(storageLog) << error;
-        emit errorOccurred(error);
+    // Only one chunk is in memory at a time, read straight from the file
+    QFile file(upload.localPath);
+    if (!file.open(QIODevice::ReadOnly) || file.size() != upload.size || !file.seek(upload.offset)) {
+        failUpload(storagePath, QString("File changed or unreadable during upload: %1").arg(upload.localPath));
         return;
     }
+    QByteArray chunk = file.read(qMin(upload.chunkSize, upload.size - upload.offset));
+    bool last = upload.offset + chunk.size() >= upload.size;
+    
+    QNetworkRequest request = createUploadRequest(upload.sessionUrl, "application/octet-stream");
+    request.setRawHeader("X-Goog-Upload-Command", last ? "upload, finalize" : "upload");
+    request.setRawHeader("X-Goog-Upload-Offset", QByteArray::number(upload.offset));
+    
+    qCDebug(storageLog) << "Uploading chunk at offset" << upload.offset << "size" << chunk.size() << (last ? "(last)" : "");
+    QNetworkReply* reply = m_networkManager->post(request, chunk);
+    watchReply(reply, chunk);
+    trackChunkProgress(reply, storagePath);
+    m_pendingRequests[reply] = UploadChunk;
+    m_requestPaths[reply] = storagePath;
+    m_uploadSerials[reply] = upload.serial;
+    m_chunkSizes[reply] = chunk.size();
+}
+
+void FirebaseStorageService::queryUpload(const QString& storagePath)
+{
+    const Upload& upload = m_uploads[storagePath];
+    
+    // Asks how many bytes the server kept, so only the rest is sent again
+    QNetworkRequest request = createUploadRequest(upload.sessionUrl, "application/octet-stream");
+    request.setRawHeader("X-Goog-Upload-Command", "query");
+    
+    QNetworkReply* reply = m_networkManager->post(request, QByteArray());
+    watchReply(reply);
+    m_pendingRequests[reply] = QueryUpload;
+    m_requestPaths[reply] = storagePath;
+    m_uploadSerials[reply] = upload.serial;
+}
+
+void FirebaseStorageService::trackChunkProgress(QNetworkReply* reply, const QString& storagePath)
+{
+    connect(reply, &QNetworkReply::uploadProgress, this, [this, storagePath](qint64 bytesSent, qint64) {
+        auto it = m_uploads.constFind(storagePath);
+        if (it == m_uploads.constEnd() || it->size <= 0) {
+            return;
+        }
+        qint64 sent = it->offset + bytesSent;
+        emit uploadProgress(storagePath, sent, it->size);
+        qCDebug(storageLog) << "Upload progress for" << storagePath << ":" << (sent * 100) / it->size << "%";
+    });
+}
+
+bool FirebaseStorageService::retryUpload(const QString& storagePath)
+{
+    auto it = m_uploads.find(storagePath);
+    if (it == m_uploads.end() || ++it->attempts > MaxUploadAttempts) {
+        return false;
+    }
     
-    QByteArray fileData = file.readAll();
-    file.close();
+    // Smaller chunks lose less on a flaky connection
+    it->chunkSize = UploadChunkGranularity;
+    int delay = qMin(UploadRetryBaseMs << (it->attempts - 1), UploadRetryMaxMs);
+    qCWarning(storageLog) << "Upload interrupted, attempt" << it->attempts << "of" << MaxUploadAttempts
+                          << "in" << delay << "ms:" << storagePath;
     
-    qCInfo(storageLog) << "Sending upload request...";
-    QNetworkReply* reply = m_networkManager->post(request, fileData);
+    QTimer::singleShot(delay, this, [this, storagePath]() {
+        auto upload = m_uploads.constFind(storagePath);
+        if (upload == m_uploads.constEnd()) {
+            return;
+        }
+        if (upload->sessionUrl.isEmpty()) {
+            startUpload(storagePath);
+        } else {
+            queryUpload(storagePath);
+        }
+    });
+    return true;
+}
+
+void FirebaseStorageService::failUpload(const QString& storagePath, const QString& error)
+{
+    Upload upload = m_uploads.take(storagePath);
+    saveUploadState();
+    qCCritical(storageLog) << "Upload failed:" << storagePath << error;
+    emit uploadFailed(storagePath, error);
     
-    // Track upload progress
-    connect(reply, &QNetworkReply::uploadProgress, 
-            this, &FirebaseStorageService::onUploadProgress);
+    // Nobody waits for an upload resumed from an earlier run
+    if (!upload.resumed) {
+        emit errorOccurred(error);
+    }
+}
+
+void FirebaseStorageService::saveUploadState() const
+{
+    if (m_uploadStatePath.isEmpty()) {
+        return;
+    }
     
-    m_pendingRequests[reply] = UploadFile;
-    m_requestPaths[reply] = finalStoragePath;
+    QJsonArray saved;
+    for (const Upload& upload : m_uploads) {
+        QJsonObject json;
+        json["storagePath"] = upload.storagePath;
+        json["localPath"] = upload.localPath;
+        json["contentType"] = upload.contentType;
+        json["size"] = upload.size;
+        json["modified"] = upload.modified.toString(Qt::ISODateWithMs);
+        json["sessionUrl"] = upload.sessionUrl;
+        saved.append(json);
+    }
     
-    qCDebug(storageLog) << "Upload request sent, waiting for response...";
+    QDir().mkpath(QFileInfo(m_uploadStatePath).absolutePath());
+    QSaveFile file(m_uploadStatePath);
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(saved).toJson(QJsonDocument::Compact));
+        file.commit();
+    }
 }
 
 void FirebaseStorageService::deleteFile(const QString& storagePath)
@@ -117,11 +309,63 @@ void FirebaseStorageService::deleteFile(const QString& storagePath)
     
     qCInfo(storageLog) << "Sending delete request...";
     QNetworkReply* reply = m_networkManager->deleteResource(request);
+    watchReply(reply);
     
     m_pendingRequests[reply] = DeleteFile;
     m_requestPaths[reply] = storagePath;
 }
 
+void FirebaseStorageService::deleteFiles(const QStringList& storagePaths, const QString& tag)
+{
+    qCInfo(storageLog) << "Deleting" << storagePaths.size() << "files, tag:" << tag;
+    
+    if (storagePaths.isEmpty()) {
+        emit filesDeleted(tag, QStringList(), QStringList());
+        return;
+    }
+    
+    // A batch with the same tag still running is reported together with this one
+    m_deleteBatches[tag].remaining += storagePaths.size();
+    
+    for (const QString& storagePath : storagePaths) {
+        QNetworkRequest request = createMetadataRequest(buildMetadataUrl(storagePath));
+        QNetworkReply* reply = m_networkManager->deleteResource(request);
+        watchReply(reply);
+        
+        m_pendingRequests[reply] = DeleteBatchFile;
+        m_requestPaths[reply] = storagePath;
+        m_requestTags[reply] = tag;
+    }
+}
+
+void FirebaseStorageService::listFiles(const QString& prefix, const QString& tag)
+{
+    qCInfo(storageLog) << "Listing files under" << prefix << "tag:" << tag;
+    requestListPage(prefix, tag, QString());
+}
+
+void FirebaseStorageService::requestListPage(const QString& prefix, const QString& tag, const QString& pageToken)
+{
+    QUrlQuery query;
+    query.addQueryItem("prefix", QUrl::toPercentEncoding(prefix));
+    query.addQueryItem("maxResults", "1000");
+    if (!pageToken.isEmpty()) {
+        query.addQueryItem("pageToken", QUrl::toPercentEncoding(pageToken));
+    }
+    if (!m_apiKey.isEmpty()) {
+        query.addQueryItem("key", m_apiKey);
+    }
+    
+    QString url = m_baseUrl + "?" + query.toString();
+    
+    QNetworkReply* reply = m_networkManager->get(createMetadataRequest(url));
+    watchReply(reply);
+    
+    m_pendingRequests[reply] = ListFiles;
+    m_requestPaths[reply] = prefix;
+    m_requestTags[reply] = tag;
+}
+
 void FirebaseStorageService::getDownloadUrl(const QString& storagePath)
 {
     qCInfo(storageLog) << "=== Getting download URL ===";
@@ -132,6 +376,7 @@ void FirebaseStorageService::getDownloadUrl(const QString& storagePath)
     
     qCInfo(storageLog) << "Sending metadata request...";
     QNetworkReply* reply = m_networkManager->get(request);
+    watchReply(reply);
     
     m_pendingRequests[reply] = GetDownloadUrl;
     m_requestPaths[reply] = storagePath;
@@ -147,6 +392,7 @@ void FirebaseStorageService::loadImage(const QString& imageUrl)
     qCInfo(storageLog) << "Fixed Image URL:" << fixedUrl;
     
     QNetworkRequest request(fixedUrl);
+    NetworkAccess::prepare(request);
     
     // Add authentication header if available
     if (!m_authToken.isEmpty()) {
@@ -158,6 +404,7 @@ void FirebaseStorageService::loadImage(const QString& imageUrl)
     
     qCInfo(storageLog) << "Sending image request...";
     QNetworkReply* reply = m_networkManager->get(request);
+    watchReply(reply);
     
     m_pendingRequests[reply] = LoadImage;
     m_requestPaths[reply] = imageUrl; // Store the original URL for reference
@@ -165,10 +412,11 @@ void FirebaseStorageService::loadImage(const QString& imageUrl)
 
 QString FirebaseStorageService::buildUploadUrl(const QString& storagePath) const
 {
-    QString encodedPath = QUrl::toPercentEncoding(storagePath);
-    QString url = QString("%1/%2").arg(m_baseUrl, encodedPath);
+    // Uploads name the object in the query instead of the path
+    QString url = m_baseUrl;
     
     QUrlQuery query;
+    query.addQueryItem("name", QUrl::toPercentEncoding(storagePath));
     if (!m_apiKey.isEmpty()) {
         query.addQueryItem("key", m_apiKey);
     }
@@ -215,6 +463,7 @@ QNetworkRequest FirebaseStorageService::createUploadRequest(const QString& url,
 {
     QNetworkRequest request(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, contentType);
+    NetworkAccess::prepare(request);
     
     if (!m_authToken.isEmpty()) {
         request.setRawHeader("Authorization", QString("Bearer %1").arg(m_authToken).toUtf8());
@@ -233,6 +482,7 @@ QNetworkRequest FirebaseStorageService::createMetadataRequest(const QString& url
 {
     QNetworkRequest request(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    NetworkAccess::prepare(request);
     
     if (!m_authToken.isEmpty()) {
         request.setRawHeader("Authorization", QString("Bearer %1").arg(m_authToken).toUtf8());
@@ -241,8 +491,85 @@ QNetworkRequest FirebaseStorageService::createMetadataRequest(const QString& url
     return request;
 }
 
+void FirebaseStorageService::watchReply(QNetworkReply* reply, const QByteArray& body)
+{
+    m_requestBodies[reply] = body;
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        onNetworkReply(reply);
+    });
+}
+
+bool FirebaseStorageService::parkIfUnauthorized(QNetworkReply* reply)
+{
+    if (!NetworkAccess::isUnauthorized(reply) || !m_pendingRequests.contains(reply)
+        || m_replayedRequests.contains(reply)) {
+        return false;
+    }
+    
+    m_parkedReplies.append(reply);
+    
+    // The token may have been refreshed while this request was in flight
+    if (!m_authToken.isEmpty() && reply->request().rawHeader("Authorization") != QString("Bearer %1").arg(m_authToken).toUtf8()) {
+        replayParkedRequests();
+        return true;
+    }
+    
+    qCInfo(storageLog) << "ID token refused, holding request until it is refreshed:" << m_requestPaths.value(reply);
+    if (m_parkedReplies.size() == 1) {
+        emit authenticationRequired();
+    }
+    return true;
+}
+
+void FirebaseStorageService::replayParkedRequests()
+{
+    const QList<QNetworkReply*> parked = m_parkedReplies;
+    m_parkedReplies.clear();
+    
+    qCInfo(storageLog) << "Replaying" << parked.size() << "request(s) with the new ID token";
+    for (QNetworkReply* oldReply : parked) {
+        QByteArray body = m_requestBodies.take(oldReply);
+        QNetworkReply* reply = NetworkAccess::resend(oldReply, body, m_authToken);
+        watchReply(reply, body);
+        
+        RequestType requestType = m_pendingRequests.take(oldReply);
+        m_pendingRequests[reply] = requestType;
+        m_requestPaths[reply] = m_requestPaths.take(oldReply);
+        if (m_uploadSerials.contains(oldReply)) {
+            m_uploadSerials[reply] = m_uploadSerials.take(oldReply);
+        }
+        if (m_chunkSizes.contains(oldReply)) {
+            m_chunkSizes[reply] = m_chunkSizes.take(oldReply);
+        }
+        if (m_requestTags.contains(oldReply)) {
+            m_requestTags[reply] = m_requestTags.take(oldReply);
+        }
+        if (requestType == UploadChunk) {
+            trackChunkProgress(reply, m_requestPaths.value(reply));
+        }
+        m_replayedRequests.insert(reply);
+        oldReply->deleteLater();
+    }
+}
+
+void FirebaseStorageService::abortParkedRequests()
+{
+    const QList<QNetworkReply*> parked = m_parkedReplies;
+    m_parkedReplies.clear();
+    
+    for (QNetworkReply* reply : parked) {
+        m_replayedRequests.insert(reply);
+        onNetworkReply(reply);
+    }
+}
+
 void FirebaseStorageService::onNetworkReply(QNetworkReply* reply)
 {
+    // Held back until a new ID token arrives, then sent again
+    if (parkIfUnauthorized(reply)) {
+        return;
+    }
+    
     reply->deleteLater();
     
     if (!m_pendingRequests.contains(reply)) {
@@ -252,39 +579,52 @@ void FirebaseStorageService::onNetworkReply(QNetworkReply* reply)
     
     RequestType requestType = m_pendingRequests.take(reply);
     QString storagePath = m_requestPaths.take(reply);
+    int uploadSerial = m_uploadSerials.take(reply);
+    qint64 chunkSize = m_chunkSizes.take(reply);
+    QString tag = m_requestTags.take(reply);
+    m_requestBodies.remove(reply);
+    m_replayedRequests.remove(reply);
     
     qCDebug(storageLog) << "=== Processing network reply ===";
     qCDebug(storageLog) << "Request type:" << requestType;
     qCDebug(storageLog) << "Storage path:" << storagePath;
     qCDebug(storageLog) << "HTTP status:" << reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
     
+    // Uploads handle their own errors: an interrupted transfer continues
+    // from the last byte the server kept
+    if (requestType == StartUpload || requestType == UploadChunk || requestType == QueryUpload) {
+        handleResumableReply(reply, requestType, storagePath, uploadSerial, chunkSize);
+        return;
+    }
+    
+    // Batch deletes and listings report their errors to the caller by tag
+    if (requestType == DeleteBatchFile) {
+        handleBatchDeleteReply(reply, storagePath, tag);
+        return;
+    }
+    if (requestType == ListFiles) {
+        handleListReply(reply, storagePath, tag);
+        return;
+    }
+    
+    int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (requestType == DeleteFile && statusCode == 404) {
+        qCInfo(storageLog) << "File already deleted:" << storagePath;
+        emit fileDeleted(storagePath);
+        return;
+    }
+    
     if (reply->error() != QNetworkReply::NoError) {
-        QByteArray responseData = reply->readAll();
-        QString error = QString("Network error: %1").arg(reply->errorString());
-        qCCritical(storageLog) << error;
-        qCCritical(storageLog) << "Response body:" << responseData;
-        
-        // Try to parse Firebase error message
-        QJsonParseError parseError;
-        QJsonDocument doc = QJsonDocument::fromJson(responseData, &parseError);
-        if (parseError.error == QJsonParseError::NoError) {
-            QJsonObject errorObj = doc.object();
-            if (errorObj.contains("error")) {
-                QJsonObject errorDetails = errorObj["error"].toObject();
-                QString firebaseError = errorDetails["message"].toString();
-                if (!firebaseError.isEmpty()) {
-                    error = QString("Firebase Storage error: %1").arg(firebaseError);
-                }
-            }
-        }
-        
-        emit errorOccurred(error);
+        emit errorOccurred(replyErrorMessage(reply));
         return;
     }
     
     switch (requestType) {
-        case UploadFile:
-            handleUploadReply(reply, storagePath);
+        case StartUpload:
+        case UploadChunk:
+        case QueryUpload:
+        case DeleteBatchFile:
+        case ListFiles:
             break;
         case DeleteFile:
             handleDeleteReply(reply, storagePath);
@@ -298,21 +638,97 @@ void FirebaseStorageService::onNetworkReply(QNetworkReply* reply)
     }
 }
 
-void FirebaseStorageService::onUploadProgress(qint64 bytesSent, qint64 bytesTotal)
+QString FirebaseStorageService::replyErrorMessage(QNetworkReply* reply) const
+{
+    QByteArray responseData = reply->readAll();
+    QString error = QString("Network error: %1").arg(reply->errorString());
+    qCCritical(storageLog) << error;
+    qCCritical(storageLog) << "Response body:" << responseData;
+    
+    // Try to parse Firebase error message
+    QJsonParseError parseError;
+    QJsonDocument doc = QJsonDocument::fromJson(responseData, &parseError);
+    if (parseError.error == QJsonParseError::NoError) {
+        QJsonObject errorObj = doc.object();
+        if (errorObj.contains("error")) {
+            QJsonObject errorDetails = errorObj["error"].toObject();
+            QString firebaseError = errorDetails["message"].toString();
+            if (!firebaseError.isEmpty()) {
+                error = QString("Firebase Storage error: %1").arg(firebaseError);
+            }
+        }
+    }
+    return error;
+}
+
+void FirebaseStorageService::handleResumableReply(QNetworkReply* reply, RequestType requestType,
+                                                  const QString& storagePath, int serial, qint64 chunkSize)
 {
-    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
-    if (reply && m_requestPaths.contains(reply)) {
-        QString storagePath = m_requestPaths[reply];
-        emit uploadProgress(storagePath, bytesSent, bytesTotal);
+    auto it = m_uploads.find(storagePath);
+    if (it == m_uploads.end() || it->serial != serial) {
+        qCDebug(storageLog) << "Ignoring reply for a replaced upload:" << storagePath;
+        return;
+    }
+    
+    if (reply->error() != QNetworkReply::NoError) {
+        int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        
+        // The session URL expired or was cancelled: start a new session
+        if (requestType != StartUpload && (statusCode == 404 || statusCode == 410)) {
+            it->sessionUrl.clear();
+            if (!retryUpload(storagePath)) {
+                failUpload(storagePath, replyErrorMessage(reply));
+            }
+            return;
+        }
         
-        if (bytesTotal > 0) {
-            int percentage = (bytesSent * 100) / bytesTotal;
-            qCDebug(storageLog) << "Upload progress for" << storagePath << ":" << percentage << "%";
+        bool retryable = statusCode == 0 || statusCode == 408 || statusCode == 429 || statusCode >= 500;
+        if (!retryable || !retryUpload(storagePath)) {
+            failUpload(storagePath, replyErrorMessage(reply));
         }
+        return;
+    }
+    
+    QByteArray status = reply->rawHeader("X-Goog-Upload-Status");
+    if (status == "final") {
+        Upload upload = m_uploads.take(storagePath);
+        saveUploadState();
+        handleUploadReply(reply, storagePath, upload.resumed);
+        return;
+    }
+    
+    switch (requestType) {
+    case StartUpload:
+        it->sessionUrl = QString::fromUtf8(reply->rawHeader("X-Goog-Upload-URL"));
+        if (it->sessionUrl.isEmpty()) {
+            failUpload(storagePath, "Upload session URL missing from response");
+            return;
+        }
+        saveUploadState();
+        uploadNextChunk(storagePath);
+        break;
+    case QueryUpload:
+        if (status != "active") {
+            qCWarning(storageLog) << "Upload session" << status << "- starting over:" << storagePath;
+            startUpload(storagePath);
+            return;
+        }
+        it->offset = reply->rawHeader("X-Goog-Upload-Size-Received").toLongLong();
+        qCInfo(storageLog) << "Resuming upload at byte" << it->offset << "of" << it->size;
+        uploadNextChunk(storagePath);
+        break;
+    case UploadChunk:
+        it->offset += chunkSize;
+        it->attempts = 0;
+        it->chunkSize = qMin(it->chunkSize * 2, MaxUploadChunkSize);
+        uploadNextChunk(storagePath);
+        break;
+    default:
+        break;
     }
 }
 
-void FirebaseStorageService::handleUploadReply(QNetworkReply* reply, const QString& storagePath)
+void FirebaseStorageService::handleUploadReply(QNetworkReply* reply, const QString& storagePath, bool resumed)
 {
     qCInfo(storageLog) << "=== Handling upload reply ===";
     
@@ -345,7 +761,11 @@ void FirebaseStorageService::handleUploadReply(QNetworkReply* reply, const QStri
     qCInfo(storageLog) << "File uploaded successfully";
     qCDebug(storageLog) << "Download URL:" << downloadUrl;
     
-    emit fileUploaded(storagePath, downloadUrl);
+    if (resumed) {
+        emit interruptedUploadFinished(storagePath, downloadUrl);
+    } else {
+        emit fileUploaded(storagePath, downloadUrl);
+    }
 }
 
 void FirebaseStorageService::handleDeleteReply(QNetworkReply* reply, const QString& storagePath)
@@ -365,6 +785,64 @@ void FirebaseStorageService::handleDeleteReply(QNetworkReply* reply, const QStri
     }
 }
 
+void FirebaseStorageService::handleBatchDeleteReply(QNetworkReply* reply, const QString& storagePath, const QString& tag)
+{
+    int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    
+    auto it = m_deleteBatches.find(tag);
+    if (it == m_deleteBatches.end()) {
+        return;
+    }
+    
+    // 404: removed earlier, e.g. by an interrupted batch
+    if (statusCode == 204 || statusCode == 200 || statusCode == 404) {
+        qCDebug(storageLog) << "Deleted:" << storagePath << "HTTP" << statusCode;
+        it->deleted.append(storagePath);
+    } else {
+        qCWarning(storageLog) << "Failed to delete" << storagePath << "-" << replyErrorMessage(reply);
+        it->failed.append(storagePath);
+    }
+    
+    if (--it->remaining > 0) {
+        return;
+    }
+    
+    DeleteBatch batch = m_deleteBatches.take(tag);
+    qCInfo(storageLog) << "Delete batch" << tag << "finished:" << batch.deleted.size()
+                       << "deleted," << batch.failed.size() << "failed";
+    emit filesDeleted(tag, batch.deleted, batch.failed);
+}
+
+void FirebaseStorageService::handleListReply(QNetworkReply* reply, const QString& prefix, const QString& tag)
+{
+    if (reply->error() != QNetworkReply::NoError) {
+        emit listFailed(tag, replyErrorMessage(reply));
+        return;
+    }
+    
+    QJsonParseError parseError;
+    QJsonDocument doc = QJsonDocument::fromJson(reply->readAll(), &parseError);
+    if (parseError.error != QJsonParseError::NoError) {
+        emit listFailed(tag, QString("Failed to parse listing: %1").arg(parseError.errorString()));
+        return;
+    }
+    
+    QJsonObject response = doc.object();
+    QStringList names;
+    const QJsonArray items = response["items"].toArray();
+    for (const QJsonValue& item : items) {
+        names.append(item.toObject()["name"].toString());
+    }
+    
+    QString nextPageToken = response["nextPageToken"].toString();
+    if (!nextPageToken.isEmpty()) {
+        requestListPage(prefix, tag, nextPageToken);
+    }
+    
+    qCDebug(storageLog) << "Listed" << names.size() << "files under" << prefix;
+    emit filesListed(tag, names, nextPageToken.isEmpty());
+}
+
 void FirebaseStorageService::handleDownloadUrlReply(QNetworkReply* reply, const QString& storagePath)
 {
     qCInfo(storageLog) << "=== Handling download URL reply ===";
@@ -453,6 +931,20 @@ QString FirebaseStorageService::generateUniqueFileName(const QString& originalFi
     }
 }
 
+QString FirebaseStorageService::storagePathFromUrl(const QString& downloadUrl)
+{
+    // fixMalformedUrl repairs the query only; the path is all we need here
+    QUrl url(downloadUrl);
+    QString path = url.path(QUrl::FullyEncoded);
+    
+    int marker = path.indexOf("/o/");
+    if (!path.contains("/v0/b/") || marker < 0) {
+        return QString();
+    }
+    
+    return QUrl::fromPercentEncoding(path.mid(marker + 3).toUtf8());
+}
+
 QString FirebaseStorageService::fixMalformedUrl(const QString& url) const
 {
     if (url.isEmpty()) {
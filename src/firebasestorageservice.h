@@ -12,6 +12,9 @@
 #include <QHttpPart>
 #include <QFileInfo>
 #include <QMimeDatabase>
+#include <QSet>
+#include <QHash>
+#include <QDateTime>
 
 Q_DECLARE_LOGGING_CATEGORY(storageLog)
 
@@ -24,35 +27,74 @@ public:
     
     void setProjectId(const QString& projectId);
     void setApiKey(const QString& apiKey);
+    // A new token also resends the requests held back after a 401
     void setAuthToken(const QString& authToken);
     
-    // Storage operations
+    // Fails the held-back requests with their original 401
+    void abortParkedRequests();
+    
+    // Storage operations. Uploads use the resumable protocol: the file is
+    // sent in chunks read from disk, and an interrupted upload continues
+    // from the last byte the server kept instead of starting over.
     void uploadFile(const QString& localFilePath, const QString& storagePath);
+    
+    // Upload sessions are saved here, so uploads cut off by closing the
+    // application can be finished by resumeInterruptedUploads() on the next
+    // run; those report through interruptedUploadFinished
+    void setUploadStatePath(const QString& filePath);
+    void resumeInterruptedUploads();
+    QStringList activeUploads() const { return m_uploads.keys(); } // Storage paths still being uploaded
     void deleteFile(const QString& storagePath);
+    
+    // Deletes several objects at once; the requests share the HTTP/2
+    // connection and the outcome is reported once through filesDeleted with
+    // the same tag. Objects that are already gone count as deleted.
+    void deleteFiles(const QStringList& storagePaths, const QString& tag);
+    
+    // Lists the objects whose names start with prefix, one filesListed per
+    // page; the last page has finished set
+    void listFiles(const QString& prefix, const QString& tag);
+    
+    // Object path inside the bucket for a download URL
+    // (.../v0/b/<bucket>/o/<encoded path>?alt=media&token=...), empty when
+    // the URL is not a Storage download URL
+    static QString storagePathFromUrl(const QString& downloadUrl);
+    
     void getDownloadUrl(const QString& storagePath);
     void loadImage(const QString& imageUrl);
 
 signals:
     void fileUploaded(const QString& storagePath, const QString& downloadUrl);
+    void interruptedUploadFinished(const QString& storagePath, const QString& downloadUrl);
     void fileDeleted(const QString& storagePath);
+    void filesDeleted(const QString& tag, const QStringList& deletedPaths, const QStringList& failedPaths);
+    void filesListed(const QString& tag, const QStringList& storagePaths, bool finished);
+    void listFailed(const QString& tag, const QString& error);
     void downloadUrlReceived(const QString& storagePath, const QString& downloadUrl);
     void imageLoaded(const QString& imageUrl, const QByteArray& imageData);
     void imageLoadFailed(const QString& imageUrl, const QString& error);
     void uploadProgress(const QString& storagePath, qint64 bytesSent, qint64 bytesTotal);
+    void uploadFailed(const QString& storagePath, const QString& error); // Also reported through errorOccurred
     void errorOccurred(const QString& error);
+    void authenticationRequired(); // A request got 401 and waits for setAuthToken()
 
 private slots:
     void onNetworkReply(QNetworkReply* reply);
-    void onUploadProgress(qint64 bytesSent, qint64 bytesTotal);
 
 private:
+    void watchReply(QNetworkReply* reply, const QByteArray& body = QByteArray());
+    bool parkIfUnauthorized(QNetworkReply* reply);
+    void replayParkedRequests();
     QString buildUploadUrl(const QString& storagePath) const;
     QString buildMetadataUrl(const QString& storagePath) const;
     QString buildDownloadUrl(const QString& storagePath, const QString& token) const;
     QNetworkRequest createUploadRequest(const QString& url, const QString& contentType) const;
     QNetworkRequest createMetadataRequest(const QString& url) const;
-    void handleUploadReply(QNetworkReply* reply, const QString& storagePath);
+    void handleUploadReply(QNetworkReply* reply, const QString& storagePath, bool resumed = false);
     void handleDeleteReply(QNetworkReply* reply, const QString& storagePath);
+    void handleBatchDeleteReply(QNetworkReply* reply, const QString& storagePath, const QString& tag);
+    void handleListReply(QNetworkReply* reply, const QString& prefix, const QString& tag);
+    void requestListPage(const QString& prefix, const QString& tag, const QString& pageToken);
     void handleDownloadUrlReply(QNetworkReply* reply, const QString& storagePath);
     void handleImageLoadReply(QNetworkReply* reply, const QString& imageUrl);
     QString generateUniqueFileName(const QString& originalFileName) const;
@@ -65,14 +107,61 @@ private:
     QString m_baseUrl;
     
     enum RequestType {
-        UploadFile,
+        StartUpload,
+        UploadChunk,
+        QueryUpload,
         DeleteFile,
+        DeleteBatchFile,
+        ListFiles,
         GetDownloadUrl,
         LoadImage
     };
     
+    struct DeleteBatch {
+        int remaining = 0;
+        QStringList deleted;
+        QStringList failed;
+    };
+    
+    struct Upload {
+        QString storagePath;
+        QString localPath;
+        QString contentType;
+        qint64 size = 0;
+        QDateTime modified;    // With size, detects a file changed between runs
+        QString sessionUrl;    // From the start request; empty until then
+        qint64 offset = 0;     // Bytes the server has confirmed
+        qint64 chunkSize = 0;
+        int attempts = 0;
+        int serial = 0;        // Tells replies of a replaced upload apart
+        bool resumed = false;  // Picked up from an earlier run
+    };
+    
+    void startUpload(const QString& storagePath);
+    void uploadNextChunk(const QString& storagePath);
+    void queryUpload(const QString& storagePath);
+    void trackChunkProgress(QNetworkReply* reply, const QString& storagePath);
+    bool retryUpload(const QString& storagePath);
+    void failUpload(const QString& storagePath, const QString& error);
+    void saveUploadState() const;
+    void handleResumableReply(QNetworkReply* reply, RequestType requestType,
+                              const QString& storagePath, int serial, qint64 chunkSize);
+    QString replyErrorMessage(QNetworkReply* reply) const;
+    
     QHash<QNetworkReply*, RequestType> m_pendingRequests;
     QHash<QNetworkReply*, QString> m_requestPaths; // For tracking storage paths
+    QHash<QNetworkReply*, QByteArray> m_requestBodies; // For resending after a 401
+    QList<QNetworkReply*> m_parkedReplies; // Refused with 401, waiting for a new token
+    QSet<QNetworkReply*> m_replayedRequests; // Already resent once; a second 401 is an error
+    
+    QHash<QNetworkReply*, QString> m_requestTags; // Batch deletes and listings
+    QHash<QString, DeleteBatch> m_deleteBatches; // Tag -> deletes still outstanding
+    
+    QHash<QString, Upload> m_uploads; // Storage path -> upload in progress
+    QHash<QNetworkReply*, int> m_uploadSerials;
+    QHash<QNetworkReply*, qint64> m_chunkSizes;
+    QString m_uploadStatePath;
+    int m_uploadSerial;
 };
 
 #endif // FIREBASESTORAGESERVICE_H
@@ -0,0 +1,200 @@
+#include "firestorequery.h"
+#include "studentfilter.h"
+
+FirestoreQuery::FirestoreQuery(const QString& collectionId)
+    : m_collectionId(collectionId)
+    , m_allDescendants(false)
+    , m_limit(0)
+{
+}
+
+FirestoreQuery& FirestoreQuery::where(const QString& fieldPath, Operator op, const QJsonValue& value)
+{
+    QJsonObject field;
+    field["fieldPath"] = fieldPath;
+    
+    QJsonObject fieldFilter;
+    fieldFilter["field"] = field;
+    fieldFilter["op"] = operatorName(op);
+    fieldFilter["value"] = encodeValue(value);
+    
+    QJsonObject filter;
+    filter["fieldFilter"] = fieldFilter;
+    m_filters.append(filter);
+    return *this;
+}
+
+FirestoreQuery& FirestoreQuery::orderBy(const QString& fieldPath, Direction direction)
+{
+    QJsonObject field;
+    field["fieldPath"] = fieldPath;
+    
+    QJsonObject order;
+    order["field"] = field;
+    order["direction"] = direction == Descending ? "DESCENDING" : "ASCENDING";
+    m_orderBy.append(order);
+    return *this;
+}
+
+FirestoreQuery& FirestoreQuery::limit(int count)
+{
+    m_limit = count;
+    return *this;
+}
+
+FirestoreQuery& FirestoreQuery::select(const QStringList& fieldPaths)
+{
+    m_select = fieldPaths;
+    return *this;
+}
+
+FirestoreQuery& FirestoreQuery::allDescendants(bool enabled)
+{
+    m_allDescendants = enabled;
+    return *this;
+}
+
+FirestoreQuery& FirestoreQuery::startAt(const QJsonObject& cursor)
+{
+    m_startAt = cursor;
+    m_startAt["before"] = true;
+    return *this;
+}
+
+FirestoreQuery& FirestoreQuery::startAfter(const QJsonObject& cursor)
+{
+    m_startAt = cursor;
+    m_startAt["before"] = false;
+    return *this;
+}
+
+FirestoreQuery& FirestoreQuery::endBefore(const QJsonObject& cursor)
+{
+    m_endAt = cursor;
+    m_endAt["before"] = true;
+    return *this;
+}
+
+QJsonObject FirestoreQuery::toStructuredQuery() const
+{
+    QJsonObject query;
+    
+    QJsonObject collection;
+    collection["collectionId"] = m_collectionId;
+    if (m_allDescendants) {
+        collection["allDescendants"] = true;
+    }
+    query["from"] = QJsonArray{collection};
+    
+    if (!m_select.isEmpty()) {
+        QJsonArray fields;
+        for (const QString& fieldPath : m_select) {
+            QJsonObject field;
+            field["fieldPath"] = fieldPath;
+            fields.append(field);
+        }
+        QJsonObject projection;
+        projection["fields"] = fields;
+        query["select"] = projection;
+    }
+    
+    if (m_filters.size() == 1) {
+        query["where"] = m_filters.first();
+    } else if (m_filters.size() > 1) {
+        QJsonObject compositeFilter;
+        compositeFilter["op"] = "AND";
+        compositeFilter["filters"] = m_filters;
+        
+        QJsonObject where;
+        where["compositeFilter"] = compositeFilter;
+        query["where"] = where;
+    }
+    
+    if (!m_orderBy.isEmpty()) {
+        query["orderBy"] = m_orderBy;
+    }
+    
+    if (!m_startAt.isEmpty()) {
+        query["startAt"] = m_startAt;
+    }
+    if (!m_endAt.isEmpty()) {
+        query["endAt"] = m_endAt;
+    }
+    
+    if (m_limit > 0) {
+        query["limit"] = m_limit;
+    }
+    
+    return query;
+}
+
+FirestoreQuery FirestoreQuery::fromStudentFilter(const StudentFilter& filter, int maxResults)
+{
+    FirestoreQuery query;
+    
+    if (!filter.field.isEmpty()) {
+        query.where("field", Equal, filter.field);
+    }
+    if (!filter.school.isEmpty()) {
+        query.where("school", Equal, filter.school);
+    }
+    
+    // "Üniversiteye gitmedi" is a school value, not a graduation flag; the
+    // Mezun/Aktif exclusion of that school is left to the client-side pass
+    if (filter.graduation == StudentFilter::Graduated) {
+        query.where("graduation", Equal, true);
+    } else if (filter.graduation == StudentFilter::Active) {
+        query.where("graduation", Equal, false);
+    } else if (filter.graduation == StudentFilter::NoUniversity && filter.school.isEmpty()) {
+        query.where("school", Equal, StudentFilter::NoUniversitySchool);
+    }
+    
+    // The year range does not apply to students who did not attend
+    // university, so it can only go to the server when the graduation
+    // filter already excludes them
+    bool yearOnServer = filter.hasYearRange() &&
+                        (filter.graduation == StudentFilter::Graduated ||
+                         filter.graduation == StudentFilter::Active);
+    if (yearOnServer) {
+        if (filter.yearFrom > StudentFilter::MinYear) {
+            query.where("year", GreaterThanOrEqual, filter.yearFrom);
+        }
+        if (filter.yearTo < StudentFilter::MaxYear) {
+            query.where("year", LessThanOrEqual, filter.yearTo);
+        }
+        // Firestore requires the first orderBy to be on the inequality field
+        query.orderBy("year", Ascending);
+    }
+    
+    query.orderBy("lastUpdateTime", Descending);
+    query.limit(maxResults);
+    return query;
+}
+
+QJsonObject FirestoreQuery::encodeValue(const QJsonValue& value)
+{
+    QJsonObject encoded;
+    if (value.isBool()) {
+        encoded["booleanValue"] = value.toBool();
+    } else if (value.isDouble()) {
+        encoded["integerValue"] = QString::number(value.toInteger());
+    } else if (value.isNull()) {
+        encoded["nullValue"] = QJsonValue::Null;
+    } else {
+        encoded["stringValue"] = value.toString();
+    }
+    return encoded;
+}
+
+QString FirestoreQuery::operatorName(Operator op)
+{
+    switch (op) {
+    case Equal: return "EQUAL";
+    case NotEqual: return "NOT_EQUAL";
+    case LessThan: return "LESS_THAN";
+    case LessThanOrEqual: return "LESS_THAN_OR_EQUAL";
+    case GreaterThan: return "GREATER_THAN";
+    case GreaterThanOrEqual: return "GREATER_THAN_OR_EQUAL";
+    }
+    return "EQUAL";
+}
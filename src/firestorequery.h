@@ -0,0 +1,97 @@
+#ifndef FIRESTOREQUERY_H
+#define FIRESTOREQUERY_H
+
+#include <QString>
+#include <QStringList>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonValue>
+
+class StudentFilter;
+
+/**
+ * FirestoreQuery - Builds a Firestore StructuredQuery for documents:runQuery
+ *
+ * Usage:
+ *   FirestoreQuery query;
+ *   query.where("school", FirestoreQuery::Equal, "TED Üniversitesi")
+ *        .orderBy("lastUpdateTime", FirestoreQuery::Descending)
+ *        .limit(200);
+ *   firestoreService->runQuery(query, "filter");
+ *
+ * Composite indexes: Firestore serves single-field equality filters from its
+ * automatic indexes, but an equality filter combined with orderBy on another
+ * field, or several filters, needs a composite index. The filter panel can
+ * produce these shapes (all on collection "People"):
+ *   field ASC, lastUpdateTime DESC
+ *   school ASC, lastUpdateTime DESC
+ *   graduation ASC, lastUpdateTime DESC
+ *   field ASC, school ASC, lastUpdateTime DESC
+ *   graduation ASC, year ASC, lastUpdateTime DESC
+ *   field ASC, graduation ASC, year ASC, lastUpdateTime DESC
+ *   school ASC, graduation ASC, year ASC, lastUpdateTime DESC
+ * A missing index makes runQuery fail with FAILED_PRECONDITION; the error
+ * message contains a console link that creates the index.
+ */
+class FirestoreQuery
+{
+public:
+    enum Operator {
+        Equal,
+        NotEqual,
+        LessThan,
+        LessThanOrEqual,
+        GreaterThan,
+        GreaterThanOrEqual
+    };
+    
+    enum Direction {
+        Ascending,
+        Descending
+    };
+    
+    explicit FirestoreQuery(const QString& collectionId = "People");
+    
+    FirestoreQuery& where(const QString& fieldPath, Operator op, const QJsonValue& value);
+    FirestoreQuery& orderBy(const QString& fieldPath, Direction direction = Ascending);
+    FirestoreQuery& limit(int count);
+    FirestoreQuery& select(const QStringList& fieldPaths);
+    // Collection-group query: every collection with this ID, as
+    // partitionQuery requires
+    FirestoreQuery& allDescendants(bool enabled = true);
+    
+    // Cursor bounds as returned by partitionQuery ({"values": [...]}); the
+    // range includes the start cursor and excludes the end cursor
+    FirestoreQuery& startAt(const QJsonObject& cursor);
+    FirestoreQuery& startAfter(const QJsonObject& cursor);
+    FirestoreQuery& endBefore(const QJsonObject& cursor);
+    
+    QString collectionId() const { return m_collectionId; }
+    bool hasFilters() const { return !m_filters.isEmpty(); }
+    bool hasProjection() const { return !m_select.isEmpty(); }
+    
+    QJsonObject toStructuredQuery() const;
+    
+    // Translates the filter panel criteria that Firestore can evaluate
+    // (equality on field/school/graduation, range on year). Substring
+    // criteria stay client-side, so the result is a superset that still
+    // has to go through StudentFilter::matches().
+    static FirestoreQuery fromStudentFilter(const StudentFilter& filter, int maxResults = 500);
+    
+    // Encodes a JSON value as a Firestore Value object
+    static QJsonObject encodeValue(const QJsonValue& value);
+
+private:
+    static QString operatorName(Operator op);
+    
+    QString m_collectionId;
+    bool m_allDescendants;
+    QJsonArray m_filters;
+    QJsonArray m_orderBy;
+    QStringList m_select;
+    QJsonObject m_startAt;
+    QJsonObject m_endAt;
+    int m_limit;
+};
+
+#endif // FIRESTOREQUERY_H
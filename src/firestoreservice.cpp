@@ -1,25 +1,34 @@
 #include "firestoreservice.h"
+#include "networkaccess.h"
 #include <QUrl>
 #include <QUrlQuery>
 #include <QJsonParseError>
 #include <QDebug>
 #include <QLoggingCategory>
 #include <QDateTime>
+#include <QRandomGenerator>
+
+namespace {
+// Documents per list page
+const int StudentPageSize = 300;
+}
 
 FirestoreService::FirestoreService(QObject *parent)
     : QObject(parent)
-    , m_networkManager(new QNetworkAccessManager(this))
+    , m_networkManager(NetworkAccess::shared())
+    , m_loadGeneration(0)
+    , m_partitionCount(0)
+    , m_partitionsRemaining(0)
 {
     qCInfo(firestoreLog) << "FirestoreService initialized";
-    connect(m_networkManager, &QNetworkAccessManager::finished,
-            this, &FirestoreService::onNetworkReply);
 }
 
 void FirestoreService::setProjectId(const QString& projectId)
 {
     qCInfo(firestoreLog) << "Setting project ID:" << projectId;
     m_projectId = projectId;
-    m_baseUrl = QString("https://firestore.googleapis.com/v1/projects/%1/databases/(default)/documents").arg(projectId);
+    m_baseUrl = NetworkAccess::origin(NetworkAccess::Firestore)
+                + QString("/v1/projects/%1/databases/(default)/documents").arg(projectId);
     qCDebug(firestoreLog) << "Base URL set to:" << m_baseUrl;
 }
 
@@ -39,22 +48,29 @@ void FirestoreService::setAuthToken(const QString& authToken)
         qCDebug(firestoreLog) << "Auth token prefix:" << authToken.left(20) + "...";
     }
     m_authToken = authToken;
+    
+    if (!m_authToken.isEmpty() && !m_parkedReplies.isEmpty()) {
+        replayParkedRequests();
+    }
 }
 
-QString FirestoreService::buildUrl(const QString& path) const
+QString FirestoreService::buildUrl(const QString& path, const QUrlQuery& extraQuery) const
 {
     QString url = m_baseUrl;
     if (!path.isEmpty()) {
-        if (!path.startsWith("/")) {
+        // Collection-level methods such as ":runQuery" attach without a slash
+        if (!path.startsWith("/") && !path.startsWith(":")) {
             url += "/";
         }
         url += path;
     }
     
-    if (!m_apiKey.isEmpty()) {
+    if (!m_apiKey.isEmpty() || !extraQuery.isEmpty()) {
         QUrl qurl(url);
-        QUrlQuery query;
-        query.addQueryItem("key", m_apiKey);
+        QUrlQuery query(extraQuery);
+        if (!m_apiKey.isEmpty()) {
+            query.addQueryItem("key", m_apiKey);
+        }
         qurl.setQuery(query);
         return qurl.toString();
     }
@@ -67,6 +83,7 @@ QNetworkRequest FirestoreService::createRequest(const QString& url) const
     QUrl qurl(url);
     QNetworkRequest request(qurl);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    NetworkAccess::prepare(request);
     
     // Add authentication header if we have a token
     if (!m_authToken.isEmpty()) {
@@ -76,15 +93,191 @@ QNetworkRequest FirestoreService::createRequest(const QString& url) const
     return request;
 }
 
-void FirestoreService::getAllStudents()
+void FirestoreService::watchReply(QNetworkReply* reply, const QByteArray& body)
+{
+    // Kept so the request can be sent again if the ID token expired
+    m_requestBodies[reply] = body;
+    
+    // The manager is shared with the other services, so each reply is
+    // routed back here through its own finished signal
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        onNetworkReply(reply);
+    });
+    
+    // A batchGet reply is a JSON array written one result at a time; hand
+    // out documents as soon as each element is complete
+    connect(reply, &QNetworkReply::readyRead, this, [this, reply]() {
+        if (m_pendingRequests.value(reply) == BatchGet && reply->error() == QNetworkReply::NoError
+            && !NetworkAccess::isUnauthorized(reply)) {
+            handleBatchGetData(reply, m_requestIds.value(reply), reply->readAll(), m_maskedRequests.contains(reply));
+        }
+    });
+}
+
+bool FirestoreService::parkIfUnauthorized(QNetworkReply* reply)
+{
+    if (!NetworkAccess::isUnauthorized(reply) || !m_pendingRequests.contains(reply)
+        || m_replayedRequests.contains(reply)) {
+        return false;
+    }
+    
+    m_parkedReplies.append(reply);
+    
+    // The token may have been refreshed while this request was in flight
+    if (!m_authToken.isEmpty() && reply->request().rawHeader("Authorization") != QString("Bearer %1").arg(m_authToken).toUtf8()) {
+        replayParkedRequests();
+        return true;
+    }
+    
+    qCInfo(firestoreLog) << "ID token refused, holding request until it is refreshed:" << reply->url().path();
+    if (m_parkedReplies.size() == 1) {
+        emit authenticationRequired();
+    }
+    return true;
+}
+
+void FirestoreService::replayParkedRequests()
+{
+    const QList<QNetworkReply*> parked = m_parkedReplies;
+    m_parkedReplies.clear();
+    
+    qCInfo(firestoreLog) << "Replaying" << parked.size() << "request(s) with the new ID token";
+    for (QNetworkReply* oldReply : parked) {
+        QByteArray body = m_requestBodies.take(oldReply);
+        QNetworkReply* reply = NetworkAccess::resend(oldReply, body, m_authToken);
+        watchReply(reply, body);
+        
+        // Move the bookkeeping over so the new reply is handled like the old one
+        m_pendingRequests[reply] = m_pendingRequests.take(oldReply);
+        if (m_requestIds.contains(oldReply)) {
+            m_requestIds[reply] = m_requestIds.take(oldReply);
+        }
+        if (m_maskedRequests.remove(oldReply)) {
+            m_maskedRequests.insert(reply);
+        }
+        m_streamBuffers.remove(oldReply);
+        m_replayedRequests.insert(reply);
+        oldReply->deleteLater();
+    }
+}
+
+void FirestoreService::abortParkedRequests()
+{
+    const QList<QNetworkReply*> parked = m_parkedReplies;
+    m_parkedReplies.clear();
+    
+    // Deliver the original 401 to the normal error handling
+    for (QNetworkReply* reply : parked) {
+        m_replayedRequests.insert(reply);
+        onNetworkReply(reply);
+    }
+}
+
+QString FirestoreService::documentName(const QString& studentId) const
+{
+    return QString("projects/%1/databases/(default)/documents/People/%2").arg(m_projectId, studentId);
+}
+
+QJsonObject FirestoreService::studentToDocument(const Student& student, const QStringList& fieldMask)
+{
+    // Convert Student to Firestore document format
+    QJsonObject fields;
+    QJsonObject studentJson = student.toJson();
+    
+    for (auto it = studentJson.begin(); it != studentJson.end(); ++it) {
+        if (!fieldMask.isEmpty() && !fieldMask.contains(it.key())) {
+            continue;
+        }
+        
+        QJsonObject field;
+        QJsonValue value = it.value();
+        
+        if (value.isString()) {
+            field["stringValue"] = value.toString();
+        } else if (value.isBool()) {
+            field["booleanValue"] = value.toBool();
+        } else if (value.isDouble()) {
+            // Note: "number" field is now a string (phone number), so this should only handle "year"
+            field["integerValue"] = QString::number(value.toInt());
+        }
+        
+        fields[it.key()] = field;
+    }
+    
+    QJsonObject document;
+    document["fields"] = fields;
+    return document;
+}
+
+Student FirestoreService::documentToStudent(const QJsonObject& document)
+{
+    // Extract document ID from the document name
+    QString documentName = document["name"].toString();
+    QString studentId = documentName.split("/").last();
+    qCDebug(dataLog) << "Document name:" << documentName << "Extracted ID:" << studentId;
+    
+    QJsonObject fields = document["fields"].toObject();
+    QJsonObject studentJson;
+    
+    // Convert Firestore fields back to regular JSON
+    for (auto it = fields.begin(); it != fields.end(); ++it) {
+        QJsonObject field = it.value().toObject();
+        
+        if (field.contains("stringValue")) {
+            studentJson[it.key()] = field["stringValue"].toString();
+        } else if (field.contains("booleanValue")) {
+            studentJson[it.key()] = field["booleanValue"].toBool();
+        } else if (field.contains("integerValue")) {
+            if (it.key() == "number") {
+                // Convert old integer phone numbers to string for backward compatibility
+                studentJson[it.key()] = field["integerValue"].toString();
+            } else {
+                studentJson[it.key()] = field["integerValue"].toString().toInt();
+            }
+        }
+    }
+    
+    Student student;
+    student.fromJson(studentJson);
+    student.setId(studentId);  // Set the extracted document ID
+    student.setUpdateTime(document["updateTime"].toString());
+    return student;
+}
+
+QStringList FirestoreService::listProjection()
+{
+    return {"name", "email", "field", "school", "year", "number",
+            "graduation", "photoURL", "lastUpdateTime"};
+}
+
+void FirestoreService::getAllStudents(const QStringList& fieldMask)
 {
     qCInfo(firestoreLog) << "=== Starting getAllStudents request ===";
     qCDebug(firestoreLog) << "Project ID:" << m_projectId;
     qCDebug(firestoreLog) << "Base URL:" << m_baseUrl;
     qCDebug(firestoreLog) << "Has API key:" << !m_apiKey.isEmpty();
     qCDebug(firestoreLog) << "Has auth token:" << !m_authToken.isEmpty();
+    qCDebug(firestoreLog) << "Field mask:" << (fieldMask.isEmpty() ? QStringList{"(all fields)"} : fieldMask);
     
-    QString url = buildUrl("/People");
+    m_loadGeneration++;
+    m_loadFieldMask = fieldMask;
+    m_loadedStudents.clear();
+    requestStudentPage(QString());
+}
+
+void FirestoreService::requestStudentPage(const QString& pageToken)
+{
+    // Firestore returns only the listed fields when mask.fieldPaths is set
+    QUrlQuery pageQuery;
+    for (const QString& fieldPath : m_loadFieldMask) {
+        pageQuery.addQueryItem("mask.fieldPaths", fieldPath);
+    }
+    pageQuery.addQueryItem("pageSize", QString::number(StudentPageSize));
+    if (!pageToken.isEmpty()) {
+        pageQuery.addQueryItem("pageToken", pageToken);
+    }
+    
+    QString url = buildUrl("/People", pageQuery);
     qCInfo(firestoreLog) << "Request URL:" << url;
     
     QNetworkRequest request = createRequest(url);
@@ -95,20 +288,131 @@ void FirestoreService::getAllStudents()
     }
     
     QNetworkReply* reply = m_networkManager->get(request);
+    
+    watchReply(reply);
     m_pendingRequests[reply] = GetAllStudents;
+    m_requestIds[reply] = QString::number(m_loadGeneration);
+    if (!m_loadFieldMask.isEmpty()) {
+        m_maskedRequests.insert(reply);
+    }
     qCInfo(firestoreLog) << "GET request sent, reply object:" << reply;
 }
 
+void FirestoreService::getAllStudentsPartitioned(int partitionCount, const QStringList& fieldMask)
+{
+    if (partitionCount <= 1) {
+        getAllStudents(fieldMask);
+        return;
+    }
+    
+    qCInfo(firestoreLog) << "=== Starting partitioned load with" << partitionCount << "partitions ===";
+    m_loadGeneration++;
+    m_loadFieldMask = fieldMask;
+    m_loadedStudents.clear();
+    
+    m_partitionCount = partitionCount;
+    m_partitionCursors.clear();
+    requestPartitionPage(QString());
+}
+
+void FirestoreService::requestPartitionPage(const QString& pageToken)
+{
+    // partitionQuery only splits collection-group queries ordered by
+    // document name; N-1 split points give N ranges
+    FirestoreQuery query;
+    query.allDescendants().orderBy("__name__", FirestoreQuery::Ascending);
+    
+    QJsonObject body;
+    body["structuredQuery"] = query.toStructuredQuery();
+    body["partitionCount"] = QString::number(m_partitionCount - 1);
+    if (!pageToken.isEmpty()) {
+        body["pageToken"] = pageToken;
+    }
+    
+    QString url = buildUrl(":partitionQuery");
+    QByteArray data = QJsonDocument(body).toJson(QJsonDocument::Compact);
+    QNetworkReply* reply = m_networkManager->post(createRequest(url), data);
+    watchReply(reply, data);
+    m_pendingRequests[reply] = PartitionQuery;
+    m_requestIds[reply] = QString::number(m_loadGeneration);
+}
+
+void FirestoreService::requestPartition(const QJsonObject& startCursor, const QJsonObject& endCursor)
+{
+    // The cursors belong to the collection-group query they came from
+    FirestoreQuery query;
+    query.allDescendants().orderBy("__name__", FirestoreQuery::Ascending);
+    if (!m_loadFieldMask.isEmpty()) {
+        query.select(m_loadFieldMask);
+    }
+    if (!startCursor.isEmpty()) {
+        query.startAt(startCursor);
+    }
+    if (!endCursor.isEmpty()) {
+        query.endBefore(endCursor);
+    }
+    
+    QJsonObject body;
+    body["structuredQuery"] = query.toStructuredQuery();
+    
+    // All partitions go out at once; over HTTP/2 they share one connection
+    QString url = buildUrl(":runQuery");
+    QByteArray data = QJsonDocument(body).toJson(QJsonDocument::Compact);
+    QNetworkReply* reply = m_networkManager->post(createRequest(url), data);
+    watchReply(reply, data);
+    m_pendingRequests[reply] = LoadPartition;
+    m_requestIds[reply] = QString::number(m_loadGeneration);
+    if (query.hasProjection()) {
+        m_maskedRequests.insert(reply);
+    }
+}
+
 void FirestoreService::getStudent(const QString& studentId)
 {
     QString url = buildUrl(QString("/People/%1").arg(studentId));
     QNetworkRequest request = createRequest(url);
     
     QNetworkReply* reply = m_networkManager->get(request);
+    
+    watchReply(reply);
     m_pendingRequests[reply] = GetStudent;
     m_requestIds[reply] = studentId;
 }
 
+void FirestoreService::getStudents(const QStringList& studentIds, const QString& tag, const QStringList& fieldMask)
+{
+    qCInfo(firestoreLog) << "=== Starting batchGet request ===";
+    qCDebug(firestoreLog) << "batchGet tag:" << tag << "documents:" << studentIds.size();
+    
+    if (studentIds.isEmpty()) {
+        emit studentsFetchFinished(tag);
+        return;
+    }
+    
+    QJsonArray documents;
+    for (const QString& studentId : studentIds) {
+        documents.append(documentName(studentId));
+    }
+    
+    QJsonObject body;
+    body["documents"] = documents;
+    if (!fieldMask.isEmpty()) {
+        QJsonObject mask;
+        mask["fieldPaths"] = QJsonArray::fromStringList(fieldMask);
+        body["mask"] = mask;
+    }
+    
+    QString url = buildUrl(":batchGet");
+    QByteArray data = QJsonDocument(body).toJson(QJsonDocument::Compact);
+    QNetworkReply* reply = m_networkManager->post(createRequest(url), data);
+    watchReply(reply, data);
+    m_pendingRequests[reply] = BatchGet;
+    m_requestIds[reply] = tag;
+    if (!fieldMask.isEmpty()) {
+        m_maskedRequests.insert(reply);
+    }
+}
+
 void FirestoreService::addStudent(const Student& student)
 {
     qCInfo(firestoreLog) << "=== Starting addStudent request ===";
@@ -118,46 +422,24 @@ void FirestoreService::addStudent(const Student& student)
     qCDebug(firestoreLog) << "Add student URL:" << url;
     QNetworkRequest request = createRequest(url);
     
-    // Convert Student to Firestore document format
-    QJsonObject fields;
-    
     // Create a mutable copy to set the lastUpdateTime
     Student updatedStudent = student;
     updatedStudent.setLastUpdateTime(QDateTime::currentDateTimeUtc());
     
-    QJsonObject studentJson = updatedStudent.toJson();
-    
-    for (auto it = studentJson.begin(); it != studentJson.end(); ++it) {
-        QJsonObject field;
-        QJsonValue value = it.value();
-        
-        if (value.isString()) {
-            field["stringValue"] = value.toString();
-        } else if (value.isBool()) {
-            field["booleanValue"] = value.toBool();
-        } else if (value.isDouble()) {
-            // Note: "number" field is now a string (phone number), so this should only handle "year"
-            field["integerValue"] = QString::number(value.toInt());
-        }
-        
-        fields[it.key()] = field;
-    }
-    
-    QJsonObject document;
-    document["fields"] = fields;
-    
-    QJsonDocument jsonDoc(document);
+    QJsonDocument jsonDoc(studentToDocument(updatedStudent));
     QByteArray data = jsonDoc.toJson();
     
     qCDebug(dataLog) << "Student JSON data:" << jsonDoc.toJson(QJsonDocument::Compact);
     qCInfo(firestoreLog) << "POST request data size:" << data.size() << "bytes";
     
     QNetworkReply* reply = m_networkManager->post(request, data);
+    
+    watchReply(reply, data);
     m_pendingRequests[reply] = AddStudent;
     qCInfo(firestoreLog) << "POST request sent, reply object:" << reply;
 }
 
-void FirestoreService::updateStudent(const Student& student)
+void FirestoreService::updateStudent(const Student& student, const QStringList& changedFields)
 {
     qCInfo(firestoreLog) << "=== Starting updateStudent request ===";
     qCInfo(dataLog) << "Updating student:" << student.getName() << "ID:" << student.getId();
@@ -169,45 +451,37 @@ void FirestoreService::updateStudent(const Student& student)
         return;
     }
     
-    QString url = buildUrl(QString("/People/%1").arg(student.getId()));
-    qCDebug(firestoreLog) << "Update student URL:" << url;
-    QNetworkRequest request = createRequest(url);
-    
-    // Convert Student to Firestore document format
-    QJsonObject fields;
-    
     // Create a mutable copy to update the lastUpdateTime
     Student updatedStudent = student;
     updatedStudent.setLastUpdateTime(QDateTime::currentDateTimeUtc());
     
-    QJsonObject studentJson = updatedStudent.toJson();
-    
-    for (auto it = studentJson.begin(); it != studentJson.end(); ++it) {
-        QJsonObject field;
-        QJsonValue value = it.value();
-        
-        if (value.isString()) {
-            field["stringValue"] = value.toString();
-        } else if (value.isBool()) {
-            field["booleanValue"] = value.toBool();
-        } else if (value.isDouble()) {
-            // Note: "number" field is now a string (phone number), so this should only handle "year"
-            field["integerValue"] = QString::number(value.toInt());
-        }
-        
-        fields[it.key()] = field;
+    // Refuse to overwrite someone else's newer version, and send only the
+    // fields that changed
+    QUrlQuery writeQuery;
+    if (!student.getUpdateTime().isEmpty()) {
+        writeQuery.addQueryItem("currentDocument.updateTime", student.getUpdateTime());
+    }
+    QStringList fieldMask = changedFields.isEmpty() ? student.dirtyFields() : changedFields;
+    if (!fieldMask.isEmpty() && !fieldMask.contains("lastUpdateTime")) {
+        fieldMask.append("lastUpdateTime");
+    }
+    for (const QString& fieldPath : fieldMask) {
+        writeQuery.addQueryItem("updateMask.fieldPaths", fieldPath);
     }
     
-    QJsonObject document;
-    document["fields"] = fields;
+    QString url = buildUrl(QString("/People/%1").arg(student.getId()), writeQuery);
+    qCDebug(firestoreLog) << "Update student URL:" << url;
+    QNetworkRequest request = createRequest(url);
     
-    QJsonDocument jsonDoc(document);
+    QJsonDocument jsonDoc(studentToDocument(updatedStudent, fieldMask));
     QByteArray data = jsonDoc.toJson();
     
     qCDebug(dataLog) << "Updated student JSON data:" << jsonDoc.toJson(QJsonDocument::Compact);
     qCInfo(firestoreLog) << "PATCH request data size:" << data.size() << "bytes";
     
     QNetworkReply* reply = m_networkManager->sendCustomRequest(request, "PATCH", data);
+    
+    watchReply(reply, data);
     m_pendingRequests[reply] = UpdateStudent;
     m_requestIds[reply] = student.getId();
     qCInfo(firestoreLog) << "PATCH request sent, reply object:" << reply;
@@ -230,11 +504,134 @@ void FirestoreService::deleteStudent(const QString& studentId)
     QNetworkRequest request = createRequest(url);
     
     QNetworkReply* reply = m_networkManager->deleteResource(request);
+    
+    watchReply(reply);
     m_pendingRequests[reply] = DeleteStudent;
     m_requestIds[reply] = studentId;
     qCInfo(firestoreLog) << "DELETE request sent, reply object:" << reply;
 }
 
+void FirestoreService::runQuery(const FirestoreQuery& query, const QString& tag)
+{
+    qCInfo(firestoreLog) << "=== Starting runQuery request ===";
+    qCDebug(firestoreLog) << "Query tag:" << tag;
+    
+    QString url = buildUrl(":runQuery");
+    QNetworkRequest request = createRequest(url);
+    
+    QJsonObject body;
+    body["structuredQuery"] = query.toStructuredQuery();
+    
+    QJsonDocument jsonDoc(body);
+    QByteArray data = jsonDoc.toJson(QJsonDocument::Compact);
+    qCDebug(firestoreLog) << "Structured query:" << data;
+    
+    QNetworkReply* reply = m_networkManager->post(request, data);
+    
+    watchReply(reply, data);
+    m_pendingRequests[reply] = RunQuery;
+    m_requestIds[reply] = tag;
+    if (query.hasProjection()) {
+        m_maskedRequests.insert(reply);
+    }
+    qCInfo(firestoreLog) << "runQuery request sent, reply object:" << reply;
+}
+
+void FirestoreService::runCountQuery(const FirestoreQuery& query, const QString& tag)
+{
+    qCInfo(firestoreLog) << "=== Starting runAggregationQuery request ===";
+    qCDebug(firestoreLog) << "Aggregation tag:" << tag;
+    
+    QString url = buildUrl(":runAggregationQuery");
+    QNetworkRequest request = createRequest(url);
+    
+    QJsonObject count;
+    count["alias"] = "count";
+    count["count"] = QJsonObject();
+    
+    QJsonObject aggregationQuery;
+    aggregationQuery["structuredQuery"] = query.toStructuredQuery();
+    aggregationQuery["aggregations"] = QJsonArray{count};
+    
+    QJsonObject body;
+    body["structuredAggregationQuery"] = aggregationQuery;
+    
+    QByteArray data = QJsonDocument(body).toJson(QJsonDocument::Compact);
+    qCDebug(firestoreLog) << "Aggregation query:" << data;
+    
+    QNetworkReply* reply = m_networkManager->post(request, data);
+    
+    watchReply(reply, data);
+    m_pendingRequests[reply] = RunAggregation;
+    m_requestIds[reply] = tag;
+}
+
+QString FirestoreService::generateDocumentId()
+{
+    // Same alphabet and length as the Firestore SDKs' auto IDs
+    static const QString alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+    QString id;
+    id.reserve(20);
+    for (int i = 0; i < 20; ++i) {
+        id += alphabet.at(QRandomGenerator::global()->bounded(alphabet.size()));
+    }
+    return id;
+}
+
+QJsonObject FirestoreService::setWrite(const Student& student, const QString& baseUpdateTime,
+                                       const QStringList& fieldMask) const
+{
+    QJsonObject document = studentToDocument(student, fieldMask);
+    document["name"] = documentName(student.getId());
+    
+    QJsonObject write;
+    write["update"] = document;
+    if (!fieldMask.isEmpty()) {
+        QJsonObject updateMask;
+        updateMask["fieldPaths"] = QJsonArray::fromStringList(fieldMask);
+        write["updateMask"] = updateMask;
+    }
+    if (!baseUpdateTime.isEmpty()) {
+        QJsonObject precondition;
+        precondition["updateTime"] = baseUpdateTime;
+        write["currentDocument"] = precondition;
+    }
+    return write;
+}
+
+QJsonObject FirestoreService::deleteWrite(const QString& studentId, const QString& baseUpdateTime) const
+{
+    QJsonObject write;
+    write["delete"] = documentName(studentId);
+    if (!baseUpdateTime.isEmpty()) {
+        QJsonObject precondition;
+        precondition["updateTime"] = baseUpdateTime;
+        write["currentDocument"] = precondition;
+    }
+    return write;
+}
+
+void FirestoreService::commitWrites(const QJsonArray& writes, const QString& tag)
+{
+    qCInfo(firestoreLog) << "=== Starting commit request ===";
+    qCDebug(firestoreLog) << "Commit tag:" << tag << "writes:" << writes.size();
+    
+    QString url = buildUrl(":commit");
+    QNetworkRequest request = createRequest(url);
+    
+    QJsonObject body;
+    body["writes"] = writes;
+    
+    QByteArray data = QJsonDocument(body).toJson(QJsonDocument::Compact);
+    qCInfo(firestoreLog) << "Commit request data size:" << data.size() << "bytes";
+    
+    QNetworkReply* reply = m_networkManager->post(request, data);
+    
+    watchReply(reply, data);
+    m_pendingRequests[reply] = Commit;
+    m_requestIds[reply] = tag;
+}
+
 void FirestoreService::onNetworkReply(QNetworkReply* reply)
 {
     if (!reply) {
@@ -242,6 +639,12 @@ void FirestoreService::onNetworkReply(QNetworkReply* reply)
         return;
     }
     
+    // An expired ID token is not a failure of the request itself: hold it
+    // until a new token arrives and send it again
+    if (parkIfUnauthorized(reply)) {
+        return;
+    }
+    
     qCInfo(firestoreLog) << "=== Processing network reply ===";
     qCInfo(firestoreLog) << "Reply object:" << reply;
     qCInfo(firestoreLog) << "Reply URL:" << reply->url().toString();
@@ -259,6 +662,10 @@ void FirestoreService::onNetworkReply(QNetworkReply* reply)
     
     RequestType requestType = m_pendingRequests.take(reply);
     QString requestId = m_requestIds.take(reply);
+    bool masked = m_maskedRequests.remove(reply);
+    QByteArray streamedTail = m_streamBuffers.take(reply);
+    m_requestBodies.remove(reply);
+    m_replayedRequests.remove(reply);
     
     QString requestTypeStr;
     switch (requestType) {
@@ -267,6 +674,12 @@ void FirestoreService::onNetworkReply(QNetworkReply* reply)
     case AddStudent: requestTypeStr = "AddStudent"; break;
     case UpdateStudent: requestTypeStr = "UpdateStudent"; break;
     case DeleteStudent: requestTypeStr = "DeleteStudent"; break;
+    case RunQuery: requestTypeStr = "RunQuery"; break;
+    case RunAggregation: requestTypeStr = "RunAggregation"; break;
+    case Commit: requestTypeStr = "Commit"; break;
+    case PartitionQuery: requestTypeStr = "PartitionQuery"; break;
+    case LoadPartition: requestTypeStr = "LoadPartition"; break;
+    case BatchGet: requestTypeStr = "BatchGet"; break;
     }
     
     qCInfo(firestoreLog) << "Processing" << requestTypeStr << "response";
@@ -287,13 +700,59 @@ void FirestoreService::onNetworkReply(QNetworkReply* reply)
         if (!errorData.isEmpty()) {
             qCDebug(firestoreLog) << "Error response body:" << errorData;
         }
+        
+        // Writes from the outbox are retried unless the server refused them:
+        // no HTTP status means the request never got there
+        if (requestType == Commit) {
+            int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            bool retryable = statusCode == 0 || statusCode == 408 || statusCode == 429 || statusCode >= 500;
+            QJsonObject errorObject = QJsonDocument::fromJson(errorData).object().value("error").toObject();
+            QString message = errorObject.value("message").toString();
+            if (message.isEmpty()) {
+                message = reply->errorString();
+            }
+            emit commitFailed(requestId, errorObject.value("status").toString(), message, retryable);
+            return;
+        }
+        
+        // A collection that cannot be partitioned is still loadable page by page
+        if (requestType == PartitionQuery) {
+            if (requestId.toInt() == m_loadGeneration) {
+                qCWarning(firestoreLog) << "partitionQuery failed, falling back to paged list";
+                getAllStudents(m_loadFieldMask);
+            }
+            return;
+        }
+        
+        // One failed range fails the whole load
+        if (requestType == LoadPartition) {
+            if (requestId.toInt() == m_loadGeneration) {
+                m_loadGeneration++;
+                m_loadedStudents.clear();
+                emit errorOccurred(QString("Network error: %1").arg(reply->errorString()));
+            }
+            return;
+        }
+        
+        // Queries report to their owner by tag; background pollers must not
+        // turn every failed poll into an error dialog
+        if (requestType == RunQuery || requestType == RunAggregation || requestType == BatchGet) {
+            emit queryFailed(requestId, QString("Network error: %1").arg(reply->errorString()));
+            return;
+        }
+        if (requestType == UpdateStudent &&
+            QJsonDocument::fromJson(errorData).object().value("error").toObject().value("status").toString() == "FAILED_PRECONDITION") {
+            emit errorOccurred("Bu kayıt siz düzenlerken başka bir kullanıcı tarafından değiştirildi. "
+                               "Lütfen listeyi yenileyip tekrar deneyin.");
+            return;
+        }
         emit errorOccurred(QString("Network error: %1").arg(reply->errorString()));
         return;
     }
     
     switch (requestType) {
     case GetAllStudents:
-        handleGetAllStudentsReply(reply);
+        handleGetAllStudentsReply(reply, masked, requestId.toInt());
         break;
     case GetStudent:
         handleGetStudentReply(reply);
@@ -307,13 +766,39 @@ void FirestoreService::onNetworkReply(QNetworkReply* reply)
     case DeleteStudent:
         handleDeleteStudentReply(reply, requestId);
         break;
+    case RunQuery:
+        handleRunQueryReply(reply, requestId, masked);
+        break;
+    case RunAggregation:
+        handleAggregationReply(reply, requestId);
+        break;
+    case Commit:
+        handleCommitReply(reply, requestId);
+        break;
+    case PartitionQuery:
+        handlePartitionQueryReply(reply, requestId.toInt());
+        break;
+    case LoadPartition:
+        handleLoadPartitionReply(reply, masked, requestId.toInt());
+        break;
+    case BatchGet:
+        m_streamBuffers.insert(reply, streamedTail);
+        handleBatchGetData(reply, requestId, reply->readAll(), masked);
+        m_streamBuffers.remove(reply);
+        emit studentsFetchFinished(requestId);
+        break;
     }
 }
 
-void FirestoreService::handleGetAllStudentsReply(QNetworkReply* reply)
+void FirestoreService::handleGetAllStudentsReply(QNetworkReply* reply, bool partial, int generation)
 {
     qCInfo(firestoreLog) << "=== Processing GetAllStudents response ===";
     
+    if (generation != m_loadGeneration) {
+        qCDebug(firestoreLog) << "Dropping page of a superseded load";
+        return;
+    }
+    
     QByteArray data = reply->readAll();
     qCInfo(firestoreLog) << "Response data size:" << data.size() << "bytes";
     qCDebug(dataLog) << "Raw response data:" << data;
@@ -343,91 +828,105 @@ void FirestoreService::handleGetAllStudentsReply(QNetworkReply* reply)
         qCDebug(dataLog) << "Processing document" << (i + 1) << "of" << documents.size();
         QJsonObject document = value.toObject();
         
-        // Extract document ID from the document name
-        QString documentName = document["name"].toString();
-        QString studentId = documentName.split("/").last();
-        qCDebug(dataLog) << "Document name:" << documentName << "Extracted ID:" << studentId;
-        
-        QJsonObject fields = document["fields"].toObject();
-        
-        Student student;
-        QJsonObject studentJson;
-        
-        // Convert Firestore fields back to regular JSON
-        for (auto it = fields.begin(); it != fields.end(); ++it) {
-            QJsonObject field = it.value().toObject();
-            
-            if (field.contains("stringValue")) {
-                studentJson[it.key()] = field["stringValue"].toString();
-            } else if (field.contains("booleanValue")) {
-                studentJson[it.key()] = field["booleanValue"].toBool();
-            } else if (field.contains("integerValue")) {
-                if (it.key() == "number") {
-                    // Phone number is now stored as string, check both string and integer fields for backward compatibility
-                    if (field.contains("stringValue")) {
-                        studentJson[it.key()] = field["stringValue"].toString();
-                    } else if (field.contains("integerValue")) {
-                        // Convert old integer format to string for backward compatibility
-                        studentJson[it.key()] = field["integerValue"].toString();
-                    }
-                } else {
-                    studentJson[it.key()] = field["integerValue"].toString().toInt();
-                }
-            }
-        }
-        
-        student.fromJson(studentJson);
-        student.setId(studentId);  // Set the extracted document ID
+        Student student = documentToStudent(document);
+        student.setPartial(partial);
+        QString studentId = student.getId();
         qCDebug(dataLog) << "Parsed student:" << student.getName() << "(" << student.getEmail() << ") with ID:" << studentId;
         students.append(student);
     }
     
     qCInfo(dataLog) << "Successfully parsed" << students.size() << "students";
-    qCInfo(firestoreLog) << "Emitting studentsReceived signal with" << students.size() << "students";
-    emit studentsReceived(students);
+    m_loadedStudents.append(students);
+    
+    QString nextPageToken = root["nextPageToken"].toString();
+    if (!nextPageToken.isEmpty()) {
+        qCInfo(firestoreLog) << "Requesting next page," << m_loadedStudents.size() << "students so far";
+        emit studentsPartitionReceived(students);
+        requestStudentPage(nextPageToken);
+        return;
+    }
+    
+    QList<Student> allStudents = m_loadedStudents;
+    m_loadedStudents.clear();
+    qCInfo(firestoreLog) << "Emitting studentsReceived signal with" << allStudents.size() << "students";
+    emit studentsReceived(allStudents);
 }
 
-void FirestoreService::handleGetStudentReply(QNetworkReply* reply)
+void FirestoreService::handlePartitionQueryReply(QNetworkReply* reply, int generation)
 {
-    QByteArray data = reply->readAll();
-    QJsonParseError error;
-    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+    if (generation != m_loadGeneration) {
+        return;
+    }
     
-    if (error.error != QJsonParseError::NoError) {
-        emit errorOccurred(QString("JSON parse error: %1").arg(error.errorString()));
+    // { "partitions": [ { "values": [ { "referenceValue": ".../People/<id>" } ] }, ... ] }
+    QJsonObject root = QJsonDocument::fromJson(reply->readAll()).object();
+    const QJsonArray partitions = root["partitions"].toArray();
+    for (const QJsonValue& partition : partitions) {
+        m_partitionCursors.append(partition.toObject());
+    }
+    
+    // Split points can come over several pages; ranges start once all are in
+    QString nextPageToken = root["nextPageToken"].toString();
+    if (!nextPageToken.isEmpty()) {
+        qCDebug(firestoreLog) << "partitionQuery page with" << partitions.size() << "split points, fetching the next";
+        requestPartitionPage(nextPageToken);
         return;
     }
     
-    QJsonObject document = doc.object();
+    const QList<QJsonObject> cursors = m_partitionCursors;
+    m_partitionCursors.clear();
+    m_partitionsRemaining = cursors.size() + 1;
+    qCInfo(firestoreLog) << "Loading" << m_partitionsRemaining << "partitions concurrently";
+    for (int i = 0; i <= cursors.size(); ++i) {
+        QJsonObject start = i > 0 ? cursors[i - 1] : QJsonObject();
+        QJsonObject end = i < cursors.size() ? cursors[i] : QJsonObject();
+        requestPartition(start, end);
+    }
+}
+
+void FirestoreService::handleLoadPartitionReply(QNetworkReply* reply, bool partial, int generation)
+{
+    if (generation != m_loadGeneration) {
+        qCDebug(firestoreLog) << "Dropping partition of a superseded load";
+        return;
+    }
     
-    // Extract document ID from the document name
-    QString documentName = document["name"].toString();
-    QString studentId = documentName.split("/").last();
+    bool ok = false;
+    QList<Student> students = parseRunQueryResults(reply->readAll(), partial, &ok);
+    if (!ok) {
+        m_loadGeneration++;
+        m_loadedStudents.clear();
+        emit errorOccurred("JSON parse error in partition response");
+        return;
+    }
     
-    QJsonObject fields = document["fields"].toObject();
+    m_loadedStudents.append(students);
+    m_partitionsRemaining--;
+    qCInfo(dataLog) << "Partition returned" << students.size() << "students," << m_partitionsRemaining << "partitions left";
     
-    Student student;
-    QJsonObject studentJson;
+    if (m_partitionsRemaining > 0) {
+        emit studentsPartitionReceived(students);
+        return;
+    }
     
-    // Convert Firestore fields back to regular JSON
-    for (auto it = fields.begin(); it != fields.end(); ++it) {
-        QJsonObject field = it.value().toObject();
-        
-        if (field.contains("stringValue")) {
-            studentJson[it.key()] = field["stringValue"].toString();
-        } else if (field.contains("booleanValue")) {
-            studentJson[it.key()] = field["booleanValue"].toBool();
-        } else if (field.contains("integerValue")) {
-            if (it.key() == "number") {
-                studentJson[it.key()] = field["integerValue"].toString().toLongLong();
-            } else {
-                studentJson[it.key()] = field["integerValue"].toString().toInt();
-            }
-        }
+    QList<Student> allStudents = m_loadedStudents;
+    m_loadedStudents.clear();
+    qCInfo(firestoreLog) << "Emitting studentsReceived signal with" << allStudents.size() << "students";
+    emit studentsReceived(allStudents);
+}
+
+void FirestoreService::handleGetStudentReply(QNetworkReply* reply)
+{
+    QByteArray data = reply->readAll();
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+    
+    if (error.error != QJsonParseError::NoError) {
+        emit errorOccurred(QString("JSON parse error: %1").arg(error.errorString()));
+        return;
     }
     
-    student.fromJson(studentJson);
-    student.setId(studentId);  // Set the extracted document ID
+    Student student = documentToStudent(doc.object());
     emit studentReceived(student);
 }
 
@@ -449,33 +948,8 @@ void FirestoreService::handleAddStudentReply(QNetworkReply* reply)
     }
     
     // Extract the created student from response
-    QJsonObject document = doc.object();
-    QString documentName = document["name"].toString();
-    QString studentId = documentName.split("/").last();
-    
-    QJsonObject fields = document["fields"].toObject();
-    Student student;
-    QJsonObject studentJson;
-    
-    // Convert Firestore fields back to regular JSON
-    for (auto it = fields.begin(); it != fields.end(); ++it) {
-        QJsonObject field = it.value().toObject();
-        
-        if (field.contains("stringValue")) {
-            studentJson[it.key()] = field["stringValue"].toString();
-        } else if (field.contains("booleanValue")) {
-            studentJson[it.key()] = field["booleanValue"].toBool();
-        } else if (field.contains("integerValue")) {
-            if (it.key() == "number") {
-                studentJson[it.key()] = field["integerValue"].toString().toLongLong();
-            } else {
-                studentJson[it.key()] = field["integerValue"].toString().toInt();
-            }
-        }
-    }
-    
-    student.fromJson(studentJson);
-    student.setId(studentId);
+    Student student = documentToStudent(doc.object());
+    QString studentId = student.getId();
     
     qCInfo(dataLog) << "Successfully added student:" << student.getName() << "with ID:" << studentId;
     qCInfo(firestoreLog) << "Emitting studentAdded signal";
@@ -499,36 +973,8 @@ void FirestoreService::handleUpdateStudentReply(QNetworkReply* reply)
         return;
     }
     
-    QJsonObject document = doc.object();
-    
-    // Extract document ID from the document name
-    QString documentName = document["name"].toString();
-    QString studentId = documentName.split("/").last();
-    
-    QJsonObject fields = document["fields"].toObject();
-    
-    Student student;
-    QJsonObject studentJson;
-    
-    // Convert Firestore fields back to regular JSON
-    for (auto it = fields.begin(); it != fields.end(); ++it) {
-        QJsonObject field = it.value().toObject();
-        
-        if (field.contains("stringValue")) {
-            studentJson[it.key()] = field["stringValue"].toString();
-        } else if (field.contains("booleanValue")) {
-            studentJson[it.key()] = field["booleanValue"].toBool();
-        } else if (field.contains("integerValue")) {
-            if (it.key() == "number") {
-                studentJson[it.key()] = field["integerValue"].toString().toLongLong();
-            } else {
-                studentJson[it.key()] = field["integerValue"].toString().toInt();
-            }
-        }
-    }
-    
-    student.fromJson(studentJson);
-    student.setId(studentId);  // Set the extracted document ID
+    Student student = documentToStudent(doc.object());
+    QString studentId = student.getId();
     
     qCInfo(dataLog) << "Successfully updated student:" << student.getName() << "ID:" << studentId;
     qCInfo(firestoreLog) << "Emitting studentUpdated signal";
@@ -565,3 +1011,175 @@ void FirestoreService::handleDeleteStudentReply(QNetworkReply* reply, const QStr
         emit errorOccurred(errorMsg);
     }
 }
+
+QList<Student> FirestoreService::parseRunQueryResults(const QByteArray& data, bool partial, bool* ok, QDateTime* readTime)
+{
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+    
+    if (error.error != QJsonParseError::NoError) {
+        qCCritical(firestoreLog) << "JSON parse error:" << error.errorString();
+        *ok = false;
+        return QList<Student>();
+    }
+    
+    // runQuery answers with an array of {document, readTime}; entries
+    // without a document only carry progress information
+    QList<Student> students;
+    const QJsonArray results = doc.array();
+    for (const QJsonValue& value : results) {
+        QJsonObject result = value.toObject();
+        if (readTime && !readTime->isValid() && result.contains("readTime")) {
+            *readTime = QDateTime::fromString(result["readTime"].toString(), Qt::ISODateWithMs);
+        }
+        if (!result.contains("document")) {
+            continue;
+        }
+        Student student = documentToStudent(result["document"].toObject());
+        student.setPartial(partial);
+        students.append(student);
+    }
+    
+    *ok = true;
+    return students;
+}
+
+void FirestoreService::handleRunQueryReply(QNetworkReply* reply, const QString& tag, bool partial)
+{
+    qCInfo(firestoreLog) << "=== Processing RunQuery response ===";
+    
+    QByteArray data = reply->readAll();
+    qCInfo(firestoreLog) << "Response data size:" << data.size() << "bytes";
+    
+    bool ok = false;
+    QDateTime readTime;
+    QList<Student> students = parseRunQueryResults(data, partial, &ok, &readTime);
+    if (!ok) {
+        qCCritical(firestoreLog) << "JSON parse error in query response for" << tag;
+        emit queryFailed(tag, "JSON parse error in query response");
+        return;
+    }
+    
+    qCInfo(dataLog) << "Query" << tag << "returned" << students.size() << "students";
+    emit queryResultsReceived(tag, students, readTime);
+}
+
+void FirestoreService::handleAggregationReply(QNetworkReply* reply, const QString& tag)
+{
+    QByteArray data = reply->readAll();
+    qCDebug(firestoreLog) << "Aggregation response for" << tag << ":" << data;
+    
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+    
+    // Like the network errors, these go to the owner of the tag, which is
+    // waiting for either a count or a failure
+    if (error.error != QJsonParseError::NoError) {
+        qCCritical(firestoreLog) << "JSON parse error:" << error.errorString();
+        emit queryFailed(tag, QString("JSON parse error: %1").arg(error.errorString()));
+        return;
+    }
+    
+    // [{ "result": { "aggregateFields": { "count": { "integerValue": "42" } } }, "readTime": ... }]
+    const QJsonArray results = doc.array();
+    for (const QJsonValue& value : results) {
+        QJsonObject aggregateFields = value.toObject().value("result").toObject().value("aggregateFields").toObject();
+        if (aggregateFields.contains("count")) {
+            qint64 count = aggregateFields.value("count").toObject().value("integerValue").toString().toLongLong();
+            qCInfo(dataLog) << "Aggregation" << tag << "count:" << count;
+            emit aggregationReceived(tag, count);
+            return;
+        }
+    }
+    
+    qCWarning(firestoreLog) << "Aggregation response for" << tag << "contained no count";
+    emit queryFailed(tag, "Aggregation response contained no count");
+}
+
+void FirestoreService::handleCommitReply(QNetworkReply* reply, const QString& tag)
+{
+    // { "writeResults": [...], "commitTime": ... }; all writes landed or none did
+    QByteArray data = reply->readAll();
+    QJsonObject root = QJsonDocument::fromJson(data).object();
+    
+    // Deletes come back without an updateTime
+    QStringList updateTimes;
+    const QJsonArray writeResults = root["writeResults"].toArray();
+    for (const QJsonValue& result : writeResults) {
+        updateTimes.append(result.toObject().value("updateTime").toString());
+    }
+    
+    qCInfo(firestoreLog) << "Commit" << tag << "applied" << writeResults.size()
+                         << "writes at" << root["commitTime"].toString();
+    emit commitSucceeded(tag, updateTimes);
+}
+
+void FirestoreService::handleBatchGetData(QNetworkReply* reply, const QString& tag, const QByteArray& data, bool partial)
+{
+    QByteArray& buffer = m_streamBuffers[reply];
+    buffer.append(data);
+    
+    // [{ "found": Document, "readTime": ... }, { "missing": ".../People/<id>", "readTime": ... }]
+    QList<Student> found;
+    QStringList missingIds;
+    const QList<QJsonObject> results = takeStreamedObjects(buffer);
+    for (const QJsonObject& result : results) {
+        if (result.contains("found")) {
+            Student student = documentToStudent(result["found"].toObject());
+            student.setPartial(partial);
+            found.append(student);
+        } else if (result.contains("missing")) {
+            missingIds.append(result["missing"].toString().split("/").last());
+        }
+    }
+    
+    if (!found.isEmpty() || !missingIds.isEmpty()) {
+        qCDebug(dataLog) << "batchGet" << tag << "delivered" << found.size() << "found," << missingIds.size() << "missing";
+        emit studentsFetched(tag, found, missingIds);
+    }
+}
+
+QList<QJsonObject> FirestoreService::takeStreamedObjects(QByteArray& buffer)
+{
+    // Cuts complete top-level objects out of a JSON array that is still
+    // arriving and leaves the unfinished remainder in the buffer
+    QList<QJsonObject> objects;
+    int depth = 0;
+    int objectStart = -1;
+    int consumed = 0;
+    bool inString = false;
+    bool escaped = false;
+    
+    for (int i = 0; i < buffer.size(); ++i) {
+        char ch = buffer.at(i);
+        if (inString) {
+            if (escaped) {
+                escaped = false;
+            } else if (ch == '\\') {
+                escaped = true;
+            } else if (ch == '"') {
+                inString = false;
+            }
+            continue;
+        }
+        
+        if (ch == '"') {
+            inString = true;
+        } else if (ch == '{') {
+            if (depth == 0) {
+                objectStart = i;
+            }
+            depth++;
+        } else if (ch == '}') {
+            depth--;
+            if (depth == 0 && objectStart >= 0) {
+                objects.append(QJsonDocument::fromJson(buffer.mid(objectStart, i - objectStart + 1)).object());
+                consumed = i + 1;
+                objectStart = -1;
+            }
+        }
+    }
+    
+    buffer.remove(0, consumed);
+    return objects;
+}
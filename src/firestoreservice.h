@@ -9,7 +9,10 @@
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QLoggingCategory>
+#include <QUrlQuery>
+#include <QSet>
 #include "student.h"
+#include "firestorequery.h"
 
 Q_DECLARE_LOGGING_CATEGORY(firestoreLog)
 Q_DECLARE_LOGGING_CATEGORY(dataLog)
@@ -23,34 +26,110 @@ public:
     
     void setProjectId(const QString& projectId);
     void setApiKey(const QString& apiKey);
+    // A new token also resends the requests held back after a 401
     void setAuthToken(const QString& authToken);
     
+    // Fails the held-back requests with their original 401, e.g. when the
+    // token could not be refreshed
+    void abortParkedRequests();
+    
+    // Fields the student table needs. Passing this to getAllStudents() keeps
+    // long fields like description out of the list payload; the full document
+    // is fetched on demand with getStudent().
+    static QStringList listProjection();
+    
     // CRUD operations
-    void getAllStudents();
+    void getAllStudents(const QStringList& fieldMask = QStringList());
+    
+    // Full load split into partitionCount ranges with :partitionQuery and
+    // fetched concurrently. Each range is emitted through
+    // studentsPartitionReceived as it arrives and the complete list through
+    // studentsReceived. Falls back to the paged getAllStudents() when the
+    // collection cannot be partitioned.
+    void getAllStudentsPartitioned(int partitionCount, const QStringList& fieldMask = QStringList());
     void getStudent(const QString& studentId);
+    
+    // Fetches several documents in one documents:batchGet request. Results
+    // are emitted through studentsFetched as they stream in, followed by
+    // studentsFetchFinished.
+    void getStudents(const QStringList& studentIds, const QString& tag, const QStringList& fieldMask = QStringList());
     void addStudent(const Student& student);
-    void updateStudent(const Student& student);
+    // Conditional on the student's updateTime when known. Only changedFields
+    // are sent (updateMask); by default the student's dirty fields
+    void updateStudent(const Student& student, const QStringList& changedFields = QStringList());
     void deleteStudent(const QString& studentId);
+    
+    // Server-side query; results come back through queryResultsReceived with
+    // the same tag and the time the server evaluated the query at
+    void runQuery(const FirestoreQuery& query, const QString& tag = QString());
+    
+    // Server-side COUNT over the query; the result comes back through aggregationReceived
+    void runCountQuery(const FirestoreQuery& query, const QString& tag);
+    
+    // Batched writes: up to 500 writes applied atomically through :commit.
+    // The outcome comes back through commitSucceeded/commitFailed with the same tag.
+    void commitWrites(const QJsonArray& writes, const QString& tag);
+    
+    // baseUpdateTime is the document updateTime the change was made against;
+    // if the document changed since, the commit fails with FAILED_PRECONDITION.
+    // Empty means unconditional. A non-empty fieldMask writes only those fields.
+    QJsonObject setWrite(const Student& student, const QString& baseUpdateTime = QString(),
+                         const QStringList& fieldMask = QStringList()) const;
+    QJsonObject deleteWrite(const QString& studentId, const QString& baseUpdateTime = QString()) const;
+    
+    // Full resource name, e.g. for query cursors on __name__
+    QString documentName(const QString& studentId) const;
+    
+    // Client-side document ID, so a new student can be shown before the server answers
+    static QString generateDocumentId();
+    
+    // Firestore document <-> Student. The document name is not set; the ID
+    // is taken from the last segment of the name when reading.
+    static QJsonObject studentToDocument(const Student& student, const QStringList& fieldMask = QStringList());
+    static Student documentToStudent(const QJsonObject& document);
 
 signals:
     void studentsReceived(const QList<Student>& students);
+    void studentsPartitionReceived(const QList<Student>& students); // Part of a load still in progress
     void studentReceived(const Student& student);
+    void studentsFetched(const QString& tag, const QList<Student>& found, const QStringList& missingIds);
+    void studentsFetchFinished(const QString& tag);
     void studentAdded(const Student& student);
     void studentUpdated(const Student& student);
     void studentDeleted(const QString& studentId);
+    void queryResultsReceived(const QString& tag, const QList<Student>& students, const QDateTime& readTime);
+    void aggregationReceived(const QString& tag, qint64 count);
+    void queryFailed(const QString& tag, const QString& error); // runQuery/runCountQuery errors
+    void commitSucceeded(const QString& tag, const QStringList& updateTimes); // One updateTime per write
+    void commitFailed(const QString& tag, const QString& status, const QString& error, bool retryable);
     void errorOccurred(const QString& error);
+    void authenticationRequired(); // A request got 401 and waits for setAuthToken()
 
 private slots:
     void onNetworkReply(QNetworkReply* reply);
 
 private:
-    QString buildUrl(const QString& path = "") const;
+    void watchReply(QNetworkReply* reply, const QByteArray& body = QByteArray());
+    bool parkIfUnauthorized(QNetworkReply* reply);
+    void replayParkedRequests();
+    QString buildUrl(const QString& path = "", const QUrlQuery& extraQuery = QUrlQuery()) const;
     QNetworkRequest createRequest(const QString& url) const;
-    void handleGetAllStudentsReply(QNetworkReply* reply);
+    void requestStudentPage(const QString& pageToken);
+    void requestPartitionPage(const QString& pageToken);
+    void requestPartition(const QJsonObject& startCursor, const QJsonObject& endCursor);
+    QList<Student> parseRunQueryResults(const QByteArray& data, bool partial, bool* ok, QDateTime* readTime = nullptr);
+    void handleGetAllStudentsReply(QNetworkReply* reply, bool partial, int generation);
+    void handlePartitionQueryReply(QNetworkReply* reply, int generation);
+    void handleLoadPartitionReply(QNetworkReply* reply, bool partial, int generation);
+    void handleBatchGetData(QNetworkReply* reply, const QString& tag, const QByteArray& data, bool partial);
+    static QList<QJsonObject> takeStreamedObjects(QByteArray& buffer);
     void handleGetStudentReply(QNetworkReply* reply);
     void handleAddStudentReply(QNetworkReply* reply);
     void handleUpdateStudentReply(QNetworkReply* reply);
     void handleDeleteStudentReply(QNetworkReply* reply, const QString& studentId);
+    void handleRunQueryReply(QNetworkReply* reply, const QString& tag, bool partial);
+    void handleAggregationReply(QNetworkReply* reply, const QString& tag);
+    void handleCommitReply(QNetworkReply* reply, const QString& tag);
     
     QNetworkAccessManager* m_networkManager;
     QString m_projectId;
@@ -63,11 +142,31 @@ private:
         GetStudent,
         AddStudent,
         UpdateStudent,
-        DeleteStudent
+        DeleteStudent,
+        RunQuery,
+        RunAggregation,
+        Commit,
+        PartitionQuery,
+        LoadPartition,
+        BatchGet
     };
     
     QHash<QNetworkReply*, RequestType> m_pendingRequests;
-    QHash<QNetworkReply*, QString> m_requestIds; // For tracking specific student IDs
+    QHash<QNetworkReply*, QString> m_requestIds; // For tracking specific student IDs and query tags
+    QSet<QNetworkReply*> m_maskedRequests; // List requests sent with a field mask
+    QHash<QNetworkReply*, QByteArray> m_streamBuffers; // Unparsed tail of streamed batchGet replies
+    QHash<QNetworkReply*, QByteArray> m_requestBodies; // For resending after a 401
+    QList<QNetworkReply*> m_parkedReplies; // Refused with 401, waiting for a new token
+    QSet<QNetworkReply*> m_replayedRequests; // Already resent once; a second 401 is an error
+    
+    // Full load in progress (list pages or partitions). Each load gets a new
+    // generation; replies of a superseded load are dropped.
+    int m_loadGeneration;
+    QStringList m_loadFieldMask;
+    QList<Student> m_loadedStudents;
+    int m_partitionCount;
+    QList<QJsonObject> m_partitionCursors; // Split points from the partitionQuery pages so far
+    int m_partitionsRemaining;
 };
 
 #endif // FIRESTORESERVICE_H
@@ -0,0 +1,47 @@
+#include "logging.h"
+#include <QDateTime>
+#include <QLoggingCategory>
+#include <cstdio>
+
+// Shared logging categories. Services declare the ones they use with
+// Q_DECLARE_LOGGING_CATEGORY; categories owned by a single service are
+// defined next to it instead.
+Q_LOGGING_CATEGORY(authLog, "auth")
+Q_LOGGING_CATEGORY(networkLog, "network")
+Q_LOGGING_CATEGORY(firestoreLog, "firestore")
+Q_LOGGING_CATEGORY(dataLog, "data")
+
+void messageOutput(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+{
+    QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz");
+    QString typeStr;
+    
+    switch (type) {
+    case QtDebugMsg:    typeStr = "DEBUG"; break;
+    case QtInfoMsg:     typeStr = "INFO "; break;
+    case QtWarningMsg:  typeStr = "WARN "; break;
+    case QtCriticalMsg: typeStr = "ERROR"; break;
+    case QtFatalMsg:    typeStr = "FATAL"; break;
+    }
+    
+    QString category = context.category ? QString("[%1]").arg(context.category) : "";
+    QString formattedMsg = QString("%1 %2 %3 %4").arg(timestamp, typeStr, category, msg);
+    
+    // Output to console
+    fprintf(stderr, "%s\n", formattedMsg.toLocal8Bit().constData());
+    fflush(stderr);
+}
+
+namespace Console {
+QTextStream& out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+QTextStream& err()
+{
+    static QTextStream stream(stderr);
+    return stream;
+}
+}
@@ -0,0 +1,19 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QTextStream>
+
+// Message handler of the application and smctl: one line per message on
+// stderr, "timestamp LEVEL [category] message"
+void messageOutput(QtMsgType type, const QMessageLogContext &context, const QString &msg);
+
+// Console streams of the command-line tools: results go to out(),
+// progress and errors to err()
+namespace Console {
+QTextStream& out();
+QTextStream& err();
+}
+
+#endif // LOGGING_H
@@ -12,6 +12,7 @@ LoginDialog::LoginDialog(QWidget *parent)
     : QDialog(parent)
     , m_emailEdit(nullptr)
     , m_passwordEdit(nullptr)
+    , m_rememberCheck(nullptr)
     , m_signInButton(nullptr)
     , m_errorLabel(nullptr)
     , m_progressBar(nullptr)
@@ -172,6 +173,13 @@ void LoginDialog::setupUI()
     );
     formLayout->addRow(passwordLabel, m_passwordEdit);
     
+    // Saved sessions skip this dialog on the next start; off unless asked
+    // for, since the computer may be shared
+    m_rememberCheck = new QCheckBox("Oturumu açık tut");
+    m_rememberCheck->setChecked(false);
+    m_rememberCheck->setStyleSheet("color: #C9A962; font-size: 12px;");
+    formLayout->addRow(QString(), m_rememberCheck);
+    
     mainLayout->addLayout(formLayout);
     mainLayout->addSpacing(10);
     
@@ -24,6 +24,8 @@ public:
     void setAuthService(FirebaseAuthService* authService);
     QString getUserId() const { return m_userId; }
     QString getUserEmail() const { return m_userEmail; }
+    bool rememberSession() const { return m_rememberCheck->isChecked(); }
+    void setRememberSessionAvailable(bool available) { m_rememberCheck->setVisible(available); }
 
 private slots:
     void onSignInClicked();
@@ -40,6 +42,7 @@ private:
     // UI Components
     QLineEdit* m_emailEdit;
     QLineEdit* m_passwordEdit;
+    QCheckBox* m_rememberCheck;
     QPushButton* m_signInButton;
     QLabel* m_errorLabel;
     
@@ -7,40 +7,18 @@
 #include <QFile>
 #include <QDebug>
 #include <QLoggingCategory>
-#include <QDateTime>
 
 #include "mainwindow.h"
+#include "logging.h"
 #include "logindialog.h"
 #include "firebaseauthservice.h"
 #include "thememanager.h"
+#include "networkaccess.h"
+#include "sessionstore.h"
 
-// Declare logging categories
-Q_LOGGING_CATEGORY(authLog, "auth")
+// Declare logging categories; the shared ones live in studentcore
 Q_LOGGING_CATEGORY(configLog, "config")
-Q_LOGGING_CATEGORY(networkLog, "network")
-Q_LOGGING_CATEGORY(firestoreLog, "firestore")
-Q_LOGGING_CATEGORY(dataLog, "data")
-
-void messageOutput(QtMsgType type, const QMessageLogContext &context, const QString &msg)
-{
-    QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz");
-    QString typeStr;
-    
-    switch (type) {
-    case QtDebugMsg:    typeStr = "DEBUG"; break;
-    case QtInfoMsg:     typeStr = "INFO "; break;
-    case QtWarningMsg:  typeStr = "WARN "; break;
-    case QtCriticalMsg: typeStr = "ERROR"; break;
-    case QtFatalMsg:    typeStr = "FATAL"; break;
-    }
-    
-    QString category = context.category ? QString("[%1]").arg(context.category) : "";
-    QString formattedMsg = QString("%1 %2 %3 %4").arg(timestamp, typeStr, category, msg);
-    
-    // Output to console
-    fprintf(stderr, "%s\n", formattedMsg.toLocal8Bit().constData());
-    fflush(stderr);
-}
+Q_DECLARE_LOGGING_CATEGORY(authLog)
 
 int main(int argc, char *argv[])
 {
@@ -147,6 +125,14 @@ int main(int argc, char *argv[])
         return 1;
     }
     
+    // [endpoints] origin sends the Firebase requests to a stand-in server
+    // such as smstandin instead of the Google hosts
+    NetworkAccess::setOriginOverride(settings.value("endpoints/origin", "").toString());
+    
+    // Open the TLS connections while the user is typing credentials, so
+    // sign-in and the first Firestore load skip the handshakes
+    NetworkAccess::prewarm();
+    
     // Create authentication service
     qCInfo(authLog) << "Creating Firebase authentication service";
     FirebaseAuthService authService;
@@ -154,22 +140,77 @@ int main(int argc, char *argv[])
     authService.setApiKey(apiKey);
     qCInfo(authLog) << "Authentication service configured successfully";
     
-    // Show login dialog
-    qCInfo(authLog) << "Showing login dialog";
-    LoginDialog loginDialog;
-    loginDialog.setAuthService(&authService);
-    
-    if (loginDialog.exec() != QDialog::Accepted) {
-        qCInfo(authLog) << "User cancelled authentication or login failed";
-        return 0;
+    // [session] store: keyring (default; nothing is saved where the build
+    // has no credential store), file, or none to always ask for the password
+    SessionStore sessionStore(projectId,
+                              SessionStore::backendFromName(settings.value("session/store", "keyring").toString()),
+                              QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/session.json");
+    bool sessionEnabled = sessionStore.backend() != SessionStore::None;
+    SessionStore::Session savedSession = sessionEnabled ? sessionStore.load() : SessionStore::Session();
+    bool rememberSession = savedSession.isValid();
+    
+    if (savedSession.isValid()) {
+        // Warm start: exchange the saved refresh token while the main window
+        // already shows the cached list
+        qCInfo(authLog) << "Saved session found, skipping login dialog";
+        authService.restoreSession(savedSession.refreshToken, savedSession.userId, savedSession.email);
+    } else {
+        // Show login dialog
+        qCInfo(authLog) << "Showing login dialog";
+        LoginDialog loginDialog;
+        loginDialog.setAuthService(&authService);
+        loginDialog.setRememberSessionAvailable(sessionEnabled);
+        
+        if (loginDialog.exec() != QDialog::Accepted) {
+            qCInfo(authLog) << "User cancelled authentication or login failed";
+            return 0;
+        }
+        
+        qCInfo(authLog) << "Authentication successful, starting main application";
+        rememberSession = sessionEnabled && loginDialog.rememberSession();
     }
     
-    qCInfo(authLog) << "Authentication successful, starting main application";
-    
-    // Authentication successful, create and show main window
+    // Keep the stored session current; the refresh token can rotate
+    auto saveSession = [&]() {
+        if (rememberSession && !authService.getRefreshToken().isEmpty()) {
+            sessionStore.save({authService.getRefreshToken(), authService.getUserId(), authService.getUserEmail()});
+        }
+    };
+    saveSession();
+    QObject::connect(&authService, &FirebaseAuthService::tokenRefreshed, &app, saveSession);
+    QObject::connect(&authService, &FirebaseAuthService::signedOut, &app, [&]() {
+        rememberSession = false;
+        sessionStore.clear();
+    });
+    
+    // Authentication successful or being resumed, create and show main window
     MainWindow window;
     window.setAuthService(&authService);
     window.show();
     
+    // A saved session the server no longer accepts falls back to the login
+    // dialog; the stored session is replaced by the next successful sign-in
+    bool resuming = savedSession.isValid();
+    QObject::connect(&authService, &FirebaseAuthService::tokenRefreshed, &app, [&]() {
+        resuming = false;
+    });
+    QObject::connect(&authService, &FirebaseAuthService::tokenRefreshFailed, &window, [&](const QString& error) {
+        if (!resuming) {
+            return;
+        }
+        resuming = false;
+        qCWarning(authLog) << "Saved session could not be resumed:" << error;
+        
+        LoginDialog loginDialog(&window);
+        loginDialog.setAuthService(&authService);
+        if (loginDialog.exec() != QDialog::Accepted) {
+            qCInfo(authLog) << "User cancelled authentication after failed session resume";
+            QApplication::quit();
+            return;
+        }
+        rememberSession = loginDialog.rememberSession();
+        saveSession();
+    }, Qt::QueuedConnection);
+    
     return app.exec();
 }
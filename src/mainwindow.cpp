@@ -7,6 +7,7 @@
 #include <QInputDialog>
 #include <QSettings>
 #include <QFile>
+#include <QFileInfo>
 #include <QLoggingCategory>
 #include <QNetworkAccessManager>
 #include <QNetworkRequest>
@@ -19,23 +20,69 @@
 #include <QGridLayout>
 #include <QFileDialog>
 #include <QDateTime>
+#include <QSignalBlocker>
+#include <QStandardPaths>
+#include <QProgressDialog>
+#include <QTimer>
 #include <algorithm>
-#include "xlsxdocument.h"
-#include "xlsxformat.h"
-#include "xlsxcellrange.h"
+#include <memory>
 #include "statisticsdialog.h"
 #include "updatedialog.h"
+#include "xlsxdocument.h"
+#include "xlsxcellrange.h"
+
+namespace {
+// Store changes arriving in bursts (load ranges, import chunks) rebuild the
+// table at most this often
+const int StoreRefreshDelayMs = 250;
 
-using namespace QXlsx;
+// Fallback for workbooks the importer cannot stream, e.g. deflated files in
+// a build without zlib. QXlsx needs QtGui, so it stays out of studentcore.
+bool loadWorkbook(const QString& filePath, QList<QVariantList>* rows)
+{
+    QXlsx::Document document(filePath);
+    if (!document.load()) {
+        return false;
+    }
+    
+    const int columnCount = StudentWriter::columnTitles().size();
+    const int lastRow = document.dimension().lastRow();
+    for (int row = 1; row <= lastRow; ++row) {
+        QVariantList cells;
+        for (int column = 1; column <= columnCount; ++column) {
+            cells.append(document.read(row, column));
+        }
+        rows->append(cells);
+    }
+    return true;
+}
+}
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , m_centralWidget(nullptr)
+    , m_store(new StudentStore(this))
     , m_firestoreService(new FirestoreService(this))
+    , m_changeFeed(new ChangeFeed(m_firestoreService, m_store, this))
+    , m_outbox(new WriteOutbox(m_firestoreService, m_store,
+                               QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/outbox.json",
+                               this))
+    , m_autoRefresh(false)
+    , m_loadPartitions(1)
+    , m_storeRefreshTimer(new QTimer(this))
     , m_storageService(new FirebaseStorageService(this))
+    , m_photoImporter(new PhotoImporter(m_storageService, m_store, m_outbox,
+                                        QStandardPaths::writableLocation(QStandardPaths::AppDataLocation), this))
+    , m_photoCollector(new PhotoGarbageCollector(m_storageService, m_firestoreService, m_store, this))
+    , m_exporter(new StudentExporter(this))
+    , m_importer(new StudentImporter(this))
     , m_authService(nullptr)
     , m_updateChecker(new UpdateChecker(this))
     , m_pendingPhotoDialog(nullptr)
+    , m_exportPending(false)
+    , m_datasetLoaded(false)
+    , m_initialLoadPending(false)
+    , m_uploadsResumed(false)
 {
     // Set window icon
     QStringList iconPaths = {
@@ -76,6 +123,10 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    // Picks up change-feed updates and local edits made since the last load
+    if (!m_snapshotPath.isEmpty() && !m_store->isEmpty()) {
+        m_store->saveSnapshot(m_snapshotPath);
+    }
 }
 
 void MainWindow::setAuthService(FirebaseAuthService* authService)
@@ -89,24 +140,36 @@ void MainWindow::setAuthService(FirebaseAuthService* authService)
         // Update window title with user info
         setWindowTitle(QString("NEVRETEM-DER MBS - %1").arg(m_authService->getUserEmail()));
         
-        // Set auth token in Firestore service
-        qCDebug(dataLog) << "Setting auth token in Firestore service";
-        m_firestoreService->setAuthToken(m_authService->getIdToken());
+        connect(m_authService, &FirebaseAuthService::authenticationSucceeded, this, &MainWindow::onAuthTokenChanged);
+        connect(m_authService, &FirebaseAuthService::tokenRefreshed, this, &MainWindow::onAuthTokenChanged);
         
-        // Set auth token in Storage service
-        qCDebug(dataLog) << "Setting auth token in Storage service";
-        m_storageService->setAuthToken(m_authService->getIdToken());
-        
-        // Connect to token refresh signal to update services
-        connect(m_authService, &FirebaseAuthService::tokenRefreshed, [this]() {
-            qCDebug(dataLog) << "Auth token refreshed, updating services";
-            m_firestoreService->setAuthToken(m_authService->getIdToken());
-            m_storageService->setAuthToken(m_authService->getIdToken());
+        // Requests refused with an expired token wait for one refresh and
+        // are then sent again; if the refresh fails they fail as before
+        connect(m_firestoreService, &FirestoreService::authenticationRequired,
+                m_authService, &FirebaseAuthService::refreshToken);
+        connect(m_storageService, &FirebaseStorageService::authenticationRequired,
+                m_authService, &FirebaseAuthService::refreshToken);
+        connect(m_authService, &FirebaseAuthService::tokenRefreshFailed, this, [this](const QString& error) {
+            qCWarning(dataLog) << "Auth token refresh failed:" << error;
+            m_firestoreService->abortParkedRequests();
+            m_storageService->abortParkedRequests();
         });
         
-        // Load students after authentication is set
-        qCInfo(dataLog) << "Triggering initial student data load";
-        onRefreshStudents();
+        if (m_authService->isAuthenticated()) {
+            onAuthTokenChanged();
+            
+            // Load students after authentication is set
+            qCInfo(dataLog) << "Triggering initial student data load";
+            onRefreshStudents();
+        } else {
+            // A saved session is being resumed; the cached list stays on
+            // screen until the new ID token allows the first load
+            qCInfo(dataLog) << "Waiting for the saved session to be resumed";
+            m_initialLoadPending = true;
+            m_statusLabel->setText(m_store->isEmpty()
+                                   ? QString("Oturum yenileniyor...")
+                                   : QString("%1 adet mezun (önbellekten), oturum yenileniyor...").arg(m_store->size()));
+        }
     } else {
         qCWarning(dataLog) << "Auth service is null";
     }
@@ -331,6 +394,9 @@ void MainWindow::setupUI()
         if (hasSelection) {
             Student student = getStudentFromRow(m_studentsTable->currentRow());
             updateStudentDetails(student);
+            if (student.isPartial()) {
+                requestFullStudent(student.getId());
+            }
         } else {
             clearStudentDetails();
         }
@@ -473,16 +539,24 @@ void MainWindow::setupMenuBar()
     
     fileMenu->addSeparator();
     
-    // Excel import/export actions
-    m_exportExcelAction = new QAction("Excel'e &Aktar", this);
-    m_exportExcelAction->setShortcut(QKeySequence("Ctrl+E"));
-    connect(m_exportExcelAction, &QAction::triggered, this, &MainWindow::onExportToExcel);
-    fileMenu->addAction(m_exportExcelAction);
+    // Import/export actions
+    m_exportAction = new QAction("Dışa &Aktar...", this);
+    m_exportAction->setShortcut(QKeySequence("Ctrl+E"));
+    connect(m_exportAction, &QAction::triggered, this, &MainWindow::onExportStudents);
+    fileMenu->addAction(m_exportAction);
+    
+    m_importAction = new QAction("&İçe Aktar...", this);
+    m_importAction->setShortcut(QKeySequence("Ctrl+I"));
+    connect(m_importAction, &QAction::triggered, this, &MainWindow::onImportStudents);
+    fileMenu->addAction(m_importAction);
     
-    m_importExcelAction = new QAction("Excel'den &İçe Aktar", this);
-    m_importExcelAction->setShortcut(QKeySequence("Ctrl+I"));
-    connect(m_importExcelAction, &QAction::triggered, this, &MainWindow::onImportFromExcel);
-    fileMenu->addAction(m_importExcelAction);
+    m_importPhotosAction = new QAction("Klasörden &Fotoğraf Aktar...", this);
+    connect(m_importPhotosAction, &QAction::triggered, this, &MainWindow::onImportPhotos);
+    fileMenu->addAction(m_importPhotosAction);
+    
+    m_cleanPhotosAction = new QAction("Sahipsiz Fotoğrafları &Temizle...", this);
+    connect(m_cleanPhotosAction, &QAction::triggered, this, &MainWindow::onCleanOrphanPhotos);
+    fileMenu->addAction(m_cleanPhotosAction);
     
     fileMenu->addSeparator();
     
@@ -536,9 +610,10 @@ void MainWindow::setupFirestore()
 {
     // Connect Firestore signals
     connect(m_firestoreService, &FirestoreService::studentsReceived, this, &MainWindow::onStudentsReceived);
-    connect(m_firestoreService, &FirestoreService::studentAdded, this, &MainWindow::onStudentAdded);
-    connect(m_firestoreService, &FirestoreService::studentUpdated, this, &MainWindow::onStudentUpdated);
-    connect(m_firestoreService, &FirestoreService::studentDeleted, this, &MainWindow::onStudentDeleted);
+    connect(m_firestoreService, &FirestoreService::studentsPartitionReceived, this, &MainWindow::onStudentsPartitionReceived);
+    connect(m_firestoreService, &FirestoreService::studentReceived, this, &MainWindow::onStudentReceived);
+    connect(m_firestoreService, &FirestoreService::queryResultsReceived, this, &MainWindow::onQueryResultsReceived);
+    connect(m_firestoreService, &FirestoreService::queryFailed, this, &MainWindow::onQueryFailed);
     connect(m_firestoreService, &FirestoreService::errorOccurred, this, &MainWindow::onFirestoreError);
     
     // Load settings from config.ini file
@@ -556,6 +631,51 @@ void MainWindow::setupFirestore()
     if (!apiKey.isEmpty()) {
         m_firestoreService->setApiKey(apiKey);
     }
+    
+    // Keep the store in sync with other operators' edits. Changes come in
+    // bursts (load ranges, import chunks) that share one table rebuild.
+    m_storeRefreshTimer->setSingleShot(true);
+    m_storeRefreshTimer->setInterval(StoreRefreshDelayMs);
+    connect(m_storeRefreshTimer, &QTimer::timeout, this, &MainWindow::onStoreChanged);
+    connect(m_store, &StudentStore::storeReset, this, &MainWindow::scheduleStoreRefresh);
+    connect(m_store, &StudentStore::studentsChanged, this, &MainWindow::scheduleStoreRefresh);
+    connect(m_changeFeed, &ChangeFeed::changesApplied, this, &MainWindow::onRemoteChangesApplied);
+    
+    // Writes go through the outbox; anything left from the last session is
+    // sent once the first list load has succeeded
+    connect(m_outbox, &WriteOutbox::pendingCountChanged, this, &MainWindow::onPendingWritesChanged);
+    connect(m_outbox, &WriteOutbox::writeCommitted, this, &MainWindow::onWriteCommitted);
+    connect(m_outbox, &WriteOutbox::writeRejected, this, &MainWindow::onWriteRejected);
+    connect(m_outbox, &WriteOutbox::writeConflict, this, &MainWindow::onWriteConflict);
+    connect(m_outbox, &WriteOutbox::reconciled, this, &MainWindow::onWritesReconciled);
+    connect(m_importer, &StudentImporter::studentsParsed, m_outbox, &WriteOutbox::enqueueSets);
+    m_importer->setWorkbookLoader(loadWorkbook);
+    m_changeFeed->setOutbox(m_outbox);
+    m_outbox->load();
+    
+    // Show the list from the last session at once; the first load after
+    // sign-in replaces it
+    m_snapshotPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+                     + QString("/students-%1.json").arg(projectId);
+    bool snapshotLoaded = false;
+    {
+        const QSignalBlocker blocker(m_store);
+        snapshotLoaded = m_store->loadSnapshot(m_snapshotPath);
+        if (snapshotLoaded) {
+            m_outbox->reapplyPending();
+        }
+    }
+    if (snapshotLoaded) {
+        onStoreChanged();
+        m_statusLabel->setText(QString("%1 adet mezun (önbellekten)").arg(m_store->size()));
+    }
+    
+    m_autoRefresh = settings.value("application/autoRefresh", false).toBool();
+    m_changeFeed->setInterval(settings.value("application/refreshInterval", 30000).toInt());
+    qCInfo(dataLog) << "Auto refresh:" << m_autoRefresh << "interval:" << m_changeFeed->interval() << "ms";
+    
+    m_loadPartitions = qBound(1, settings.value("firestore/loadPartitions", 1).toInt(), 32);
+    qCInfo(dataLog) << "Full loads use" << m_loadPartitions << "partitions";
 }
 
 void MainWindow::setupStorage()
@@ -563,6 +683,19 @@ void MainWindow::setupStorage()
     // Connect Storage service signals
     connect(m_storageService, &FirebaseStorageService::imageLoaded, this, &MainWindow::onImageLoaded);
     connect(m_storageService, &FirebaseStorageService::imageLoadFailed, this, &MainWindow::onImageLoadFailed);
+    connect(m_storageService, &FirebaseStorageService::interruptedUploadFinished, this, &MainWindow::onInterruptedUploadFinished);
+    connect(m_storageService, &FirebaseStorageService::filesListed, this, &MainWindow::onPhotoFilesListed);
+    connect(m_storageService, &FirebaseStorageService::filesDeleted, this, &MainWindow::onPhotoFilesDeleted);
+    connect(m_photoCollector, &PhotoGarbageCollector::scanFinished, this, &MainWindow::onOrphanScanFinished);
+    connect(m_photoCollector, &PhotoGarbageCollector::deleteFinished, this, &MainWindow::onOrphanDeleteFinished);
+    connect(m_photoCollector, &PhotoGarbageCollector::deleteProgress, this, [this](int done, int total) {
+        m_statusLabel->setText(QString("Sahipsiz fotoğraflar siliniyor... (%1/%2)").arg(done).arg(total));
+    });
+    connect(m_photoCollector, &PhotoGarbageCollector::failed, this, [this](const QString& error) {
+        m_statusLabel->setText("Hazır");
+        QMessageBox::warning(this, "Fotoğraf Temizliği", QString("Depolama listelenemedi:\n%1").arg(error));
+    });
+    m_storageService->setUploadStatePath(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/uploads.json");
     
     // Load settings from config.ini file
     QString configPath = QApplication::applicationDirPath() + "/../../config.ini";
@@ -587,12 +720,17 @@ void MainWindow::onAddStudent()
     dialog->setStorageService(m_storageService);
     if (dialog->exec() == QDialog::Accepted) {
         Student student = dialog->getStudent();
+        student.setId(FirestoreService::generateDocumentId());
+        student.setLastUpdateTime(QDateTime::currentDateTimeUtc());
         
-        // Store the dialog pointer for deferred photo upload
-        m_pendingPhotoDialog = dialog;
+        qCInfo(dataLog) << "Queueing new student:" << student.getName() << "with ID:" << student.getId();
+        m_outbox->enqueueSet(student);
         
-        showLoadingState(true);
-        m_firestoreService->addStudent(student);
+        // The ID is known up front, so the photo upload can start right away
+        m_pendingPhotoDialog = dialog;
+        connect(m_pendingPhotoDialog, &StudentDialog::deferredUploadCompleted,
+                this, &MainWindow::onDeferredUploadCompleted, Qt::UniqueConnection);
+        m_pendingPhotoDialog->uploadDeferredPhoto(student.getId());
     } else {
         // Clean up dialog if cancelled
         dialog->deleteLater();
@@ -605,13 +743,39 @@ void MainWindow::onEditStudent()
     if (currentRow < 0) return;
     
     Student student = getStudentFromRow(currentRow);
+    if (student.isPartial()) {
+        // The list projection lacks the description; editing it would blank
+        // the field on save, so wait for the full document first
+        qCInfo(dataLog) << "Fetching full document before editing student ID:" << student.getId();
+        m_pendingEditStudentId = student.getId();
+        showLoadingState(true);
+        requestFullStudent(student.getId());
+        return;
+    }
+    
+    openEditDialog(student);
+}
+
+void MainWindow::openEditDialog(const Student& student)
+{
     StudentDialog dialog(student, this);
     dialog.setStorageService(m_storageService);
     if (dialog.exec() == QDialog::Accepted) {
         Student updatedStudent = dialog.getStudent();
-        showLoadingState(true);
-        m_firestoreService->updateStudent(updatedStudent);
+        updatedStudent.setLastUpdateTime(QDateTime::currentDateTimeUtc());
+        m_outbox->enqueueSet(updatedStudent);
+    }
+}
+
+void MainWindow::requestFullStudent(const QString& studentId)
+{
+    if (studentId.isEmpty() || m_pendingFullFetches.contains(studentId)) {
+        return;
     }
+    
+    qCDebug(dataLog) << "Requesting full document for student ID:" << studentId;
+    m_pendingFullFetches.insert(studentId);
+    m_firestoreService->getStudent(studentId);
 }
 
 void MainWindow::onDeleteStudent()
@@ -625,21 +789,12 @@ void MainWindow::onDeleteStudent()
                                    QMessageBox::Yes | QMessageBox::No);
     
     if (ret == QMessageBox::Yes) {
-        showLoadingState(true);
-        
-        // Delete associated photo first if it exists
-        if (!student.getPhotoURL().isEmpty() && m_storageService) {
-            // Generate the expected storage path based on student ID
-            QString studentId = student.getId();
-            // Try common image extensions
-            QStringList extensions = {"jpg", "jpeg", "png", "gif", "bmp"};
-            for (const QString& ext : extensions) {
-                QString storagePath = QString("student_photos/%1.%2").arg(studentId, ext);
-                m_storageService->deleteFile(storagePath);
-            }
-        }
-        
-        m_firestoreService->deleteStudent(student.getId());
+        // The photo is removed once the delete has been committed, so a
+        // rolled-back delete keeps it. Its exact path comes from the photo
+        // URL, which is gone from the store by then.
+        m_photoDeletePaths[student.getId()] = FirebaseStorageService::storagePathFromUrl(student.getPhotoURL());
+        m_outbox->enqueueDelete(student.getId());
+        clearStudentDetails();
     }
 }
 
@@ -650,8 +805,9 @@ void MainWindow::onRefreshStudents()
     qCDebug(dataLog) << "Current filtered count:" << m_filteredStudents.size();
     
     showLoadingState(true);
-    qCInfo(dataLog) << "Requesting all students from Firestore";
-    m_firestoreService->getAllStudents();
+    m_pendingFullFetches.clear();
+    qCInfo(dataLog) << "Requesting student list projection from Firestore";
+    m_firestoreService->getAllStudentsPartitioned(m_loadPartitions, FirestoreService::listProjection());
 }
 
 void MainWindow::onSearchTextChanged()
@@ -704,6 +860,9 @@ void MainWindow::onClearFilters()
 void MainWindow::onShowStatistics()
 {
     StatisticsDialog dialog(m_allStudents, this);
+    // Without a full local dataset the client-side counts would be wrong,
+    // so let Firestore count right away
+    dialog.setFirestoreService(m_firestoreService, !m_datasetLoaded);
     dialog.exec();
 }
 
@@ -767,124 +926,296 @@ void MainWindow::onStudentsReceived(const QList<Student>& students)
     
     qCInfo(dataLog) << "Student breakdown - Active:" << activeCount << "Graduated:" << graduatedCount << "No University:" << noUniversityCount;
     
-    m_allStudents = students;
-    qCDebug(dataLog) << "Updated m_allStudents, size:" << m_allStudents.size();
-    
-    // Update filter dropdowns with new data
-    if (m_filterFrame && m_filterFrame->isVisible()) {
-        qCDebug(dataLog) << "Updating filter dropdowns with new student data";
-        populateFilterDropdowns();
+    m_datasetLoaded = true;
+    qCInfo(dataLog) << "Replacing store contents and applying filters";
+    {
+        // Local writes the server has not seen yet stay visible
+        const QSignalBlocker blocker(m_store);
+        m_store->replaceAll(students);
+        m_outbox->reapplyPending();
+    }
+    onStoreChanged();
+    m_outbox->flush();
+    if (!m_snapshotPath.isEmpty()) {
+        m_store->saveSnapshot(m_snapshotPath);
     }
     
-    qCInfo(dataLog) << "Applying filters to student list";
-    filterStudents();
+    // Photo uploads cut off last time can finish now that the students
+    // they belong to are known
+    if (!m_uploadsResumed) {
+        m_uploadsResumed = true;
+        m_storageService->resumeInterruptedUploads();
+    }
     
     QString statusText = QString("%1 adet mezun yüklendi").arg(students.size());
     m_statusLabel->setText(statusText);
     qCInfo(dataLog) << "Status updated:" << statusText;
+    
+    // Start following changes from the freshly loaded snapshot
+    if (m_autoRefresh) {
+        m_changeFeed->start();
+    }
+    
+    if (m_exportPending) {
+        m_exportPending = false;
+        qCInfo(dataLog) << "Full documents loaded, resuming export";
+        onExportStudents();
+    }
 }
 
-void MainWindow::onStudentAdded(const Student& student)
+void MainWindow::onStudentsPartitionReceived(const QList<Student>& students)
 {
-    qCInfo(dataLog) << "=== Student added successfully ===";
-    qCInfo(dataLog) << "Added student:" << student.getName() << "(" << student.getEmail() << ")";
-    qCDebug(dataLog) << "Student ID:" << student.getId();
-    
-    showLoadingState(false);
+    // Show rows as ranges arrive; onStudentsReceived replaces the store with
+    // the complete list at the end
+    qCDebug(dataLog) << "Merging" << students.size() << "students from a partial load";
+    QList<Student> incoming;
+    incoming.reserve(students.size());
+    for (const Student& student : students) {
+        if (!m_outbox->hasPendingWrite(student.getId())) {
+            incoming.append(student);
+        }
+    }
+    m_store->upsertMany(incoming);
+    m_statusLabel->setText(QString("%1 adet mezun yüklendi, yükleme sürüyor...").arg(m_store->size()));
+}
+
+void MainWindow::scheduleStoreRefresh()
+{
+    // Not restarted while running, so a steady stream still refreshes
+    if (!m_storeRefreshTimer->isActive()) {
+        m_storeRefreshTimer->start();
+    }
+}
+
+void MainWindow::onStoreChanged()
+{
+    m_storeRefreshTimer->stop();
+    
+    // Keep the selected student selected across table rebuilds
+    QString selectedId;
+    if (m_studentsTable->currentRow() >= 0) {
+        QTableWidgetItem* item = m_studentsTable->item(m_studentsTable->currentRow(), 1);
+        if (item) {
+            selectedId = item->data(Qt::UserRole).toString();
+        }
+    }
     
-    qCDebug(dataLog) << "Current student count before adding:" << m_allStudents.size();
-    m_allStudents.append(student);
-    qCDebug(dataLog) << "Current student count after adding:" << m_allStudents.size();
+    m_allStudents = m_store->students();
+    qCDebug(dataLog) << "Updated m_allStudents from store, size:" << m_allStudents.size();
     
-    // Handle deferred photo upload if there's a pending dialog
-    if (m_pendingPhotoDialog) {
-        qCInfo(dataLog) << "Uploading deferred photo for student ID:" << student.getId();
-        
-        // Connect the completion signal
-        connect(m_pendingPhotoDialog, &StudentDialog::deferredUploadCompleted,
-                this, &MainWindow::onDeferredUploadCompleted, Qt::UniqueConnection);
-        
-        m_pendingPhotoDialog->uploadDeferredPhoto(student.getId());
-        // Don't delete the dialog immediately - let it clean up after upload completes
-        // The dialog will be cleaned up when the upload finishes or fails
+    // Update filter dropdowns with new data
+    if (m_filterFrame && m_filterFrame->isVisible()) {
+        qCDebug(dataLog) << "Updating filter dropdowns with new student data";
+        populateFilterDropdowns();
     }
     
-    qCInfo(dataLog) << "Refreshing filtered student list";
     filterStudents();
     
-    m_statusLabel->setText("Mezun başarıyla eklendi");
-    qCInfo(dataLog) << "Student addition process completed";
+    if (!selectedId.isEmpty()) {
+        int row = findStudentRow(selectedId);
+        if (row >= 0) {
+            m_studentsTable->selectRow(row);
+        } else {
+            clearStudentDetails();
+        }
+    }
 }
 
-void MainWindow::onStudentUpdated(const Student& student)
+void MainWindow::onRemoteChangesApplied(int changedCount, int removedCount)
 {
-    qCInfo(dataLog) << "=== Student updated successfully ===";
-    qCInfo(dataLog) << "Updated student:" << student.getName() << "(" << student.getEmail() << ")";
-    qCDebug(dataLog) << "Student ID:" << student.getId();
+    qCInfo(dataLog) << "Remote changes applied - changed:" << changedCount << "removed:" << removedCount;
+    m_statusLabel->setText(QString("%1 adet mezun (%2 değişiklik alındı)")
+                               .arg(m_store->size())
+                               .arg(changedCount + removedCount));
+}
+
+void MainWindow::onStudentReceived(const Student& student)
+{
+    qCDebug(dataLog) << "Received full document for student ID:" << student.getId();
+    m_pendingFullFetches.remove(student.getId());
+    
+    if (m_outbox->hasPendingWrite(student.getId())) {
+        // The local copy is newer than what the server returned
+        qCDebug(dataLog) << "Keeping local version of student with pending writes:" << student.getId();
+        if (m_pendingEditStudentId == student.getId()) {
+            m_pendingEditStudentId.clear();
+            showLoadingState(false);
+            openEditDialog(m_store->student(student.getId()));
+        }
+        return;
+    }
     
-    showLoadingState(false);
+    // Record the full document without rebuilding the table
+    {
+        const QSignalBlocker blocker(m_store);
+        m_store->upsert(student);
+    }
     
-    // Update the student in our list
-    bool found = false;
-    for (int i = 0; i < m_allStudents.size(); ++i) {
-        if (m_allStudents[i].getId() == student.getId()) {
-            qCDebug(dataLog) << "Found student at index" << i << "- updating";
-            qCDebug(dataLog) << "Old name:" << m_allStudents[i].getName() << "New name:" << student.getName();
-            m_allStudents[i] = student;
-            found = true;
+    // Replace the projected record with the full one in both lists
+    for (Student& existing : m_allStudents) {
+        if (existing.getId() == student.getId()) {
+            existing = student;
+            break;
+        }
+    }
+    for (Student& existing : m_filteredStudents) {
+        if (existing.getId() == student.getId()) {
+            existing = student;
             break;
         }
     }
     
-    if (!found) {
-        qCWarning(dataLog) << "Could not find student with ID" << student.getId() << "in local list";
+    // Fill in the description cell without rebuilding the table
+    int row = findStudentRow(student.getId());
+    if (row >= 0) {
+        QTableWidgetItem* descriptionItem = m_studentsTable->item(row, 8);
+        if (descriptionItem) {
+            descriptionItem->setText(student.getDescription());
+        }
+        if (row == m_studentsTable->currentRow()) {
+            m_descriptionLabel->setText(student.getDescription());
+        }
+    }
+    
+    if (student.getId() == m_pendingEditStudentId) {
+        m_pendingEditStudentId.clear();
+        showLoadingState(false);
+        m_statusLabel->setText("Hazır");
+        openEditDialog(student);
+    }
+}
+
+void MainWindow::onPendingWritesChanged(int count)
+{
+    qCDebug(dataLog) << "Pending writes:" << count;
+    if (count > 0) {
+        m_statusLabel->setText(QString("%1 değişiklik gönderilmeyi bekliyor").arg(count));
     } else {
-        qCDebug(dataLog) << "Student updated in local list";
+        m_statusLabel->setText("Tüm değişiklikler kaydedildi");
+    }
+}
+
+void MainWindow::onWriteCommitted(const QString& studentId, WriteOutbox::Operation operation)
+{
+    if (operation != WriteOutbox::Delete || !m_storageService) {
+        return;
     }
     
-    qCInfo(dataLog) << "Refreshing filtered student list";
-    filterStudents();
+    // Delete associated photo now that the document is gone
+    if (!m_photoDeletePaths.contains(studentId)) {
+        // Queued in an earlier run, so the photo URL is unknown: look the
+        // object up by name. Photos are stored as student_photos/{id}.{ext}
+        m_storageService->listFiles(QString("student_photos/%1.").arg(studentId), "photo-lookup");
+        return;
+    }
+    
+    QString storagePath = m_photoDeletePaths.take(studentId);
+    if (storagePath.isEmpty()) {
+        return; // No photo
+    }
     
-    m_statusLabel->setText("Mezun başarıyla güncellendi");
-    qCInfo(dataLog) << "Student update process completed";
+    // Deletes committed in the same batch go out together
+    if (m_photoDeleteQueue.isEmpty()) {
+        QTimer::singleShot(0, this, &MainWindow::flushPhotoDeletes);
+    }
+    m_photoDeleteQueue.append(storagePath);
 }
 
-void MainWindow::onStudentDeleted(const QString& studentId)
+void MainWindow::flushPhotoDeletes()
 {
-    qCInfo(dataLog) << "=== Student deleted successfully ===";
-    qCInfo(dataLog) << "Deleted student ID:" << studentId;
+    if (m_photoDeleteQueue.isEmpty()) {
+        return;
+    }
     
-    showLoadingState(false);
+    qCInfo(dataLog) << "Deleting" << m_photoDeleteQueue.size() << "photos of deleted students";
+    m_storageService->deleteFiles(m_photoDeleteQueue, "photos");
+    m_photoDeleteQueue.clear();
+}
+
+void MainWindow::onPhotoFilesListed(const QString& tag, const QStringList& storagePaths, bool finished)
+{
+    Q_UNUSED(finished)
+    if (tag != "photo-lookup" || storagePaths.isEmpty()) {
+        return;
+    }
     
-    // Remove the student from our list
-    bool found = false;
-    QString deletedStudentName;
-    for (int i = 0; i < m_allStudents.size(); ++i) {
-        if (m_allStudents[i].getId() == studentId) {
-            deletedStudentName = m_allStudents[i].getName();
-            qCDebug(dataLog) << "Found student at index" << i << "- removing:" << deletedStudentName;
-            qCDebug(dataLog) << "Student count before removal:" << m_allStudents.size();
-            m_allStudents.removeAt(i);
-            qCDebug(dataLog) << "Student count after removal:" << m_allStudents.size();
-            found = true;
-            break;
-        }
+    if (m_photoDeleteQueue.isEmpty()) {
+        QTimer::singleShot(0, this, &MainWindow::flushPhotoDeletes);
+    }
+    m_photoDeleteQueue.append(storagePaths);
+}
+
+void MainWindow::onPhotoFilesDeleted(const QString& tag, const QStringList& deletedPaths, const QStringList& failedPaths)
+{
+    if (tag != "photos") {
+        return;
     }
     
-    if (!found) {
-        qCWarning(dataLog) << "Could not find student with ID" << studentId << "in local list";
-    } else {
-        qCInfo(dataLog) << "Successfully removed student:" << deletedStudentName;
+    qCInfo(dataLog) << "Photo cleanup:" << deletedPaths.size() << "deleted," << failedPaths.size() << "failed";
+    if (!failedPaths.isEmpty()) {
+        qCWarning(dataLog) << "Photos left in storage:" << failedPaths;
     }
+}
+
+void MainWindow::onWriteRejected(const QString& studentId, const QString& error)
+{
+    qCWarning(dataLog) << "Write for student" << studentId << "was rejected and rolled back:" << error;
+    m_photoDeletePaths.remove(studentId);
     
-    qCInfo(dataLog) << "Refreshing filtered student list";
-    filterStudents();
+    QString name = m_store->contains(studentId) ? m_store->student(studentId).getName() : studentId;
+    QMessageBox::warning(this, "Değişiklik Geri Alındı",
+                         QString("'%1' için yapılan değişiklik sunucu tarafından reddedildi ve geri alındı.\n\n%2")
+                             .arg(name, error));
+}
+
+void MainWindow::onWriteConflict(WriteOutbox::Operation operation, const Student& local, const Student& server,
+                                 const QStringList& fields)
+{
+    qCWarning(dataLog) << "Write conflict for student" << server.getId() << "fields:" << fields;
     
-    qCDebug(dataLog) << "Clearing student details panel";
-    clearStudentDetails();
+    // Only the fields this edit touched are offered; the other operator's
+    // changes to the rest stay
+    QStringList editedFields = fields;
+    editedFields.removeAll("lastUpdateTime");
     
-    m_statusLabel->setText("Mezun başarıyla silindi");
-    qCInfo(dataLog) << "Student deletion process completed";
+    QString question;
+    if (operation == WriteOutbox::Delete) {
+        question = QString("'%1' siz silmeden önce başka bir kullanıcı tarafından değiştirildi.\n\n"
+                           "Yine de silinsin mi?").arg(server.getName());
+    } else {
+        question = QString("'%1' siz düzenlerken başka bir kullanıcı tarafından değiştirildi.\n\n"
+                           "Değiştirdiğiniz alanlar: %2\n\n"
+                           "Sizin değişiklikleriniz uygulansın mı? Hayır derseniz sunucudaki sürüm korunur.")
+                       .arg(server.getName(), editedFields.join(", "));
+    }
+    
+    int ret = QMessageBox::question(this, "Çakışma", question, QMessageBox::Yes | QMessageBox::No);
+    if (ret != QMessageBox::Yes) {
+        m_statusLabel->setText("Sunucudaki sürüm korundu");
+        return;
+    }
+    
+    // Re-apply on top of the server version, which is now in the store
+    if (operation == WriteOutbox::Delete) {
+        m_outbox->enqueueDelete(server.getId());
+    } else {
+        Student mine = server;
+        mine.clearDirty();
+        mine.applyFields(local, editedFields);
+        mine.setLastUpdateTime(QDateTime::currentDateTimeUtc());
+        m_outbox->enqueueSet(mine);
+    }
+}
+
+void MainWindow::onWritesReconciled(int confirmedCount, int missingCount)
+{
+    qCInfo(dataLog) << "Written students confirmed:" << confirmedCount << "missing:" << missingCount;
+    if (missingCount > 0) {
+        QMessageBox::warning(this, "Doğrulama",
+                             QString("Kaydedilen %1 mezun sunucuda bulunamadı ve listeden kaldırıldı.").arg(missingCount));
+        return;
+    }
+    m_statusLabel->setText(QString("Tüm değişiklikler kaydedildi (%1 kayıt doğrulandı)").arg(confirmedCount));
 }
 
 void MainWindow::onFirestoreError(const QString& error)
@@ -893,13 +1224,9 @@ void MainWindow::onFirestoreError(const QString& error)
     qCCritical(dataLog) << "Error message:" << error;
     
     showLoadingState(false);
-    
-    // Clean up pending photo dialog if there's an error
-    if (m_pendingPhotoDialog) {
-        qCWarning(dataLog) << "Cleaning up pending photo dialog due to error";
-        m_pendingPhotoDialog->deleteLater();
-        m_pendingPhotoDialog = nullptr;
-    }
+    m_pendingEditStudentId.clear();
+    m_pendingFullFetches.clear();
+    m_exportPending = false;
     
     qCWarning(dataLog) << "Showing error dialog to user";
     QMessageBox::critical(this, "Firestore Hatası", error);
@@ -1121,134 +1448,93 @@ void MainWindow::populateFilterDropdowns()
     qCDebug(dataLog) << "Filter dropdowns populated - Fields:" << uniqueFields.size() << "Schools:" << uniqueSchools.size();
 }
 
-void MainWindow::filterStudents()
+StudentFilter MainWindow::currentFilter() const
 {
-    QString searchText = m_searchEdit->text().toLower();
-    qCDebug(dataLog) << "=== Filtering students ===";
-    qCDebug(dataLog) << "Search text:" << (searchText.isEmpty() ? "(empty)" : searchText);
-    qCDebug(dataLog) << "Total students to filter:" << m_allStudents.size();
-    
-    // Get filter criteria
-    QString nameFilter = m_nameFilterEdit ? m_nameFilterEdit->text().toLower() : "";
-    QString emailFilter = m_emailFilterEdit ? m_emailFilterEdit->text().toLower() : "";
-    QString fieldFilter = m_fieldFilterCombo ? m_fieldFilterCombo->currentData().toString() : "";
-    QString schoolFilter = m_schoolFilterCombo ? m_schoolFilterCombo->currentData().toString() : "";
-    int graduationFilter = m_graduationFilterCombo ? m_graduationFilterCombo->currentData().toInt() : -1;
+    StudentFilter filter;
+    filter.searchText = m_searchEdit->text().toLower();
+    filter.name = m_nameFilterEdit ? m_nameFilterEdit->text().toLower() : "";
+    filter.email = m_emailFilterEdit ? m_emailFilterEdit->text().toLower() : "";
+    filter.field = m_fieldFilterCombo ? m_fieldFilterCombo->currentData().toString() : "";
+    filter.school = m_schoolFilterCombo ? m_schoolFilterCombo->currentData().toString() : "";
+    filter.graduation = m_graduationFilterCombo ? m_graduationFilterCombo->currentData().toInt() : StudentFilter::AnyGraduation;
     int yearFrom = m_yearFromSpinBox ? m_yearFromSpinBox->value() : 0;
     int yearTo = m_yearToSpinBox ? m_yearToSpinBox->value() : 9999;
     
     // Handle special values for year range
-    if (yearFrom == 0) yearFrom = 1900; // Minimum reasonable year
-    if (yearTo == 9999) yearTo = 2100;  // Maximum reasonable year
-    
-    qCDebug(dataLog) << "Filter criteria - Name:" << nameFilter << "Email:" << emailFilter 
-                     << "Field:" << fieldFilter << "School:" << schoolFilter 
-                     << "Graduation:" << graduationFilter << "Year range:" << yearFrom << "-" << yearTo;
+    filter.yearFrom = (yearFrom == 0) ? StudentFilter::MinYear : yearFrom;
+    filter.yearTo = (yearTo == 9999) ? StudentFilter::MaxYear : yearTo;
+    return filter;
+}
+
+void MainWindow::filterStudents()
+{
+    StudentFilter filter = currentFilter();
+    qCDebug(dataLog) << "=== Filtering students ===";
+    qCDebug(dataLog) << "Search text:" << (filter.searchText.isEmpty() ? "(empty)" : filter.searchText);
+    qCDebug(dataLog) << "Total students to filter:" << m_allStudents.size();
     
-    m_filteredStudents.clear();
+    qCDebug(dataLog) << "Filter criteria - Name:" << filter.name << "Email:" << filter.email 
+                     << "Field:" << filter.field << "School:" << filter.school 
+                     << "Graduation:" << filter.graduation << "Year range:" << filter.yearFrom << "-" << filter.yearTo;
+    
+    // With a cold cache, ask Firestore for the matching slice instead of
+    // waiting for the whole collection; the reply goes through the same
+    // client-side pass in onQueryResultsReceived
+    bool hasServerCriteria = !filter.field.isEmpty() || !filter.school.isEmpty() ||
+                             filter.graduation != StudentFilter::AnyGraduation;
+    if (!m_datasetLoaded && hasServerCriteria) {
+        qCInfo(dataLog) << "Local dataset not loaded yet, running filter query on the server";
+        FirestoreQuery query = FirestoreQuery::fromStudentFilter(filter);
+        query.select(FirestoreService::listProjection());
+        m_firestoreService->runQuery(query, "filter");
+        return;
+    }
     
-    bool hasAnyFilter = !searchText.isEmpty() || !nameFilter.isEmpty() || !emailFilter.isEmpty() ||
-                       !fieldFilter.isEmpty() || !schoolFilter.isEmpty() || graduationFilter != -1 ||
-                       yearFrom > 1900 || yearTo < 2100;
+    applyFilter(m_allStudents, filter);
+}
+
+void MainWindow::applyFilter(const QList<Student>& students, const StudentFilter& filter)
+{
+    m_filteredStudents = filter.apply(students);
     
-    if (!hasAnyFilter) {
+    if (filter.isEmpty()) {
         qCDebug(dataLog) << "No filters applied - showing all students";
-        m_filteredStudents = m_allStudents;
     } else {
-        qCDebug(dataLog) << "Applying filters";
-        int matchCount = 0;
-        for (const Student& student : m_allStudents) {
-            bool matches = true;
-            
-            // Apply search text filter (searches across multiple fields)
-            if (!searchText.isEmpty()) {
-                bool searchMatches = student.getName().toLower().contains(searchText) ||
-                                   student.getEmail().toLower().contains(searchText) ||
-                                   student.getField().toLower().contains(searchText) ||
-                                   student.getSchool().toLower().contains(searchText) ||
-                                   student.getDescription().toLower().contains(searchText);
-                if (!searchMatches) {
-                    matches = false;
-                }
-            }
-            
-            // Apply specific field filters
-            if (matches && !nameFilter.isEmpty()) {
-                if (!student.getName().toLower().contains(nameFilter)) {
-                    matches = false;
-                }
-            }
-            
-            if (matches && !emailFilter.isEmpty()) {
-                if (!student.getEmail().toLower().contains(emailFilter)) {
-                    matches = false;
-                }
-            }
-            
-            if (matches && !fieldFilter.isEmpty()) {
-                if (student.getField() != fieldFilter) {
-                    matches = false;
-                }
-            }
-            
-            if (matches && !schoolFilter.isEmpty()) {
-                if (student.getSchool() != schoolFilter) {
-                    matches = false;
-                }
-            }
-            
-            if (matches && graduationFilter != -1) {
-                bool isGraduated = student.getGraduation();
-                QString school = student.getSchool();
-                bool didNotAttendUniversity = (school == "Üniversiteye gitmedi");
-                
-                if (graduationFilter == 1) {
-                    // Mezun - graduated from university
-                    if (!isGraduated || didNotAttendUniversity) {
-                        matches = false;
-                    }
-                } else if (graduationFilter == 0) {
-                    // Aktif (Devam Ediyor) - currently studying
-                    if (isGraduated || didNotAttendUniversity) {
-                        matches = false;
-                    }
-                } else if (graduationFilter == 2) {
-                    // Üniversiteye Gitmedi - didn't attend university
-                    if (!didNotAttendUniversity) {
-                        matches = false;
-                    }
-                }
-            }
-            
-            if (matches) {
-                int studentYear = student.getYear();
-                // Only apply year range filter if student attended university
-                bool didNotAttendUniversity = (student.getSchool() == "Üniversiteye gitmedi");
-                if (!didNotAttendUniversity && (studentYear < yearFrom || studentYear > yearTo)) {
-                    matches = false;
-                }
-            }
-            
-            if (matches) {
-                m_filteredStudents.append(student);
-                matchCount++;
-            }
-        }
-        qCInfo(dataLog) << "Filters applied - found" << matchCount << "matches out of" << m_allStudents.size() << "students";
+        qCInfo(dataLog) << "Filters applied - found" << m_filteredStudents.size() << "matches out of" << students.size() << "students";
     }
     
-    // Sort by lastUpdateTime in descending order (newest first)
-    std::sort(m_filteredStudents.begin(), m_filteredStudents.end(), 
-              [](const Student& a, const Student& b) {
-                  return a.getLastUpdateTime() > b.getLastUpdateTime();
-              });
-    
     qCDebug(dataLog) << "Filtered students count:" << m_filteredStudents.size();
     qCDebug(dataLog) << "Students sorted by lastUpdateTime (newest first)";
     qCDebug(dataLog) << "Populating table with filtered results";
     populateTable(m_filteredStudents);
 }
 
+void MainWindow::onQueryResultsReceived(const QString& tag, const QList<Student>& students)
+{
+    if (tag != "filter") {
+        return;
+    }
+    
+    if (m_datasetLoaded) {
+        // The full list arrived while the query was in flight; it already
+        // has been filtered locally
+        qCDebug(dataLog) << "Ignoring filter query results, local dataset is loaded";
+        return;
+    }
+    
+    qCInfo(dataLog) << "Server-side filter returned" << students.size() << "students";
+    applyFilter(students, currentFilter());
+}
+
+void MainWindow::onQueryFailed(const QString& tag, const QString& error)
+{
+    // Other tags belong to the change feed and the statistics dialog
+    if (tag != "filter") {
+        return;
+    }
+    onFirestoreError(error);
+}
+
 Student MainWindow::getStudentFromRow(int row) const
 {
     if (row < 0 || row >= m_studentsTable->rowCount()) {
@@ -1346,17 +1632,53 @@ void MainWindow::onSignOut()
             m_authService->signOut();
         }
         
+        // The local copy of the dataset belongs to the session
+        if (!m_snapshotPath.isEmpty()) {
+            QFile::remove(m_snapshotPath);
+            m_snapshotPath.clear();
+        }
+        
         // Close the application - user will need to authenticate again on next startup
         QApplication::quit();
     }
 }
 
+void MainWindow::onAuthTokenChanged()
+{
+    qCDebug(dataLog) << "Auth token changed, updating services";
+    m_firestoreService->setAuthToken(m_authService->getIdToken());
+    m_storageService->setAuthToken(m_authService->getIdToken());
+    
+    if (m_initialLoadPending) {
+        m_initialLoadPending = false;
+        setWindowTitle(QString("NEVRETEM-DER MBS - %1").arg(m_authService->getUserEmail()));
+        qCInfo(dataLog) << "Session resumed, triggering initial student data load";
+        onRefreshStudents();
+    }
+}
+
 void MainWindow::onDeferredUploadCompleted()
 {
     qCInfo(dataLog) << "Deferred photo upload completed, clearing pending dialog pointer";
     m_pendingPhotoDialog = nullptr;
 }
 
+void MainWindow::onInterruptedUploadFinished(const QString& storagePath, const QString& downloadUrl)
+{
+    // Photos are stored as student_photos/{id}.{ext}
+    QString studentId = QFileInfo(storagePath).completeBaseName();
+    if (!m_store->contains(studentId)) {
+        qCWarning(dataLog) << "Resumed upload finished for unknown student:" << storagePath;
+        return;
+    }
+    
+    qCInfo(dataLog) << "Resumed photo upload finished for student ID:" << studentId;
+    Student student = m_store->student(studentId);
+    student.setPhotoURL(downloadUrl);
+    student.setLastUpdateTime(QDateTime::currentDateTimeUtc());
+    m_outbox->enqueueSet(student);
+}
+
 void MainWindow::onImageLoaded(const QString& imageUrl, const QByteArray& imageData)
 {
     qCDebug(dataLog) << "Image loaded successfully for URL:" << imageUrl;
@@ -1446,243 +1768,344 @@ void MainWindow::onImageLoadFailed(const QString& imageUrl, const QString& error
     }
 }
 
-void MainWindow::onExportToExcel()
+void MainWindow::onExportStudents()
 {
     // Get the list to export (filtered or all)
     const QList<Student>& studentsToExport = m_filteredStudents.isEmpty() ? m_allStudents : m_filteredStudents;
     
     if (studentsToExport.isEmpty()) {
-        QMessageBox::information(this, "Excel'e Aktar", "Aktarılacak mezun verisi bulunamadı.");
+        QMessageBox::information(this, "Dışa Aktar", "Aktarılacak mezun verisi bulunamadı.");
         return;
     }
     
-    // Get file path from user
+    // The table is loaded with a field mask; the export includes descriptions,
+    // so reload the full documents first and come back here when they arrive
+    bool hasPartial = std::any_of(studentsToExport.begin(), studentsToExport.end(),
+                                  [](const Student& student) { return student.isPartial(); });
+    if (hasPartial) {
+        qCInfo(dataLog) << "Export needs full documents, reloading without field mask";
+        m_exportPending = true;
+        showLoadingState(true);
+        m_firestoreService->getAllStudentsPartitioned(m_loadPartitions);
+        return;
+    }
+    
+    // Get file path and format from user; the formats on offer depend on the build
+    QStringList filters;
+    const QList<StudentWriter::Format> formats = StudentWriter::availableFormats();
+    for (StudentWriter::Format format : formats) {
+        filters.append(StudentWriter::fileFilter(format));
+    }
     QString defaultFileName = QString("mezunlar_%1.xlsx")
         .arg(QDateTime::currentDateTime().toString("yyyy-MM-dd_HHmmss"));
     
+    QString selectedFilter;
     QString filePath = QFileDialog::getSaveFileName(this,
-        "Excel'e Aktar",
+        "Dışa Aktar",
         defaultFileName,
-        "Excel Dosyaları (*.xlsx);;Tüm Dosyalar (*)");
+        filters.join(";;"),
+        &selectedFilter);
     
     if (filePath.isEmpty()) {
         return; // User cancelled
     }
     
-    // Create Excel document
-    Document xlsx;
-    
-    // Create header format (bold, centered, with background color)
-    Format headerFormat;
-    headerFormat.setFontBold(true);
-    headerFormat.setHorizontalAlignment(Format::AlignHCenter);
-    headerFormat.setVerticalAlignment(Format::AlignVCenter);
-    headerFormat.setPatternBackgroundColor(QColor(79, 129, 189)); // Blue background
-    headerFormat.setFontColor(QColor(Qt::white));
-    headerFormat.setBorderStyle(Format::BorderThin);
-    
-    // Write header row
-    xlsx.write(1, 1, "Ad", headerFormat);
-    xlsx.write(1, 2, "E-posta", headerFormat);
-    xlsx.write(1, 3, "Açıklama", headerFormat);
-    xlsx.write(1, 4, "Alan", headerFormat);
-    xlsx.write(1, 5, "Okul", headerFormat);
-    xlsx.write(1, 6, "Numara", headerFormat);
-    xlsx.write(1, 7, "Lise Mezuniyet Yılı", headerFormat);
-    xlsx.write(1, 8, "Üniversite Mezun Durumu", headerFormat);
-    
-    // Create cell format for data
-    Format dataFormat;
-    dataFormat.setBorderStyle(Format::BorderThin);
-    dataFormat.setVerticalAlignment(Format::AlignVCenter);
-    
-    // Create format for centered columns (year, graduation)
-    Format centerFormat;
-    centerFormat.setBorderStyle(Format::BorderThin);
-    centerFormat.setHorizontalAlignment(Format::AlignHCenter);
-    centerFormat.setVerticalAlignment(Format::AlignVCenter);
-    
-    // Write student data
-    int row = 2; // Start from row 2 (after header)
-    for (const Student& student : studentsToExport) {
-        QString graduationStatus = student.getGraduation() ? "Evet" : "Hayır";
-        
-        xlsx.write(row, 1, student.getName(), dataFormat);
-        xlsx.write(row, 2, student.getEmail(), dataFormat);
-        xlsx.write(row, 3, student.getDescription(), dataFormat);
-        xlsx.write(row, 4, student.getField(), dataFormat);
-        xlsx.write(row, 5, student.getSchool(), dataFormat);
-        xlsx.write(row, 6, student.getNumber(), centerFormat);
-        xlsx.write(row, 7, student.getYear(), centerFormat);
-        xlsx.write(row, 8, graduationStatus, centerFormat);
-        
-        row++;
-    }
-    
-    // Auto-fit columns
-    xlsx.setColumnWidth(1, 20);  // Ad
-    xlsx.setColumnWidth(2, 30);  // E-posta
-    xlsx.setColumnWidth(3, 40);  // Açıklama
-    xlsx.setColumnWidth(4, 20);  // Alan
-    xlsx.setColumnWidth(5, 25);  // Okul
-    xlsx.setColumnWidth(6, 15);  // Numara
-    xlsx.setColumnWidth(7, 20);  // Lise Mezuniyet Yılı
-    xlsx.setColumnWidth(8, 25);  // Üniversite Mezun Durumu
-    
-    // Save the document
-    if (xlsx.saveAs(filePath)) {
-        int exportedCount = studentsToExport.size();
+    // A known suffix wins; otherwise the chosen filter decides and adds its suffix
+    StudentWriter::Format format = formats.value(qMax(0, filters.indexOf(selectedFilter)));
+    StudentWriter::Format suffixFormat = StudentWriter::formatForPath(filePath);
+    if (QFileInfo(filePath).suffix().compare(StudentWriter::suffix(suffixFormat), Qt::CaseInsensitive) == 0
+        && formats.contains(suffixFormat)) {
+        format = suffixFormat;
+    } else {
+        filePath += "." + StudentWriter::suffix(format);
+    }
+    
+    if (m_exporter->isRunning()) {
+        QMessageBox::information(this, "Dışa Aktar", "Dışa aktarma zaten devam ediyor.");
+        return;
+    }
+    
+    // Rows are written on a worker thread; the dialog follows its progress
+    QProgressDialog* progress = new QProgressDialog("Dosya yazılıyor...", "İptal", 0, studentsToExport.size(), this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(500);
+    progress->setAutoClose(false);
+    progress->setAutoReset(false);
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+    
+    connect(progress, &QProgressDialog::canceled, m_exporter, &StudentExporter::cancel);
+    connect(m_exporter, &StudentExporter::progress, progress, &QProgressDialog::setValue);
+    connect(m_exporter, &StudentExporter::finished, progress, [this, progress](int exportedCount, const QString& filePath) {
+        progress->close();
         QMessageBox::information(this, "Başarılı", 
-            QString("%1 mezun başarıyla Excel dosyasına aktarıldı.\n\nDosya: %2")
+            QString("%1 mezun başarıyla dosyaya aktarıldı.\n\nDosya: %2")
                 .arg(exportedCount)
                 .arg(filePath));
         
         qCInfo(dataLog) << "Exported" << exportedCount << "students to" << filePath;
-    } else {
-        QMessageBox::critical(this, "Hata", "Excel dosyası oluşturulamadı.");
-        qCWarning(dataLog) << "Failed to save Excel file:" << filePath;
-    }
+    });
+    connect(m_exporter, &StudentExporter::failed, progress, [this, progress, filePath](const QString& error) {
+        progress->close();
+        QMessageBox::critical(this, "Hata", QString("Dosya oluşturulamadı.\n\n%1").arg(error));
+        qCWarning(dataLog) << "Failed to save export file:" << filePath << error;
+    });
+    connect(m_exporter, &StudentExporter::cancelled, progress, &QProgressDialog::close);
+    
+    m_exporter->start(studentsToExport, filePath, format);
 }
 
-void MainWindow::onImportFromExcel()
+void MainWindow::onImportStudents()
 {
-    // Ask user for confirmation
-    QMessageBox::StandardButton reply = QMessageBox::question(this,
-        "Excel'den İçe Aktar",
-        "Excel dosyasından mezun verilerini içe aktarmak istiyor musunuz?\n\n"
-        "Not: Fotoğraflar içe aktarılmayacak. Var olan kayıtlar güncellenmeyecek, yalnızca yeni kayıtlar eklenecektir.",
-        QMessageBox::Yes | QMessageBox::No);
-    
-    if (reply != QMessageBox::Yes) {
+    // Ask user for confirmation and whether existing records are updated
+    QMessageBox box(this);
+    box.setWindowTitle("İçe Aktar");
+    box.setIcon(QMessageBox::Question);
+    box.setText("Excel veya CSV dosyasından mezun verilerini içe aktarmak istiyor musunuz?\n\n"
+                "Not: Fotoğraflar içe aktarılmayacak. Var olan kayıtlarla aynı satırlar atlanır. "
+                "Güncelleme seçilirse var olan kayıtların yalnızca değişen alanları güncellenir.");
+    QPushButton* addOnlyButton = box.addButton("Yalnızca Yeni Kayıtlar", QMessageBox::AcceptRole);
+    QPushButton* upsertButton = box.addButton("Yeni Kayıtlar ve Güncelleme", QMessageBox::AcceptRole);
+    box.addButton(QMessageBox::Cancel);
+    box.setDefaultButton(addOnlyButton);
+    box.exec();
+    
+    if (box.clickedButton() != addOnlyButton && box.clickedButton() != upsertButton) {
         return;
     }
+    StudentImporter::Mode mode = box.clickedButton() == upsertButton ? StudentImporter::Upsert : StudentImporter::AddOnly;
     
     // Get file path from user
     QString filePath = QFileDialog::getOpenFileName(this,
-        "Excel'den İçe Aktar",
+        "İçe Aktar",
         "",
-        "Excel Dosyaları (*.xlsx);;Tüm Dosyalar (*)");
+        "Tablo Dosyaları (*.xlsx *.csv);;Excel Dosyaları (*.xlsx);;CSV Dosyaları (*.csv);;Tüm Dosyalar (*)");
     
     if (filePath.isEmpty()) {
         return; // User cancelled
     }
     
-    // Open Excel document
-    Document xlsx(filePath);
-    if (!xlsx.load()) {
-        QMessageBox::critical(this, "Hata", "Excel dosyası açılamadı veya geçersiz format.");
+    if (m_importer->isRunning()) {
+        QMessageBox::information(this, "İçe Aktar", "İçe aktarma zaten devam ediyor.");
         return;
     }
-    
-    int importedCount = 0;
-    int errorCount = 0;
-    QStringList errors;
-    
-    // Get the dimension of the data
-    CellRange dimension = xlsx.dimension();
-    int lastRow = dimension.lastRow();
-    
-    if (lastRow < 2) {
-        QMessageBox::warning(this, "Hata", "Excel dosyası boş veya yalnızca başlık satırı içeriyor.");
+    // Rows are checked against the loaded students; with a partial list the
+    // ones not loaded yet would be added again
+    if (!m_datasetLoaded) {
+        QMessageBox::information(this, "İçe Aktar",
+                                 "Mezun listesi tamamen yüklendikten sonra tekrar deneyin.");
         return;
     }
     
-    // Read data starting from row 2 (skip header)
-    for (int row = 2; row <= lastRow; row++) {
-        // Read cell values using the read method (simpler and more reliable)
-        QString name = xlsx.read(row, 1).toString().trimmed();
-        QString email = xlsx.read(row, 2).toString().trimmed();
-        QString description = xlsx.read(row, 3).toString().trimmed();
-        QString field = xlsx.read(row, 4).toString().trimmed();
-        QString school = xlsx.read(row, 5).toString().trimmed();
-        QString number = xlsx.read(row, 6).toString().trimmed();
-        
-        // Skip completely empty rows
-        if (name.isEmpty() && email.isEmpty() && field.isEmpty()) {
-            continue;
+    // Rows are read and checked on worker threads; accepted students reach
+    // the outbox chunk by chunk through studentsParsed
+    QProgressDialog* progress = new QProgressDialog("Dosya okunuyor...", "İptal", 0, 0, this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(500);
+    progress->setAutoClose(false);
+    progress->setAutoReset(false);
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+    
+    connect(progress, &QProgressDialog::canceled, m_importer, &StudentImporter::cancel);
+    connect(m_importer, &StudentImporter::progress, progress, [progress](int rowsRead, int totalRows) {
+        // The row count comes from the sheet's dimension and may be missing
+        if (totalRows > 0) {
+            progress->setMaximum(qMax(totalRows, rowsRead));
+            progress->setValue(rowsRead);
         }
+    });
+    connect(m_importer, &StudentImporter::finished, progress,
+            [this, progress, filePath, mode](int importedCount, int unchangedCount, int changedCount,
+                                       const QStringList& errors, bool cancelled) {
+        progress->close();
         
-        // Validate required fields (only name is required)
-        if (name.isEmpty()) {
-            errors.append(QString("Satır %1: Ad zorunludur").arg(row));
-            errorCount++;
-            continue;
+        // Show results
+        int errorCount = errors.size();
+        QString message = QString("%1 mezun başarıyla içe aktarıldı.").arg(importedCount);
+        if (unchangedCount > 0) {
+            message += QString("\n%1 satır mevcut kayıtlarla aynı olduğu için atlandı.").arg(unchangedCount);
         }
-        
-        // Parse year
-        QVariant yearValue = xlsx.read(row, 7);
-        bool yearOk = false;
-        int year = 0;
-        
-        if (yearValue.typeId() == QMetaType::Int || yearValue.typeId() == QMetaType::LongLong || 
-            yearValue.typeId() == QMetaType::Double) {
-            year = yearValue.toInt(&yearOk);
-        } else if (!yearValue.toString().isEmpty()) {
-            year = yearValue.toString().toInt(&yearOk);
+        if (changedCount > 0 && mode == StudentImporter::Upsert) {
+            message += QString("\n%1 mevcut kaydın değişen alanları güncellendi.").arg(changedCount);
+        } else if (changedCount > 0) {
+            message += QString("\n%1 satır mevcut kayıtlardan farklı; bu kayıtlar güncellenmedi.").arg(changedCount);
         }
-        
-        if (!yearOk || year == 0) {
-            errors.append(QString("Satır %1: Geçersiz yıl değeri").arg(row));
-            errorCount++;
-            continue;
+        if (cancelled) {
+            message += "\n\nİçe aktarma iptal edildi; kalan satırlar okunmadı.";
         }
-        
-        // Parse graduation status
-        QVariant graduationValue = xlsx.read(row, 8);
-        bool graduation = false;
-        
-        if (graduationValue.isNull() || graduationValue.toString().isEmpty()) {
-            errors.append(QString("Satır %1: Mezuniyet durumu zorunludur").arg(row));
-            errorCount++;
-            continue;
+        if (errorCount > 0) {
+            message += QString("\n\n%1 satırda hata oluştu:").arg(errorCount);
+            if (errors.size() <= 10) {
+                message += "\n" + errors.join("\n");
+            } else {
+                message += "\n" + errors.mid(0, 10).join("\n");
+                message += QString("\n... ve %1 hata daha").arg(errors.size() - 10);
+            }
         }
         
-        QString graduationStr = graduationValue.toString().toLower().trimmed();
-        if (graduationStr == "evet" || graduationStr == "yes" || graduationStr == "true" || graduationStr == "1") {
-            graduation = true;
-        } else if (graduationStr == "hayır" || graduationStr == "no" || graduationStr == "false" || graduationStr == "0") {
-            graduation = false;
+        // Re-importing a sheet that is already in is a success too
+        int matchedCount = importedCount + unchangedCount + changedCount;
+        if (matchedCount > 0 && errorCount == 0 && !cancelled) {
+            QMessageBox::information(this, "Başarılı", message);
+        } else if (matchedCount > 0) {
+            QMessageBox::warning(this, "Kısmen Başarılı", message);
         } else {
-            errors.append(QString("Satır %1: Geçersiz mezuniyet durumu: %2 (Evet/Hayır bekleniyor)")
-                .arg(row).arg(graduationStr));
-            errorCount++;
-            continue;
+            QMessageBox::critical(this, "Başarısız", message);
         }
         
-        // Create student object (ID will be assigned by Firestore)
-        Student student("", name, email, description, field, school, number, year, graduation, "");
-        
-        // Add student to Firestore
-        m_firestoreService->addStudent(student);
-        importedCount++;
+        qCInfo(dataLog) << "Imported" << importedCount << "students from" << filePath 
+                        << "with" << errorCount << "errors;" << unchangedCount << "unchanged,"
+                        << changedCount << (mode == StudentImporter::Upsert ? "updated" : "changed rows skipped");
+    });
+    connect(m_importer, &StudentImporter::failed, progress, [this, progress](const QString& error) {
+        progress->close();
+        QMessageBox::critical(this, "Hata", error);
+    });
+    
+    m_importer->start(filePath, m_store->students(), mode);
+}
+
+void MainWindow::onImportPhotos()
+{
+    if (m_photoImporter->isRunning()) {
+        QMessageBox::information(this, "Fotoğraf Aktarımı", "Fotoğraf aktarımı zaten devam ediyor.");
+        return;
+    }
+    // A dialog waiting for its deferred upload takes any finished upload as its own
+    if (m_pendingPhotoDialog) {
+        QMessageBox::information(this, "Yükleme Devam Ediyor",
+                                 "Lütfen mevcut fotoğraf yüklemesinin tamamlanmasını bekleyin.");
+        return;
+    }
+    
+    QString directory = QFileDialog::getExistingDirectory(this, "Fotoğraf Klasörü Seç");
+    if (directory.isEmpty()) {
+        return; // User cancelled
+    }
+    
+    PhotoImporter::Plan plan = m_photoImporter->scan(directory);
+    
+    QString summary = QString("%1 fotoğraf mezunlarla eşleşti.").arg(plan.matches.size());
+    if (!plan.alreadyImported.isEmpty()) {
+        summary += QString("\n%1 fotoğraf daha önce aktarılmış, atlanacak.").arg(plan.alreadyImported.size());
+    }
+    if (!plan.unmatched.isEmpty()) {
+        summary += QString("\n%1 dosya hiçbir mezunla eşleşmedi.").arg(plan.unmatched.size());
+    }
+    if (!plan.ambiguous.isEmpty()) {
+        summary += QString("\n%1 dosya birden fazla eşleşme nedeniyle atlanacak.").arg(plan.ambiguous.size());
+    }
+    
+    QStringList details;
+    for (const QString& filePath : plan.unmatched) {
+        details.append(QString("Eşleşmedi: %1").arg(QFileInfo(filePath).fileName()));
+    }
+    for (const QString& filePath : plan.ambiguous) {
+        details.append(QString("Belirsiz: %1").arg(QFileInfo(filePath).fileName()));
+    }
+    
+    QMessageBox box(this);
+    box.setWindowTitle("Klasörden Fotoğraf Aktar");
+    box.setDetailedText(details.join("\n"));
+    if (plan.matches.isEmpty()) {
+        box.setIcon(QMessageBox::Information);
+        box.setText(summary + "\n\nYüklenecek fotoğraf yok.");
+        box.exec();
+        return;
     }
+    box.setIcon(QMessageBox::Question);
+    box.setText(summary + "\n\nEşleşen fotoğraflar yüklensin mi? Mevcut fotoğrafların yerini alacaklar.");
+    box.setStandardButtons(QMessageBox::Yes | QMessageBox::No);
+    if (box.exec() != QMessageBox::Yes) {
+        return;
+    }
+    
+    QProgressDialog* progress = new QProgressDialog("Fotoğraflar yükleniyor...", "İptal", 0, plan.matches.size(), this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(0);
+    progress->setAutoClose(false);
+    progress->setAutoReset(false);
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+    
+    connect(progress, &QProgressDialog::canceled, m_photoImporter, &PhotoImporter::cancel);
+    connect(m_photoImporter, &PhotoImporter::progress, progress, [progress](int done, int total) {
+        progress->setMaximum(total);
+        progress->setValue(done);
+        progress->setLabelText(QString("Fotoğraflar yükleniyor... (%1/%2)").arg(done).arg(total));
+    });
     
-    // Show results
-    QString message = QString("%1 mezun başarıyla içe aktarıldı.").arg(importedCount);
-    if (errorCount > 0) {
-        message += QString("\n\n%1 satırda hata oluştu:").arg(errorCount);
-        if (errors.size() <= 10) {
-            message += "\n" + errors.join("\n");
+    auto failures = std::make_shared<QStringList>();
+    connect(m_photoImporter, &PhotoImporter::photoFailed, progress, [failures](const QString& filePath, const QString& error) {
+        failures->append(QString("%1: %2").arg(QFileInfo(filePath).fileName(), error));
+    });
+    connect(m_photoImporter, &PhotoImporter::finished, progress, [this, progress, failures](int imported, int failed) {
+        progress->close();
+        m_statusLabel->setText(QString("%1 fotoğraf aktarıldı").arg(imported));
+        
+        QString message = QString("%1 fotoğraf başarıyla aktarıldı.").arg(imported);
+        if (failed > 0) {
+            message += QString("\n\n%1 fotoğraf aktarılamadı:").arg(failed);
+            message += "\n" + failures->mid(0, 10).join("\n");
+            if (failures->size() > 10) {
+                message += QString("\n... ve %1 hata daha").arg(failures->size() - 10);
+            }
+            QMessageBox::warning(this, "Kısmen Başarılı", message);
         } else {
-            message += "\n" + errors.mid(0, 10).join("\n");
-            message += QString("\n... ve %1 hata daha").arg(errors.size() - 10);
+            QMessageBox::information(this, "Başarılı", message);
         }
+    });
+    
+    m_photoImporter->start(plan.matches);
+}
+
+void MainWindow::onCleanOrphanPhotos()
+{
+    if (m_photoCollector->isRunning()) {
+        QMessageBox::information(this, "Fotoğraf Temizliği", "Fotoğraf temizliği zaten devam ediyor.");
+        return;
+    }
+    // With a partial list, the photos of students not loaded yet would look orphaned
+    if (!m_datasetLoaded) {
+        QMessageBox::information(this, "Fotoğraf Temizliği",
+                                 "Mezun listesi tamamen yüklendikten sonra tekrar deneyin.");
+        return;
     }
     
-    if (importedCount > 0 && errorCount == 0) {
-        QMessageBox::information(this, "Başarılı", message);
-    } else if (importedCount > 0 && errorCount > 0) {
-        QMessageBox::warning(this, "Kısmen Başarılı", message);
-    } else {
-        QMessageBox::critical(this, "Başarısız", message);
+    m_statusLabel->setText("Sahipsiz fotoğraflar aranıyor...");
+    m_photoCollector->scan();
+}
+
+void MainWindow::onOrphanScanFinished(const QStringList& orphans, int scannedCount)
+{
+    m_statusLabel->setText("Hazır");
+    
+    if (orphans.isEmpty()) {
+        QMessageBox::information(this, "Fotoğraf Temizliği",
+                                 QString("%1 fotoğraf tarandı, sahipsiz fotoğraf bulunamadı.").arg(scannedCount));
+        return;
     }
     
-    qCInfo(dataLog) << "Imported" << importedCount << "students from" << filePath 
-                    << "with" << errorCount << "errors";
+    QMessageBox box(this);
+    box.setWindowTitle("Fotoğraf Temizliği");
+    box.setIcon(QMessageBox::Question);
+    box.setText(QString("%1 fotoğraf tarandı, %2 tanesi hiçbir mezuna ait değil.\n\n"
+                        "Sahipsiz fotoğraflar silinsin mi?").arg(scannedCount).arg(orphans.size()));
+    box.setDetailedText(orphans.join("\n"));
+    box.setStandardButtons(QMessageBox::Yes | QMessageBox::No);
+    if (box.exec() != QMessageBox::Yes) {
+        return;
+    }
     
-    // Refresh the table to show newly imported students
-    if (importedCount > 0) {
-        onRefreshStudents();
+    m_photoCollector->deleteOrphans(orphans);
+}
+
+void MainWindow::onOrphanDeleteFinished(int deletedCount, const QStringList& failedPaths)
+{
+    m_statusLabel->setText(QString("%1 sahipsiz fotoğraf silindi").arg(deletedCount));
+    
+    if (!failedPaths.isEmpty()) {
+        QMessageBox::warning(this, "Kısmen Başarılı",
+                             QString("%1 fotoğraf silindi, %2 fotoğraf silinemedi.")
+                                 .arg(deletedCount).arg(failedPaths.size()));
     }
 }
 
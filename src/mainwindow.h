@@ -23,12 +23,21 @@
 #include <QFrame>
 #include <QToolButton>
 #include <QLoggingCategory>
+#include <QTimer>
 
 #include "student.h"
+#include "studentfilter.h"
 
 Q_DECLARE_LOGGING_CATEGORY(dataLog)
 #include "firestoreservice.h"
+#include "studentstore.h"
+#include "changefeed.h"
+#include "writeoutbox.h"
 #include "firebasestorageservice.h"
+#include "photoimporter.h"
+#include "photogarbagecollector.h"
+#include "studentexporter.h"
+#include "studentimporter.h"
 #include "studentdialog.h"
 #include "firebaseauthservice.h"
 #include "updatechecker.h"
@@ -64,13 +73,26 @@ private slots:
     
     // Firestore service slots
     void onStudentsReceived(const QList<Student>& students);
-    void onStudentAdded(const Student& student);
-    void onStudentUpdated(const Student& student);
-    void onStudentDeleted(const QString& studentId);
+    void onStudentsPartitionReceived(const QList<Student>& students);
+    void onStudentReceived(const Student& student);
+    void onQueryResultsReceived(const QString& tag, const QList<Student>& students);
     void onFirestoreError(const QString& error);
+    void onQueryFailed(const QString& tag, const QString& error);
+    void scheduleStoreRefresh();
+    void onStoreChanged();
+    void onRemoteChangesApplied(int changedCount, int removedCount);
+    
+    // Outbox slots
+    void onPendingWritesChanged(int count);
+    void onWriteCommitted(const QString& studentId, WriteOutbox::Operation operation);
+    void onWriteRejected(const QString& studentId, const QString& error);
+    void onWriteConflict(WriteOutbox::Operation operation, const Student& local, const Student& server,
+                         const QStringList& fields);
+    void onWritesReconciled(int confirmedCount, int missingCount);
     
     // Authentication slots
     void onSignOut();
+    void onAuthTokenChanged();
     
     // Image loading slots
     void onImageLoaded(const QString& imageUrl, const QByteArray& imageData);
@@ -78,10 +100,20 @@ private slots:
     
     // Deferred photo upload slot
     void onDeferredUploadCompleted();
+    void onInterruptedUploadFinished(const QString& storagePath, const QString& downloadUrl);
+    
+    // Photo cleanup after deletes
+    void flushPhotoDeletes();
+    void onPhotoFilesListed(const QString& tag, const QStringList& storagePaths, bool finished);
+    void onPhotoFilesDeleted(const QString& tag, const QStringList& deletedPaths, const QStringList& failedPaths);
     
-    // Excel import/export slots
-    void onExportToExcel();
-    void onImportFromExcel();
+    // Import/export slots (Excel, CSV, Arrow/Parquet)
+    void onExportStudents();
+    void onImportStudents();
+    void onImportPhotos();
+    void onCleanOrphanPhotos();
+    void onOrphanScanFinished(const QStringList& orphans, int scannedCount);
+    void onOrphanDeleteFinished(int deletedCount, const QStringList& failedPaths);
     void onShowStatistics();
     
     // Update checker slots
@@ -102,9 +134,13 @@ private:
     void updateStudentDetails(const Student& student);
     void clearStudentDetails();
     void filterStudents();
+    StudentFilter currentFilter() const;
+    void applyFilter(const QList<Student>& students, const StudentFilter& filter);
     Student getStudentFromRow(int row) const;
     int findStudentRow(const QString& studentId) const;
     void showLoadingState(bool loading);
+    void openEditDialog(const Student& student);
+    void requestFullStudent(const QString& studentId);
     void loadStudentPhoto(QLabel* photoLabel, const QString& photoUrl);
     void loadStudentDetailsPhoto(const QString& photoUrl);
     
@@ -160,8 +196,18 @@ private:
     // Data
     QList<Student> m_allStudents;
     QList<Student> m_filteredStudents;
+    StudentStore* m_store; // Source of truth; m_allStudents is its snapshot for the view
     FirestoreService* m_firestoreService;
+    ChangeFeed* m_changeFeed;
+    WriteOutbox* m_outbox; // Local edits waiting to reach Firestore
+    bool m_autoRefresh; // [application] autoRefresh in config.ini
+    int m_loadPartitions; // [firestore] loadPartitions: concurrent ranges for full loads
+    QTimer* m_storeRefreshTimer; // Coalesces store changes into one table rebuild
     FirebaseStorageService* m_storageService;
+    PhotoImporter* m_photoImporter; // Bulk photo import from a folder
+    PhotoGarbageCollector* m_photoCollector; // Finds photos no student refers to
+    StudentExporter* m_exporter; // Streams exports on a worker thread
+    StudentImporter* m_importer; // Reads and validates imports off the GUI thread
     FirebaseAuthService* m_authService;
     UpdateChecker* m_updateChecker;
     
@@ -169,14 +215,28 @@ private:
     QHash<QString, QLabel*> m_photoLabels; // URL -> QLabel mapping for image loading
     QString m_currentDetailsPhotoUrl; // Track current details panel photo URL
     StudentDialog* m_pendingPhotoDialog; // For deferred photo upload
+    QHash<QString, QString> m_photoDeletePaths; // Student ID -> photo to remove once the delete commits ("" = none)
+    QStringList m_photoDeleteQueue; // Sent together with the next flushPhotoDeletes()
+    
+    // Two-phase loading: the table is filled from a field-masked list and
+    // full documents are fetched lazily when a row is selected or edited
+    QSet<QString> m_pendingFullFetches; // Student IDs with a getStudent in flight
+    QString m_pendingEditStudentId; // Edit dialog waiting for the full document
+    bool m_exportPending; // Export waiting for an unmasked reload
+    bool m_datasetLoaded; // False until the first full list arrives (cold cache)
+    QString m_snapshotPath; // Store contents of the last session, shown before sign-in completes
+    bool m_initialLoadPending; // Saved session still being resumed; load when the token arrives
+    bool m_uploadsResumed; // Photo uploads cut off in the last run were picked up
     
     // Actions
     QAction* m_exitAction;
     QAction* m_aboutAction;
     QAction* m_settingsAction;
     QAction* m_signOutAction;
-    QAction* m_exportExcelAction;
-    QAction* m_importExcelAction;
+    QAction* m_exportAction;
+    QAction* m_importAction;
+    QAction* m_importPhotosAction;
+    QAction* m_cleanPhotosAction;
     QAction* m_statisticsAction;
     QAction* m_checkUpdatesAction;
 };
@@ -0,0 +1,111 @@
+#include "networkaccess.h"
+#include <QCoreApplication>
+#include <QSslConfiguration>
+#include <QSslSocket>
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(networkLog)
+
+namespace {
+QNetworkAccessManager* s_manager = nullptr;
+QString s_originOverride;
+
+// Indexed by NetworkAccess::Service
+const char* const GoogleHosts[] = {
+    "firestore.googleapis.com",
+    "firebasestorage.googleapis.com",
+    "identitytoolkit.googleapis.com",
+    "securetoken.googleapis.com"
+};
+}
+
+QNetworkAccessManager* NetworkAccess::shared()
+{
+    if (!s_manager) {
+        // Owned by the application so it outlives every service
+        s_manager = new QNetworkAccessManager(QCoreApplication::instance());
+        qCInfo(networkLog) << "Shared network access manager created";
+    }
+    return s_manager;
+}
+
+QString NetworkAccess::origin(Service service)
+{
+    if (!s_originOverride.isEmpty()) {
+        return s_originOverride;
+    }
+    return QString("https://%1").arg(QString::fromLatin1(GoogleHosts[service]));
+}
+
+void NetworkAccess::setOriginOverride(const QString& origin)
+{
+    // Paths are appended with a leading slash
+    s_originOverride = origin;
+    while (s_originOverride.endsWith('/')) {
+        s_originOverride.chop(1);
+    }
+    if (!s_originOverride.isEmpty()) {
+        qCWarning(networkLog) << "Firebase requests go to" << s_originOverride << "instead of the Google hosts";
+    }
+}
+
+bool NetworkAccess::hasOriginOverride()
+{
+    return !s_originOverride.isEmpty();
+}
+
+void NetworkAccess::prewarm()
+{
+    if (hasOriginOverride()) {
+        return;
+    }
+    if (!QSslSocket::supportsSsl()) {
+        qCWarning(networkLog) << "TLS not available, skipping connection pre-warming";
+        return;
+    }
+    
+    // Offer h2 during the handshake so the warmed connection is the one
+    // HTTP/2 requests will reuse
+    QSslConfiguration sslConfig = QSslConfiguration::defaultConfiguration();
+    sslConfig.setAllowedNextProtocols({QSslConfiguration::ALPNProtocolHTTP2,
+                                       QSslConfiguration::NextProtocolHttp1_1});
+    
+    for (const char* host : GoogleHosts) {
+        qCDebug(networkLog) << "Pre-warming connection to" << host;
+        shared()->connectToHostEncrypted(QString::fromLatin1(host), 443, sslConfig);
+    }
+}
+
+void NetworkAccess::prepare(QNetworkRequest& request, int transferTimeoutMs)
+{
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+    request.setTransferTimeout(transferTimeoutMs);
+}
+
+bool NetworkAccess::isUnauthorized(QNetworkReply* reply)
+{
+    return reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 401;
+}
+
+QNetworkReply* NetworkAccess::resend(QNetworkReply* reply, const QByteArray& body, const QString& authToken)
+{
+    QNetworkRequest request = reply->request();
+    request.setRawHeader("Authorization", QString("Bearer %1").arg(authToken).toUtf8());
+    
+    switch (reply->operation()) {
+    case QNetworkAccessManager::HeadOperation:
+        return shared()->head(request);
+    case QNetworkAccessManager::PostOperation:
+        return shared()->post(request, body);
+    case QNetworkAccessManager::PutOperation:
+        return shared()->put(request, body);
+    case QNetworkAccessManager::DeleteOperation:
+        return shared()->deleteResource(request);
+    case QNetworkAccessManager::CustomOperation:
+        // sendCustomRequest() records the verb on the request
+        return shared()->sendCustomRequest(request, request.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray(), body);
+    case QNetworkAccessManager::GetOperation:
+    default:
+        return shared()->get(request);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef NETWORKACCESS_H
+#define NETWORKACCESS_H
+
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+
+/**
+ * NetworkAccess - The application's single QNetworkAccessManager
+ *
+ * All Firebase services send their requests through one manager so they
+ * share its connection pool: one TLS handshake and one HTTP/2 connection per
+ * host, multiplexing Firestore, Storage and Auth requests. Because every
+ * service uses the same manager, replies must be handled through their own
+ * QNetworkReply::finished signal rather than QNetworkAccessManager::finished.
+ */
+class NetworkAccess
+{
+public:
+    enum Service {
+        Firestore,
+        Storage,
+        IdentityToolkit,
+        SecureToken
+    };
+    
+    static QNetworkAccessManager* shared();
+    
+    // Scheme and host the service's requests go to, e.g.
+    // "https://firestore.googleapis.com". An origin override sends every
+    // service to one server instead, such as the local FirebaseStandIn;
+    // set it before the services are configured.
+    static QString origin(Service service);
+    static void setOriginOverride(const QString& origin);
+    static bool hasOriginOverride();
+    
+    // Opens TLS connections (ALPN h2) to the Google hosts in the background,
+    // so the first real request does not pay for DNS, TCP and the handshake.
+    // Does nothing with an origin override.
+    static void prewarm();
+    
+    // Common request settings: HTTP/2 allowed and a transfer timeout
+    static void prepare(QNetworkRequest& request, int transferTimeoutMs = DefaultTransferTimeout);
+    
+    // True when the server refused the request's ID token (HTTP 401)
+    static bool isUnauthorized(QNetworkReply* reply);
+    
+    // Sends the reply's request again, with the same method and body, under a
+    // new bearer token
+    static QNetworkReply* resend(QNetworkReply* reply, const QByteArray& body, const QString& authToken);
+    
+    static const int DefaultTransferTimeout = 60000;
+
+private:
+    NetworkAccess() = delete;
+};
+
+#endif // NETWORKACCESS_H
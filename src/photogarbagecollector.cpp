@@ -0,0 +1,237 @@
+#include "photogarbagecollector.h"
+#include "firebasestorageservice.h"
+#include "firestoreservice.h"
+#include "studentstore.h"
+#include "student.h"
+
+Q_LOGGING_CATEGORY(photoGcLog, "storage.photogc")
+
+namespace {
+const char* const ListTag = "photogc:list";
+const char* const DeleteTag = "photogc:delete";
+const char* const ConfirmTag = "photogc:confirm";
+
+const char* const PhotoPrefix = "student_photos/";
+
+// Deletes sent at once; the next batch starts when this one is done
+const int DeleteBatchSize = 50;
+
+// Student documents per batchGet when confirming orphans
+const int ConfirmBatchSize = 300;
+}
+
+PhotoGarbageCollector::PhotoGarbageCollector(FirebaseStorageService* storageService, FirestoreService* firestoreService,
+                                             StudentStore* store, QObject *parent)
+    : QObject(parent)
+    , m_storageService(storageService)
+    , m_firestoreService(firestoreService)
+    , m_store(store)
+    , m_scanning(false)
+    , m_scannedCount(0)
+    , m_confirmsPending(0)
+    , m_deleteTotal(0)
+    , m_deleteDone(0)
+{
+    connect(m_storageService, &FirebaseStorageService::filesListed, this, &PhotoGarbageCollector::onFilesListed);
+    connect(m_storageService, &FirebaseStorageService::listFailed, this, &PhotoGarbageCollector::onListFailed);
+    connect(m_storageService, &FirebaseStorageService::filesDeleted, this, &PhotoGarbageCollector::onFilesDeleted);
+    connect(m_firestoreService, &FirestoreService::studentsFetched, this, &PhotoGarbageCollector::onStudentsFetched);
+    connect(m_firestoreService, &FirestoreService::studentsFetchFinished, this, &PhotoGarbageCollector::onStudentsFetchFinished);
+    connect(m_firestoreService, &FirestoreService::queryFailed, this, &PhotoGarbageCollector::onFetchFailed);
+}
+
+QSet<QString> PhotoGarbageCollector::referencedPaths() const
+{
+    QSet<QString> paths;
+    const QList<Student> students = m_store->students();
+    paths.reserve(students.size());
+    for (const Student& student : students) {
+        QString path = FirebaseStorageService::storagePathFromUrl(student.getPhotoURL());
+        if (!path.isEmpty()) {
+            paths.insert(path);
+        }
+    }
+    
+    // An upload finishes before its photoURL is written
+    const QStringList uploading = m_storageService->activeUploads();
+    for (const QString& path : uploading) {
+        paths.insert(path);
+    }
+    return paths;
+}
+
+QString PhotoGarbageCollector::studentIdForPath(const QString& storagePath)
+{
+    // student_photos/<id>.<ext>, as the dialog and photo import name them
+    QString fileName = storagePath.mid(QString(PhotoPrefix).size());
+    return fileName.section('.', 0, 0);
+}
+
+void PhotoGarbageCollector::scan()
+{
+    if (isRunning()) {
+        return;
+    }
+    
+    m_scanning = true;
+    m_referenced = referencedPaths();
+    m_orphans.clear();
+    m_scannedCount = 0;
+    
+    qCInfo(photoGcLog) << "Scanning" << PhotoPrefix << "against" << m_referenced.size() << "referenced photos";
+    m_storageService->listFiles(PhotoPrefix, ListTag);
+}
+
+void PhotoGarbageCollector::onFilesListed(const QString& tag, const QStringList& storagePaths, bool finished)
+{
+    if (tag != ListTag || !m_scanning) {
+        return;
+    }
+    
+    for (const QString& path : storagePaths) {
+        // Folder placeholders created by the console
+        if (path.endsWith('/')) {
+            continue;
+        }
+        ++m_scannedCount;
+        if (!m_referenced.contains(path)) {
+            m_orphans.append(path);
+        }
+    }
+    
+    if (finished) {
+        m_scanning = false;
+        m_referenced.clear();
+        qCInfo(photoGcLog) << "Scan finished:" << m_orphans.size() << "orphans in" << m_scannedCount << "objects";
+        emit scanFinished(m_orphans, m_scannedCount);
+    }
+}
+
+void PhotoGarbageCollector::onListFailed(const QString& tag, const QString& error)
+{
+    if (tag != ListTag || !m_scanning) {
+        return;
+    }
+    
+    m_scanning = false;
+    m_referenced.clear();
+    qCWarning(photoGcLog) << "Listing failed:" << error;
+    emit failed(error);
+}
+
+void PhotoGarbageCollector::deleteOrphans(const QStringList& storagePaths)
+{
+    if (isRunning()) {
+        return;
+    }
+    
+    // The store may have changed since the scan
+    QSet<QString> referenced = referencedPaths();
+    m_deleteQueue.clear();
+    for (const QString& path : storagePaths) {
+        if (path.startsWith(PhotoPrefix) && !referenced.contains(path)) {
+            m_deleteQueue.append(path);
+        }
+    }
+    
+    // The local store may be stale: ask the server who the photos belong to
+    QStringList studentIds;
+    for (const QString& path : std::as_const(m_deleteQueue)) {
+        QString studentId = studentIdForPath(path);
+        if (!studentId.isEmpty() && !studentIds.contains(studentId)) {
+            studentIds.append(studentId);
+        }
+    }
+    if (studentIds.isEmpty()) {
+        startDeleting();
+        return;
+    }
+    
+    qCInfo(photoGcLog) << "Confirming" << m_deleteQueue.size() << "orphans against" << studentIds.size() << "server documents";
+    m_confirmsPending = (studentIds.size() + ConfirmBatchSize - 1) / ConfirmBatchSize;
+    for (int i = 0; i < studentIds.size(); i += ConfirmBatchSize) {
+        m_firestoreService->getStudents(studentIds.mid(i, ConfirmBatchSize), ConfirmTag, {"photoURL"});
+    }
+}
+
+void PhotoGarbageCollector::onStudentsFetched(const QString& tag, const QList<Student>& found, const QStringList& missingIds)
+{
+    Q_UNUSED(missingIds);
+    if (tag != ConfirmTag || m_confirmsPending == 0) {
+        return;
+    }
+    
+    for (const Student& student : found) {
+        QString path = FirebaseStorageService::storagePathFromUrl(student.getPhotoURL());
+        if (!path.isEmpty() && m_deleteQueue.removeAll(path) > 0) {
+            qCInfo(photoGcLog) << "Keeping" << path << "- the server copy of" << student.getId() << "still uses it";
+        }
+    }
+}
+
+void PhotoGarbageCollector::onStudentsFetchFinished(const QString& tag)
+{
+    if (tag != ConfirmTag || m_confirmsPending == 0) {
+        return;
+    }
+    
+    if (--m_confirmsPending == 0) {
+        startDeleting();
+    }
+}
+
+void PhotoGarbageCollector::onFetchFailed(const QString& tag, const QString& error)
+{
+    if (tag != ConfirmTag || m_confirmsPending == 0) {
+        return;
+    }
+    
+    // Unconfirmed orphans are not deleted
+    m_confirmsPending = 0;
+    m_deleteQueue.clear();
+    qCWarning(photoGcLog) << "Could not confirm orphans on the server:" << error;
+    emit failed(error);
+}
+
+void PhotoGarbageCollector::startDeleting()
+{
+    m_deleteFailed.clear();
+    m_deleteDone = 0;
+    m_deleteTotal = m_deleteQueue.size();
+    if (m_deleteTotal == 0) {
+        emit deleteFinished(0, QStringList());
+        return;
+    }
+    
+    qCInfo(photoGcLog) << "Deleting" << m_deleteTotal << "orphaned photos";
+    emit deleteProgress(0, m_deleteTotal);
+    deleteNextBatch();
+}
+
+void PhotoGarbageCollector::deleteNextBatch()
+{
+    QStringList batch = m_deleteQueue.mid(0, DeleteBatchSize);
+    m_deleteQueue = m_deleteQueue.mid(batch.size());
+    m_storageService->deleteFiles(batch, DeleteTag);
+}
+
+void PhotoGarbageCollector::onFilesDeleted(const QString& tag, const QStringList& deletedPaths, const QStringList& failedPaths)
+{
+    if (tag != DeleteTag || m_deleteTotal == 0) {
+        return;
+    }
+    
+    m_deleteDone += deletedPaths.size() + failedPaths.size();
+    m_deleteFailed.append(failedPaths);
+    emit deleteProgress(m_deleteDone, m_deleteTotal);
+    
+    if (!m_deleteQueue.isEmpty()) {
+        deleteNextBatch();
+        return;
+    }
+    
+    int deletedCount = m_deleteTotal - m_deleteFailed.size();
+    m_deleteTotal = 0;
+    qCInfo(photoGcLog) << "Deleted" << deletedCount << "orphaned photos," << m_deleteFailed.size() << "failed";
+    emit deleteFinished(deletedCount, m_deleteFailed);
+}
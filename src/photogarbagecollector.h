@@ -0,0 +1,82 @@
+#ifndef PHOTOGARBAGECOLLECTOR_H
+#define PHOTOGARBAGECOLLECTOR_H
+
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QLoggingCategory>
+#include "student.h"
+
+Q_DECLARE_LOGGING_CATEGORY(photoGcLog)
+
+class FirebaseStorageService;
+class FirestoreService;
+class StudentStore;
+
+/**
+ * PhotoGarbageCollector - Finds and removes photos no student refers to
+ *
+ * Failed replacements and deletes can leave objects under student_photos/
+ * that no photoURL points to. scan() pages through the bucket listing and
+ * checks each object against a hash set of the storage paths of all
+ * photoURLs in the store; it only reports, so it doubles as a dry run.
+ * deleteOrphans() removes the reported objects in batches of parallel
+ * deletes. Each path is checked against the store again first, and then
+ * against the server: the students the photos are named after are read
+ * with batchGet, and a photo that a server copy still points to is kept.
+ * A stale local store (a student added elsewhere since the last load)
+ * therefore cannot cost anyone their photo; if the check fails, nothing
+ * is deleted.
+ *
+ * Objects still being uploaded are never reported. The store must hold
+ * the full student list, otherwise live photos look orphaned.
+ */
+class PhotoGarbageCollector : public QObject
+{
+    Q_OBJECT
+
+public:
+    PhotoGarbageCollector(FirebaseStorageService* storageService, FirestoreService* firestoreService,
+                          StudentStore* store, QObject *parent = nullptr);
+    
+    void scan();
+    void deleteOrphans(const QStringList& storagePaths);
+    bool isRunning() const { return m_scanning || m_confirmsPending > 0 || m_deleteTotal > 0; }
+
+signals:
+    void scanFinished(const QStringList& orphans, int scannedCount);
+    void deleteProgress(int done, int total);
+    void deleteFinished(int deletedCount, const QStringList& failedPaths);
+    void failed(const QString& error);
+
+private slots:
+    void onFilesListed(const QString& tag, const QStringList& storagePaths, bool finished);
+    void onListFailed(const QString& tag, const QString& error);
+    void onFilesDeleted(const QString& tag, const QStringList& deletedPaths, const QStringList& failedPaths);
+    void onStudentsFetched(const QString& tag, const QList<Student>& found, const QStringList& missingIds);
+    void onStudentsFetchFinished(const QString& tag);
+    void onFetchFailed(const QString& tag, const QString& error);
+
+private:
+    QSet<QString> referencedPaths() const;
+    static QString studentIdForPath(const QString& storagePath);
+    void startDeleting();
+    void deleteNextBatch();
+    
+    FirebaseStorageService* m_storageService;
+    FirestoreService* m_firestoreService;
+    StudentStore* m_store;
+    
+    bool m_scanning;
+    QSet<QString> m_referenced; // Storage paths of all photoURLs when the scan started
+    QStringList m_orphans;
+    int m_scannedCount;
+    
+    int m_confirmsPending; // batchGet requests checking the candidates on the server
+    QStringList m_deleteQueue;
+    QStringList m_deleteFailed;
+    int m_deleteTotal;
+    int m_deleteDone;
+};
+
+#endif // PHOTOGARBAGECOLLECTOR_H
@@ -0,0 +1,400 @@
+#include "photoimporter.h"
+#include "firebasestorageservice.h"
+#include "studentstore.h"
+#include "writeoutbox.h"
+#include "duplicateindex.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QImage>
+#include <QImageReader>
+#include <QPainter>
+#include <QPointer>
+#include <QThreadPool>
+#include <QSet>
+#include <algorithm>
+
+Q_LOGGING_CATEGORY(photoImportLog, "storage.photoimport")
+
+namespace {
+// Photos in flight at once: scaling plus upload
+const int MaxParallelPhotos = 4;
+
+// Photos are shown as thumbnails and in the details panel; larger ones are scaled down
+const int MaxPhotoDimension = 1024;
+const int JpegQuality = 85;
+
+// New photoURLs are collected for this long and handed to the outbox together
+const int FlushDelayMs = 1000;
+}
+
+PhotoImporter::PhotoImporter(FirebaseStorageService* storageService, StudentStore* store, WriteOutbox* outbox,
+                             const QString& stateDir, QObject *parent)
+    : QObject(parent)
+    , m_storageService(storageService)
+    , m_store(store)
+    , m_outbox(outbox)
+    , m_stateDir(stateDir)
+    , m_manifestLoaded(false)
+    , m_preparing(0)
+    , m_total(0)
+    , m_imported(0)
+    , m_failed(0)
+    , m_flushTimer(new QTimer(this))
+{
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(FlushDelayMs);
+    connect(m_flushTimer, &QTimer::timeout, this, &PhotoImporter::flushCompleted);
+    connect(m_storageService, &FirebaseStorageService::fileUploaded, this, &PhotoImporter::onFileUploaded);
+    connect(m_storageService, &FirebaseStorageService::uploadFailed, this, &PhotoImporter::onUploadFailed);
+}
+
+QString PhotoImporter::manifestKey(const QString& filePath)
+{
+    // A file changed since it was imported is imported again
+    QFileInfo info(filePath);
+    return QString("%1|%2|%3").arg(info.absoluteFilePath())
+                              .arg(info.size())
+                              .arg(info.lastModified().toMSecsSinceEpoch());
+}
+
+PhotoImporter::Plan PhotoImporter::scan(const QString& directory)
+{
+    loadManifest();
+    
+    // File name keys -> students; one key can fit several students
+    QHash<QString, QStringList> byPhone;
+    QHash<QString, QStringList> byEmail;
+    QHash<QString, QStringList> byName;
+    const QList<Student> students = m_store->students();
+    for (const Student& student : students) {
+        QString phone = DuplicateIndex::phoneKey(student.getNumber());
+        if (!phone.isEmpty()) {
+            byPhone[phone].append(student.getId());
+        }
+        QString email = student.getEmail().trimmed().toLower();
+        if (!email.isEmpty()) {
+            byEmail[email].append(student.getId());
+            QString localPart = email.section('@', 0, 0);
+            if (!byEmail.value(localPart).contains(student.getId())) {
+                byEmail[localPart].append(student.getId());
+            }
+        }
+        if (!student.getName().trimmed().isEmpty()) {
+            byName[DuplicateIndex::foldText(student.getName())].append(student.getId());
+        }
+    }
+    
+    QSet<QString> imageSuffixes;
+    const QList<QByteArray> formats = QImageReader::supportedImageFormats();
+    for (const QByteArray& format : formats) {
+        imageSuffixes.insert(QString::fromLatin1(format).toLower());
+    }
+    
+    Plan plan;
+    QHash<QString, int> matchIndex; // Student ID -> index in plan.matches
+    QSet<QString> contested;        // Students several files fit
+    
+    QDirIterator it(directory, QDir::Files | QDir::Readable);
+    QStringList files;
+    while (it.hasNext()) {
+        files.append(it.next());
+    }
+    files.sort();
+    
+    for (const QString& filePath : files) {
+        QFileInfo info(filePath);
+        if (!imageSuffixes.contains(info.suffix().toLower())) {
+            continue;
+        }
+        
+        QString baseName = info.completeBaseName();
+        // Only names without letters are read as phone numbers
+        bool numeric = std::none_of(baseName.begin(), baseName.end(), [](QChar ch) { return ch.isLetter(); });
+        QString phone = numeric ? DuplicateIndex::phoneKey(baseName) : QString();
+        QStringList candidates;
+        QString matchedBy;
+        if (!phone.isEmpty() && byPhone.contains(phone)) {
+            candidates = byPhone.value(phone);
+            matchedBy = "phone";
+        } else if (byEmail.contains(baseName.trimmed().toLower())) {
+            candidates = byEmail.value(baseName.trimmed().toLower());
+            matchedBy = "email";
+        } else if (byName.contains(DuplicateIndex::foldText(baseName))) {
+            candidates = byName.value(DuplicateIndex::foldText(baseName));
+            matchedBy = "name";
+        }
+        
+        if (candidates.isEmpty()) {
+            plan.unmatched.append(filePath);
+            continue;
+        }
+        if (candidates.size() > 1) {
+            plan.ambiguous.append(filePath);
+            continue;
+        }
+        
+        QString studentId = candidates.first();
+        QString imported = m_manifest.value(manifestKey(filePath)).toString();
+        if (imported == studentId && !m_store->student(studentId).getPhotoURL().isEmpty()) {
+            plan.alreadyImported.append(filePath);
+            continue;
+        }
+        
+        if (contested.contains(studentId)) {
+            plan.ambiguous.append(filePath);
+            continue;
+        }
+        if (matchIndex.contains(studentId)) {
+            // Neither file wins; both are left for the user
+            contested.insert(studentId);
+            plan.ambiguous.append(plan.matches[matchIndex.value(studentId)].filePath);
+            plan.ambiguous.append(filePath);
+            continue;
+        }
+        
+        matchIndex[studentId] = plan.matches.size();
+        plan.matches.append({filePath, studentId, matchedBy});
+    }
+    
+    // Drop the matches whose student turned out to be contested
+    QList<Match> matches;
+    for (const Match& match : plan.matches) {
+        if (!contested.contains(match.studentId)) {
+            matches.append(match);
+        }
+    }
+    plan.matches = matches;
+    
+    qCInfo(photoImportLog) << "Scanned" << directory << "-" << plan.matches.size() << "matched,"
+                           << plan.unmatched.size() << "unmatched," << plan.ambiguous.size() << "ambiguous,"
+                           << plan.alreadyImported.size() << "already imported";
+    return plan;
+}
+
+void PhotoImporter::start(const QList<Match>& matches)
+{
+    if (isRunning() || matches.isEmpty()) {
+        return;
+    }
+    
+    QDir().mkpath(m_stateDir + "/photo-import");
+    m_queue = matches;
+    m_total = matches.size();
+    m_imported = 0;
+    m_failed = 0;
+    
+    qCInfo(photoImportLog) << "Importing" << m_total << "photos," << MaxParallelPhotos << "at a time";
+    emit progress(0, m_total);
+    pump();
+}
+
+void PhotoImporter::cancel()
+{
+    if (!isRunning()) {
+        return;
+    }
+    
+    qCInfo(photoImportLog) << "Import cancelled," << m_queue.size() << "photos not started";
+    m_total -= m_queue.size();
+    m_queue.clear();
+    pump();
+}
+
+void PhotoImporter::pump()
+{
+    while (!m_queue.isEmpty() && m_active.size() + m_preparing < MaxParallelPhotos) {
+        Match match = m_queue.takeFirst();
+        QString scaledPath = QString("%1/photo-import/%2.jpg").arg(m_stateDir, match.studentId);
+        
+        // Decoding and scaling stay off the UI thread
+        ++m_preparing;
+        QPointer<PhotoImporter> self(this);
+        QThreadPool::globalInstance()->start([self, match, scaledPath]() {
+            Prepared prepared = preparePhoto(match.filePath, scaledPath);
+            if (self) {
+                QMetaObject::invokeMethod(self, [self, match, prepared]() {
+                    if (self) {
+                        self->onPrepared(match, prepared);
+                    }
+                }, Qt::QueuedConnection);
+            }
+        });
+    }
+    
+    if (m_total > 0 && m_queue.isEmpty() && m_active.isEmpty() && m_preparing == 0) {
+        flushCompleted();
+        int imported = m_imported;
+        int failed = m_failed;
+        m_total = 0;
+        qCInfo(photoImportLog) << "Import finished:" << imported << "imported," << failed << "failed";
+        emit finished(imported, failed);
+    }
+}
+
+PhotoImporter::Prepared PhotoImporter::preparePhoto(const QString& filePath, const QString& scaledPath)
+{
+    Prepared prepared;
+    
+    QImageReader reader(filePath);
+    reader.setAutoTransform(true);
+    QSize size = reader.size();
+    if (!size.isValid()) {
+        prepared.error = QString("Resim okunamadı: %1").arg(reader.errorString());
+        return prepared;
+    }
+    
+    // Small enough JPEGs are sent as they are
+    bool fits = size.width() <= MaxPhotoDimension && size.height() <= MaxPhotoDimension;
+    if (fits && reader.format() == "jpeg") {
+        prepared.localPath = filePath;
+        return prepared;
+    }
+    
+    if (!fits) {
+        reader.setScaledSize(size.scaled(MaxPhotoDimension, MaxPhotoDimension, Qt::KeepAspectRatio));
+    }
+    QImage image = reader.read();
+    if (image.isNull()) {
+        prepared.error = QString("Resim okunamadı: %1").arg(reader.errorString());
+        return prepared;
+    }
+    
+    // JPEG has no transparency; put it on white instead of black
+    if (image.hasAlphaChannel()) {
+        QImage flattened(image.size(), QImage::Format_RGB32);
+        flattened.fill(Qt::white);
+        QPainter painter(&flattened);
+        painter.drawImage(0, 0, image);
+        painter.end();
+        image = flattened;
+    }
+    
+    if (!image.save(scaledPath, "JPG", JpegQuality)) {
+        prepared.error = QString("Küçültülmüş resim kaydedilemedi: %1").arg(scaledPath);
+        return prepared;
+    }
+    
+    prepared.localPath = scaledPath;
+    prepared.temporary = true;
+    return prepared;
+}
+
+void PhotoImporter::onPrepared(const Match& match, const Prepared& prepared)
+{
+    --m_preparing;
+    
+    if (!prepared.error.isEmpty()) {
+        ++m_failed;
+        qCWarning(photoImportLog) << "Could not prepare" << match.filePath << "-" << prepared.error;
+        emit photoFailed(match.filePath, prepared.error);
+        emit progress(m_imported + m_failed, m_total);
+        pump();
+        return;
+    }
+    
+    QString storagePath = QString("student_photos/%1.jpg").arg(match.studentId);
+    m_active[storagePath] = {match, prepared};
+    m_storageService->uploadFile(prepared.localPath, storagePath);
+}
+
+void PhotoImporter::onFileUploaded(const QString& storagePath, const QString& downloadUrl)
+{
+    auto it = m_active.constFind(storagePath);
+    if (it == m_active.constEnd()) {
+        return;
+    }
+    Match match = it->match;
+    
+    // Deleted while its photo was uploading
+    if (!m_store->contains(match.studentId)) {
+        finishJob(storagePath, "Mezun kaydı içe aktarma sırasında silindi");
+        m_storageService->deleteFile(storagePath);
+        return;
+    }
+    
+    Student student = m_store->student(match.studentId);
+    
+    // A photo with another extension would be left behind
+    QString oldStoragePath = FirebaseStorageService::storagePathFromUrl(student.getPhotoURL());
+    if (!oldStoragePath.isEmpty() && oldStoragePath != storagePath) {
+        m_storageService->deleteFile(oldStoragePath);
+    }
+    
+    student.setPhotoURL(downloadUrl);
+    student.setLastUpdateTime(QDateTime::currentDateTimeUtc());
+    m_completed.append(student);
+    m_manifest[manifestKey(match.filePath)] = match.studentId;
+    if (!m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
+    
+    finishJob(storagePath, QString());
+}
+
+void PhotoImporter::onUploadFailed(const QString& storagePath, const QString& error)
+{
+    if (m_active.contains(storagePath)) {
+        finishJob(storagePath, error);
+    }
+}
+
+void PhotoImporter::finishJob(const QString& storagePath, const QString& error)
+{
+    Job job = m_active.take(storagePath);
+    if (job.prepared.temporary) {
+        QFile::remove(job.prepared.localPath);
+    }
+    
+    if (error.isEmpty()) {
+        ++m_imported;
+    } else {
+        ++m_failed;
+        qCWarning(photoImportLog) << "Import failed for" << job.match.filePath << "-" << error;
+        emit photoFailed(job.match.filePath, error);
+    }
+    
+    emit progress(m_imported + m_failed, m_total);
+    pump();
+}
+
+void PhotoImporter::flushCompleted()
+{
+    m_flushTimer->stop();
+    if (m_completed.isEmpty()) {
+        return;
+    }
+    
+    qCDebug(photoImportLog) << "Queueing" << m_completed.size() << "photo URLs";
+    m_outbox->enqueueSets(m_completed);
+    m_completed.clear();
+    saveManifest();
+}
+
+void PhotoImporter::loadManifest()
+{
+    if (m_manifestLoaded) {
+        return;
+    }
+    m_manifestLoaded = true;
+    
+    QFile file(m_stateDir + "/photo-import.json");
+    if (file.open(QIODevice::ReadOnly)) {
+        m_manifest = QJsonDocument::fromJson(file.readAll()).object();
+    }
+}
+
+void PhotoImporter::saveManifest() const
+{
+    QDir().mkpath(m_stateDir);
+    QSaveFile file(m_stateDir + "/photo-import.json");
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(photoImportLog) << "Could not save import manifest:" << file.errorString();
+        return;
+    }
+    file.write(QJsonDocument(m_manifest).toJson(QJsonDocument::Compact));
+    file.commit();
+}
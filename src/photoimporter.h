@@ -0,0 +1,113 @@
+#ifndef PHOTOIMPORTER_H
+#define PHOTOIMPORTER_H
+
+#include <QObject>
+#include <QList>
+#include <QHash>
+#include <QTimer>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include "student.h"
+
+Q_DECLARE_LOGGING_CATEGORY(photoImportLog)
+
+class FirebaseStorageService;
+class StudentStore;
+class WriteOutbox;
+
+/**
+ * PhotoImporter - Attaches a folder of photos to students in one go
+ *
+ * scan() matches each image file to a student by its file name, trying the
+ * phone number (a name of digits, spaces and +()-, compared through
+ * DuplicateIndex::phoneKey, so 0532 123 45 67.jpg and 905321234567.jpg
+ * both fit), then the e-mail address (whole or the part before @), then
+ * the name (case, Turkish letters and _-. separators ignored). Files that
+ * fit several students, or a student that several files fit, are left out
+ * for the user to sort.
+ *
+ * start() runs the matches through a small pipeline, a few at a time:
+ *   - large or non-JPEG images are scaled down and re-encoded as JPEG on
+ *     the thread pool;
+ *   - the result is uploaded to student_photos/{id}.jpg;
+ *   - the new photoURL goes through the WriteOutbox in batches.
+ * Finished files are recorded in a manifest, so running the import again
+ * on the same folder only sends what is still missing. Uploads cut off by
+ * closing the application are finished by the storage service next run.
+ */
+class PhotoImporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Match {
+        QString filePath;
+        QString studentId;
+        QString matchedBy; // "phone", "email" or "name"
+    };
+    
+    struct Plan {
+        QList<Match> matches;
+        QStringList unmatched;       // No student fits the file name
+        QStringList ambiguous;       // Several students, or several files for one student
+        QStringList alreadyImported; // Done in an earlier run and unchanged since
+    };
+    
+    PhotoImporter(FirebaseStorageService* storageService, StudentStore* store, WriteOutbox* outbox,
+                  const QString& stateDir, QObject *parent = nullptr);
+    
+    Plan scan(const QString& directory);
+    
+    void start(const QList<Match>& matches);
+    void cancel(); // Drops the files not started yet; running uploads finish
+    bool isRunning() const { return m_total > 0; }
+
+signals:
+    void progress(int done, int total);
+    void photoFailed(const QString& filePath, const QString& error);
+    void finished(int imported, int failed);
+
+private slots:
+    void onFileUploaded(const QString& storagePath, const QString& downloadUrl);
+    void onUploadFailed(const QString& storagePath, const QString& error);
+    void flushCompleted();
+
+private:
+    struct Prepared {
+        QString localPath; // File to upload: the original or a scaled copy
+        bool temporary = false;
+        QString error;
+    };
+    
+    struct Job {
+        Match match;
+        Prepared prepared;
+    };
+    
+    static QString manifestKey(const QString& filePath);
+    static Prepared preparePhoto(const QString& filePath, const QString& scaledPath);
+    
+    void pump();
+    void onPrepared(const Match& match, const Prepared& prepared);
+    void finishJob(const QString& storagePath, const QString& error);
+    void loadManifest();
+    void saveManifest() const;
+    
+    FirebaseStorageService* m_storageService;
+    StudentStore* m_store;
+    WriteOutbox* m_outbox;
+    QString m_stateDir;
+    QJsonObject m_manifest; // manifestKey -> student ID of files already imported
+    bool m_manifestLoaded;
+    
+    QList<Match> m_queue;
+    QHash<QString, Job> m_active; // Storage path -> upload in flight
+    int m_preparing;              // Images being scaled on the thread pool
+    int m_total;
+    int m_imported;
+    int m_failed;
+    QList<Student> m_completed;   // New photoURLs not yet handed to the outbox
+    QTimer* m_flushTimer;
+};
+
+#endif // PHOTOIMPORTER_H
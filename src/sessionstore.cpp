@@ -0,0 +1,251 @@
+#if defined(HAVE_QTKEYCHAIN)
+#include <qt6keychain/keychain.h>
+#include <QEventLoop>
+#elif defined(HAVE_LIBSECRET)
+// glib uses "signals" as an identifier, which Qt defines as a macro
+#undef signals
+#include <libsecret/secret.h>
+#define signals Q_SIGNALS
+#endif
+
+#include "sessionstore.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(authLog)
+
+#if defined(HAVE_QTKEYCHAIN)
+namespace {
+const char* const KeychainService = "org.nevretemder.StudentManager.Session";
+
+// QtKeychain jobs are asynchronous; the store is used at startup and
+// sign-out only, so wait for them
+void runJob(QKeychain::Job* job)
+{
+    QEventLoop loop;
+    QObject::connect(job, &QKeychain::Job::finished, &loop, &QEventLoop::quit);
+    job->start();
+    loop.exec();
+}
+}
+#elif defined(HAVE_LIBSECRET)
+namespace {
+const SecretSchema* sessionSchema()
+{
+    static const SecretSchema schema = {
+        "org.nevretemder.StudentManager.Session", SECRET_SCHEMA_NONE,
+        {
+            { "project", SECRET_SCHEMA_ATTRIBUTE_STRING },
+            { nullptr, SecretSchemaAttributeType(0) }
+        }
+    };
+    return &schema;
+}
+}
+#endif
+
+SessionStore::SessionStore(const QString& projectId, Backend backend, const QString& filePath)
+    : m_projectId(projectId)
+    , m_backend(backend == Keyring && !keyringAvailable() ? None : backend)
+    , m_filePath(filePath)
+{
+    static const char* const names[] = {"keyring", "file", "none"};
+    qCInfo(authLog) << "Session store backend:" << names[m_backend];
+}
+
+bool SessionStore::keyringAvailable()
+{
+#if defined(HAVE_QTKEYCHAIN) || defined(HAVE_LIBSECRET)
+    return true;
+#else
+    return false;
+#endif
+}
+
+SessionStore::Backend SessionStore::backendFromName(const QString& name)
+{
+    if (name == "none") {
+        return None;
+    }
+    return name == "file" ? File : Keyring;
+}
+
+SessionStore::Session SessionStore::load() const
+{
+    QByteArray data;
+    if (m_backend == Keyring) {
+        return loadFromKeyring(&data) ? deserialize(data) : Session();
+    }
+    if (m_backend == None) {
+        return Session();
+    }
+    
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return Session();
+    }
+    return deserialize(file.readAll());
+}
+
+bool SessionStore::save(const Session& session) const
+{
+    QByteArray data = serialize(session);
+    if (m_backend == Keyring) {
+        if (saveToKeyring(data)) {
+            // A file left by an earlier version or store=file
+            QFile::remove(m_filePath);
+            return true;
+        }
+        qCWarning(authLog) << "Keyring not reachable, session not saved";
+        return false;
+    }
+    if (m_backend == None) {
+        return false;
+    }
+    
+    QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+    QSaveFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(authLog) << "Could not save session:" << file.errorString();
+        return false;
+    }
+    file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+    file.write(data);
+    if (!file.commit()) {
+        qCWarning(authLog) << "Could not save session:" << file.errorString();
+        return false;
+    }
+    QFile::setPermissions(m_filePath, QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+    return true;
+}
+
+void SessionStore::clear() const
+{
+    if (m_backend == Keyring) {
+        clearKeyring();
+    }
+    QFile::remove(m_filePath);
+    qCInfo(authLog) << "Saved session cleared";
+}
+
+QByteArray SessionStore::serialize(const Session& session) const
+{
+    QJsonObject json;
+    json["projectId"] = m_projectId;
+    json["refreshToken"] = session.refreshToken;
+    json["userId"] = session.userId;
+    json["email"] = session.email;
+    return QJsonDocument(json).toJson(QJsonDocument::Compact);
+}
+
+SessionStore::Session SessionStore::deserialize(const QByteArray& data) const
+{
+    QJsonObject json = QJsonDocument::fromJson(data).object();
+    
+    // A session of another project is useless here
+    if (json["projectId"].toString() != m_projectId) {
+        return Session();
+    }
+    
+    Session session;
+    session.refreshToken = json["refreshToken"].toString();
+    session.userId = json["userId"].toString();
+    session.email = json["email"].toString();
+    return session;
+}
+
+bool SessionStore::loadFromKeyring(QByteArray* data) const
+{
+#if defined(HAVE_QTKEYCHAIN)
+    QKeychain::ReadPasswordJob job(KeychainService);
+    job.setAutoDelete(false);
+    job.setKey(m_projectId);
+    runJob(&job);
+    if (job.error() != QKeychain::NoError) {
+        if (job.error() != QKeychain::EntryNotFound) {
+            qCWarning(authLog) << "Keychain lookup failed:" << job.errorString();
+        }
+        return false;
+    }
+    *data = job.binaryData();
+    return true;
+#elif defined(HAVE_LIBSECRET)
+    GError* error = nullptr;
+    gchar* secret = secret_password_lookup_sync(sessionSchema(), nullptr, &error,
+                                                "project", m_projectId.toUtf8().constData(),
+                                                nullptr);
+    if (error) {
+        qCWarning(authLog) << "Keyring lookup failed:" << error->message;
+        g_error_free(error);
+        return false;
+    }
+    if (!secret) {
+        return false;
+    }
+    *data = QByteArray(secret);
+    secret_password_free(secret);
+    return true;
+#else
+    Q_UNUSED(data);
+    return false;
+#endif
+}
+
+bool SessionStore::saveToKeyring(const QByteArray& data) const
+{
+#if defined(HAVE_QTKEYCHAIN)
+    QKeychain::WritePasswordJob job(KeychainService);
+    job.setAutoDelete(false);
+    job.setKey(m_projectId);
+    job.setBinaryData(data);
+    runJob(&job);
+    if (job.error() != QKeychain::NoError) {
+        qCWarning(authLog) << "Keychain store failed:" << job.errorString();
+        return false;
+    }
+    return true;
+#elif defined(HAVE_LIBSECRET)
+    GError* error = nullptr;
+    QByteArray label = QString("NEVRETEM-DER MBS (%1)").arg(m_projectId).toUtf8();
+    gboolean stored = secret_password_store_sync(sessionSchema(), SECRET_COLLECTION_DEFAULT,
+                                                 label.constData(), data.constData(), nullptr, &error,
+                                                 "project", m_projectId.toUtf8().constData(),
+                                                 nullptr);
+    if (error) {
+        qCWarning(authLog) << "Keyring store failed:" << error->message;
+        g_error_free(error);
+        return false;
+    }
+    return stored;
+#else
+    Q_UNUSED(data);
+    return false;
+#endif
+}
+
+void SessionStore::clearKeyring() const
+{
+#if defined(HAVE_QTKEYCHAIN)
+    QKeychain::DeletePasswordJob job(KeychainService);
+    job.setAutoDelete(false);
+    job.setKey(m_projectId);
+    runJob(&job);
+    if (job.error() != QKeychain::NoError && job.error() != QKeychain::EntryNotFound) {
+        qCWarning(authLog) << "Keychain clear failed:" << job.errorString();
+    }
+#elif defined(HAVE_LIBSECRET)
+    GError* error = nullptr;
+    secret_password_clear_sync(sessionSchema(), nullptr, &error,
+                               "project", m_projectId.toUtf8().constData(),
+                               nullptr);
+    if (error) {
+        qCWarning(authLog) << "Keyring clear failed:" << error->message;
+        g_error_free(error);
+    }
+#endif
+}
@@ -0,0 +1,61 @@
+#ifndef SESSIONSTORE_H
+#define SESSIONSTORE_H
+
+#include <QString>
+
+/**
+ * SessionStore - Keeps the signed-in user's refresh token between runs
+ *
+ * With a saved session the application exchanges the refresh token for a
+ * new ID token in the background instead of showing the login dialog, so
+ * startup does not wait for an interactive sign-in. The token goes into
+ * the platform credential store: Credential Manager on Windows, the
+ * Keychain on macOS and the Secret Service keyring on Linux, through
+ * QtKeychain, or libsecret alone on Linux builds without it. Where there
+ * is no such store, or it does not answer, nothing is saved. A plain file
+ * readable only by the user (which does not hold on NTFS) is written only
+ * when asked for with the File backend.
+ */
+class SessionStore
+{
+public:
+    enum Backend {
+        Keyring,
+        File,
+        None
+    };
+    
+    struct Session {
+        QString refreshToken;
+        QString userId;
+        QString email;
+        
+        bool isValid() const { return !refreshToken.isEmpty(); }
+    };
+    
+    // projectId keeps sessions of different Firebase projects apart
+    SessionStore(const QString& projectId, Backend backend, const QString& filePath);
+    
+    static bool keyringAvailable(); // Built with QtKeychain or libsecret
+    static Backend backendFromName(const QString& name); // [session] store: "keyring", "file" or "none"
+    
+    Backend backend() const { return m_backend; }
+    
+    Session load() const;
+    bool save(const Session& session) const;
+    void clear() const;
+
+private:
+    QByteArray serialize(const Session& session) const;
+    Session deserialize(const QByteArray& data) const;
+    
+    bool loadFromKeyring(QByteArray* data) const;
+    bool saveToKeyring(const QByteArray& data) const;
+    void clearKeyring() const;
+    
+    QString m_projectId;
+    Backend m_backend;
+    QString m_filePath;
+};
+
+#endif // SESSIONSTORE_H
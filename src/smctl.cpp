@@ -0,0 +1,750 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QLocale>
+#include <QLoggingCategory>
+#include <QMap>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+
+#include "firebaseauthservice.h"
+#include "firestoreservice.h"
+#include "logging.h"
+#include "firebasestorageservice.h"
+#include "networkaccess.h"
+#include "sessionstore.h"
+#include "studentstore.h"
+#include "writeoutbox.h"
+#include "studentexporter.h"
+#include "studentimporter.h"
+#include "photogarbagecollector.h"
+
+Q_LOGGING_CATEGORY(cliLog, "smctl")
+
+/*
+ * smctl - Bulk operations without the desktop window
+ *
+ *   smctl export -o FILE [--format csv|xlsx|arrow|parquet]
+ *   smctl import FILE [--batch-size N] [--upsert] [--timeout S]
+ *   smctl sync [--snapshot FILE] [--timeout S]
+ *   smctl stats [--top N]
+ *   smctl gc-photos [--delete]
+ *
+ * Uses the same config.ini and saved session as the application. Without a
+ * saved session, SMCTL_EMAIL and SMCTL_PASSWORD sign in instead. Results go
+ * to stdout, progress and throughput to stderr. Writes that make no
+ * progress for --timeout seconds are left in the outbox file for the next
+ * run. Exit code 0 on success, 1 when the operation failed or timed out,
+ * 2 for usage errors.
+ */
+
+namespace {
+const int ExitOk = 0;
+const int ExitFailed = 1;
+const int ExitUsage = 2;
+
+using Console::out;
+using Console::err;
+
+bool quiet = false;
+
+void report(const QString& text)
+{
+    if (!quiet) {
+        err() << text << Qt::endl;
+    }
+}
+
+// "12.345 kayıt, 3,2 sn, 3.858 kayıt/sn"
+QString throughput(qint64 count, qint64 elapsedMs, const QString& unit = "kayıt")
+{
+    double seconds = qMax<qint64>(elapsedMs, 1) / 1000.0;
+    QLocale locale(QLocale::Turkish);
+    return QString("%1 %2, %3 sn, %4 %2/sn")
+        .arg(locale.toString(count), unit, locale.toString(seconds, 'f', 1),
+             locale.toString(qRound64(count / seconds)));
+}
+
+// Prints "label: done/total" at every tenth of the way
+class ProgressReporter
+{
+public:
+    explicit ProgressReporter(const QString& label) : m_label(label), m_lastStep(-1) {}
+    
+    void update(int done, int total)
+    {
+        if (total <= 0) {
+            return;
+        }
+        int step = qBound(0, done * 10 / total, 10);
+        if (step != m_lastStep) {
+            m_lastStep = step;
+            report(QString("%1: %2/%3 (%%4)").arg(m_label).arg(done).arg(total).arg(step * 10));
+        }
+    }
+
+private:
+    QString m_label;
+    int m_lastStep;
+};
+
+/**
+ * Context - The services one command needs, configured like the application
+ *
+ * Everything runs on the main thread's event loop; the waits below spin a
+ * local QEventLoop until the awaited signal arrives, so each command reads
+ * as a sequence of steps.
+ */
+class Context
+{
+public:
+    Context()
+        : partitions(1)
+    {
+    }
+    
+    bool configure(const QString& configPath, int partitionOverride, const QString& originOverride)
+    {
+        QSettings settings(configPath, QSettings::IniFormat);
+        NetworkAccess::setOriginOverride(originOverride.isEmpty() ? settings.value("endpoints/origin", "").toString()
+                                                                  : originOverride);
+        projectId = settings.value("firestore/projectId", "").toString();
+        apiKey = settings.value("firestore/apiKey", "").toString();
+        sessionBackend = settings.value("session/store", "keyring").toString();
+        if (projectId.isEmpty() || apiKey.isEmpty()) {
+            err() << "Firebase ayarları eksik: " << configPath << Qt::endl;
+            return false;
+        }
+        
+        // Full loads are partitioned; by default as wide as the machine,
+        // within the range the application allows
+        int configured = settings.value("firestore/loadPartitions", 0).toInt();
+        int requested = partitionOverride > 0 ? partitionOverride
+                        : configured > 0 ? configured : QThread::idealThreadCount();
+        partitions = qBound(1, requested, 32);
+        
+        auth.setProjectId(projectId);
+        auth.setApiKey(apiKey);
+        firestore.setProjectId(projectId);
+        firestore.setApiKey(apiKey);
+        storage.setProjectId(projectId);
+        storage.setApiKey(apiKey);
+        return true;
+    }
+    
+    // Resumes the application's saved session, or signs in with
+    // SMCTL_EMAIL/SMCTL_PASSWORD when set
+    bool signIn()
+    {
+        QObject::connect(&auth, &FirebaseAuthService::authenticationSucceeded, &firestore, [this]() { applyToken(); });
+        QObject::connect(&auth, &FirebaseAuthService::tokenRefreshed, &firestore, [this]() { applyToken(); });
+        QObject::connect(&firestore, &FirestoreService::authenticationRequired, &auth, &FirebaseAuthService::refreshToken);
+        QObject::connect(&storage, &FirebaseStorageService::authenticationRequired, &auth, &FirebaseAuthService::refreshToken);
+        QObject::connect(&auth, &FirebaseAuthService::tokenRefreshFailed, &firestore, [this](const QString& error) {
+            qCWarning(cliLog) << "Token refresh failed:" << error;
+            firestore.abortParkedRequests();
+            storage.abortParkedRequests();
+        });
+        
+        QString error;
+        QEventLoop loop;
+        QObject::connect(&auth, &FirebaseAuthService::authenticationSucceeded, &loop, [&]() { loop.quit(); });
+        QObject::connect(&auth, &FirebaseAuthService::authenticationFailed, &loop, [&](const QString& message) {
+            error = message;
+            loop.quit();
+        });
+        QObject::connect(&auth, &FirebaseAuthService::tokenRefreshed, &loop, [&]() { loop.quit(); });
+        QObject::connect(&auth, &FirebaseAuthService::tokenRefreshFailed, &loop, [&](const QString& message) {
+            error = message;
+            loop.quit();
+        });
+        
+        QString email = qEnvironmentVariable("SMCTL_EMAIL");
+        QString password = qEnvironmentVariable("SMCTL_PASSWORD");
+        if (!email.isEmpty() && !password.isEmpty()) {
+            auth.signInWithEmailAndPassword(email, password);
+        } else {
+            SessionStore sessionStore(projectId, SessionStore::backendFromName(sessionBackend),
+                                      QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/session.json");
+            SessionStore::Session session = sessionStore.load();
+            if (!session.isValid()) {
+                err() << "Kayıtlı oturum yok. Uygulamada \"Oturumu açık tut\" ile giriş yapın "
+                         "ya da SMCTL_EMAIL ve SMCTL_PASSWORD değişkenlerini ayarlayın." << Qt::endl;
+                return false;
+            }
+            auth.restoreSession(session.refreshToken, session.userId, session.email);
+            
+            // The refresh token can rotate; keep the application's copy current
+            QObject::connect(&auth, &FirebaseAuthService::tokenRefreshed, &firestore, [this, sessionStore]() {
+                if (!auth.getRefreshToken().isEmpty()) {
+                    sessionStore.save({auth.getRefreshToken(), auth.getUserId(), auth.getUserEmail()});
+                }
+            });
+        }
+        loop.exec();
+        
+        if (!auth.isAuthenticated()) {
+            err() << "Giriş yapılamadı: " << error << Qt::endl;
+            return false;
+        }
+        qCInfo(cliLog) << "Signed in as" << auth.getUserEmail();
+        return true;
+    }
+    
+    // Full partitioned load into the store. The list projection leaves out
+    // descriptions, which only exports need.
+    bool loadStudents(bool projection)
+    {
+        QString error;
+        QEventLoop loop;
+        QElapsedTimer timer;
+        QObject::connect(&firestore, &FirestoreService::studentsReceived, &loop, [&](const QList<Student>& students) {
+            store.replaceAll(students);
+            loop.quit();
+        });
+        QObject::connect(&firestore, &FirestoreService::errorOccurred, &loop, [&](const QString& message) {
+            error = message;
+            loop.quit();
+        });
+        
+        timer.start();
+        report(QString("Kayıtlar yükleniyor (%1 bölüm)...").arg(partitions));
+        firestore.getAllStudentsPartitioned(partitions, projection ? FirestoreService::listProjection() : QStringList());
+        loop.exec();
+        
+        if (!error.isEmpty()) {
+            err() << "Kayıtlar yüklenemedi: " << error << Qt::endl;
+            return false;
+        }
+        report("Yüklendi: " + throughput(store.size(), timer.elapsed()));
+        return true;
+    }
+    
+    QString outboxPath() const
+    {
+        return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/smctl-outbox.json";
+    }
+    
+    QString snapshotPath() const
+    {
+        return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+               + QString("/students-%1.json").arg(projectId);
+    }
+    
+    FirebaseAuthService auth;
+    FirestoreService firestore;
+    FirebaseStorageService storage;
+    StudentStore store;
+    QString projectId;
+    QString apiKey;
+    QString sessionBackend;
+    int partitions;
+
+private:
+    void applyToken()
+    {
+        firestore.setAuthToken(auth.getIdToken());
+        storage.setAuthToken(auth.getIdToken());
+    }
+};
+
+// Sends what is queued in the outbox and waits until the queue is empty
+struct DrainResult {
+    int committed = 0;
+    int rejected = 0;
+    int conflicts = 0;
+};
+
+void connectOutboxReporting(WriteOutbox* outbox, DrainResult* result)
+{
+    QObject::connect(outbox, &WriteOutbox::writeCommitted, outbox, [result]() { result->committed++; });
+    QObject::connect(outbox, &WriteOutbox::writeRejected, outbox, [result](const QString& studentId, const QString& error) {
+        result->rejected++;
+        err() << "Reddedildi " << studentId << ": " << error << Qt::endl;
+    });
+    QObject::connect(outbox, &WriteOutbox::writeConflict, outbox,
+                     [result](WriteOutbox::Operation, const Student& local, const Student&) {
+        result->conflicts++;
+        err() << "Çakışma, sunucudaki sürüm korundu: " << local.getId() << " " << local.getName() << Qt::endl;
+    });
+}
+
+// Quits loop once the outbox has made no progress for timeoutMs; every
+// change of the pending count, and restart(), start the wait over. No
+// limit when timeoutMs is 0.
+class StallTimer
+{
+public:
+    StallTimer(WriteOutbox* outbox, QEventLoop* loop, int timeoutMs)
+        : m_expired(false)
+    {
+        m_timer.setSingleShot(true);
+        m_timer.setInterval(timeoutMs);
+        QObject::connect(&m_timer, &QTimer::timeout, loop, [this, loop]() {
+            m_expired = true;
+            loop->quit();
+        });
+        QObject::connect(outbox, &WriteOutbox::pendingCountChanged, &m_timer, [this]() { restart(); });
+    }
+    
+    void restart()
+    {
+        if (m_timer.interval() > 0) {
+            m_timer.start();
+        }
+    }
+    
+    bool expired() const { return m_expired; }
+
+private:
+    QTimer m_timer;
+    bool m_expired;
+};
+
+void reportUnsent(const WriteOutbox& outbox, const QString& outboxPath, int timeoutSeconds)
+{
+    err() << outbox.pendingCount() << " yazma gönderilemedi (" << timeoutSeconds << " sn ilerleme yok); "
+          << outboxPath << " dosyasında sonraki çalıştırmayı bekliyor" << Qt::endl;
+}
+
+// False when the queue did not drain within the timeout
+bool drainOutbox(WriteOutbox* outbox, int timeoutSeconds)
+{
+    if (outbox->pendingCount() == 0) {
+        return true;
+    }
+    QEventLoop loop;
+    StallTimer stall(outbox, &loop, timeoutSeconds * 1000);
+    QObject::connect(outbox, &WriteOutbox::pendingCountChanged, &loop, [&](int count) {
+        if (count == 0) {
+            loop.quit();
+        }
+    });
+    stall.restart();
+    outbox->flush();
+    loop.exec();
+    return !stall.expired();
+}
+
+int runExport(Context& context, const QCommandLineParser& parser)
+{
+    QString filePath = parser.value("output");
+    if (filePath.isEmpty()) {
+        err() << "export için --output gerekli" << Qt::endl;
+        return ExitUsage;
+    }
+    
+    StudentWriter::Format format = StudentWriter::formatForPath(filePath);
+    if (parser.isSet("format") && !StudentWriter::formatForName(parser.value("format"), &format)) {
+        err() << "Bilinmeyen biçim: " << parser.value("format") << Qt::endl;
+        return ExitUsage;
+    }
+    if (!StudentWriter::availableFormats().contains(format)) {
+        err() << "Bu derleme " << StudentWriter::suffix(format) << " biçimini desteklemiyor" << Qt::endl;
+        return ExitUsage;
+    }
+    
+    if (!context.signIn() || !context.loadStudents(false)) {
+        return ExitFailed;
+    }
+    
+    StudentExporter exporter;
+    ProgressReporter progress("Dışa aktarılıyor");
+    QString error;
+    int exported = 0;
+    QEventLoop loop;
+    QObject::connect(&exporter, &StudentExporter::progress, &loop, [&](int done, int total) {
+        progress.update(done, total);
+    });
+    QObject::connect(&exporter, &StudentExporter::finished, &loop, [&](int count) {
+        exported = count;
+        loop.quit();
+    });
+    QObject::connect(&exporter, &StudentExporter::failed, &loop, [&](const QString& message) {
+        error = message;
+        loop.quit();
+    });
+    
+    QElapsedTimer timer;
+    timer.start();
+    exporter.start(context.store.students(), filePath, format);
+    loop.exec();
+    
+    if (!error.isEmpty()) {
+        err() << "Dışa aktarma başarısız: " << error << Qt::endl;
+        return ExitFailed;
+    }
+    qint64 elapsed = timer.elapsed();
+    double megabytes = QFileInfo(filePath).size() / (1024.0 * 1024.0);
+    report("Yazıldı: " + throughput(exported, elapsed)
+           + QString(", %1 MB/sn").arg(megabytes / (qMax<qint64>(elapsed, 1) / 1000.0), 0, 'f', 1));
+    out() << filePath << Qt::endl;
+    return ExitOk;
+}
+
+int runImport(Context& context, const QCommandLineParser& parser, const QString& filePath)
+{
+    if (filePath.isEmpty()) {
+        err() << "import için dosya gerekli" << Qt::endl;
+        return ExitUsage;
+    }
+    if (!QFileInfo::exists(filePath)) {
+        err() << "Dosya bulunamadı: " << filePath << Qt::endl;
+        return ExitUsage;
+    }
+    
+    if (!context.signIn() || !context.loadStudents(true)) {
+        return ExitFailed;
+    }
+    
+    // Writes go through an outbox of their own, so an interrupted import
+    // is finished by the next smctl run without touching the application's
+    WriteOutbox outbox(&context.firestore, &context.store, context.outboxPath());
+    outbox.setBatchSize(parser.value("batch-size").toInt());
+    outbox.load();
+    if (outbox.pendingCount() > 0) {
+        report(QString("Önceki çalışmadan kalan %1 yazma da gönderiliyor").arg(outbox.pendingCount()));
+    }
+    DrainResult writes;
+    connectOutboxReporting(&outbox, &writes);
+    
+    StudentImporter importer;
+    QObject::connect(&importer, &StudentImporter::studentsParsed, &outbox, &WriteOutbox::enqueueSets);
+    
+    ProgressReporter progress("Okunuyor");
+    QString error;
+    QStringList rowErrors;
+    int imported = 0;
+    int unchanged = 0;
+    int changed = 0;
+    bool importDone = false;
+    QEventLoop loop;
+    QElapsedTimer timer;
+    qint64 readElapsed = 0;
+    int timeout = parser.value("timeout").toInt();
+    StallTimer stall(&outbox, &loop, timeout * 1000);
+    
+    auto finishWhenDrained = [&]() {
+        if (importDone && outbox.pendingCount() == 0) {
+            loop.quit();
+        }
+    };
+    QObject::connect(&importer, &StudentImporter::progress, &loop, [&](int rowsRead, int totalRows) {
+        progress.update(rowsRead, totalRows);
+        stall.restart(); // Reading a long run of unchanged rows is progress too
+    });
+    QObject::connect(&importer, &StudentImporter::finished, &loop,
+                     [&](int importedCount, int unchangedCount, int changedCount, const QStringList& errors) {
+        imported = importedCount;
+        unchanged = unchangedCount;
+        changed = changedCount;
+        rowErrors = errors;
+        importDone = true;
+        readElapsed = timer.elapsed();
+        finishWhenDrained();
+    });
+    QObject::connect(&importer, &StudentImporter::failed, &loop, [&](const QString& message) {
+        error = message;
+        loop.quit();
+    });
+    QObject::connect(&outbox, &WriteOutbox::pendingCountChanged, &loop, finishWhenDrained);
+    
+    timer.start();
+    importer.start(filePath, context.store.students(),
+                   parser.isSet("upsert") ? StudentImporter::Upsert : StudentImporter::AddOnly);
+    stall.restart();
+    outbox.flush();
+    loop.exec();
+    
+    if (!error.isEmpty()) {
+        err() << "İçe aktarma başarısız: " << error << Qt::endl;
+        return ExitFailed;
+    }
+    if (stall.expired()) {
+        // Queued writes stay in the outbox file; rows not read yet are
+        // found again by the next import of the same file
+        importer.cancel();
+        reportUnsent(outbox, context.outboxPath(), timeout);
+        return ExitFailed;
+    }
+    
+    for (const QString& rowError : std::as_const(rowErrors)) {
+        err() << rowError << Qt::endl;
+    }
+    report("Okundu: " + throughput(imported + unchanged + changed + rowErrors.size(), readElapsed, "satır"));
+    report("Gönderildi: " + throughput(writes.committed, timer.elapsed(), "yazma"));
+    out() << QString("eklenen=%1 güncellenen=%2 değişmeyen=%3 atlanan=%4 hatalı=%5 reddedilen=%6 çakışan=%7")
+                 .arg(imported)
+                 .arg(parser.isSet("upsert") ? changed : 0)
+                 .arg(unchanged)
+                 .arg(parser.isSet("upsert") ? 0 : changed)
+                 .arg(rowErrors.size())
+                 .arg(writes.rejected)
+                 .arg(writes.conflicts)
+          << Qt::endl;
+    return rowErrors.isEmpty() && writes.rejected == 0 ? ExitOk : ExitFailed;
+}
+
+int runSync(Context& context, const QCommandLineParser& parser)
+{
+    QString snapshotPath = parser.isSet("snapshot") ? parser.value("snapshot") : context.snapshotPath();
+    if (!context.signIn()) {
+        return ExitFailed;
+    }
+    
+    // Writes a previous smctl run could not deliver go out first
+    WriteOutbox outbox(&context.firestore, &context.store, context.outboxPath());
+    outbox.load();
+    DrainResult writes;
+    connectOutboxReporting(&outbox, &writes);
+    bool drained = true;
+    if (outbox.pendingCount() > 0) {
+        report(QString("%1 bekleyen yazma gönderiliyor").arg(outbox.pendingCount()));
+        drained = drainOutbox(&outbox, parser.value("timeout").toInt());
+        if (!drained) {
+            reportUnsent(outbox, context.outboxPath(), parser.value("timeout").toInt());
+        }
+    }
+    
+    // Compare against the cached list the application starts with
+    QHash<QString, QDateTime> previous;
+    if (context.store.loadSnapshot(snapshotPath)) {
+        for (const Student& student : context.store.students()) {
+            previous.insert(student.getId(), student.getLastUpdateTime());
+        }
+    }
+    if (!context.loadStudents(true)) {
+        return ExitFailed;
+    }
+    
+    int added = 0;
+    int updated = 0;
+    for (const Student& student : context.store.students()) {
+        auto it = previous.constFind(student.getId());
+        if (it == previous.constEnd()) {
+            added++;
+        } else {
+            if (it.value() != student.getLastUpdateTime()) {
+                updated++;
+            }
+            previous.erase(it);
+        }
+    }
+    
+    if (!context.store.saveSnapshot(snapshotPath)) {
+        err() << "Önbellek yazılamadı: " << snapshotPath << Qt::endl;
+        return ExitFailed;
+    }
+    out() << QString("toplam=%1 yeni=%2 değişen=%3 silinen=%4 gönderilen=%5 reddedilen=%6")
+                 .arg(context.store.size()).arg(added).arg(updated).arg(previous.size())
+                 .arg(writes.committed).arg(writes.rejected)
+          << Qt::endl;
+    return drained && writes.rejected == 0 ? ExitOk : ExitFailed;
+}
+
+void printDistribution(const QString& title, const QHash<QString, int>& counts, int top)
+{
+    QList<QPair<QString, int>> rows;
+    rows.reserve(counts.size());
+    for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+        rows.append({it.key(), it.value()});
+    }
+    std::sort(rows.begin(), rows.end(), [](const QPair<QString, int>& a, const QPair<QString, int>& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    
+    out() << Qt::endl << title << Qt::endl;
+    for (int i = 0; i < rows.size() && (top <= 0 || i < top); ++i) {
+        out() << QString("%1\t%2").arg(rows[i].second, 8).arg(rows[i].first) << Qt::endl;
+    }
+}
+
+int runStats(Context& context, const QCommandLineParser& parser)
+{
+    if (!context.signIn() || !context.loadStudents(true)) {
+        return ExitFailed;
+    }
+    
+    // Same figures as the statistics dialog
+    const QString unspecified = "Belirtilmemiş";
+    int graduates = 0;
+    QHash<QString, int> schools;
+    QHash<QString, int> fields;
+    QMap<int, int> years;
+    const QList<Student> students = context.store.students();
+    for (const Student& student : students) {
+        if (student.getGraduation()) {
+            graduates++;
+        }
+        schools[student.getSchool().isEmpty() ? unspecified : student.getSchool()]++;
+        fields[student.getField().isEmpty() ? unspecified : student.getField()]++;
+        if (student.getYear() > 0) {
+            years[student.getYear()]++;
+        }
+    }
+    
+    out() << "Toplam Mezun\t" << students.size() << Qt::endl;
+    out() << "Üniversite Mezunu\t" << graduates << Qt::endl;
+    out() << "Devam Eden\t" << students.size() - graduates << Qt::endl;
+    
+    int top = parser.value("top").toInt();
+    printDistribution("Okullar", schools, top);
+    printDistribution("Alanlar", fields, top);
+    
+    out() << Qt::endl << "Yıllar" << Qt::endl;
+    for (auto it = years.constBegin(); it != years.constEnd(); ++it) {
+        out() << QString("%1\t%2").arg(it.value(), 8).arg(it.key()) << Qt::endl;
+    }
+    return ExitOk;
+}
+
+int runGcPhotos(Context& context, const QCommandLineParser& parser)
+{
+    // The collector needs every photoURL, so the full list is loaded first
+    if (!context.signIn() || !context.loadStudents(true)) {
+        return ExitFailed;
+    }
+    
+    PhotoGarbageCollector collector(&context.storage, &context.firestore, &context.store);
+    QStringList orphans;
+    QString error;
+    QEventLoop loop;
+    QElapsedTimer timer;
+    QObject::connect(&collector, &PhotoGarbageCollector::scanFinished, &loop, [&](const QStringList& found, int scanned) {
+        orphans = found;
+        report("Tarandı: " + throughput(scanned, timer.elapsed(), "nesne"));
+        loop.quit();
+    });
+    QObject::connect(&collector, &PhotoGarbageCollector::failed, &loop, [&](const QString& message) {
+        error = message;
+        loop.quit();
+    });
+    
+    timer.start();
+    collector.scan();
+    loop.exec();
+    if (!error.isEmpty()) {
+        err() << "Tarama başarısız: " << error << Qt::endl;
+        return ExitFailed;
+    }
+    
+    for (const QString& path : std::as_const(orphans)) {
+        out() << path << Qt::endl;
+    }
+    if (!parser.isSet("delete") || orphans.isEmpty()) {
+        report(QString("%1 sahipsiz fotoğraf").arg(orphans.size()));
+        return ExitOk;
+    }
+    
+    ProgressReporter progress("Siliniyor");
+    QStringList failedPaths;
+    int deleted = 0;
+    QObject::connect(&collector, &PhotoGarbageCollector::deleteProgress, &loop, [&](int done, int total) {
+        progress.update(done, total);
+    });
+    QObject::connect(&collector, &PhotoGarbageCollector::deleteFinished, &loop, [&](int count, const QStringList& failed) {
+        deleted = count;
+        failedPaths = failed;
+        loop.quit();
+    });
+    
+    timer.restart();
+    collector.deleteOrphans(orphans);
+    loop.exec();
+    if (!error.isEmpty()) {
+        err() << "Silme başarısız: " << error << Qt::endl;
+        return ExitFailed;
+    }
+    
+    for (const QString& path : std::as_const(failedPaths)) {
+        err() << "Silinemedi: " << path << Qt::endl;
+    }
+    report("Silindi: " + throughput(deleted, timer.elapsed(), "fotoğraf"));
+    return failedPaths.isEmpty() ? ExitOk : ExitFailed;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    
+    // Same names as the application, so the saved session, snapshot and
+    // config lookup resolve to the same files
+    app.setApplicationName("NEVRETEM-DER MBS");
+    app.setApplicationVersion(SMCTL_VERSION);
+    app.setOrganizationName("NEVRETEM-DER");
+    app.setOrganizationDomain("nevretem-der.org");
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("NEVRETEM-DER MBS toplu işlemler\n\n"
+                                     "Komutlar:\n"
+                                     "  export     Tüm kayıtları dosyaya aktarır\n"
+                                     "  import     Excel veya CSV dosyasından kayıt ekler\n"
+                                     "  sync       Bekleyen yazmaları gönderir, önbelleği yeniler\n"
+                                     "  stats      Özet istatistikleri yazdırır\n"
+                                     "  gc-photos  Hiçbir kaydın kullanmadığı fotoğrafları listeler");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("command", "export, import, sync, stats veya gc-photos");
+    parser.addPositionalArgument("file", "import: okunacak dosya", "[file]");
+    parser.addOptions({
+        {{"c", "config"}, "Ayar dosyası (varsayılan: uygulamanınki)", "file"},
+        {{"o", "output"}, "export: yazılacak dosya", "file"},
+        {{"f", "format"}, "export: xlsx, csv, arrow veya parquet (varsayılan: dosya uzantısı)", "format"},
+        {"partitions", "Tam yüklemede paralel bölüm sayısı (1-32)", "count"},
+        {"origin", "Firebase yerine bu sunucuya bağlan (ör. smstandin: http://127.0.0.1:9090)", "url"},
+        {"batch-size", "import: commit başına yazma (1-500)", "count", "500"},
+        {"upsert", "import: mevcut kayıtların değişen alanlarını da güncelle"},
+        {"timeout", "import, sync: yazmalar bu kadar saniye ilerlemezse vazgeç, 0 sınırsız", "seconds", "300"},
+        {"snapshot", "sync: önbellek dosyası (varsayılan: uygulamanınki)", "file"},
+        {"top", "stats: listelenecek okul ve alan sayısı, 0 hepsi", "count", "10"},
+        {"delete", "gc-photos: sahipsiz fotoğrafları sil"},
+        {{"q", "quiet"}, "İlerleme ve hız bilgisi yazdırma"},
+        {"verbose", "Servis günlüklerini göster"}
+    });
+    parser.process(app);
+    
+    quiet = parser.isSet("quiet");
+    qInstallMessageHandler(messageOutput);
+    QLoggingCategory::setFilterRules(parser.isSet("verbose") ? "*.debug=false" : "*.debug=false\n*.info=false");
+    
+    const QStringList arguments = parser.positionalArguments();
+    QString command = arguments.value(0);
+    static const QStringList commands = {"export", "import", "sync", "stats", "gc-photos"};
+    if (!commands.contains(command)) {
+        err() << (command.isEmpty() ? QString("Komut gerekli") : "Bilinmeyen komut: " + command) << Qt::endl;
+        parser.showHelp(ExitUsage);
+    }
+    
+    QString configPath = parser.value("config");
+    if (configPath.isEmpty()) {
+        configPath = QCoreApplication::applicationDirPath() + "/../../config.ini";
+        if (!QFile::exists(configPath)) {
+            configPath = "config.ini";
+        }
+    }
+    
+    Context context;
+    if (!context.configure(configPath, parser.value("partitions").toInt(), parser.value("origin"))) {
+        return ExitUsage;
+    }
+    NetworkAccess::prewarm();
+    
+    if (command == "export") {
+        return runExport(context, parser);
+    } else if (command == "import") {
+        return runImport(context, parser, arguments.value(1));
+    } else if (command == "sync") {
+        return runSync(context, parser);
+    } else if (command == "stats") {
+        return runStats(context, parser);
+    }
+    return runGcPhotos(context, parser);
+}
@@ -0,0 +1,198 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QLocale>
+#include <QStandardPaths>
+#include <climits>
+
+#include "datasetgenerator.h"
+#include "logging.h"
+#include "networkaccess.h"
+#include "studentstore.h"
+#include "studentwriter.h"
+
+/*
+ * smgen - Synthetic student datasets for benchmarks
+ *
+ *   smgen --count 100k -o ogrenciler.csv      # or .xlsx, .arrow, .parquet
+ *   smgen --count 1m --snapshot students.json # for smstandin --data
+ *   smgen --count 10k --store --project ID    # the application's local copy
+ *
+ * The same --count and --seed give the same students (and IDs) as
+ * smstandin --students, so results from file, store and stand-in runs can
+ * be compared. Exit code 0 on success, 1 when writing failed, 2 for usage
+ * errors.
+ */
+
+namespace {
+const int ExitOk = 0;
+const int ExitFailed = 1;
+const int ExitUsage = 2;
+
+using Console::out;
+using Console::err;
+
+QString throughput(qint64 count, qint64 elapsedMs)
+{
+    double seconds = qMax<qint64>(elapsedMs, 1) / 1000.0;
+    QLocale locale(QLocale::Turkish);
+    return QString("%1 kayıt, %2 sn, %3 kayıt/sn")
+        .arg(locale.toString(count), locale.toString(seconds, 'f', 1),
+             locale.toString(qRound64(count / seconds)));
+}
+
+// "250", "10k", "1m"
+qint64 parseCount(const QString& text)
+{
+    QString value = text.trimmed().toLower();
+    qint64 factor = 1;
+    if (value.endsWith('k')) {
+        factor = 1000;
+        value.chop(1);
+    } else if (value.endsWith('m')) {
+        factor = 1000000;
+        value.chop(1);
+    }
+    bool ok = false;
+    qint64 count = value.toLongLong(&ok);
+    return ok && count > 0 ? count * factor : -1;
+}
+
+QString universitiesPath(const QString& requested)
+{
+    if (!requested.isEmpty()) {
+        return requested;
+    }
+    // Copied next to the executables by the build, else the source tree
+    QString path = QDir(QCoreApplication::applicationDirPath()).filePath("universities.json");
+    return QFile::exists(path) ? path : "src/universities.json";
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    
+    // The application's names, so --store finds its data directory
+    app.setApplicationName("NEVRETEM-DER MBS");
+    app.setApplicationVersion(SMCTL_VERSION);
+    app.setOrganizationName("NEVRETEM-DER");
+    app.setOrganizationDomain("nevretem-der.org");
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Karşılaştırmalı ölçümler için örnek öğrenci verisi üretir");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        {{"n", "count"}, "Kayıt sayısı, ör. 1000, 10k, 1m", "count"},
+        {{"o", "output"}, "Yazılacak dosya (xlsx, csv, arrow, parquet)", "file"},
+        {{"f", "format"}, "xlsx, csv, arrow veya parquet (varsayılan: dosya uzantısı)", "format"},
+        {"snapshot", "Önbellek dosyası olarak yaz (smstandin --data)", "file"},
+        {"store", "Uygulamanın bu proje için yerel kopyasının yerine yaz"},
+        {"project", "Fotoğraf adreslerindeki ve --store için proje kimliği", "id", "demo"},
+        {"origin", "Fotoğraf adreslerinde Firebase yerine bu sunucu", "url"},
+        {"seed", "Rastgele sayı tohumu", "number", "1"},
+        {"skew", "Okul ve bölüm dağılımının Zipf üssü", "exponent", "1.0"},
+        {"photo-rate", "Fotoğrafı olan kayıtların oranı (0-1)", "rate", "0.7"},
+        {"universities", "Okul listesi (varsayılan: universities.json)", "file"},
+        {{"q", "quiet"}, "Hız bilgisi yazdırma"}
+    });
+    parser.process(app);
+    
+    qint64 count = parseCount(parser.value("count"));
+    if (count <= 0 || count > INT_MAX) {
+        err() << "Geçerli bir --count gerekli" << Qt::endl;
+        parser.showHelp(ExitUsage);
+    }
+    if (!parser.isSet("output") && !parser.isSet("snapshot") && !parser.isSet("store")) {
+        err() << "Çıktı gerekli: --output, --snapshot veya --store" << Qt::endl;
+        return ExitUsage;
+    }
+    
+    StudentWriter::Format format = StudentWriter::formatForPath(parser.value("output"));
+    if (parser.isSet("format") && !StudentWriter::formatForName(parser.value("format"), &format)) {
+        err() << "Bilinmeyen biçim: " << parser.value("format") << Qt::endl;
+        return ExitUsage;
+    }
+    if (parser.isSet("output") && !StudentWriter::availableFormats().contains(format)) {
+        err() << "Bu derleme " << StudentWriter::suffix(format) << " biçimini desteklemiyor" << Qt::endl;
+        return ExitUsage;
+    }
+    
+    NetworkAccess::setOriginOverride(parser.value("origin"));
+    DatasetGenerator generator(parser.value("seed").toUInt());
+    QString schoolsPath = universitiesPath(parser.value("universities"));
+    if (!generator.loadSchools(schoolsPath)) {
+        err() << "Okul listesi okunamadı (" << schoolsPath << "), büyük üniversitelerle devam ediliyor" << Qt::endl;
+    }
+    generator.setSkew(parser.value("skew").toDouble());
+    generator.setPhotoRate(parser.value("photo-rate").toDouble());
+    generator.setProjectId(parser.value("project"));
+    
+    bool quiet = parser.isSet("quiet");
+    QElapsedTimer timer;
+    timer.start();
+    
+    // Files are written as the records are made, so memory stays flat;
+    // the store outputs need the whole set
+    bool keep = parser.isSet("snapshot") || parser.isSet("store");
+    QList<Student> students;
+    if (keep) {
+        students.reserve(count);
+    }
+    std::unique_ptr<StudentWriter> writer;
+    if (parser.isSet("output")) {
+        writer = StudentWriter::create(format, parser.value("output"));
+        if (!writer->open()) {
+            err() << "Dosya açılamadı: " << writer->errorString() << Qt::endl;
+            return ExitFailed;
+        }
+    }
+    for (qint64 i = 0; i < count; ++i) {
+        Student student = generator.next();
+        if (writer && !writer->write(student)) {
+            err() << "Yazılamadı: " << writer->errorString() << Qt::endl;
+            writer->discard();
+            return ExitFailed;
+        }
+        if (keep) {
+            students.append(student);
+        }
+    }
+    if (writer && !writer->close()) {
+        err() << "Yazılamadı: " << writer->errorString() << Qt::endl;
+        return ExitFailed;
+    }
+    
+    if (keep) {
+        StudentStore store;
+        store.replaceAll(students);
+        QStringList paths;
+        if (parser.isSet("snapshot")) {
+            paths.append(parser.value("snapshot"));
+        }
+        if (parser.isSet("store")) {
+            // Same location as MainWindow's snapshot for the project
+            QString directory = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+            QDir().mkpath(directory);
+            paths.append(directory + QString("/students-%1.json").arg(parser.value("project")));
+        }
+        for (const QString& path : std::as_const(paths)) {
+            if (!store.saveSnapshot(path)) {
+                err() << "Önbellek dosyası yazılamadı: " << path << Qt::endl;
+                return ExitFailed;
+            }
+            out() << path << Qt::endl;
+        }
+    }
+    
+    if (writer) {
+        out() << parser.value("output") << Qt::endl;
+    }
+    if (!quiet) {
+        err() << "Üretildi: " << throughput(count, timer.elapsed()) << Qt::endl;
+    }
+    return ExitOk;
+}
@@ -0,0 +1,155 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QLoggingCategory>
+#include <QUrlQuery>
+
+#include "firebasestandin.h"
+#include "datasetgenerator.h"
+#include "logging.h"
+#include "studentstore.h"
+
+/*
+ * smstandin - Local Firestore, Storage and Auth stand-in
+ *
+ *   smstandin [--port 9090] [--students N [--photo JPEG] | --data FILE]
+ *             [--latency MS] [--jitter MS]
+ *             [--error-rate R] [--errors 429,503] [--fail-next N:STATUS]
+ *             [--user EMAIL:PASSWORD] [--token-lifetime S] [--seed N]
+ *
+ * Serves until interrupted. Point the application or smctl at it with
+ *
+ *   [endpoints]
+ *   origin=http://127.0.0.1:9090
+ *
+ * in config.ini, or smctl --origin. The project ID and API key in
+ * config.ini are accepted as they are.
+ */
+
+namespace {
+const int ExitOk = 0;
+const int ExitFailed = 1;
+const int ExitUsage = 2;
+
+using Console::out;
+using Console::err;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("smstandin");
+    app.setApplicationVersion(SMCTL_VERSION);
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Firestore, Storage ve Auth yerine geçen yerel test sunucusu");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        {"host", "Dinlenecek adres", "address", "127.0.0.1"},
+        {{"p", "port"}, "Dinlenecek port, 0 rastgele", "port", "9090"},
+        {"students", "Üretilecek örnek kayıt sayısı (smgen ile aynı veri)", "count", "0"},
+        {"photo", "Üretilen kayıtların fotoğrafı olarak sunulacak JPEG", "file"},
+        {"data", "Kayıtları bu önbellek dosyasından yükle", "file"},
+        {"latency", "Her yanıta eklenen gecikme (ms)", "ms", "0"},
+        {"jitter", "Gecikmeye eklenen rastgele en fazla süre (ms)", "ms", "0"},
+        {"error-rate", "Firestore ve Storage isteklerinin rastgele hata oranı (0-1)", "rate", "0"},
+        {"errors", "Rastgele hatalarda kullanılacak durum kodları", "codes", "429,503"},
+        {"fail-next", "İlk N isteği bu durum koduyla reddet", "count:status"},
+        {"user", "Kabul edilecek kullanıcı; verilmezse her giriş kabul edilir", "email:password"},
+        {"token-lifetime", "Kimlik jetonlarının geçerlilik süresi (s)", "seconds", "3600"},
+        {"seed", "Rastgele sayı tohumu", "number", "1"},
+        {{"q", "quiet"}, "İstekleri yazdırma"}
+    });
+    parser.process(app);
+    
+    QLoggingCategory::setFilterRules("*.debug=false");
+    
+    FirebaseStandIn standIn;
+    quint32 seed = parser.value("seed").toUInt();
+    standIn.setSeed(seed);
+    standIn.setTokenLifetime(qMax(1, parser.value("token-lifetime").toInt()));
+    standIn.setLatency(parser.value("latency").toInt(), parser.value("jitter").toInt());
+    
+    QList<int> statuses;
+    const QStringList codes = parser.value("errors").split(',', Qt::SkipEmptyParts);
+    for (const QString& code : codes) {
+        int status = code.trimmed().toInt();
+        if (status < 400 || status > 599) {
+            err() << "Geçersiz durum kodu: " << code << Qt::endl;
+            return ExitUsage;
+        }
+        statuses.append(status);
+    }
+    standIn.setErrorRate(parser.value("error-rate").toDouble(), statuses);
+    
+    if (parser.isSet("fail-next")) {
+        QStringList parts = parser.value("fail-next").split(':');
+        if (parts.size() != 2 || parts[0].toInt() <= 0 || parts[1].toInt() < 400) {
+            err() << "--fail-next biçimi: adet:durum, ör. 3:503" << Qt::endl;
+            return ExitUsage;
+        }
+        standIn.failNext(parts[0].toInt(), parts[1].toInt());
+    }
+    
+    const QStringList users = parser.values("user");
+    for (const QString& user : users) {
+        int colon = user.indexOf(':');
+        if (colon <= 0) {
+            err() << "--user biçimi: eposta:parola" << Qt::endl;
+            return ExitUsage;
+        }
+        standIn.addUser(user.left(colon), user.mid(colon + 1));
+    }
+    
+    if (!standIn.listen(QHostAddress(parser.value("host")), quint16(parser.value("port").toUInt()))) {
+        err() << "Dinlenemedi: " << standIn.errorString() << Qt::endl;
+        return ExitFailed;
+    }
+    
+    if (parser.isSet("data")) {
+        StudentStore store;
+        if (!store.loadSnapshot(parser.value("data"))) {
+            err() << "Önbellek dosyası okunamadı: " << parser.value("data") << Qt::endl;
+            return ExitFailed;
+        }
+        standIn.setStudents(store.students());
+    }
+    
+    // Generated after listening, so the photo URLs carry this origin
+    int count = parser.value("students").toInt();
+    if (count > 0) {
+        DatasetGenerator generator(seed);
+        generator.loadSchools(QDir(QCoreApplication::applicationDirPath()).filePath("universities.json"));
+        generator.setProjectId("standin", standIn.origin());
+        QList<Student> students = generator.generate(count);
+        standIn.addStudents(students);
+        
+        if (parser.isSet("photo")) {
+            QFile photo(parser.value("photo"));
+            if (!photo.open(QIODevice::ReadOnly)) {
+                err() << "Fotoğraf okunamadı: " << photo.fileName() << Qt::endl;
+                return ExitFailed;
+            }
+            QByteArray data = photo.readAll();
+            for (const Student& student : std::as_const(students)) {
+                if (!student.getPhotoURL().isEmpty()) {
+                    QString token = QUrlQuery(QUrl(student.getPhotoURL())).queryItemValue("token");
+                    standIn.putObject(DatasetGenerator::photoPath(student.getId()), data, "image/jpeg", token);
+                }
+            }
+        }
+    }
+    
+    if (!parser.isSet("quiet")) {
+        QObject::connect(&standIn, &FirebaseStandIn::requestHandled,
+                         [](const QString& method, const QString& path, int status) {
+            err() << status << ' ' << method << ' ' << path << Qt::endl;
+        });
+    }
+    
+    out() << standIn.documentCount() << " kayıt, " << standIn.origin() << " adresinde hazır" << Qt::endl;
+    out() << "config.ini:\n[endpoints]\norigin=" << standIn.origin() << Qt::endl;
+    return app.exec() == 0 ? ExitOk : ExitFailed;
+}
@@ -9,9 +9,40 @@
 #include <QPushButton>
 #include <QStyle>
 #include <algorithm>
+#include "firestoreservice.h"
+#include "firestorequery.h"
+
+// Label used for students without a school or field; has no server-side equivalent
+static const char* const UnspecifiedLabel = "Belirtilmemiş";
+
+// Tags of this dialog's server requests
+static const char* const TagPrefix = "stats:";
+static const char* const TotalTag = "stats:total";
+static const char* const GraduatesTag = "stats:graduates";
+static const char* const SchoolTagPrefix = "stats:school:";
+static const char* const FieldTagPrefix = "stats:field:";
+static const char* const KeysTag = "stats:keys";
+
+// Rows per chart
+static const int TopRows = 5;
+
+// Without local data, the schools and fields to count come from this many
+// recent records; the most frequent candidates are counted on the server
+static const int KeySampleSize = 1000;
+static const int KeyCandidates = 10;
 
 StatisticsDialog::StatisticsDialog(const QList<Student>& students, QWidget *parent)
     : QDialog(parent), m_students(students)
+    , m_firestoreService(nullptr)
+    , m_totalValueLabel(nullptr)
+    , m_graduatesValueLabel(nullptr)
+    , m_activeValueLabel(nullptr)
+    , m_sourceLabel(nullptr)
+    , m_serverButton(nullptr)
+    , m_schoolsLayout(nullptr)
+    , m_fieldsLayout(nullptr)
+    , m_pendingAggregations(0)
+    , m_serverCountsFailed(false)
 {
     setWindowTitle("İstatistik Paneli");
     resize(900, 700);
@@ -36,12 +67,12 @@ void StatisticsDialog::calculateStatistics()
         
         // School distribution
         QString school = s.getSchool();
-        if (school.isEmpty()) school = "Belirtilmemiş";
+        if (school.isEmpty()) school = UnspecifiedLabel;
         m_schoolDistribution[school]++;
         
         // Field distribution
         QString field = s.getField();
-        if (field.isEmpty()) field = "Belirtilmemiş";
+        if (field.isEmpty()) field = UnspecifiedLabel;
         m_fieldDistribution[field]++;
         
         // Year distribution
@@ -78,9 +109,9 @@ void StatisticsDialog::setupUI()
     QHBoxLayout* cardsLayout = new QHBoxLayout();
     cardsLayout->setSpacing(20);
     
-    cardsLayout->addWidget(createSummaryCard("Toplam Mezun", QString::number(m_totalStudents), "", "#2B7A8C"));
-    cardsLayout->addWidget(createSummaryCard("Üniversite Mezunu", QString::number(m_graduates), "", "#2C5AA0"));
-    cardsLayout->addWidget(createSummaryCard("Devam Eden", QString::number(m_activeStudents), "", "#C9A962"));
+    cardsLayout->addWidget(createSummaryCard("Toplam Mezun", QString::number(m_totalStudents), "", "#2B7A8C", &m_totalValueLabel));
+    cardsLayout->addWidget(createSummaryCard("Üniversite Mezunu", QString::number(m_graduates), "", "#2C5AA0", &m_graduatesValueLabel));
+    cardsLayout->addWidget(createSummaryCard("Devam Eden", QString::number(m_activeStudents), "", "#C9A962", &m_activeValueLabel));
     
     contentLayout->addLayout(cardsLayout);
     
@@ -93,6 +124,7 @@ void StatisticsDialog::setupUI()
     schoolsFrame->setObjectName("statsCard");
     schoolsFrame->setStyleSheet("#statsCard { background: rgba(30, 95, 111, 0.4); border: 1px solid #C9A962; border-radius: 12px; }");
     QVBoxLayout* schoolsLayout = new QVBoxLayout(schoolsFrame);
+    m_schoolsLayout = schoolsLayout;
     schoolsLayout->setContentsMargins(20, 20, 20, 20);
     
     QLabel* schoolsTitle = new QLabel("En Çok Öğrenci Olan Okullar");
@@ -109,8 +141,8 @@ void StatisticsDialog::setupUI()
     // Show top 5
     int count = 0;
     for (const auto& pair : sortedSchools) {
-        if (count++ >= 5) break;
-        schoolsLayout->addWidget(createChartRow(pair.second, pair.first, m_totalStudents, "#C9A962"));
+        if (count++ >= TopRows) break;
+        schoolsLayout->addWidget(createChartRow(pair.second, pair.first, m_totalStudents, "#C9A962", &m_schoolRows[pair.second]));
     }
     schoolsLayout->addStretch();
     
@@ -119,6 +151,7 @@ void StatisticsDialog::setupUI()
     fieldsFrame->setObjectName("statsCard");
     fieldsFrame->setStyleSheet("#statsCard { background: rgba(30, 95, 111, 0.4); border: 1px solid #C9A962; border-radius: 12px; }");
     QVBoxLayout* fieldsLayout = new QVBoxLayout(fieldsFrame);
+    m_fieldsLayout = fieldsLayout;
     fieldsLayout->setContentsMargins(20, 20, 20, 20);
     
     QLabel* fieldsTitle = new QLabel("En Çok Tercih Edilen Alanlar");
@@ -135,8 +168,8 @@ void StatisticsDialog::setupUI()
     // Show top 5
     count = 0;
     for (const auto& pair : sortedFields) {
-        if (count++ >= 5) break;
-        fieldsLayout->addWidget(createChartRow(pair.second, pair.first, m_totalStudents, "#2B7A8C"));
+        if (count++ >= TopRows) break;
+        fieldsLayout->addWidget(createChartRow(pair.second, pair.first, m_totalStudents, "#2B7A8C", &m_fieldRows[pair.second]));
     }
     fieldsLayout->addStretch();
     
@@ -151,7 +184,19 @@ void StatisticsDialog::setupUI()
     
     // Close button
     QHBoxLayout* buttonLayout = new QHBoxLayout();
+    
+    m_sourceLabel = new QLabel("Sayılar yüklenmiş verilerden hesaplandı");
+    m_sourceLabel->setStyleSheet("color: rgba(255, 255, 255, 0.7); background: transparent;");
+    buttonLayout->addWidget(m_sourceLabel);
     buttonLayout->addStretch();
+    
+    m_serverButton = new QPushButton("Sunucudan Güncelle");
+    m_serverButton->setCursor(Qt::PointingHandCursor);
+    m_serverButton->setToolTip("Sayıları Firestore üzerinde hesaplat (tüm veriyi indirmeden)");
+    m_serverButton->setVisible(false);
+    connect(m_serverButton, &QPushButton::clicked, this, &StatisticsDialog::onRefreshFromServer);
+    buttonLayout->addWidget(m_serverButton);
+    
     QPushButton* closeButton = new QPushButton("Kapat");
     closeButton->setCursor(Qt::PointingHandCursor);
     closeButton->setStyleSheet(
@@ -173,7 +218,8 @@ void StatisticsDialog::setupUI()
     mainLayout->addLayout(buttonLayout);
 }
 
-QWidget* StatisticsDialog::createSummaryCard(const QString& title, const QString& value, const QString& iconPath, const QString& color)
+QWidget* StatisticsDialog::createSummaryCard(const QString& title, const QString& value, const QString& iconPath, const QString& color,
+                                             QLabel** valueLabelOut)
 {
     Q_UNUSED(iconPath);
     QFrame* card = new QFrame();
@@ -198,10 +244,15 @@ QWidget* StatisticsDialog::createSummaryCard(const QString& title, const QString
     layout->addWidget(valueLabel);
     layout->addStretch();
     
+    if (valueLabelOut) {
+        *valueLabelOut = valueLabel;
+    }
+    
     return card;
 }
 
-QWidget* StatisticsDialog::createChartRow(const QString& label, int value, int total, const QString& color)
+QWidget* StatisticsDialog::createChartRow(const QString& label, int value, int total, const QString& color,
+                                          ChartRowWidgets* widgets)
 {
     QWidget* row = new QWidget();
     QVBoxLayout* layout = new QVBoxLayout(row);
@@ -239,5 +290,225 @@ QWidget* StatisticsDialog::createChartRow(const QString& label, int value, int t
     layout->addLayout(headerLayout);
     layout->addWidget(bar);
     
+    if (widgets) {
+        widgets->countLabel = countLabel;
+        widgets->bar = bar;
+    }
+    
     return row;
 }
+
+void StatisticsDialog::setFirestoreService(FirestoreService* service, bool refreshNow)
+{
+    m_firestoreService = service;
+    if (!m_firestoreService) {
+        return;
+    }
+    
+    connect(m_firestoreService, &FirestoreService::aggregationReceived,
+            this, &StatisticsDialog::onAggregationReceived);
+    connect(m_firestoreService, &FirestoreService::queryResultsReceived,
+            this, &StatisticsDialog::onKeysReceived);
+    connect(m_firestoreService, &FirestoreService::queryFailed, this, [this](const QString& tag) {
+        if (!tag.startsWith(TagPrefix) || m_pendingAggregations <= 0) {
+            return;
+        }
+        // The other counts still arrive; a row keeps its local figure and a
+        // candidate without a count is not shown as zero
+        qCWarning(firestoreLog) << "Server count failed for" << tag;
+        m_serverCountsFailed = true;
+        if (tag.startsWith(SchoolTagPrefix)) {
+            m_schoolCandidates.remove(tag.mid(QString(SchoolTagPrefix).size()));
+        } else if (tag.startsWith(FieldTagPrefix)) {
+            m_fieldCandidates.remove(tag.mid(QString(FieldTagPrefix).size()));
+        }
+        if (--m_pendingAggregations == 0) {
+            finishServerCounts();
+        }
+    });
+    m_serverButton->setVisible(true);
+    
+    if (refreshNow) {
+        onRefreshFromServer();
+    }
+}
+
+void StatisticsDialog::onRefreshFromServer()
+{
+    if (!m_firestoreService || m_pendingAggregations > 0) {
+        return;
+    }
+    
+    // One COUNT per card and per chart row shown; each is a single small
+    // request regardless of collection size
+    m_firestoreService->runCountQuery(FirestoreQuery(), TotalTag);
+    m_firestoreService->runCountQuery(FirestoreQuery().where("graduation", FirestoreQuery::Equal, true), GraduatesTag);
+    m_pendingAggregations = 2;
+    m_serverCountsFailed = false;
+    m_schoolCandidates.clear();
+    m_fieldCandidates.clear();
+    
+    for (auto it = m_schoolRows.constBegin(); it != m_schoolRows.constEnd(); ++it) {
+        if (it.key() == UnspecifiedLabel) continue;
+        m_firestoreService->runCountQuery(FirestoreQuery().where("school", FirestoreQuery::Equal, it.key()),
+                                          SchoolTagPrefix + it.key());
+        m_pendingAggregations++;
+    }
+    for (auto it = m_fieldRows.constBegin(); it != m_fieldRows.constEnd(); ++it) {
+        if (it.key() == UnspecifiedLabel) continue;
+        m_firestoreService->runCountQuery(FirestoreQuery().where("field", FirestoreQuery::Equal, it.key()),
+                                          FieldTagPrefix + it.key());
+        m_pendingAggregations++;
+    }
+    
+    // Nothing loaded locally: find out which schools and fields to count
+    if (m_schoolRows.isEmpty() || m_fieldRows.isEmpty()) {
+        FirestoreQuery sample;
+        sample.select({"school", "field"})
+              .orderBy("lastUpdateTime", FirestoreQuery::Descending)
+              .limit(KeySampleSize);
+        m_firestoreService->runQuery(sample, KeysTag);
+        m_pendingAggregations++;
+    }
+    
+    m_serverButton->setEnabled(false);
+    m_sourceLabel->setText("Sayılar sunucudan alınıyor...");
+}
+
+void StatisticsDialog::onKeysReceived(const QString& tag, const QList<Student>& students)
+{
+    if (tag != KeysTag || m_pendingAggregations <= 0) {
+        return;
+    }
+    
+    QHash<QString, int> schools;
+    QHash<QString, int> fields;
+    for (const Student& student : students) {
+        if (!student.getSchool().isEmpty()) schools[student.getSchool()]++;
+        if (!student.getField().isEmpty()) fields[student.getField()]++;
+    }
+    
+    // The most frequent keys of the sample are counted on the server
+    auto topKeys = [](const QHash<QString, int>& frequencies) {
+        QList<QPair<int, QString>> sorted;
+        for (auto it = frequencies.constBegin(); it != frequencies.constEnd(); ++it) {
+            sorted.append({it.value(), it.key()});
+        }
+        std::sort(sorted.begin(), sorted.end(), std::greater<QPair<int, QString>>());
+        QStringList keys;
+        for (int i = 0; i < sorted.size() && i < KeyCandidates; ++i) {
+            keys.append(sorted[i].second);
+        }
+        return keys;
+    };
+    
+    if (m_schoolRows.isEmpty()) {
+        const QStringList keys = topKeys(schools);
+        for (const QString& school : keys) {
+            m_schoolCandidates.insert(school, 0);
+            m_firestoreService->runCountQuery(FirestoreQuery().where("school", FirestoreQuery::Equal, school),
+                                              SchoolTagPrefix + school);
+            m_pendingAggregations++;
+        }
+    }
+    if (m_fieldRows.isEmpty()) {
+        const QStringList keys = topKeys(fields);
+        for (const QString& field : keys) {
+            m_fieldCandidates.insert(field, 0);
+            m_firestoreService->runCountQuery(FirestoreQuery().where("field", FirestoreQuery::Equal, field),
+                                              FieldTagPrefix + field);
+            m_pendingAggregations++;
+        }
+    }
+    
+    if (--m_pendingAggregations == 0) {
+        finishServerCounts();
+    }
+}
+
+void StatisticsDialog::onAggregationReceived(const QString& tag, qint64 count)
+{
+    if (m_pendingAggregations <= 0) {
+        return;
+    }
+    
+    int value = static_cast<int>(count);
+    if (tag == TotalTag) {
+        m_totalStudents = value;
+        updateTotals();
+    } else if (tag == GraduatesTag) {
+        m_graduates = value;
+        updateTotals();
+    } else if (tag.startsWith(SchoolTagPrefix)) {
+        QString school = tag.mid(QString(SchoolTagPrefix).size());
+        ChartRowWidgets widgets = m_schoolRows.value(school);
+        if (widgets.countLabel) {
+            widgets.countLabel->setText(QString::number(value));
+            widgets.bar->setValue(value);
+        } else if (m_schoolCandidates.contains(school)) {
+            m_schoolCandidates[school] = value;
+        }
+    } else if (tag.startsWith(FieldTagPrefix)) {
+        QString field = tag.mid(QString(FieldTagPrefix).size());
+        ChartRowWidgets widgets = m_fieldRows.value(field);
+        if (widgets.countLabel) {
+            widgets.countLabel->setText(QString::number(value));
+            widgets.bar->setValue(value);
+        } else if (m_fieldCandidates.contains(field)) {
+            m_fieldCandidates[field] = value;
+        }
+    } else {
+        return;
+    }
+    
+    if (--m_pendingAggregations == 0) {
+        finishServerCounts();
+    }
+}
+
+void StatisticsDialog::finishServerCounts()
+{
+    addServerRows(m_schoolsLayout, &m_schoolRows, m_schoolCandidates, "#C9A962");
+    addServerRows(m_fieldsLayout, &m_fieldRows, m_fieldCandidates, "#2B7A8C");
+    m_schoolCandidates.clear();
+    m_fieldCandidates.clear();
+    updateTotals();
+    
+    m_serverButton->setEnabled(true);
+    m_sourceLabel->setText(m_serverCountsFailed ? "Sayıların bir kısmı sunucudan alınamadı"
+                                                : "Sayılar sunucudan alındı");
+}
+
+void StatisticsDialog::addServerRows(QVBoxLayout* layout, QHash<QString, ChartRowWidgets>* rows,
+                                     const QHash<QString, int>& counts, const QString& color)
+{
+    QList<QPair<int, QString>> sorted;
+    for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+        sorted.append({it.value(), it.key()});
+    }
+    std::sort(sorted.begin(), sorted.end(), std::greater<QPair<int, QString>>());
+    
+    // Above the stretch that closes the column
+    for (int i = 0; i < sorted.size() && i < TopRows; ++i) {
+        const QString& key = sorted[i].second;
+        layout->insertWidget(layout->count() - 1,
+                             createChartRow(key, sorted[i].first, m_totalStudents, color, &(*rows)[key]));
+    }
+}
+
+void StatisticsDialog::updateTotals()
+{
+    // Active students are everyone not marked as graduated, matching calculateStatistics()
+    m_activeStudents = qMax(0, m_totalStudents - m_graduates);
+    m_totalValueLabel->setText(QString::number(m_totalStudents));
+    m_graduatesValueLabel->setText(QString::number(m_graduates));
+    m_activeValueLabel->setText(QString::number(m_activeStudents));
+    
+    // Bars are drawn relative to the total
+    for (const ChartRowWidgets& widgets : std::as_const(m_schoolRows)) {
+        widgets.bar->setRange(0, m_totalStudents);
+    }
+    for (const ChartRowWidgets& widgets : std::as_const(m_fieldRows)) {
+        widgets.bar->setRange(0, m_totalStudents);
+    }
+}
@@ -4,12 +4,15 @@
 #include <QDialog>
 #include <QList>
 #include <QMap>
+#include <QHash>
 #include "student.h"
 
 class QVBoxLayout;
 class QGridLayout;
 class QLabel;
 class QProgressBar;
+class QPushButton;
+class FirestoreService;
 
 class StatisticsDialog : public QDialog
 {
@@ -17,16 +20,39 @@ class StatisticsDialog : public QDialog
 
 public:
     explicit StatisticsDialog(const QList<Student>& students, QWidget *parent = nullptr);
+    
+    // Enables server-side counts via runAggregationQuery. When refreshNow is
+    // set (local data partial or stale) the counts are requested immediately,
+    // otherwise only when the user asks for them. Without local data the
+    // schools and fields to count are taken from a sample of recent records.
+    void setFirestoreService(FirestoreService* service, bool refreshNow = false);
+
+private slots:
+    void onRefreshFromServer();
+    void onAggregationReceived(const QString& tag, qint64 count);
+    void onKeysReceived(const QString& tag, const QList<Student>& students);
 
 private:
+    struct ChartRowWidgets {
+        QLabel* countLabel = nullptr;
+        QProgressBar* bar = nullptr;
+    };
+    
     void setupUI();
     void calculateStatistics();
     
     // Helper to create a summary card
-    QWidget* createSummaryCard(const QString& title, const QString& value, const QString& iconPath, const QString& color);
+    QWidget* createSummaryCard(const QString& title, const QString& value, const QString& iconPath, const QString& color,
+                               QLabel** valueLabel = nullptr);
     
     // Helper to create a progress bar row for charts
-    QWidget* createChartRow(const QString& label, int value, int total, const QString& color);
+    QWidget* createChartRow(const QString& label, int value, int total, const QString& color,
+                            ChartRowWidgets* widgets = nullptr);
+    
+    void updateTotals();
+    void finishServerCounts();
+    void addServerRows(QVBoxLayout* layout, QHash<QString, ChartRowWidgets>* rows,
+                       const QHash<QString, int>& counts, const QString& color);
 
     QList<Student> m_students;
     
@@ -37,6 +63,22 @@ private:
     QMap<QString, int> m_schoolDistribution;
     QMap<QString, int> m_fieldDistribution;
     QMap<int, int> m_yearDistribution;
+    
+    // Widgets updated with server-side counts
+    FirestoreService* m_firestoreService;
+    QLabel* m_totalValueLabel;
+    QLabel* m_graduatesValueLabel;
+    QLabel* m_activeValueLabel;
+    QLabel* m_sourceLabel;
+    QPushButton* m_serverButton;
+    QHash<QString, ChartRowWidgets> m_schoolRows;
+    QHash<QString, ChartRowWidgets> m_fieldRows;
+    QVBoxLayout* m_schoolsLayout;
+    QVBoxLayout* m_fieldsLayout;
+    QHash<QString, int> m_schoolCandidates; // Server counts for schools without a row yet
+    QHash<QString, int> m_fieldCandidates;
+    int m_pendingAggregations;
+    bool m_serverCountsFailed; // Some counts of the current refresh failed
 };
 
 #endif // STATISTICSDIALOG_H
@@ -1,12 +1,16 @@
 #include "student.h"
 #include <QUuid>
 #include <QTimeZone>
+#include <QList>
+#include <QPair>
 
 Student::Student()
     : m_number("")
     , m_year(0)
     , m_graduation(false)
     , m_lastUpdateTime(QDateTime::currentDateTimeUtc())
+    , m_partial(false)
+    , m_dirty(0)
 {
 }
 
@@ -24,6 +28,8 @@ Student::Student(const QString& id, const QString& name, const QString& email,
     , m_graduation(graduation)
     , m_photoURL(photoURL)
     , m_lastUpdateTime(QDateTime::currentDateTimeUtc())
+    , m_partial(false)
+    , m_dirty(0)
 {
 }
 
@@ -64,9 +70,76 @@ void Student::fromJson(const QJsonObject& json)
         // For existing records without lastUpdateTime, use epoch time (oldest)
         m_lastUpdateTime = QDateTime::fromSecsSinceEpoch(0, QTimeZone::utc());
     }
+    
+    // Freshly loaded values are not modifications
+    m_dirty = 0;
 }
 
 bool Student::isValid() const
 {
     return !m_name.isEmpty() && !m_email.isEmpty() && !m_field.isEmpty() && !m_school.isEmpty();
 }
+
+QStringList Student::changedFields(const Student& other) const
+{
+    QStringList fields;
+    const QJsonObject mine = toJson();
+    const QJsonObject theirs = other.toJson();
+    for (auto it = mine.begin(); it != mine.end(); ++it) {
+        if (it.key() != "id" && it.value() != theirs.value(it.key())) {
+            fields.append(it.key());
+        }
+    }
+    return fields;
+}
+
+QStringList Student::dirtyFields() const
+{
+    static const QList<QPair<DirtyFlag, QString>> fieldNames = {
+        {NameDirty, "name"},
+        {EmailDirty, "email"},
+        {DescriptionDirty, "description"},
+        {FieldDirty, "field"},
+        {SchoolDirty, "school"},
+        {NumberDirty, "number"},
+        {YearDirty, "year"},
+        {GraduationDirty, "graduation"},
+        {PhotoURLDirty, "photoURL"},
+        {LastUpdateTimeDirty, "lastUpdateTime"}
+    };
+    
+    QStringList fields;
+    for (const auto& entry : fieldNames) {
+        if (m_dirty & entry.first) {
+            fields.append(entry.second);
+        }
+    }
+    return fields;
+}
+
+void Student::applyFields(const Student& source, const QStringList& fields)
+{
+    for (const QString& field : fields) {
+        if (field == "name") {
+            setName(source.m_name);
+        } else if (field == "email") {
+            setEmail(source.m_email);
+        } else if (field == "description") {
+            setDescription(source.m_description);
+        } else if (field == "field") {
+            setField(source.m_field);
+        } else if (field == "school") {
+            setSchool(source.m_school);
+        } else if (field == "number") {
+            setNumber(source.m_number);
+        } else if (field == "year") {
+            setYear(source.m_year);
+        } else if (field == "graduation") {
+            setGraduation(source.m_graduation);
+        } else if (field == "photoURL") {
+            setPhotoURL(source.m_photoURL);
+        } else if (field == "lastUpdateTime") {
+            setLastUpdateTime(source.m_lastUpdateTime);
+        }
+    }
+}
@@ -5,10 +5,25 @@
 #include <QJsonObject>
 #include <QJsonDocument>
 #include <QDateTime>
+#include <QStringList>
 
 class Student
 {
 public:
+    // One bit per document field, set by the setters when a value changes
+    enum DirtyFlag {
+        NameDirty = 0x001,
+        EmailDirty = 0x002,
+        DescriptionDirty = 0x004,
+        FieldDirty = 0x008,
+        SchoolDirty = 0x010,
+        NumberDirty = 0x020,
+        YearDirty = 0x040,
+        GraduationDirty = 0x080,
+        PhotoURLDirty = 0x100,
+        LastUpdateTimeDirty = 0x200
+    };
+
     Student();
     Student(const QString& id, const QString& name, const QString& email, 
             const QString& description, const QString& field, const QString& school,
@@ -26,27 +41,58 @@ public:
     bool getGraduation() const { return m_graduation; }
     QString getPhotoURL() const { return m_photoURL; }
     QDateTime getLastUpdateTime() const { return m_lastUpdateTime; }
+    
+    // True when the record was loaded through a field mask (list projection)
+    // and fields outside the projection, such as description, are not loaded yet
+    bool isPartial() const { return m_partial; }
+    
+    // Server-side updateTime of the document this record was read from, kept
+    // verbatim (microsecond precision) for write preconditions
+    QString getUpdateTime() const { return m_updateTime; }
 
     // Setters
     void setId(const QString& id) { m_id = id; }
-    void setName(const QString& name) { m_name = name; }
-    void setEmail(const QString& email) { m_email = email; }
-    void setDescription(const QString& description) { m_description = description; }
-    void setField(const QString& field) { m_field = field; }
-    void setSchool(const QString& school) { m_school = school; }
-    void setNumber(const QString& number) { m_number = number; }
-    void setYear(int year) { m_year = year; }
-    void setGraduation(bool graduation) { m_graduation = graduation; }
-    void setPhotoURL(const QString& photoURL) { m_photoURL = photoURL; }
-    void setLastUpdateTime(const QDateTime& lastUpdateTime) { m_lastUpdateTime = lastUpdateTime; }
+    void setName(const QString& name) { assign(m_name, name, NameDirty); }
+    void setEmail(const QString& email) { assign(m_email, email, EmailDirty); }
+    void setDescription(const QString& description) { assign(m_description, description, DescriptionDirty); }
+    void setField(const QString& field) { assign(m_field, field, FieldDirty); }
+    void setSchool(const QString& school) { assign(m_school, school, SchoolDirty); }
+    void setNumber(const QString& number) { assign(m_number, number, NumberDirty); }
+    void setYear(int year) { assign(m_year, year, YearDirty); }
+    void setGraduation(bool graduation) { assign(m_graduation, graduation, GraduationDirty); }
+    void setPhotoURL(const QString& photoURL) { assign(m_photoURL, photoURL, PhotoURLDirty); }
+    void setLastUpdateTime(const QDateTime& lastUpdateTime) { assign(m_lastUpdateTime, lastUpdateTime, LastUpdateTimeDirty); }
+    void setPartial(bool partial) { m_partial = partial; }
+    void setUpdateTime(const QString& updateTime) { m_updateTime = updateTime; }
 
     // JSON conversion
     QJsonObject toJson() const;
     void fromJson(const QJsonObject& json);
     
     bool isValid() const;
+    
+    // Document fields whose values differ from other; the ID is not a field
+    QStringList changedFields(const Student& other) const;
+    
+    // Fields modified through the setters since the record was loaded; these
+    // become the updateMask of the next write
+    bool isDirty() const { return m_dirty != 0; }
+    QStringList dirtyFields() const;
+    void clearDirty() { m_dirty = 0; }
+    
+    // Copies the named document fields from source through the setters
+    void applyFields(const Student& source, const QStringList& fields);
 
 private:
+    template <typename T>
+    void assign(T& member, const T& value, DirtyFlag flag)
+    {
+        if (member != value) {
+            member = value;
+            m_dirty |= flag;
+        }
+    }
+
     QString m_id;
     QString m_name;
     QString m_email;
@@ -58,6 +104,9 @@ private:
     bool m_graduation;
     QString m_photoURL;
     QDateTime m_lastUpdateTime;
+    bool m_partial;
+    QString m_updateTime;
+    int m_dirty;
 };
 
 #endif // STUDENT_H
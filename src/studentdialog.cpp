@@ -395,32 +395,6 @@ void StudentDialog::onSelectPhoto()
                 m_photoStatusLabel->setText("Fotoğraf yüklüyor...");
                 m_photoStatusLabel->setVisible(true);
                 
-                // Delete old photo file first for existing students
-                if (!m_student.getPhotoURL().isEmpty()) {
-                    // Try to extract extension from the stored URL
-                    // URL format: ...student_photos%2F{ID}.{ext}?alt=media...
-                    QString photoUrl = m_student.getPhotoURL();
-                    QRegularExpression extensionRegex(QString("student_photos(?:%2F|/)%1\\.(jpg|jpeg|png|gif|bmp)").arg(m_student.getId()));
-                    QRegularExpressionMatch match = extensionRegex.match(photoUrl);
-                    
-                    if (match.hasMatch()) {
-                        // We found the exact extension, delete only that file
-                        QString extension = match.captured(1);
-                        QString oldStoragePath = QString("student_photos/%1.%2").arg(m_student.getId(), extension);
-                        qDebug() << "Deleting old photo with extension:" << extension;
-                        m_storageService->deleteFile(oldStoragePath);
-                    } else {
-                        // Fallback: try common extensions (should rarely happen)
-                        qDebug() << "Could not extract extension from URL:" << photoUrl;
-                        qDebug() << "Trying common extensions as fallback";
-                        QStringList extensions = {"jpg", "jpeg", "png", "gif", "bmp"};
-                        for (const QString& ext : extensions) {
-                            QString oldStoragePath = QString("student_photos/%1.%2").arg(m_student.getId(), ext);
-                            m_storageService->deleteFile(oldStoragePath);
-                        }
-                    }
-                }
-                
                 // Get file extension from selected file
                 QString fileExtension = QFileInfo(fileName).suffix().toLower();
                 if (fileExtension.isEmpty()) {
@@ -428,6 +402,15 @@ void StudentDialog::onSelectPhoto()
                 }
                 
                 QString storagePath = QString("student_photos/%1.%2").arg(m_student.getId(), fileExtension);
+                
+                // Delete the old photo file. The upload overwrites an object
+                // with the same name anyway, and deleting it would race the upload.
+                QString oldStoragePath = FirebaseStorageService::storagePathFromUrl(m_student.getPhotoURL());
+                if (!oldStoragePath.isEmpty() && oldStoragePath != storagePath) {
+                    qDebug() << "Deleting old photo:" << oldStoragePath;
+                    m_storageService->deleteFile(oldStoragePath);
+                }
+                
                 m_storageService->uploadFile(fileName, storagePath);
             } else {
                 // For new students or when no storage service, just show selected status
@@ -455,28 +438,12 @@ void StudentDialog::onRemovePhoto()
     
     // If there's an existing photo and we have a storage service, delete it
     if (!m_photoURLEdit->text().isEmpty() && m_storageService && !m_student.getId().isEmpty()) {
-        // Try to extract extension from the stored URL
-        // URL format: ...student_photos%2F{ID}.{ext}?alt=media...
-        QString photoUrl = m_photoURLEdit->text();
-        QString studentId = m_student.getId();
-        QRegularExpression extensionRegex(QString("student_photos(?:%2F|/)%1\\.(jpg|jpeg|png|gif|bmp)").arg(studentId));
-        QRegularExpressionMatch match = extensionRegex.match(photoUrl);
-        
-        if (match.hasMatch()) {
-            // We found the exact extension, delete only that file
-            QString extension = match.captured(1);
-            QString storagePath = QString("student_photos/%1.%2").arg(studentId, extension);
-            qDebug() << "Deleting old photo with extension:" << extension;
+        QString storagePath = FirebaseStorageService::storagePathFromUrl(m_photoURLEdit->text());
+        if (!storagePath.isEmpty()) {
+            qDebug() << "Deleting photo:" << storagePath;
             m_storageService->deleteFile(storagePath);
         } else {
-            // Fallback: try common extensions (should rarely happen)
-            qDebug() << "Could not extract extension from URL:" << photoUrl;
-            qDebug() << "Trying common extensions as fallback";
-            QStringList extensions = {"jpg", "jpeg", "png", "gif", "bmp"};
-            for (const QString& ext : extensions) {
-                QString storagePath = QString("student_photos/%1.%2").arg(studentId, ext);
-                m_storageService->deleteFile(storagePath);
-            }
+            qDebug() << "Photo URL does not point into storage, nothing to delete:" << m_photoURLEdit->text();
         }
     }
     
@@ -0,0 +1,95 @@
+#include "studentexporter.h"
+#include <QThread>
+
+Q_LOGGING_CATEGORY(exportLog, "data.export")
+
+namespace {
+// Progress is reported every this many rows
+const int ProgressInterval = 1000;
+}
+
+StudentExporter::StudentExporter(QObject *parent)
+    : QObject(parent)
+    , m_thread(nullptr)
+    , m_cancelRequested(false)
+{
+}
+
+StudentExporter::~StudentExporter()
+{
+    if (m_thread) {
+        m_cancelRequested = true;
+        m_thread->wait();
+        delete m_thread;
+    }
+}
+
+void StudentExporter::start(const QList<Student>& students, const QString& filePath, StudentWriter::Format format)
+{
+    if (isRunning()) {
+        return;
+    }
+    
+    m_cancelRequested = false;
+    m_thread = QThread::create([this, students, filePath, format]() {
+        run(students, filePath, format);
+    });
+    connect(m_thread, &QThread::finished, this, [this]() {
+        m_thread->deleteLater();
+        m_thread = nullptr;
+    });
+    
+    qCInfo(exportLog) << "Exporting" << students.size() << "students to" << filePath;
+    m_thread->start();
+}
+
+void StudentExporter::cancel()
+{
+    m_cancelRequested = true;
+}
+
+void StudentExporter::run(const QList<Student>& students, const QString& filePath, StudentWriter::Format format)
+{
+    // Runs on the worker thread; signals reach the GUI thread queued
+    std::unique_ptr<StudentWriter> writer = StudentWriter::create(format, filePath);
+    if (!writer) {
+        emit failed(QString("Unsupported format: %1").arg(StudentWriter::suffix(format)));
+        return;
+    }
+    if (!writer->open()) {
+        QString error = writer->errorString();
+        writer->discard();
+        emit failed(error);
+        return;
+    }
+    
+    int total = students.size();
+    for (int i = 0; i < total; ++i) {
+        if (m_cancelRequested) {
+            writer->discard();
+            qCInfo(exportLog) << "Export cancelled after" << i << "rows";
+            emit cancelled();
+            return;
+        }
+        
+        if (!writer->write(students[i])) {
+            QString error = writer->errorString();
+            writer->discard();
+            emit failed(error);
+            return;
+        }
+        
+        if ((i + 1) % ProgressInterval == 0) {
+            emit progress(i + 1, total);
+        }
+    }
+    
+    if (!writer->close()) {
+        emit failed(writer->errorString());
+        return;
+    }
+    
+    qCInfo(exportLog) << "Exported" << total << "students to" << filePath;
+    emit progress(total, total);
+    emit finished(total, filePath);
+}
@@ -0,0 +1,49 @@
+#ifndef STUDENTEXPORTER_H
+#define STUDENTEXPORTER_H
+
+#include <QObject>
+#include <QList>
+#include <QLoggingCategory>
+#include <atomic>
+#include "student.h"
+#include "studentwriter.h"
+
+Q_DECLARE_LOGGING_CATEGORY(exportLog)
+
+class QThread;
+
+/**
+ * StudentExporter - Exports students to a file on a worker thread
+ *
+ * The rows are streamed through the StudentWriter for the chosen format
+ * (XLSX, CSV, Arrow IPC or Parquet), so the window stays responsive and
+ * memory stays flat however many students are exported.
+ * Signals are delivered to the GUI thread; cancel() stops at the next row
+ * and leaves no partial file behind.
+ */
+class StudentExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StudentExporter(QObject *parent = nullptr);
+    ~StudentExporter();
+    
+    void start(const QList<Student>& students, const QString& filePath, StudentWriter::Format format);
+    void cancel();
+    bool isRunning() const { return m_thread != nullptr; }
+
+signals:
+    void progress(int done, int total);
+    void finished(int exportedCount, const QString& filePath);
+    void failed(const QString& error);
+    void cancelled();
+
+private:
+    void run(const QList<Student>& students, const QString& filePath, StudentWriter::Format format);
+    
+    QThread* m_thread;
+    std::atomic<bool> m_cancelRequested;
+};
+
+#endif // STUDENTEXPORTER_H
@@ -0,0 +1,102 @@
+#include "studentfilter.h"
+#include <algorithm>
+
+const QString StudentFilter::NoUniversitySchool = QStringLiteral("Üniversiteye gitmedi");
+
+StudentFilter::StudentFilter()
+    : graduation(AnyGraduation)
+    , yearFrom(MinYear)
+    , yearTo(MaxYear)
+{
+}
+
+bool StudentFilter::isEmpty() const
+{
+    return searchText.isEmpty() && name.isEmpty() && email.isEmpty() &&
+           field.isEmpty() && school.isEmpty() && graduation == AnyGraduation &&
+           !hasYearRange();
+}
+
+bool StudentFilter::matches(const Student& student) const
+{
+    // Apply search text filter (searches across multiple fields).
+    // Descriptions only match once the full document has been fetched.
+    if (!searchText.isEmpty()) {
+        bool searchMatches = student.getName().toLower().contains(searchText) ||
+                             student.getEmail().toLower().contains(searchText) ||
+                             student.getField().toLower().contains(searchText) ||
+                             student.getSchool().toLower().contains(searchText) ||
+                             student.getDescription().toLower().contains(searchText);
+        if (!searchMatches) {
+            return false;
+        }
+    }
+    
+    // Apply specific field filters
+    if (!name.isEmpty() && !student.getName().toLower().contains(name)) {
+        return false;
+    }
+    
+    if (!email.isEmpty() && !student.getEmail().toLower().contains(email)) {
+        return false;
+    }
+    
+    if (!field.isEmpty() && student.getField() != field) {
+        return false;
+    }
+    
+    if (!school.isEmpty() && student.getSchool() != school) {
+        return false;
+    }
+    
+    bool didNotAttendUniversity = (student.getSchool() == NoUniversitySchool);
+    
+    if (graduation != AnyGraduation) {
+        bool isGraduated = student.getGraduation();
+        
+        if (graduation == Graduated) {
+            // Mezun - graduated from university
+            if (!isGraduated || didNotAttendUniversity) {
+                return false;
+            }
+        } else if (graduation == Active) {
+            // Aktif (Devam Ediyor) - currently studying
+            if (isGraduated || didNotAttendUniversity) {
+                return false;
+            }
+        } else if (graduation == NoUniversity) {
+            // Üniversiteye Gitmedi - didn't attend university
+            if (!didNotAttendUniversity) {
+                return false;
+            }
+        }
+    }
+    
+    // Only apply year range filter if student attended university
+    int studentYear = student.getYear();
+    if (!didNotAttendUniversity && (studentYear < yearFrom || studentYear > yearTo)) {
+        return false;
+    }
+    
+    return true;
+}
+
+QList<Student> StudentFilter::apply(const QList<Student>& students) const
+{
+    QList<Student> result;
+    if (isEmpty()) {
+        result = students;
+    } else {
+        for (const Student& student : students) {
+            if (matches(student)) {
+                result.append(student);
+            }
+        }
+    }
+    
+    // Newest first, like the table shows them
+    std::sort(result.begin(), result.end(), [](const Student& a, const Student& b) {
+        return a.getLastUpdateTime() > b.getLastUpdateTime();
+    });
+    return result;
+}
@@ -0,0 +1,41 @@
+#ifndef STUDENTFILTER_H
+#define STUDENTFILTER_H
+
+#include <QList>
+#include <QString>
+#include "student.h"
+
+// Filter criteria from the search box and the filter panel.
+// Used both for local filtering and for building server-side queries.
+class StudentFilter
+{
+public:
+    enum GraduationFilter {
+        AnyGraduation = -1,
+        Active = 0,       // Aktif (Devam Ediyor)
+        Graduated = 1,    // Mezun
+        NoUniversity = 2  // Üniversiteye Gitmedi
+    };
+    
+    static const int MinYear = 1900;
+    static const int MaxYear = 2100;
+    static const QString NoUniversitySchool;
+    
+    StudentFilter();
+    
+    QString searchText;  // Lowercase, matched against several fields
+    QString name;        // Lowercase substring
+    QString email;       // Lowercase substring
+    QString field;       // Exact match
+    QString school;      // Exact match
+    int graduation;
+    int yearFrom;
+    int yearTo;
+    
+    bool isEmpty() const;
+    bool hasYearRange() const { return yearFrom > MinYear || yearTo < MaxYear; }
+    bool matches(const Student& student) const;
+    QList<Student> apply(const QList<Student>& students) const; // Matches, newest first
+};
+
+#endif // STUDENTFILTER_H
@@ -0,0 +1,365 @@
+#include "studentimporter.h"
+#include "csvstream.h"
+#include "xlsxstreamreader.h"
+#include "duplicateindex.h"
+#include "firestoreservice.h"
+#include <QThread>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QMutex>
+#include <QHash>
+#include <QDateTime>
+#include <QFileInfo>
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+Q_LOGGING_CATEGORY(importLog, "data.import")
+
+namespace {
+// Rows validated per pool task
+const int ChunkSize = 2000;
+
+// Progress is reported every this many rows
+const int ProgressInterval = 1000;
+}
+
+StudentImporter::StudentImporter(QObject *parent)
+    : QObject(parent)
+    , m_thread(nullptr)
+    , m_cancelRequested(false)
+{
+}
+
+StudentImporter::~StudentImporter()
+{
+    if (m_thread) {
+        m_cancelRequested = true;
+        m_thread->wait();
+        delete m_thread;
+    }
+}
+
+void StudentImporter::start(const QString& filePath, const QList<Student>& existing, Mode mode)
+{
+    if (isRunning()) {
+        return;
+    }
+    
+    m_cancelRequested = false;
+    m_thread = QThread::create([this, filePath, existing, mode]() {
+        run(filePath, existing, mode);
+    });
+    connect(m_thread, &QThread::finished, this, [this]() {
+        m_thread->deleteLater();
+        m_thread = nullptr;
+    });
+    
+    qCInfo(importLog) << "Importing students from" << filePath << (mode == Upsert ? "(upsert)" : "");
+    m_thread->start();
+}
+
+void StudentImporter::cancel()
+{
+    m_cancelRequested = true;
+}
+
+bool StudentImporter::parseRow(const Row& row, Student* student, QString* error)
+{
+    // Returns false with an empty error for rows that are skipped silently
+    auto cell = [&row](int column) {
+        return column < row.cells.size() ? row.cells.at(column) : QVariant();
+    };
+    
+    QString name = cell(0).toString().trimmed();
+    QString email = cell(1).toString().trimmed();
+    QString description = cell(2).toString().trimmed();
+    QString field = cell(3).toString().trimmed();
+    QString school = cell(4).toString().trimmed();
+    QString number = cell(5).toString().trimmed();
+    
+    // Skip completely empty rows
+    if (name.isEmpty() && email.isEmpty() && field.isEmpty()) {
+        return false;
+    }
+    
+    // Validate required fields (only name is required)
+    if (name.isEmpty()) {
+        *error = QString("Satır %1: Ad zorunludur").arg(row.number);
+        return false;
+    }
+    
+    // Parse year
+    QVariant yearValue = cell(6);
+    bool yearOk = false;
+    int year = 0;
+    
+    if (yearValue.typeId() == QMetaType::Int || yearValue.typeId() == QMetaType::LongLong ||
+        yearValue.typeId() == QMetaType::Double) {
+        year = yearValue.toInt(&yearOk);
+    } else if (!yearValue.toString().isEmpty()) {
+        year = yearValue.toString().toInt(&yearOk);
+    }
+    
+    if (!yearOk || year == 0) {
+        *error = QString("Satır %1: Geçersiz yıl değeri").arg(row.number);
+        return false;
+    }
+    
+    // Parse graduation status
+    QVariant graduationValue = cell(7);
+    bool graduation = false;
+    
+    if (graduationValue.isNull() || graduationValue.toString().isEmpty()) {
+        *error = QString("Satır %1: Mezuniyet durumu zorunludur").arg(row.number);
+        return false;
+    }
+    
+    QString graduationStr = graduationValue.toString().toLower().trimmed();
+    if (graduationStr == "evet" || graduationStr == "yes" || graduationStr == "true" || graduationStr == "1") {
+        graduation = true;
+    } else if (graduationStr == "hayır" || graduationStr == "no" || graduationStr == "false" || graduationStr == "0") {
+        graduation = false;
+    } else {
+        *error = QString("Satır %1: Geçersiz mezuniyet durumu: %2 (Evet/Hayır bekleniyor)")
+            .arg(row.number).arg(graduationStr);
+        return false;
+    }
+    
+    // Create student object with a client-side document ID
+    *student = Student(FirestoreService::generateDocumentId(), name, email, description, field, school, number, year, graduation, "");
+    student->setLastUpdateTime(QDateTime::currentDateTimeUtc());
+    return true;
+}
+
+void StudentImporter::run(const QString& filePath, const QList<Student>& existing, Mode mode)
+{
+    // Runs on the worker thread; signals reach the GUI thread queued
+    const DuplicateIndex index(existing);
+    
+    std::function<bool(Row*)> nextRow;
+    int totalRows = 0;
+    
+    bool csv = QFileInfo(filePath).suffix().compare("csv", Qt::CaseInsensitive) == 0;
+    CsvReader csvReader(filePath);
+    XlsxStreamReader reader(filePath);
+    QList<QVariantList> workbookRows;
+    int workbookRow = 0;
+    bool workbookLoaded = false;
+    if (csv) {
+        if (!csvReader.open()) {
+            emit failed(QString("CSV dosyası açılamadı.\n\n%1").arg(csvReader.errorString()));
+            return;
+        }
+        nextRow = [&csvReader](Row* row) {
+            return csvReader.readRow(&row->number, &row->cells);
+        };
+    } else if (reader.open()) {
+        totalRows = reader.rowCountHint();
+        nextRow = [&reader](Row* row) {
+            return reader.readRow(&row->number, &row->cells);
+        };
+    } else {
+        // Unusual packaging, or deflated parts without zlib: load the whole
+        // workbook instead, still off the GUI thread
+        qCWarning(importLog) << "Streaming read failed, loading the workbook:" << reader.errorString();
+        if (!m_workbookLoader || !m_workbookLoader(filePath, &workbookRows)) {
+            emit failed("Excel dosyası açılamadı veya geçersiz format.");
+            return;
+        }
+        workbookLoaded = true;
+        totalRows = workbookRows.size();
+        nextRow = [&workbookRows, &workbookRow](Row* row) {
+            if (workbookRow >= workbookRows.size()) {
+                return false;
+            }
+            row->number = workbookRow + 1;
+            row->cells = workbookRows.at(workbookRow++);
+            return true;
+        };
+    }
+    
+    // Validation runs on a private pool so a big import does not starve the
+    // global one; the semaphore keeps the reader at most a few chunks ahead
+    QThreadPool pool;
+    QSemaphore freeSlots(pool.maxThreadCount() * 2);
+    QList<RowError> errors;
+    std::atomic<int> importedCount(0);
+    std::atomic<int> unchangedCount(0);
+    std::atomic<int> changedCount(0);
+    
+    // Rows that survive the checks against the existing records still have
+    // to be compared with the earlier rows of the file
+    struct Candidate {
+        int row = 0;
+        Student student;
+        DuplicateIndex::Match match;
+    };
+    struct ChunkResult {
+        QList<Candidate> candidates;
+        QList<RowError> errors;
+    };
+    
+    // Rows accepted so far, so a student listed twice in the file is added
+    // or updated once. Chunks finish in any order but are resolved in file
+    // order, so the earlier of two rows is always the one kept.
+    QMutex resultsMutex;
+    QHash<int, ChunkResult> finishedChunks; // Chunk sequence -> result
+    int nextChunk = 0;
+    int submittedChunks = 0;
+    DuplicateIndex accepted;
+    QHash<QString, int> acceptedRows; // Generated ID -> row number
+    QHash<QString, int> updatedRows;  // Existing ID -> row number
+    
+    // Runs with resultsMutex held, one chunk at a time
+    auto resolve = [&](const ChunkResult& result) {
+        QList<Student> students;
+        int newCount = 0;
+        for (const Candidate& candidate : result.candidates) {
+            const int rowNumber = candidate.row;
+            if (candidate.match.status == DuplicateIndex::Changed) {
+                int firstRow = updatedRows.value(candidate.match.studentId);
+                if (firstRow > 0) {
+                    errors.append({rowNumber, QString("Satır %1: Satır %2 ile aynı kişi").arg(rowNumber).arg(firstRow)});
+                    continue;
+                }
+                updatedRows.insert(candidate.match.studentId, rowNumber);
+                
+                // The stored record with only the differing fields set, so
+                // those become its update mask
+                Student updated = index.student(candidate.match.studentId);
+                updated.clearDirty();
+                updated.applyFields(candidate.student, candidate.match.changedFields);
+                updated.setLastUpdateTime(candidate.student.getLastUpdateTime());
+                students.append(updated);
+                continue;
+            }
+            
+            DuplicateIndex::Match repeat = accepted.classify(candidate.student);
+            if (repeat.status != DuplicateIndex::New) {
+                int firstRow = acceptedRows.value(repeat.studentId);
+                QString message;
+                if (repeat.status == DuplicateIndex::Similar) {
+                    message = QString("Satır %1: Satır %2 ile benzer isim, aktarılmadı; kontrol edin").arg(rowNumber).arg(firstRow);
+                } else if (firstRow > 0) {
+                    message = QString("Satır %1: Satır %2 ile aynı kişi").arg(rowNumber).arg(firstRow);
+                } else {
+                    message = QString("Satır %1: Dosyada birden fazla satırla eşleşiyor").arg(rowNumber);
+                }
+                errors.append({rowNumber, message});
+                continue;
+            }
+            accepted.add(candidate.student);
+            acceptedRows.insert(candidate.student.getId(), rowNumber);
+            students.append(candidate.student);
+            ++newCount;
+        }
+        errors += result.errors;
+        if (!students.isEmpty() && !m_cancelRequested) {
+            importedCount += newCount;
+            changedCount += int(students.size()) - newCount;
+            emit studentsParsed(students);
+        }
+    };
+    
+    auto submit = [&](const QList<Row>& chunk) {
+        const int sequence = submittedChunks++;
+        freeSlots.acquire();
+        pool.start([&, chunk, sequence]() {
+            ChunkResult result;
+            for (const Row& row : chunk) {
+                Student student;
+                QString error;
+                if (!parseRow(row, &student, &error)) {
+                    if (!error.isEmpty()) {
+                        result.errors.append({row.number, error});
+                    }
+                    continue;
+                }
+                
+                DuplicateIndex::Match match = index.classify(student);
+                if (match.status == DuplicateIndex::Identical) {
+                    ++unchangedCount;
+                    continue;
+                }
+                if (match.status == DuplicateIndex::Ambiguous) {
+                    result.errors.append({row.number, QString("Satır %1: Birden fazla mevcut kayıtla eşleşiyor").arg(row.number)});
+                    continue;
+                }
+                if (match.status == DuplicateIndex::Similar) {
+                    // A near name alone may be someone else: neither added
+                    // nor written over the stored record
+                    result.errors.append({row.number, QString("Satır %1: Benzer isimli kayıt var (%2), aktarılmadı; kontrol edin")
+                        .arg(row.number).arg(index.student(match.studentId).getName())});
+                    continue;
+                }
+                if (match.status == DuplicateIndex::Changed && mode == AddOnly) {
+                    ++changedCount;
+                    continue;
+                }
+                result.candidates.append({row.number, student, match});
+            }
+            
+            // Whoever completes the next chunk in file order resolves it and
+            // any later ones already waiting; a slot is freed per chunk
+            // resolved, so waiting results stay bounded
+            QMutexLocker locker(&resultsMutex);
+            finishedChunks.insert(sequence, result);
+            while (finishedChunks.contains(nextChunk)) {
+                resolve(finishedChunks.take(nextChunk++));
+                freeSlots.release();
+            }
+        });
+    };
+    
+    QList<Row> chunk;
+    chunk.reserve(ChunkSize);
+    int dataRows = 0;
+    int rowsRead = 0;
+    Row row;
+    while (!m_cancelRequested && nextRow(&row)) {
+        ++rowsRead;
+        if (rowsRead % ProgressInterval == 0) {
+            emit progress(row.number, totalRows);
+        }
+        if (row.number < 2) {
+            continue; // Header
+        }
+        ++dataRows;
+        chunk.append(row);
+        if (chunk.size() == ChunkSize) {
+            submit(chunk);
+            chunk.clear();
+        }
+    }
+    if (!chunk.isEmpty() && !m_cancelRequested) {
+        submit(chunk);
+    }
+    pool.waitForDone();
+    
+    QString readError = csv ? csvReader.errorString() : (workbookLoaded ? QString() : reader.errorString());
+    if (!readError.isEmpty()) {
+        qCWarning(importLog) << "Read stopped at row" << row.number << ":" << readError;
+        errors.append({row.number + 1, QString("Satır %1 ve sonrası okunamadı: %2").arg(row.number + 1).arg(readError)});
+    }
+    if (dataRows == 0 && !m_cancelRequested && errors.isEmpty()) {
+        emit failed("Dosya boş veya yalnızca başlık satırı içeriyor.");
+        return;
+    }
+    
+    std::sort(errors.begin(), errors.end(), [](const RowError& a, const RowError& b) {
+        return a.row < b.row;
+    });
+    QStringList messages;
+    messages.reserve(errors.size());
+    for (const RowError& error : errors) {
+        messages.append(error.message);
+    }
+    
+    bool cancelled = m_cancelRequested;
+    qCInfo(importLog) << "Imported" << importedCount.load() << "students from" << filePath << "-"
+                      << unchangedCount.load() << "unchanged," << changedCount.load() << "changed,"
+                      << messages.size() << "errors" << (cancelled ? "(cancelled)" : "");
+    emit progress(totalRows > 0 ? totalRows : rowsRead, totalRows);
+    emit finished(importedCount.load(), unchangedCount.load(), changedCount.load(), messages, cancelled);
+}
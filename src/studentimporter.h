@@ -0,0 +1,91 @@
+#ifndef STUDENTIMPORTER_H
+#define STUDENTIMPORTER_H
+
+#include <QObject>
+#include <QList>
+#include <QStringList>
+#include <QVariantList>
+#include <QLoggingCategory>
+#include <atomic>
+#include <functional>
+#include "student.h"
+
+Q_DECLARE_LOGGING_CATEGORY(importLog)
+
+class QThread;
+
+/**
+ * StudentImporter - Imports students from an Excel or CSV file off the GUI thread
+ *
+ * A worker thread streams the first sheet through XlsxStreamReader, or the
+ * records of a .csv file through CsvReader, and hands chunks of rows to a
+ * thread pool for validation. Each chunk's accepted students are emitted as
+ * soon as it is checked, so they reach the outbox while the rest of the
+ * file is still being read. Workbooks the stream reader cannot handle are
+ * passed to the workbook loader, if one is set, on the worker.
+ *
+ * Every valid row is looked up in a DuplicateIndex of the existing students
+ * and of the rows already accepted from the same file, so importing the
+ * same sheet twice adds nothing the second time. Repeats within the file
+ * are resolved in row order, whichever chunk is checked first. Rows
+ * matching several records, or only a near name, are reported as errors
+ * for review. What happens to a row matching one existing record by
+ * e-mail, phone number or identical name depends on the mode:
+ *   - AddOnly counts it as unchanged or changed and leaves the record alone;
+ *   - Upsert copies the differing fields onto the stored record and emits
+ *     it, so the outbox sends only those fields as a masked update.
+ * Unchanged rows cost nothing in either mode.
+ *
+ * Columns are those of the spreadsheet exports: name, email, description,
+ * field, school, number, year, graduation; row 1 is the header.
+ */
+class StudentImporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Mode {
+        AddOnly, // New students only
+        Upsert   // New students, plus changed fields of existing ones
+    };
+    
+    // Reads every row of a workbook in one go; rows[i] is sheet row i + 1.
+    // Runs on the worker thread.
+    using WorkbookLoader = std::function<bool(const QString& filePath, QList<QVariantList>* rows)>;
+    
+    explicit StudentImporter(QObject *parent = nullptr);
+    ~StudentImporter();
+    
+    void setWorkbookLoader(const WorkbookLoader& loader) { m_workbookLoader = loader; }
+    
+    void start(const QString& filePath, const QList<Student>& existing, Mode mode = AddOnly);
+    void cancel();
+    bool isRunning() const { return m_thread != nullptr; }
+
+signals:
+    void studentsParsed(const QList<Student>& students); // New, and in Upsert mode updated, students
+    void progress(int rowsRead, int totalRows); // totalRows is 0 when unknown
+    // changedCount rows were updated in Upsert mode and skipped in AddOnly
+    void finished(int importedCount, int unchangedCount, int changedCount,
+                  const QStringList& errors, bool cancelled); // Errors in row order
+    void failed(const QString& error);
+
+private:
+    struct Row {
+        int number = 0;
+        QVariantList cells;
+    };
+    struct RowError {
+        int row = 0;
+        QString message;
+    };
+    
+    void run(const QString& filePath, const QList<Student>& existing, Mode mode);
+    static bool parseRow(const Row& row, Student* student, QString* error);
+    
+    QThread* m_thread;
+    std::atomic<bool> m_cancelRequested;
+    WorkbookLoader m_workbookLoader; // Fallback for workbooks the stream reader refuses
+};
+
+#endif // STUDENTIMPORTER_H
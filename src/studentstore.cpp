@@ -0,0 +1,209 @@
+#include "studentstore.h"
+#include <QLoggingCategory>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+Q_DECLARE_LOGGING_CATEGORY(dataLog)
+
+StudentStore::StudentStore(QObject *parent)
+    : QObject(parent)
+{
+}
+
+QList<Student> StudentStore::students() const
+{
+    return m_students.values();
+}
+
+Student StudentStore::student(const QString& studentId) const
+{
+    return m_students.value(studentId);
+}
+
+bool StudentStore::contains(const QString& studentId) const
+{
+    return m_students.contains(studentId);
+}
+
+QSet<QString> StudentStore::ids() const
+{
+    QSet<QString> result;
+    result.reserve(m_students.size());
+    for (auto it = m_students.constBegin(); it != m_students.constEnd(); ++it) {
+        result.insert(it.key());
+    }
+    return result;
+}
+
+QDateTime StudentStore::latestUpdateTime() const
+{
+    QDateTime latest;
+    for (const Student& student : m_students) {
+        if (!latest.isValid() || student.getLastUpdateTime() > latest) {
+            latest = student.getLastUpdateTime();
+        }
+    }
+    return latest;
+}
+
+void StudentStore::replaceAll(const QList<Student>& students)
+{
+    m_students.clear();
+    m_students.reserve(students.size());
+    for (const Student& student : students) {
+        m_students.insert(student.getId(), student);
+    }
+    qCDebug(dataLog) << "Store reset with" << m_students.size() << "students";
+    emit storeReset();
+}
+
+void StudentStore::upsert(const Student& student)
+{
+    if (mergeStudent(student)) {
+        emit studentsChanged({student}, QStringList());
+    }
+}
+
+void StudentStore::upsertMany(const QList<Student>& students)
+{
+    QList<Student> changed;
+    for (const Student& student : students) {
+        if (mergeStudent(student)) {
+            changed.append(student);
+        }
+    }
+    if (!changed.isEmpty()) {
+        qCDebug(dataLog) << "Store merged" << changed.size() << "changed students";
+        emit studentsChanged(changed, QStringList());
+    }
+}
+
+void StudentStore::remove(const QString& studentId)
+{
+    if (m_students.remove(studentId) > 0) {
+        emit studentsChanged(QList<Student>(), {studentId});
+    }
+}
+
+void StudentStore::removeMany(const QStringList& studentIds)
+{
+    QStringList removed;
+    for (const QString& studentId : studentIds) {
+        if (m_students.remove(studentId) > 0) {
+            removed.append(studentId);
+        }
+    }
+    if (!removed.isEmpty()) {
+        qCDebug(dataLog) << "Store removed" << removed.size() << "students";
+        emit studentsChanged(QList<Student>(), removed);
+    }
+}
+
+void StudentStore::clear()
+{
+    m_students.clear();
+    emit storeReset();
+}
+
+void StudentStore::setUpdateTime(const QString& studentId, const QString& updateTime)
+{
+    auto it = m_students.find(studentId);
+    if (it != m_students.end()) {
+        it->setUpdateTime(updateTime);
+    }
+}
+
+bool StudentStore::mergeStudent(const Student& student)
+{
+    if (student.getId().isEmpty()) {
+        return false;
+    }
+    
+    auto it = m_students.find(student.getId());
+    if (it != m_students.end()) {
+        // A projected copy of the version we already hold in full adds nothing
+        if (student.isPartial() && !it->isPartial() &&
+            student.getLastUpdateTime() == it->getLastUpdateTime()) {
+            return false;
+        }
+        *it = student;
+    } else {
+        m_students.insert(student.getId(), student);
+    }
+    return true;
+}
+
+bool StudentStore::saveSnapshot(const QString& filePath) const
+{
+    QJsonArray students;
+    for (const Student& student : m_students) {
+        students.append(studentToJson(student));
+    }
+    
+    QJsonObject root;
+    root["savedAt"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["students"] = students;
+    
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(dataLog) << "Could not write store snapshot:" << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    if (!file.commit()) {
+        qCWarning(dataLog) << "Could not save store snapshot:" << file.errorString();
+        return false;
+    }
+    qCDebug(dataLog) << "Store snapshot saved," << m_students.size() << "students";
+    return true;
+}
+
+bool StudentStore::loadSnapshot(const QString& filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    
+    QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    if (!root.contains("students")) {
+        qCWarning(dataLog) << "Ignoring unreadable store snapshot" << filePath;
+        return false;
+    }
+    
+    QList<Student> students;
+    const QJsonArray entries = root["students"].toArray();
+    students.reserve(entries.size());
+    for (const QJsonValue& value : entries) {
+        Student student = studentFromJson(value.toObject());
+        if (!student.getId().isEmpty()) {
+            students.append(student);
+        }
+    }
+    
+    qCInfo(dataLog) << "Loaded" << students.size() << "students from snapshot saved at" << root["savedAt"].toString();
+    replaceAll(students);
+    return true;
+}
+
+QJsonObject StudentStore::studentToJson(const Student& student)
+{
+    QJsonObject json = student.toJson();
+    json["partial"] = student.isPartial();
+    json["updateTime"] = student.getUpdateTime();
+    return json;
+}
+
+Student StudentStore::studentFromJson(const QJsonObject& json)
+{
+    Student student;
+    student.fromJson(json);
+    student.setPartial(json["partial"].toBool());
+    student.setUpdateTime(json["updateTime"].toString());
+    return student;
+}
@@ -0,0 +1,66 @@
+#ifndef STUDENTSTORE_H
+#define STUDENTSTORE_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QStringList>
+#include <QJsonObject>
+#include "student.h"
+
+/**
+ * StudentStore - In-memory set of students keyed by document ID
+ *
+ * Single place where loads, incremental changes and local edits meet.
+ * Views listen to studentsChanged/storeReset instead of patching their own
+ * copies of the list.
+ */
+class StudentStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StudentStore(QObject *parent = nullptr);
+    
+    QList<Student> students() const;
+    Student student(const QString& studentId) const;
+    bool contains(const QString& studentId) const;
+    QSet<QString> ids() const;
+    int size() const { return m_students.size(); }
+    bool isEmpty() const { return m_students.isEmpty(); }
+    
+    // Highest lastUpdateTime in the store; used as the change feed resume point
+    QDateTime latestUpdateTime() const;
+    
+    void replaceAll(const QList<Student>& students);
+    void upsert(const Student& student);
+    void upsertMany(const QList<Student>& students);
+    void remove(const QString& studentId);
+    void removeMany(const QStringList& studentIds);
+    void clear();
+    
+    // Records the server updateTime after a write; not a visible change, so no signal
+    void setUpdateTime(const QString& studentId, const QString& updateTime);
+    
+    // Local copy of the store on disk, shown at the next startup before the
+    // first load from the server has finished. loadSnapshot() replaces the
+    // contents (storeReset) and returns false when there is no usable file.
+    bool saveSnapshot(const QString& filePath) const;
+    bool loadSnapshot(const QString& filePath);
+    
+    // Student::toJson plus the sync state it leaves out (partial, updateTime)
+    static QJsonObject studentToJson(const Student& student);
+    static Student studentFromJson(const QJsonObject& json);
+
+signals:
+    void storeReset();
+    void studentsChanged(const QList<Student>& changed, const QStringList& removedIds);
+
+private:
+    bool mergeStudent(const Student& student);
+    
+    QHash<QString, Student> m_students;
+};
+
+#endif // STUDENTSTORE_H
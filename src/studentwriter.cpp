@@ -0,0 +1,176 @@
+#include "studentwriter.h"
+#include "xlsxstreamwriter.h"
+#include "csvstream.h"
+#include <QFileInfo>
+
+#ifdef HAVE_ARROW
+#include "arrowstudentwriter.h"
+#endif
+
+namespace {
+QString yesNo(bool value)
+{
+    return value ? "Evet" : "Hayır";
+}
+
+class XlsxStudentWriter : public StudentWriter
+{
+public:
+    explicit XlsxStudentWriter(const QString& filePath)
+        : m_writer(filePath)
+    {
+    }
+    
+    bool open() override
+    {
+        if (!m_writer.open("Sheet1", {20, 30, 40, 20, 25, 15, 20, 25})) {
+            return false;
+        }
+        m_writer.beginRow();
+        for (const QString& title : columnTitles()) {
+            m_writer.addSharedString(title, XlsxStreamWriter::Header);
+        }
+        return m_writer.endRow();
+    }
+    
+    bool write(const Student& student) override
+    {
+        // Field, school and the yes/no column repeat, so they go into the
+        // shared strings table; the rest are written inline
+        m_writer.beginRow();
+        m_writer.addString(student.getName());
+        m_writer.addString(student.getEmail());
+        m_writer.addString(student.getDescription());
+        m_writer.addSharedString(student.getField());
+        m_writer.addSharedString(student.getSchool());
+        m_writer.addString(student.getNumber(), XlsxStreamWriter::Centered);
+        m_writer.addNumber(student.getYear(), XlsxStreamWriter::Centered);
+        m_writer.addSharedString(yesNo(student.getGraduation()), XlsxStreamWriter::Centered);
+        return m_writer.endRow();
+    }
+    
+    bool close() override { return m_writer.close(); }
+    void discard() override { m_writer.discard(); }
+    QString errorString() const override { return m_writer.errorString(); }
+
+private:
+    XlsxStreamWriter m_writer;
+};
+
+class CsvStudentWriter : public StudentWriter
+{
+public:
+    explicit CsvStudentWriter(const QString& filePath)
+        : m_writer(filePath)
+    {
+    }
+    
+    bool open() override
+    {
+        return m_writer.open() && m_writer.writeRow(columnTitles());
+    }
+    
+    bool write(const Student& student) override
+    {
+        return m_writer.writeRow({
+            student.getName(), student.getEmail(), student.getDescription(),
+            student.getField(), student.getSchool(), student.getNumber(),
+            QString::number(student.getYear()), yesNo(student.getGraduation())
+        });
+    }
+    
+    bool close() override { return m_writer.close(); }
+    void discard() override { m_writer.discard(); }
+    QString errorString() const override { return m_writer.errorString(); }
+
+private:
+    CsvWriter m_writer;
+};
+}
+
+std::unique_ptr<StudentWriter> StudentWriter::create(Format format, const QString& filePath)
+{
+    switch (format) {
+    case Csv:
+        return std::make_unique<CsvStudentWriter>(filePath);
+#ifdef HAVE_ARROW
+    case ArrowIpc:
+        return std::make_unique<ArrowStudentWriter>(filePath, ArrowStudentWriter::Ipc);
+    case Parquet:
+        return std::make_unique<ArrowStudentWriter>(filePath, ArrowStudentWriter::Parquet);
+#endif
+    case Xlsx:
+        return std::make_unique<XlsxStudentWriter>(filePath);
+    default:
+        return nullptr;
+    }
+}
+
+QList<StudentWriter::Format> StudentWriter::availableFormats()
+{
+#ifdef HAVE_ARROW
+    return {Xlsx, Csv, ArrowIpc, Parquet};
+#else
+    return {Xlsx, Csv};
+#endif
+}
+
+StudentWriter::Format StudentWriter::formatForPath(const QString& filePath)
+{
+    QString fileSuffix = QFileInfo(filePath).suffix().toLower();
+    for (Format format : {Csv, ArrowIpc, Parquet}) {
+        if (fileSuffix == suffix(format)) {
+            return format;
+        }
+    }
+    return Xlsx;
+}
+
+bool StudentWriter::formatForName(const QString& name, Format* format)
+{
+    for (Format candidate : {Xlsx, Csv, ArrowIpc, Parquet}) {
+        if (name.compare(suffix(candidate), Qt::CaseInsensitive) == 0) {
+            *format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+QString StudentWriter::suffix(Format format)
+{
+    switch (format) {
+    case Csv:
+        return "csv";
+    case ArrowIpc:
+        return "arrow";
+    case Parquet:
+        return "parquet";
+    case Xlsx:
+    default:
+        return "xlsx";
+    }
+}
+
+QString StudentWriter::fileFilter(Format format)
+{
+    switch (format) {
+    case Csv:
+        return "CSV Dosyaları (*.csv)";
+    case ArrowIpc:
+        return "Apache Arrow Dosyaları (*.arrow)";
+    case Parquet:
+        return "Parquet Dosyaları (*.parquet)";
+    case Xlsx:
+    default:
+        return "Excel Dosyaları (*.xlsx)";
+    }
+}
+
+QStringList StudentWriter::columnTitles()
+{
+    return {
+        "Ad", "E-posta", "Açıklama", "Alan", "Okul", "Numara",
+        "Lise Mezuniyet Yılı", "Üniversite Mezun Durumu"
+    };
+}
@@ -0,0 +1,50 @@
+#ifndef STUDENTWRITER_H
+#define STUDENTWRITER_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <memory>
+#include "student.h"
+
+/**
+ * StudentWriter - One bulk export format, written a student at a time
+ *
+ * StudentExporter drives a writer from its worker thread: open(), write()
+ * for every student, then close(), or discard() when cancelled. No format
+ * leaves a partial file behind. Writers are made by create() from the
+ * file name's suffix; the formats offered depend on the build:
+ *   - Xlsx and Csv always, with the columns of the import template;
+ *   - ArrowIpc (.arrow) and Parquet (.parquet) with Apache Arrow
+ *     (HAVE_ARROW), typed columns named after the Firestore fields.
+ */
+class StudentWriter
+{
+public:
+    enum Format {
+        Xlsx,
+        Csv,
+        ArrowIpc,
+        Parquet
+    };
+    
+    virtual ~StudentWriter() = default;
+    
+    virtual bool open() = 0;
+    virtual bool write(const Student& student) = 0;
+    virtual bool close() = 0;
+    virtual void discard() = 0;
+    virtual QString errorString() const = 0;
+    
+    static std::unique_ptr<StudentWriter> create(Format format, const QString& filePath);
+    static QList<Format> availableFormats();
+    static Format formatForPath(const QString& filePath); // Xlsx for unknown suffixes
+    static bool formatForName(const QString& name, Format* format); // By suffix, as in "--format csv"
+    static QString suffix(Format format);
+    static QString fileFilter(Format format); // "Excel Dosyaları (*.xlsx)"
+    
+    // Header row of the spreadsheet formats, in import column order
+    static QStringList columnTitles();
+};
+
+#endif // STUDENTWRITER_H
@@ -1,4 +1,5 @@
 #include "updatechecker.h"
+#include "networkaccess.h"
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
@@ -8,11 +9,9 @@
 
 UpdateChecker::UpdateChecker(QObject *parent)
     : QObject(parent)
-    , m_networkManager(new QNetworkAccessManager(this))
+    , m_networkManager(NetworkAccess::shared())
     , m_silent(false)
 {
-    connect(m_networkManager, &QNetworkAccessManager::finished,
-            this, &UpdateChecker::onReplyFinished);
 }
 
 UpdateChecker::~UpdateChecker()
@@ -31,7 +30,10 @@ void UpdateChecker::checkForUpdates(const QString& repoPath, const QString& curr
     request.setHeader(QNetworkRequest::UserAgentHeader, "NEVRETEM-DER-MBS-UpdateChecker");
     request.setRawHeader("Accept", "application/vnd.github.v3+json");
 
-    m_networkManager->get(request);
+    QNetworkReply* reply = m_networkManager->get(request);
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        onReplyFinished(reply);
+    });
 }
 
 void UpdateChecker::onReplyFinished(QNetworkReply* reply)
@@ -1,11 +1,12 @@
 #include "updatedownloader.h"
+#include "networkaccess.h"
 #include <QNetworkRequest>
 #include <QDir>
 #include <QFileInfo>
 
 UpdateDownloader::UpdateDownloader(QObject *parent)
     : QObject(parent)
-    , m_networkManager(new QNetworkAccessManager(this))
+    , m_networkManager(NetworkAccess::shared())
     , m_reply(nullptr)
     , m_outputFile(nullptr)
 {
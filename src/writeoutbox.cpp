@@ -0,0 +1,593 @@
+#include "writeoutbox.h"
+#include "firestoreservice.h"
+#include "studentstore.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <algorithm>
+#include <functional>
+
+Q_LOGGING_CATEGORY(outboxLog, "firestore.outbox")
+
+namespace {
+// Firestore accepts at most 500 writes per commit
+const int MaxBatchSize = 500;
+
+const char* const ConflictTag = "outbox:conflict";
+const char* const ReconcileTag = "outbox:reconcile";
+
+const int InitialRetryDelay = 2000;
+const int MaxRetryDelay = 5 * 60 * 1000;
+
+// Bulk enqueues and sent batches within this window share one rewrite of
+// the outbox file
+const int SaveDelayMs = 1000;
+}
+
+WriteOutbox::WriteOutbox(FirestoreService* firestoreService, StudentStore* store,
+                         const QString& filePath, QObject *parent)
+    : QObject(parent)
+    , m_firestoreService(firestoreService)
+    , m_store(store)
+    , m_filePath(filePath)
+    , m_nextSequence(1)
+    , m_batchSize(MaxBatchSize)
+    , m_isolateRemaining(0)
+    , m_retryDelay(InitialRetryDelay)
+    , m_retryTimer(new QTimer(this))
+    , m_saveTimer(new QTimer(this))
+{
+    m_retryTimer->setSingleShot(true);
+    connect(m_retryTimer, &QTimer::timeout, this, &WriteOutbox::flush);
+    m_saveTimer->setSingleShot(true);
+    m_saveTimer->setInterval(SaveDelayMs);
+    connect(m_saveTimer, &QTimer::timeout, this, &WriteOutbox::save);
+    connect(m_firestoreService, &FirestoreService::commitSucceeded, this, &WriteOutbox::onCommitSucceeded);
+    connect(m_firestoreService, &FirestoreService::commitFailed, this, &WriteOutbox::onCommitFailed);
+    connect(m_firestoreService, &FirestoreService::studentsFetched, this, &WriteOutbox::onStudentsFetched);
+}
+
+WriteOutbox::~WriteOutbox()
+{
+    if (m_saveTimer->isActive()) {
+        save();
+    }
+}
+
+void WriteOutbox::setBatchSize(int size)
+{
+    m_batchSize = qBound(1, size, MaxBatchSize);
+}
+
+void WriteOutbox::load()
+{
+    QFile file(m_filePath);
+    if (!file.exists()) {
+        qCDebug(outboxLog) << "No saved outbox at" << m_filePath;
+        return;
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCWarning(outboxLog) << "Could not open outbox file:" << file.errorString();
+        return;
+    }
+    
+    QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    m_entries.clear();
+    m_entrySequences.clear();
+    m_nextSequence = qMax<qint64>(1, root["nextSequence"].toInteger());
+    
+    const QJsonArray entries = root["entries"].toArray();
+    for (const QJsonValue& value : entries) {
+        QJsonObject json = value.toObject();
+        Entry entry;
+        entry.sequence = json["sequence"].toInteger();
+        entry.operation = json["operation"].toString() == "delete" ? Delete : Set;
+        entry.studentId = json["studentId"].toString();
+        entry.student = StudentStore::studentFromJson(json["student"].toObject());
+        entry.hadPrevious = json["hadPrevious"].toBool();
+        entry.previous = StudentStore::studentFromJson(json["previous"].toObject());
+        entry.attempts = json["attempts"].toInt();
+        for (const QJsonValue& field : json["fields"].toArray()) {
+            entry.fields.append(field.toString());
+        }
+        if (entry.studentId.isEmpty()) {
+            continue;
+        }
+        m_nextSequence = qMax(m_nextSequence, entry.sequence + 1);
+        appendEntry(entry);
+    }
+    
+    qCInfo(outboxLog) << "Restored" << m_entries.size() << "pending writes from" << m_filePath;
+    emit pendingCountChanged(m_entries.size());
+}
+
+int WriteOutbox::findQueuedEntry(const QString& studentId) const
+{
+    // Only the newest entry for a student may absorb a new write, and only
+    // while it has not been sent
+    const QList<qint64> sequences = m_entrySequences.values(studentId);
+    if (sequences.isEmpty()) {
+        return -1;
+    }
+    qint64 newest = *std::max_element(sequences.begin(), sequences.end());
+    return m_inFlight.contains(newest) ? -1 : indexOfSequence(newest);
+}
+
+int WriteOutbox::indexOfSequence(qint64 sequence) const
+{
+    auto it = std::lower_bound(m_entries.begin(), m_entries.end(), sequence,
+                               [](const Entry& entry, qint64 value) { return entry.sequence < value; });
+    return it != m_entries.end() && it->sequence == sequence ? int(it - m_entries.begin()) : -1;
+}
+
+void WriteOutbox::appendEntry(const Entry& entry)
+{
+    m_entries.append(entry);
+    m_entrySequences.insert(entry.studentId, entry.sequence);
+}
+
+WriteOutbox::Entry WriteOutbox::takeEntry(int index)
+{
+    Entry entry = m_entries.takeAt(index);
+    m_entrySequences.remove(entry.studentId, entry.sequence);
+    return entry;
+}
+
+void WriteOutbox::enqueueSet(const Student& student)
+{
+    queueSet(student);
+    
+    // The store holds the saved state; the next edit starts with clean dirty bits
+    Student stored = student;
+    stored.clearDirty();
+    m_store->upsert(stored);
+    save();
+    emit pendingCountChanged(m_entries.size());
+    flush();
+}
+
+void WriteOutbox::enqueueSets(const QList<Student>& students)
+{
+    QList<Student> stored;
+    stored.reserve(students.size());
+    for (const Student& student : students) {
+        queueSet(student);
+        stored.append(student);
+        stored.last().clearDirty();
+    }
+    m_store->upsertMany(stored);
+    
+    // Imports arrive in many chunks; flush() writes the file before any of
+    // them is sent
+    scheduleSave();
+    emit pendingCountChanged(m_entries.size());
+    flush();
+}
+
+void WriteOutbox::queueSet(const Student& student)
+{
+    int index = findQueuedEntry(student.getId());
+    if (index >= 0) {
+        qCDebug(outboxLog) << "Merging write into queued entry for" << student.getId();
+        m_entries[index].operation = Set;
+        m_entries[index].student = student;
+        for (const QString& field : student.dirtyFields()) {
+            if (!m_entries[index].fields.contains(field)) {
+                m_entries[index].fields.append(field);
+            }
+        }
+    } else {
+        Entry entry;
+        entry.sequence = m_nextSequence++;
+        entry.operation = Set;
+        entry.studentId = student.getId();
+        entry.student = student;
+        entry.fields = student.dirtyFields();
+        entry.hadPrevious = m_store->contains(student.getId());
+        entry.previous = m_store->student(student.getId());
+        appendEntry(entry);
+    }
+}
+
+void WriteOutbox::enqueueDelete(const QString& studentId)
+{
+    int index = findQueuedEntry(studentId);
+    if (index >= 0 && m_entries[index].operation == Set && !m_entries[index].hadPrevious) {
+        // Created and deleted before the server heard of it
+        qCDebug(outboxLog) << "Dropping unsent create for" << studentId;
+        takeEntry(index);
+    } else if (index >= 0) {
+        m_entries[index].operation = Delete;
+        m_entries[index].student = Student();
+    } else {
+        Entry entry;
+        entry.sequence = m_nextSequence++;
+        entry.operation = Delete;
+        entry.studentId = studentId;
+        entry.hadPrevious = m_store->contains(studentId);
+        entry.previous = m_store->student(studentId);
+        appendEntry(entry);
+    }
+    
+    m_store->remove(studentId);
+    save();
+    emit pendingCountChanged(m_entries.size());
+    flush();
+}
+
+void WriteOutbox::reapplyPending()
+{
+    for (const Entry& entry : std::as_const(m_entries)) {
+        applyToStore(entry);
+    }
+}
+
+bool WriteOutbox::hasPendingWrite(const QString& studentId) const
+{
+    return m_entrySequences.contains(studentId);
+}
+
+QSet<QString> WriteOutbox::pendingIds() const
+{
+    QSet<QString> ids;
+    ids.reserve(m_entrySequences.size());
+    for (auto it = m_entrySequences.keyBegin(); it != m_entrySequences.keyEnd(); ++it) {
+        ids.insert(*it);
+    }
+    return ids;
+}
+
+void WriteOutbox::applyToStore(const Entry& entry)
+{
+    if (entry.operation == Set) {
+        m_store->upsert(entry.student);
+    } else {
+        m_store->remove(entry.studentId);
+    }
+}
+
+void WriteOutbox::rollback(const Entry& entry)
+{
+    if (entry.hadPrevious) {
+        m_store->upsert(entry.previous);
+    } else {
+        m_store->remove(entry.studentId);
+    }
+}
+
+void WriteOutbox::flush()
+{
+    if (!m_inFlight.isEmpty() || m_entries.isEmpty()) {
+        return;
+    }
+    m_retryTimer->stop();
+    
+    // A commit may not touch the same document twice, so a batch ends at
+    // the first repeated student
+    int limit = m_isolateRemaining > 0 ? 1 : m_batchSize;
+    QJsonArray writes;
+    QSet<QString> batchIds;
+    for (const Entry& entry : std::as_const(m_entries)) {
+        if (writes.size() >= limit || batchIds.contains(entry.studentId)) {
+            break;
+        }
+        batchIds.insert(entry.studentId);
+        writes.append(toWrite(entry));
+        m_inFlight.append(entry.sequence);
+    }
+    
+    // Nothing reaches the server that a crash could forget locally
+    if (m_saveTimer->isActive()) {
+        save();
+    }
+    
+    m_inFlightTag = QString("outbox:%1").arg(m_inFlight.first());
+    qCInfo(outboxLog) << "Flushing" << writes.size() << "of" << m_entries.size() << "pending writes";
+    m_firestoreService->commitWrites(writes, m_inFlightTag);
+}
+
+QJsonObject WriteOutbox::toWrite(const Entry& entry) const
+{
+    // previous is the version the change was made against: its updateTime
+    // is the precondition and the fields that differ from it are the mask
+    QString baseUpdateTime = entry.hadPrevious ? entry.previous.getUpdateTime() : QString();
+    if (entry.operation == Delete) {
+        return m_firestoreService->deleteWrite(entry.studentId, baseUpdateTime);
+    }
+    
+    // Entries restored from an older outbox file have no dirty fields
+    QStringList fieldMask;
+    if (entry.hadPrevious) {
+        fieldMask = !entry.fields.isEmpty() ? entry.fields : entry.student.changedFields(entry.previous);
+    }
+    return m_firestoreService->setWrite(entry.student, baseUpdateTime, fieldMask);
+}
+
+void WriteOutbox::onCommitSucceeded(const QString& tag, const QStringList& updateTimes)
+{
+    if (tag != m_inFlightTag) {
+        return;
+    }
+    
+    for (int k = 0; k < m_inFlight.size(); ++k) {
+        int index = indexOfSequence(m_inFlight[k]);
+        if (index < 0) {
+            continue;
+        }
+        
+        Entry committed = takeEntry(index);
+        if (committed.operation == Set) {
+            m_reconcileIds.insert(committed.studentId);
+        } else {
+            m_reconcileIds.remove(committed.studentId);
+        }
+        QString updateTime = updateTimes.value(k);
+        if (committed.operation == Set && !updateTime.isEmpty()) {
+            // The next edit of this student is made against the version just written
+            if (!hasPendingWrite(committed.studentId)) {
+                m_store->setUpdateTime(committed.studentId, updateTime);
+            }
+            const QList<qint64> later = m_entrySequences.values(committed.studentId);
+            for (qint64 sequence : later) {
+                int laterIndex = indexOfSequence(sequence);
+                if (laterIndex >= 0) {
+                    m_entries[laterIndex].previous.setUpdateTime(updateTime);
+                }
+            }
+        }
+        emit writeCommitted(committed.studentId, committed.operation);
+    }
+    
+    if (m_isolateRemaining > 0) {
+        m_isolateRemaining = qMax(0, m_isolateRemaining - m_inFlight.size());
+    }
+    m_retryDelay = InitialRetryDelay;
+    qCInfo(outboxLog) << "Committed" << m_inFlight.size() << "writes," << m_entries.size() << "still pending";
+    finishBatch();
+}
+
+void WriteOutbox::onCommitFailed(const QString& tag, const QString& status, const QString& error, bool retryable)
+{
+    if (tag != m_inFlightTag) {
+        return;
+    }
+    
+    if (retryable) {
+        for (qint64 sequence : std::as_const(m_inFlight)) {
+            int index = indexOfSequence(sequence);
+            if (index >= 0) {
+                m_entries[index].attempts++;
+            }
+        }
+        qCWarning(outboxLog) << "Commit failed:" << error << "- retrying in" << m_retryDelay << "ms";
+        m_inFlight.clear();
+        m_inFlightTag.clear();
+        scheduleSave();
+        m_retryTimer->start(m_retryDelay);
+        m_retryDelay = qMin(m_retryDelay * 2, MaxRetryDelay);
+        return;
+    }
+    
+    if (m_inFlight.size() > 1) {
+        // Commits are atomic; resend one by one to find the refused write
+        qCWarning(outboxLog) << "Batch of" << m_inFlight.size() << "writes refused:" << error << "- isolating";
+        m_isolateRemaining = m_inFlight.size();
+        finishBatch();
+        return;
+    }
+    
+    // Roll back the refused write together with any later writes to the same
+    // student, which were built on top of it
+    int index = indexOfSequence(m_inFlight.first());
+    if (index >= 0) {
+        Entry rejected = takeEntry(index);
+        QList<qint64> later = m_entrySequences.values(rejected.studentId);
+        std::sort(later.begin(), later.end(), std::greater<qint64>());
+        QList<Entry> dependents;
+        for (qint64 sequence : std::as_const(later)) {
+            int laterIndex = indexOfSequence(sequence);
+            if (sequence > rejected.sequence && laterIndex >= 0) {
+                dependents.prepend(takeEntry(laterIndex));
+            }
+        }
+        rollback(rejected);
+        
+        if (status == "FAILED_PRECONDITION") {
+            // Someone else changed the document first; fetch their version
+            // before asking the user which one to keep
+            Conflict conflict;
+            const Entry& latest = dependents.isEmpty() ? rejected : dependents.last();
+            conflict.operation = latest.operation;
+            conflict.local = latest.operation == Set ? latest.student : rejected.previous;
+            conflict.base = rejected.previous;
+            conflict.fields = rejected.fields;
+            for (const Entry& dependent : std::as_const(dependents)) {
+                for (const QString& field : dependent.fields) {
+                    if (!conflict.fields.contains(field)) {
+                        conflict.fields.append(field);
+                    }
+                }
+            }
+            m_conflicts.insert(rejected.studentId, conflict);
+            qCWarning(outboxLog) << "Write for" << rejected.studentId << "conflicts with a newer server version";
+            m_firestoreService->getStudents({rejected.studentId}, ConflictTag);
+        } else {
+            qCWarning(outboxLog) << "Write for" << rejected.studentId << "refused, rolling back:" << error;
+            emit writeRejected(rejected.studentId, error);
+        }
+    }
+    
+    if (m_isolateRemaining > 0) {
+        m_isolateRemaining--;
+    }
+    finishBatch();
+}
+
+void WriteOutbox::onStudentsFetched(const QString& tag, const QList<Student>& found, const QStringList& missingIds)
+{
+    if (tag == ConflictTag) {
+        for (const Student& server : found) {
+            if (m_conflicts.contains(server.getId())) {
+                resolveConflict(server);
+            }
+        }
+        for (const QString& studentId : missingIds) {
+            if (!m_conflicts.contains(studentId)) {
+                continue;
+            }
+            // Deleted on the server in the meantime
+            Conflict conflict = m_conflicts.take(studentId);
+            m_store->remove(studentId);
+            if (conflict.operation == Delete) {
+                emit writeCommitted(studentId, Delete);
+            } else {
+                emit writeRejected(studentId, "Kayıt başka bir kullanıcı tarafından silinmiş");
+            }
+        }
+        return;
+    }
+    
+    if (tag == ReconcileTag) {
+        // Students edited again since the check was sent keep their local version
+        QList<Student> confirmed;
+        for (const Student& server : found) {
+            if (!hasPendingWrite(server.getId())) {
+                confirmed.append(server);
+            }
+        }
+        QStringList missing;
+        for (const QString& studentId : missingIds) {
+            if (!hasPendingWrite(studentId)) {
+                missing.append(studentId);
+            }
+        }
+        
+        m_store->upsertMany(confirmed);
+        m_store->removeMany(missing);
+        if (!missing.isEmpty()) {
+            qCWarning(outboxLog) << missing.size() << "written students are missing on the server:" << missing;
+        }
+        emit reconciled(confirmed.size(), missing.size());
+    }
+}
+
+void WriteOutbox::resolveConflict(const Student& server)
+{
+    Conflict conflict = m_conflicts.take(server.getId());
+    m_store->upsert(server);
+    
+    // Without merged dirty fields the write sent the difference to its base
+    if (conflict.operation == Set && conflict.fields.isEmpty()) {
+        conflict.fields = conflict.local.changedFields(conflict.base);
+    }
+    
+    // A retried commit whose first attempt did land looks like a conflict
+    // with our own write. Only the edited fields count: a partial local
+    // copy differs from the server in the fields it never loaded.
+    QStringList differing;
+    const QStringList changed = conflict.local.changedFields(server);
+    for (const QString& field : changed) {
+        if (conflict.fields.contains(field) && field != "lastUpdateTime") {
+            differing.append(field);
+        }
+    }
+    if (conflict.operation == Set && differing.isEmpty()) {
+        qCInfo(outboxLog) << "Server already holds the local version of" << server.getId();
+        emit writeCommitted(server.getId(), Set);
+        return;
+    }
+    
+    // Edits to different fields do not conflict: re-apply ours on top of theirs
+    if (conflict.operation == Set && !conflict.base.isPartial() && !conflict.fields.isEmpty()) {
+        QStringList serverFields = server.changedFields(conflict.base);
+        QStringList localFields = conflict.fields;
+        serverFields.removeAll("lastUpdateTime");
+        localFields.removeAll("lastUpdateTime");
+        
+        bool overlap = false;
+        for (const QString& field : std::as_const(localFields)) {
+            if (serverFields.contains(field)) {
+                overlap = true;
+                break;
+            }
+        }
+        
+        if (!overlap) {
+            qCInfo(outboxLog) << "Rebasing fields" << localFields << "of" << server.getId()
+                              << "onto server changes to" << serverFields;
+            Student merged = server;
+            merged.clearDirty();
+            merged.applyFields(conflict.local, conflict.fields);
+            enqueueSet(merged);
+            return;
+        }
+    }
+    
+    emit writeConflict(conflict.operation, conflict.local, server, conflict.fields);
+}
+
+void WriteOutbox::finishBatch()
+{
+    m_inFlight.clear();
+    m_inFlightTag.clear();
+    scheduleSave();
+    emit pendingCountChanged(m_entries.size());
+    
+    if (m_entries.isEmpty() && !m_reconcileIds.isEmpty()) {
+        qCInfo(outboxLog) << "Queue drained, reading back" << m_reconcileIds.size() << "written students";
+        m_firestoreService->getStudents(QStringList(m_reconcileIds.begin(), m_reconcileIds.end()), ReconcileTag);
+        m_reconcileIds.clear();
+        return;
+    }
+    flush();
+}
+
+void WriteOutbox::scheduleSave()
+{
+    // Not restarted while running, so a steady stream still gets saved
+    if (!m_saveTimer->isActive()) {
+        m_saveTimer->start();
+    }
+}
+
+void WriteOutbox::save()
+{
+    m_saveTimer->stop();
+    
+    QJsonArray entries;
+    for (const Entry& entry : m_entries) {
+        QJsonObject json;
+        json["sequence"] = entry.sequence;
+        json["operation"] = entry.operation == Delete ? "delete" : "set";
+        json["studentId"] = entry.studentId;
+        if (entry.operation == Set) {
+            json["student"] = StudentStore::studentToJson(entry.student);
+            json["fields"] = QJsonArray::fromStringList(entry.fields);
+        }
+        json["hadPrevious"] = entry.hadPrevious;
+        if (entry.hadPrevious) {
+            json["previous"] = StudentStore::studentToJson(entry.previous);
+        }
+        json["attempts"] = entry.attempts;
+        entries.append(json);
+    }
+    
+    QJsonObject root;
+    root["nextSequence"] = m_nextSequence;
+    root["entries"] = entries;
+    
+    // Write to a temporary file and rename, so a crash never leaves half a queue
+    QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+    QSaveFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(outboxLog) << "Could not write outbox file:" << file.errorString();
+        return;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    if (!file.commit()) {
+        qCWarning(outboxLog) << "Could not save outbox file:" << file.errorString();
+    }
+}
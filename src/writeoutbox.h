@@ -0,0 +1,143 @@
+#ifndef WRITEOUTBOX_H
+#define WRITEOUTBOX_H
+
+#include <QObject>
+#include <QList>
+#include <QSet>
+#include <QHash>
+#include <QTimer>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include "student.h"
+
+Q_DECLARE_LOGGING_CATEGORY(outboxLog)
+
+class FirestoreService;
+class StudentStore;
+
+/**
+ * WriteOutbox - Optimistic local writes with durable, batched delivery
+ *
+ * Adds, edits and deletes are applied to the StudentStore immediately and
+ * queued in a JSON file, so they survive restarts and offline periods. The
+ * queue is sent through FirestoreService::commitWrites in batches:
+ *   - network errors, 429 and 5xx keep the batch and retry with backoff;
+ *   - a refused batch is resent one write at a time to find the culprit,
+ *     whose change is rolled back in the store and reported via writeRejected.
+ * Several edits to the same student that have not been sent yet collapse
+ * into one write.
+ *
+ * Edits and deletes are conditional on the updateTime of the version they
+ * were made against and send only the changed fields. When someone else
+ * changed the document first, the server version is fetched and put in the
+ * store. If the two edits touched different fields, the local one is
+ * re-applied on top silently; otherwise writeConflict reports both versions
+ * and the fields the local change touched, the only ones to re-apply.
+ *
+ * Whenever the queue drains, the written students are read back with one
+ * batchGet and the store is corrected from the server copies.
+ *
+ * Entries are kept in sequence order and indexed by student ID, so lookups
+ * stay cheap with a large import queued. A single edit or delete is saved
+ * to the file before enqueueSet/enqueueDelete return. Bulk enqueues and
+ * finished batches are saved at most once a second, but always before the
+ * next commit is sent and on destruction.
+ */
+class WriteOutbox : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Operation {
+        Set,
+        Delete
+    };
+    
+    WriteOutbox(FirestoreService* firestoreService, StudentStore* store,
+                const QString& filePath, QObject *parent = nullptr);
+    ~WriteOutbox() override;
+    
+    // Restores the queue saved by a previous session
+    void load();
+    
+    // Writes per commit, capped at the 500 Firestore accepts
+    void setBatchSize(int size);
+    int batchSize() const { return m_batchSize; }
+    
+    void enqueueSet(const Student& student);
+    void enqueueSets(const QList<Student>& students); // One store update and one save for bulk adds
+    void enqueueDelete(const QString& studentId);
+    
+    // Re-applies queued writes after the store was reloaded from the server
+    void reapplyPending();
+    
+    bool hasPendingWrite(const QString& studentId) const;
+    QSet<QString> pendingIds() const;
+    int pendingCount() const { return m_entries.size(); }
+
+public slots:
+    void flush();
+
+signals:
+    void pendingCountChanged(int count);
+    void writeCommitted(const QString& studentId, WriteOutbox::Operation operation);
+    void writeRejected(const QString& studentId, const QString& error);
+    void writeConflict(WriteOutbox::Operation operation, const Student& local, const Student& server,
+                       const QStringList& fields);
+    void reconciled(int confirmedCount, int missingCount); // Server check after the queue drained
+
+private slots:
+    void onCommitSucceeded(const QString& tag, const QStringList& updateTimes);
+    void onCommitFailed(const QString& tag, const QString& status, const QString& error, bool retryable);
+    void onStudentsFetched(const QString& tag, const QList<Student>& found, const QStringList& missingIds);
+
+private:
+    struct Entry {
+        qint64 sequence = 0;
+        Operation operation = Set;
+        QString studentId;
+        Student student;      // Set: the new version
+        bool hadPrevious = false;
+        Student previous;     // Store contents before the first queued write, for rollback
+        QStringList fields;   // Set: dirty fields of all merged edits, sent as the updateMask
+        int attempts = 0;
+    };
+    
+    struct Conflict {
+        Operation operation = Set;
+        Student local;
+        Student base;         // Version the local change was made against
+        QStringList fields;   // Fields the local change touched
+    };
+    
+    int findQueuedEntry(const QString& studentId) const;
+    int indexOfSequence(qint64 sequence) const;
+    void appendEntry(const Entry& entry);
+    Entry takeEntry(int index);
+    void queueSet(const Student& student);
+    QJsonObject toWrite(const Entry& entry) const;
+    void applyToStore(const Entry& entry);
+    void rollback(const Entry& entry);
+    void scheduleSave();
+    void save();
+    void finishBatch();
+    void resolveConflict(const Student& server);
+    
+    FirestoreService* m_firestoreService;
+    StudentStore* m_store;
+    QString m_filePath;
+    QList<Entry> m_entries; // Ascending sequence
+    QMultiHash<QString, qint64> m_entrySequences; // Student ID -> sequences of its entries
+    QHash<QString, Conflict> m_conflicts; // Student ID -> refused local change awaiting the server version
+    QSet<QString> m_reconcileIds; // Students written since the queue last drained
+    QList<qint64> m_inFlight;   // Sequences of the batch being committed
+    QString m_inFlightTag;
+    qint64 m_nextSequence;
+    int m_batchSize;
+    int m_isolateRemaining;     // Writes left to resend one by one after a refused batch
+    int m_retryDelay;
+    QTimer* m_retryTimer;
+    QTimer* m_saveTimer;
+};
+
+#endif // WRITEOUTBOX_H
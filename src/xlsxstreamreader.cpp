@@ -0,0 +1,224 @@
+#include "xlsxstreamreader.h"
+#include "zipreader.h"
+
+namespace {
+const char* const DefaultSheetPath = "xl/worksheets/sheet1.xml";
+const char* const DefaultSharedStringsPath = "xl/sharedStrings.xml";
+}
+
+XlsxStreamReader::XlsxStreamReader(const QString& filePath)
+    : m_filePath(filePath)
+    , m_rowCountHint(0)
+    , m_lastRow(0)
+{
+}
+
+XlsxStreamReader::~XlsxStreamReader() = default;
+
+QString XlsxStreamReader::resolvePath(const QString& target)
+{
+    // Relationship targets are relative to xl/ unless absolute
+    return target.startsWith('/') ? target.mid(1) : "xl/" + target;
+}
+
+int XlsxStreamReader::columnIndex(const QString& reference)
+{
+    // "C12" -> 2, "AA3" -> 26; -1 without a column part
+    int index = 0;
+    int letters = 0;
+    for (QChar ch : reference) {
+        if (ch < 'A' || ch > 'Z') {
+            break;
+        }
+        index = index * 26 + (ch.unicode() - 'A' + 1);
+        ++letters;
+    }
+    return letters > 0 ? index - 1 : -1;
+}
+
+QString XlsxStreamReader::firstSheetPath()
+{
+    // workbook.xml names the sheets in order; the relationships map the
+    // first one's r:id to its part
+    QString relationId;
+    QXmlStreamReader workbook(m_zip->readEntry("xl/workbook.xml"));
+    while (!workbook.atEnd() && relationId.isEmpty()) {
+        if (workbook.readNext() == QXmlStreamReader::StartElement && workbook.name() == u"sheet") {
+            const QXmlStreamAttributes attributes = workbook.attributes();
+            for (const QXmlStreamAttribute& attribute : attributes) {
+                if (attribute.name() == u"id") {
+                    relationId = attribute.value().toString();
+                }
+            }
+        }
+    }
+    
+    QXmlStreamReader relationships(m_zip->readEntry("xl/_rels/workbook.xml.rels"));
+    while (!relationships.atEnd()) {
+        if (relationships.readNext() == QXmlStreamReader::StartElement && relationships.name() == u"Relationship"
+            && relationships.attributes().value("Id") == relationId) {
+            return resolvePath(relationships.attributes().value("Target").toString());
+        }
+    }
+    return DefaultSheetPath;
+}
+
+bool XlsxStreamReader::loadSharedStrings(const QString& path)
+{
+    std::unique_ptr<QIODevice> device = m_zip->openEntry(path);
+    if (!device) {
+        m_error = m_zip->errorString();
+        return false;
+    }
+    
+    // Rich text splits a string into runs; phonetic hints are not part of it
+    QXmlStreamReader xml(device.get());
+    QString current;
+    bool inPhonetic = false;
+    while (!xml.atEnd()) {
+        QXmlStreamReader::TokenType token = xml.readNext();
+        if (token == QXmlStreamReader::StartElement) {
+            if (xml.name() == u"si") {
+                current.clear();
+            } else if (xml.name() == u"rPh") {
+                inPhonetic = true;
+            } else if (xml.name() == u"t" && !inPhonetic) {
+                current += xml.readElementText();
+            }
+        } else if (token == QXmlStreamReader::EndElement) {
+            if (xml.name() == u"si") {
+                m_sharedStrings.append(current);
+            } else if (xml.name() == u"rPh") {
+                inPhonetic = false;
+            }
+        }
+    }
+    if (xml.hasError()) {
+        m_error = QString("Shared strings: %1").arg(xml.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool XlsxStreamReader::open()
+{
+    m_zip.reset(new ZipReader(m_filePath));
+    if (!m_zip->open()) {
+        m_error = m_zip->errorString();
+        return false;
+    }
+    
+    if (m_zip->contains(DefaultSharedStringsPath) && !loadSharedStrings(DefaultSharedStringsPath)) {
+        return false;
+    }
+    
+    m_sheet = m_zip->openEntry(firstSheetPath());
+    if (!m_sheet) {
+        m_error = m_zip->errorString();
+        return false;
+    }
+    m_xml.setDevice(m_sheet.get());
+    
+    // Skip to the rows, picking up the dimension (e.g. A1:H1000) on the way
+    while (!m_xml.atEnd()) {
+        if (m_xml.readNext() != QXmlStreamReader::StartElement) {
+            continue;
+        }
+        if (m_xml.name() == u"dimension") {
+            QString reference = m_xml.attributes().value("ref").toString();
+            QString last = reference.section(':', -1);
+            int digits = 0;
+            while (digits < last.size() && !last.at(digits).isDigit()) {
+                ++digits;
+            }
+            m_rowCountHint = last.mid(digits).toInt();
+        } else if (m_xml.name() == u"sheetData") {
+            return true;
+        }
+    }
+    
+    m_error = m_xml.hasError() ? m_xml.errorString() : "Sheet has no data";
+    return false;
+}
+
+QVariant XlsxStreamReader::readCell(const QString& type)
+{
+    // At <c>; the value is in <v>, or in <is><t> for inline strings
+    QString text;
+    bool hasValue = false;
+    while (m_xml.readNextStartElement()) {
+        if (m_xml.name() == u"v") {
+            text = m_xml.readElementText();
+            hasValue = true;
+        } else if (m_xml.name() == u"is") {
+            while (!m_xml.atEnd() && !(m_xml.isEndElement() && m_xml.name() == u"is")) {
+                if (m_xml.readNext() == QXmlStreamReader::StartElement && m_xml.name() == u"t") {
+                    text += m_xml.readElementText();
+                }
+            }
+            hasValue = true;
+        } else {
+            m_xml.skipCurrentElement(); // Formula and extensions
+        }
+    }
+    
+    if (!hasValue) {
+        return QVariant();
+    }
+    if (type == "s") {
+        int index = text.toInt();
+        return index >= 0 && index < m_sharedStrings.size() ? QVariant(m_sharedStrings.at(index)) : QVariant();
+    }
+    if (type == "inlineStr" || type == "str" || type == "e") {
+        return text;
+    }
+    if (type == "b") {
+        return text == "1";
+    }
+    
+    bool ok = false;
+    double number = text.toDouble(&ok);
+    return ok ? QVariant(number) : QVariant(text);
+}
+
+bool XlsxStreamReader::readRow(int* rowNumber, QVariantList* cells)
+{
+    while (!m_xml.atEnd()) {
+        QXmlStreamReader::TokenType token = m_xml.readNext();
+        if (token == QXmlStreamReader::EndElement && m_xml.name() == u"sheetData") {
+            break;
+        }
+        if (token != QXmlStreamReader::StartElement || m_xml.name() != u"row") {
+            continue;
+        }
+        
+        bool numbered = false;
+        int row = m_xml.attributes().value("r").toInt(&numbered);
+        m_lastRow = numbered ? row : m_lastRow + 1;
+        
+        cells->clear();
+        while (m_xml.readNextStartElement()) {
+            if (m_xml.name() != u"c") {
+                m_xml.skipCurrentElement();
+                continue;
+            }
+            int column = columnIndex(m_xml.attributes().value("r").toString());
+            if (column < 0) {
+                column = cells->size();
+            }
+            QVariant value = readCell(m_xml.attributes().value("t").toString());
+            if (column >= cells->size()) {
+                cells->resize(column + 1);
+            }
+            (*cells)[column] = value;
+        }
+        
+        *rowNumber = m_lastRow;
+        return true;
+    }
+    
+    if (m_xml.hasError()) {
+        m_error = m_xml.errorString();
+    }
+    return false;
+}
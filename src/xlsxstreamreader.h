@@ -0,0 +1,54 @@
+#ifndef XLSXSTREAMREADER_H
+#define XLSXSTREAMREADER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVariantList>
+#include <QXmlStreamReader>
+#include <memory>
+
+class ZipReader;
+class QIODevice;
+
+/**
+ * XlsxStreamReader - Reads the first sheet of an XLSX file row by row
+ *
+ * The sheet XML is inflated and parsed as it is read, so only the shared
+ * strings table and the current row are in memory. Cells come back as
+ * QString, double or bool; missing cells in a row are empty QVariants.
+ */
+class XlsxStreamReader
+{
+public:
+    explicit XlsxStreamReader(const QString& filePath);
+    ~XlsxStreamReader();
+    
+    bool open();
+    
+    // Last row of the sheet's dimension record, 0 when the file has none
+    int rowCountHint() const { return m_rowCountHint; }
+    
+    // False at the end of the sheet or on error
+    bool readRow(int* rowNumber, QVariantList* cells);
+    
+    bool hasError() const { return !m_error.isEmpty(); }
+    QString errorString() const { return m_error; }
+
+private:
+    QString firstSheetPath();
+    bool loadSharedStrings(const QString& path);
+    QVariant readCell(const QString& type);
+    static int columnIndex(const QString& reference);
+    static QString resolvePath(const QString& target);
+    
+    QString m_filePath;
+    std::unique_ptr<ZipReader> m_zip;
+    std::unique_ptr<QIODevice> m_sheet;
+    QXmlStreamReader m_xml;
+    QStringList m_sharedStrings;
+    int m_rowCountHint;
+    int m_lastRow;
+    QString m_error;
+};
+
+#endif // XLSXSTREAMREADER_H
@@ -0,0 +1,237 @@
+#include "xlsxstreamwriter.h"
+#include "zipwriter.h"
+
+namespace {
+const char* const XmlDeclaration = "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n";
+const char* const MainNamespace = "http://schemas.openxmlformats.org/spreadsheetml/2006/main";
+const char* const RelationshipNamespace = "http://schemas.openxmlformats.org/officeDocument/2006/relationships";
+
+const char* const ContentTypes =
+    "<Types xmlns=\"http://schemas.openxmlformats.org/package/2006/content-types\">"
+    "<Default Extension=\"rels\" ContentType=\"application/vnd.openxmlformats-package.relationships+xml\"/>"
+    "<Default Extension=\"xml\" ContentType=\"application/xml\"/>"
+    "<Override PartName=\"/xl/workbook.xml\" ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.sheet.main+xml\"/>"
+    "<Override PartName=\"/xl/worksheets/sheet1.xml\" ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.worksheet+xml\"/>"
+    "<Override PartName=\"/xl/styles.xml\" ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.styles+xml\"/>"
+    "<Override PartName=\"/xl/sharedStrings.xml\" ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.sharedStrings+xml\"/>"
+    "</Types>";
+
+const char* const PackageRelationships =
+    "<Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">"
+    "<Relationship Id=\"rId1\" Type=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships/officeDocument\" Target=\"xl/workbook.xml\"/>"
+    "</Relationships>";
+
+const char* const WorkbookRelationships =
+    "<Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">"
+    "<Relationship Id=\"rId1\" Type=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships/worksheet\" Target=\"worksheets/sheet1.xml\"/>"
+    "<Relationship Id=\"rId2\" Type=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships/styles\" Target=\"styles.xml\"/>"
+    "<Relationship Id=\"rId3\" Type=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships/sharedStrings\" Target=\"sharedStrings.xml\"/>"
+    "</Relationships>";
+
+// Cell formats in the order of XlsxStreamWriter::Style; the header matches
+// the one the QXlsx export used (blue 4F81BD background)
+const char* const Styles =
+    "<styleSheet xmlns=\"http://schemas.openxmlformats.org/spreadsheetml/2006/main\">"
+    "<fonts count=\"2\">"
+    "<font><sz val=\"11\"/><name val=\"Calibri\"/></font>"
+    "<font><b/><sz val=\"11\"/><color rgb=\"FFFFFFFF\"/><name val=\"Calibri\"/></font>"
+    "</fonts>"
+    "<fills count=\"3\">"
+    "<fill><patternFill patternType=\"none\"/></fill>"
+    "<fill><patternFill patternType=\"gray125\"/></fill>"
+    "<fill><patternFill patternType=\"solid\"><fgColor rgb=\"FF4F81BD\"/><bgColor indexed=\"64\"/></patternFill></fill>"
+    "</fills>"
+    "<borders count=\"2\">"
+    "<border><left/><right/><top/><bottom/><diagonal/></border>"
+    "<border><left style=\"thin\"><color auto=\"1\"/></left><right style=\"thin\"><color auto=\"1\"/></right>"
+    "<top style=\"thin\"><color auto=\"1\"/></top><bottom style=\"thin\"><color auto=\"1\"/></bottom><diagonal/></border>"
+    "</borders>"
+    "<cellStyleXfs count=\"1\"><xf numFmtId=\"0\" fontId=\"0\" fillId=\"0\" borderId=\"0\"/></cellStyleXfs>"
+    "<cellXfs count=\"4\">"
+    "<xf numFmtId=\"0\" fontId=\"0\" fillId=\"0\" borderId=\"0\" xfId=\"0\"/>"
+    "<xf numFmtId=\"0\" fontId=\"1\" fillId=\"2\" borderId=\"1\" xfId=\"0\" applyFont=\"1\" applyFill=\"1\" applyBorder=\"1\" applyAlignment=\"1\">"
+    "<alignment horizontal=\"center\" vertical=\"center\"/></xf>"
+    "<xf numFmtId=\"0\" fontId=\"0\" fillId=\"0\" borderId=\"1\" xfId=\"0\" applyBorder=\"1\" applyAlignment=\"1\">"
+    "<alignment vertical=\"center\"/></xf>"
+    "<xf numFmtId=\"0\" fontId=\"0\" fillId=\"0\" borderId=\"1\" xfId=\"0\" applyBorder=\"1\" applyAlignment=\"1\">"
+    "<alignment horizontal=\"center\" vertical=\"center\"/></xf>"
+    "</cellXfs>"
+    "<cellStyles count=\"1\"><cellStyle name=\"Normal\" xfId=\"0\" builtinId=\"0\"/></cellStyles>"
+    "</styleSheet>";
+}
+
+XlsxStreamWriter::XlsxStreamWriter(const QString& filePath)
+    : m_filePath(filePath)
+    , m_file(filePath)
+    , m_rowNumber(0)
+    , m_column(0)
+    , m_sharedCount(0)
+{
+}
+
+XlsxStreamWriter::~XlsxStreamWriter()
+{
+    if (m_file.isOpen()) {
+        discard();
+    }
+}
+
+QString XlsxStreamWriter::errorString() const
+{
+    if (!m_error.isEmpty()) {
+        return m_error;
+    }
+    return m_zip ? m_zip->errorString() : QString();
+}
+
+QString XlsxStreamWriter::columnName(int column)
+{
+    // 0 -> A, 25 -> Z, 26 -> AA
+    QString name;
+    for (int n = column + 1; n > 0; n = (n - 1) / 26) {
+        name.prepend(QChar('A' + (n - 1) % 26));
+    }
+    return name;
+}
+
+QString XlsxStreamWriter::escaped(const QString& text)
+{
+    // Control characters other than tab and newlines are not allowed in XML
+    QString clean;
+    clean.reserve(text.size());
+    for (QChar ch : text) {
+        if (ch.unicode() >= 0x20 || ch == '\t' || ch == '\n' || ch == '\r') {
+            clean.append(ch);
+        }
+    }
+    return clean.toHtmlEscaped();
+}
+
+bool XlsxStreamWriter::open(const QString& sheetName, const QList<double>& columnWidths)
+{
+    if (!m_file.open(QIODevice::WriteOnly)) {
+        m_error = QString("Could not open %1: %2").arg(m_filePath, m_file.errorString());
+        return false;
+    }
+    m_zip.reset(new ZipWriter(&m_file));
+    m_sheetName = sheetName;
+    
+    QByteArray workbook = QByteArray(XmlDeclaration)
+        + "<workbook xmlns=\"" + MainNamespace + "\" xmlns:r=\"" + RelationshipNamespace + "\">"
+        + "<sheets><sheet name=\"" + escaped(sheetName).toUtf8() + "\" sheetId=\"1\" r:id=\"rId1\"/></sheets>"
+        + "</workbook>";
+    
+    const QList<QPair<QString, QByteArray>> parts = {
+        {"[Content_Types].xml", QByteArray(XmlDeclaration) + ContentTypes},
+        {"_rels/.rels", QByteArray(XmlDeclaration) + PackageRelationships},
+        {"xl/workbook.xml", workbook},
+        {"xl/_rels/workbook.xml.rels", QByteArray(XmlDeclaration) + WorkbookRelationships},
+        {"xl/styles.xml", QByteArray(XmlDeclaration) + Styles}
+    };
+    for (const auto& part : parts) {
+        if (!m_zip->beginEntry(part.first) || !m_zip->write(part.second)) {
+            return false;
+        }
+    }
+    
+    // The sheet stays open; rows are appended until close()
+    QByteArray sheet = QByteArray(XmlDeclaration)
+        + "<worksheet xmlns=\"" + MainNamespace + "\" xmlns:r=\"" + RelationshipNamespace + "\">";
+    if (!columnWidths.isEmpty()) {
+        sheet += "<cols>";
+        for (int i = 0; i < columnWidths.size(); ++i) {
+            sheet += QString("<col min=\"%1\" max=\"%1\" width=\"%2\" customWidth=\"1\"/>")
+                         .arg(i + 1).arg(columnWidths[i]).toUtf8();
+        }
+        sheet += "</cols>";
+    }
+    sheet += "<sheetData>";
+    return m_zip->beginEntry("xl/worksheets/sheet1.xml") && m_zip->write(sheet);
+}
+
+void XlsxStreamWriter::beginRow()
+{
+    ++m_rowNumber;
+    m_column = 0;
+    m_row = QString("<row r=\"%1\">").arg(m_rowNumber).toUtf8();
+}
+
+void XlsxStreamWriter::beginCell(Style style, const char* type)
+{
+    m_row += "<c r=\"" + columnName(m_column++).toLatin1() + QByteArray::number(m_rowNumber) + "\"";
+    if (style != Default) {
+        m_row += " s=\"" + QByteArray::number(style) + "\"";
+    }
+    if (type) {
+        m_row += QByteArray(" t=\"") + type + "\"";
+    }
+    m_row += ">";
+}
+
+void XlsxStreamWriter::addString(const QString& text, Style style)
+{
+    beginCell(style, "inlineStr");
+    m_row += "<is><t xml:space=\"preserve\">" + escaped(text).toUtf8() + "</t></is></c>";
+}
+
+void XlsxStreamWriter::addSharedString(const QString& text, Style style)
+{
+    auto it = m_sharedIndex.constFind(text);
+    int index;
+    if (it != m_sharedIndex.constEnd()) {
+        index = it.value();
+    } else {
+        index = m_sharedStrings.size();
+        m_sharedIndex.insert(text, index);
+        m_sharedStrings.append(text);
+    }
+    ++m_sharedCount;
+    
+    beginCell(style, "s");
+    m_row += "<v>" + QByteArray::number(index) + "</v></c>";
+}
+
+void XlsxStreamWriter::addNumber(double value, Style style)
+{
+    beginCell(style, nullptr);
+    m_row += "<v>" + QByteArray::number(value, 'g', 15) + "</v></c>";
+}
+
+bool XlsxStreamWriter::endRow()
+{
+    m_row += "</row>";
+    return m_zip->write(m_row);
+}
+
+bool XlsxStreamWriter::close()
+{
+    if (!m_zip->write("</sheetData></worksheet>") || !m_zip->endEntry()) {
+        discard();
+        return false;
+    }
+    
+    QByteArray shared = QByteArray(XmlDeclaration)
+        + "<sst xmlns=\"" + MainNamespace + "\" count=\"" + QByteArray::number(m_sharedCount)
+        + "\" uniqueCount=\"" + QByteArray::number(m_sharedStrings.size()) + "\">";
+    for (const QString& text : m_sharedStrings) {
+        shared += "<si><t xml:space=\"preserve\">" + escaped(text).toUtf8() + "</t></si>";
+    }
+    shared += "</sst>";
+    
+    if (!m_zip->beginEntry("xl/sharedStrings.xml") || !m_zip->write(shared) || !m_zip->finish()) {
+        discard();
+        return false;
+    }
+    
+    if (!m_file.commit()) {
+        m_error = QString("Could not save %1: %2").arg(m_filePath, m_file.errorString());
+        return false;
+    }
+    return true;
+}
+
+void XlsxStreamWriter::discard()
+{
+    m_file.cancelWriting();
+    m_file.commit(); // Closes the device and removes the temporary file
+}
@@ -0,0 +1,69 @@
+#ifndef XLSXSTREAMWRITER_H
+#define XLSXSTREAMWRITER_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QList>
+#include <QSaveFile>
+#include <memory>
+
+class ZipWriter;
+
+/**
+ * XlsxStreamWriter - Writes a single-sheet XLSX file row by row
+ *
+ * Rows go straight into the compressed sheet part instead of a workbook
+ * model, so memory does not grow with the row count. Cells are either
+ * inline strings or, for columns with few distinct values (school, field,
+ * yes/no), entries in the shared strings table, which is written when the
+ * file is closed. The file only replaces the target once close() succeeds.
+ */
+class XlsxStreamWriter
+{
+public:
+    // Cell formats of the built-in stylesheet
+    enum Style {
+        Default = 0,
+        Header = 1,   // Bold white on blue, centered, thin border
+        Data = 2,     // Thin border
+        Centered = 3  // Thin border, centered
+    };
+    
+    explicit XlsxStreamWriter(const QString& filePath);
+    ~XlsxStreamWriter();
+    
+    bool open(const QString& sheetName, const QList<double>& columnWidths);
+    
+    void beginRow();
+    void addString(const QString& text, Style style = Data);
+    void addSharedString(const QString& text, Style style = Data);
+    void addNumber(double value, Style style = Data);
+    bool endRow();
+    
+    bool close();
+    void discard(); // Leaves the target untouched
+    
+    QString errorString() const;
+
+private:
+    void beginCell(Style style, const char* type);
+    static QString columnName(int column);
+    static QString escaped(const QString& text);
+    
+    QString m_filePath;
+    QSaveFile m_file;
+    std::unique_ptr<ZipWriter> m_zip;
+    QString m_sheetName;
+    QString m_error;
+    
+    QByteArray m_row;    // Row being built
+    int m_rowNumber;
+    int m_column;
+    
+    QHash<QString, int> m_sharedIndex;
+    QStringList m_sharedStrings;
+    int m_sharedCount;   // References, for the count attribute
+};
+
+#endif // XLSXSTREAMWRITER_H
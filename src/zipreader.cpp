@@ -0,0 +1,236 @@
+#include "zipreader.h"
+#include <QDataStream>
+#include <QtEndian>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#else
+struct z_stream_s {};
+#endif
+
+namespace {
+const quint32 LocalHeaderSignature = 0x04034b50;
+const quint32 CentralHeaderSignature = 0x02014b50;
+const quint32 EndOfCentralDirectorySignature = 0x06054b50;
+
+const int LocalHeaderSize = 30;
+const int EndOfCentralDirectorySize = 22;
+const int MaxCommentSize = 0xFFFF;
+
+const quint16 MethodStored = 0;
+const quint16 MethodDeflated = 8;
+
+// Compressed bytes read from the file at a time
+const int InputChunkSize = 64 * 1024;
+}
+
+ZipReader::ZipReader(const QString& filePath)
+    : m_file(filePath)
+{
+}
+
+ZipReader::~ZipReader() = default;
+
+bool ZipReader::open()
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    
+    // The end record sits at the very end, followed only by an optional comment
+    qint64 tailSize = qMin<qint64>(m_file.size(), EndOfCentralDirectorySize + MaxCommentSize);
+    m_file.seek(m_file.size() - tailSize);
+    QByteArray tail = m_file.read(tailSize);
+    
+    int end = -1;
+    for (int i = tail.size() - EndOfCentralDirectorySize; i >= 0; --i) {
+        if (qFromLittleEndian<quint32>(tail.constData() + i) == EndOfCentralDirectorySignature) {
+            end = i;
+            break;
+        }
+    }
+    if (end < 0) {
+        m_error = "Not a ZIP archive";
+        return false;
+    }
+    
+    quint16 entryCount = qFromLittleEndian<quint16>(tail.constData() + end + 10);
+    quint32 directorySize = qFromLittleEndian<quint32>(tail.constData() + end + 12);
+    quint32 directoryOffset = qFromLittleEndian<quint32>(tail.constData() + end + 16);
+    
+    m_file.seek(directoryOffset);
+    QByteArray directory = m_file.read(directorySize);
+    if (directory.size() != static_cast<int>(directorySize)) {
+        m_error = "Truncated central directory";
+        return false;
+    }
+    
+    QDataStream stream(directory);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    for (int i = 0; i < entryCount; ++i) {
+        quint32 signature;
+        quint16 versionMadeBy, versionNeeded, flags, time, date, nameLength, extraLength, commentLength;
+        quint16 disk, internalAttributes;
+        quint32 crc, externalAttributes;
+        Entry entry;
+        stream >> signature >> versionMadeBy >> versionNeeded >> flags >> entry.method >> time >> date
+               >> crc >> entry.compressedSize >> entry.size >> nameLength >> extraLength >> commentLength
+               >> disk >> internalAttributes >> externalAttributes >> entry.headerOffset;
+        if (signature != CentralHeaderSignature || stream.status() != QDataStream::Ok) {
+            m_error = "Corrupt central directory";
+            return false;
+        }
+        
+        QByteArray name(nameLength, Qt::Uninitialized);
+        stream.readRawData(name.data(), nameLength);
+        stream.skipRawData(extraLength + commentLength);
+        m_entries.insert(QString::fromUtf8(name), entry);
+    }
+    return true;
+}
+
+std::unique_ptr<QIODevice> ZipReader::openEntry(const QString& name)
+{
+    auto it = m_entries.constFind(name);
+    if (it == m_entries.constEnd()) {
+        m_error = QString("Missing entry: %1").arg(name);
+        return nullptr;
+    }
+
+#ifdef HAVE_ZLIB
+    bool supported = it->method == MethodStored || it->method == MethodDeflated;
+#else
+    bool supported = it->method == MethodStored;
+#endif
+    if (!supported) {
+        m_error = QString("Unsupported compression method %1 for %2").arg(it->method).arg(name);
+        return nullptr;
+    }
+    
+    // The local header's name and extra field can differ from the central copy
+    m_file.seek(it->headerOffset);
+    QByteArray header = m_file.read(LocalHeaderSize);
+    if (header.size() != LocalHeaderSize || qFromLittleEndian<quint32>(header.constData()) != LocalHeaderSignature) {
+        m_error = QString("Corrupt local header for %1").arg(name);
+        return nullptr;
+    }
+    qint64 dataOffset = it->headerOffset + LocalHeaderSize
+        + qFromLittleEndian<quint16>(header.constData() + 26)
+        + qFromLittleEndian<quint16>(header.constData() + 28);
+    
+    std::unique_ptr<QIODevice> device(new ZipEntryDevice(&m_file, dataOffset, it->compressedSize, it->size,
+                                                         it->method == MethodDeflated));
+    device->open(QIODevice::ReadOnly);
+    return device;
+}
+
+QByteArray ZipReader::readEntry(const QString& name)
+{
+    std::unique_ptr<QIODevice> device = openEntry(name);
+    return device ? device->readAll() : QByteArray();
+}
+
+ZipEntryDevice::ZipEntryDevice(QFile* file, qint64 dataOffset, qint64 compressedSize, qint64 size, bool deflated)
+    : m_file(file)
+    , m_position(dataOffset)
+    , m_compressedLeft(compressedSize)
+    , m_left(size)
+    , m_deflated(deflated)
+{
+#ifdef HAVE_ZLIB
+    if (m_deflated) {
+        m_stream.reset(new z_stream_s());
+        // Negative window bits: raw deflate without zlib header
+        inflateInit2(m_stream.get(), -MAX_WBITS);
+    }
+#endif
+}
+
+ZipEntryDevice::~ZipEntryDevice()
+{
+#ifdef HAVE_ZLIB
+    if (m_stream) {
+        inflateEnd(m_stream.get());
+    }
+#endif
+}
+
+qint64 ZipEntryDevice::bytesAvailable() const
+{
+    return m_left + QIODevice::bytesAvailable();
+}
+
+qint64 ZipEntryDevice::writeData(const char* data, qint64 maxSize)
+{
+    Q_UNUSED(data)
+    Q_UNUSED(maxSize)
+    return -1;
+}
+
+qint64 ZipEntryDevice::readData(char* data, qint64 maxSize)
+{
+    if (m_left <= 0) {
+        return 0;
+    }
+    maxSize = qMin(maxSize, m_left);
+    
+    if (!m_deflated) {
+        if (!m_file->seek(m_position)) {
+            return -1;
+        }
+        qint64 read = m_file->read(data, maxSize);
+        if (read <= 0) {
+            return -1;
+        }
+        m_position += read;
+        m_left -= read;
+        return read;
+    }
+
+#ifdef HAVE_ZLIB
+    z_stream_s* stream = m_stream.get();
+    stream->next_out = reinterpret_cast<Bytef*>(data);
+    stream->avail_out = static_cast<uInt>(qMin<qint64>(maxSize, InputChunkSize * 4));
+    
+    while (stream->avail_out > 0) {
+        if (m_input.isEmpty() && m_compressedLeft > 0) {
+            if (!m_file->seek(m_position)) {
+                return -1;
+            }
+            m_input = m_file->read(qMin<qint64>(InputChunkSize, m_compressedLeft));
+            if (m_input.isEmpty()) {
+                return -1;
+            }
+            m_position += m_input.size();
+            m_compressedLeft -= m_input.size();
+        }
+        
+        stream->next_in = reinterpret_cast<Bytef*>(m_input.data());
+        stream->avail_in = static_cast<uInt>(m_input.size());
+        int result = inflate(stream, Z_NO_FLUSH);
+        m_input.remove(0, m_input.size() - static_cast<int>(stream->avail_in));
+        
+        if (result == Z_STREAM_END) {
+            break;
+        }
+        // Z_BUF_ERROR only means more input is needed
+        if (result != Z_OK && result != Z_BUF_ERROR) {
+            setErrorString(QString("Inflate failed (%1)").arg(result));
+            return -1;
+        }
+        if (m_input.isEmpty() && m_compressedLeft == 0) {
+            break;
+        }
+    }
+    
+    qint64 produced = reinterpret_cast<char*>(stream->next_out) - data;
+    m_left -= produced;
+    if (produced == 0) {
+        m_left = 0; // Stream ended early; report end instead of spinning
+    }
+    return produced;
+#else
+    return -1;
+#endif
+}
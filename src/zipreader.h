@@ -0,0 +1,76 @@
+#ifndef ZIPREADER_H
+#define ZIPREADER_H
+
+#include <QFile>
+#include <QHash>
+#include <QIODevice>
+#include <QString>
+#include <memory>
+
+struct z_stream_s;
+
+/**
+ * ZipReader - Reads entries of a ZIP archive without extracting it
+ *
+ * Only the central directory is loaded up front. openEntry() returns a
+ * sequential device that inflates the entry as it is read, so a large
+ * sheet can be parsed with QXmlStreamReader in constant memory. Deflated
+ * entries need zlib (HAVE_ZLIB); without it only stored entries open.
+ */
+class ZipReader
+{
+public:
+    explicit ZipReader(const QString& filePath);
+    ~ZipReader();
+    
+    bool open();
+    bool contains(const QString& name) const { return m_entries.contains(name); }
+    
+    // The device reads from this reader's file, so it must not outlive it
+    std::unique_ptr<QIODevice> openEntry(const QString& name);
+    QByteArray readEntry(const QString& name); // Small parts only
+    
+    QString errorString() const { return m_error; }
+
+private:
+    struct Entry {
+        quint16 method = 0;
+        quint32 compressedSize = 0;
+        quint32 size = 0;
+        quint32 headerOffset = 0;
+    };
+    
+    QFile m_file;
+    QHash<QString, Entry> m_entries;
+    QString m_error;
+};
+
+/**
+ * ZipEntryDevice - Sequential, read-only view of one archive entry
+ */
+class ZipEntryDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    ZipEntryDevice(QFile* file, qint64 dataOffset, qint64 compressedSize, qint64 size, bool deflated);
+    ~ZipEntryDevice() override;
+    
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 maxSize) override;
+
+private:
+    QFile* m_file;
+    qint64 m_position;         // Next compressed byte to read from the file
+    qint64 m_compressedLeft;
+    qint64 m_left;             // Uncompressed bytes not yet returned
+    bool m_deflated;
+    QByteArray m_input;        // Compressed bytes read but not yet inflated
+    std::unique_ptr<z_stream_s> m_stream;
+};
+
+#endif // ZIPREADER_H
@@ -0,0 +1,237 @@
+#include "zipwriter.h"
+#include <QIODevice>
+#include <QDataStream>
+#include <QDateTime>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#else
+struct z_stream_s {};
+#endif
+
+namespace {
+const quint32 LocalHeaderSignature = 0x04034b50;
+const quint32 CentralHeaderSignature = 0x02014b50;
+const quint32 EndOfCentralDirectorySignature = 0x06054b50;
+
+const quint16 VersionNeeded = 20;
+const quint16 Utf8NamesFlag = 0x0800;
+const quint16 MethodStored = 0;
+const quint16 MethodDeflated = 8;
+
+// Offset of the CRC field in the local header, patched when an entry ends
+const int LocalHeaderCrcOffset = 14;
+
+// Entry data is compressed and written in pieces of this size
+const int BufferSize = 64 * 1024;
+
+#ifndef HAVE_ZLIB
+quint32 crc32Update(quint32 crc, const QByteArray& data)
+{
+    static quint32 table[256] = {};
+    static bool tableReady = false;
+    if (!tableReady) {
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? (0xEDB88320u ^ (value >> 1)) : (value >> 1);
+            }
+            table[i] = value;
+        }
+        tableReady = true;
+    }
+    
+    crc = ~crc;
+    for (char byte : data) {
+        crc = table[(crc ^ static_cast<quint8>(byte)) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+#endif
+}
+
+ZipWriter::ZipWriter(QIODevice* device)
+    : m_device(device)
+    , m_inEntry(false)
+    , m_dosTime(0)
+    , m_dosDate(0)
+{
+    // All entries get the time the archive was started
+    QDateTime now = QDateTime::currentDateTime();
+    m_dosTime = static_cast<quint16>((now.time().hour() << 11) | (now.time().minute() << 5) | (now.time().second() / 2));
+    m_dosDate = static_cast<quint16>(((now.date().year() - 1980) << 9) | (now.date().month() << 5) | now.date().day());
+}
+
+ZipWriter::~ZipWriter()
+{
+#ifdef HAVE_ZLIB
+    if (m_inEntry && m_stream) {
+        deflateEnd(m_stream.get());
+    }
+#endif
+}
+
+bool ZipWriter::fail(const QString& error)
+{
+    if (m_error.isEmpty()) {
+        m_error = error;
+    }
+    return false;
+}
+
+bool ZipWriter::writeRaw(const QByteArray& data)
+{
+    if (m_device->write(data) != data.size()) {
+        return fail(QString("Write failed: %1").arg(m_device->errorString()));
+    }
+    return true;
+}
+
+bool ZipWriter::beginEntry(const QString& name)
+{
+    if (m_inEntry && !endEntry()) {
+        return false;
+    }
+    if (!m_error.isEmpty()) {
+        return false;
+    }
+    
+    Entry entry;
+    entry.name = name.toUtf8();
+    entry.headerOffset = static_cast<quint32>(m_device->pos());
+#ifdef HAVE_ZLIB
+    entry.method = MethodDeflated;
+    m_stream.reset(new z_stream_s());
+    // Negative window bits: raw deflate, as ZIP expects
+    if (deflateInit2(m_stream.get(), Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return fail("Could not initialise deflate");
+    }
+#else
+    entry.method = MethodStored;
+#endif
+    
+    // CRC and sizes are patched in by endEntry()
+    QByteArray header;
+    QDataStream stream(&header, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream << LocalHeaderSignature << VersionNeeded << Utf8NamesFlag << entry.method
+           << m_dosTime << m_dosDate << quint32(0) << quint32(0) << quint32(0)
+           << quint16(entry.name.size()) << quint16(0);
+    header.append(entry.name);
+    
+    m_entries.append(entry);
+    m_inEntry = true;
+    m_buffer.clear();
+    return writeRaw(header);
+}
+
+bool ZipWriter::write(const QByteArray& data)
+{
+    if (!m_inEntry || !m_error.isEmpty()) {
+        return false;
+    }
+    
+    Entry& entry = m_entries.last();
+#ifdef HAVE_ZLIB
+    entry.crc = crc32(entry.crc, reinterpret_cast<const Bytef*>(data.constData()), data.size());
+#else
+    entry.crc = crc32Update(entry.crc, data);
+#endif
+    entry.size += data.size();
+    
+    m_buffer.append(data);
+    if (m_buffer.size() >= BufferSize) {
+        return flushBuffer(false);
+    }
+    return true;
+}
+
+bool ZipWriter::flushBuffer(bool last)
+{
+    Entry& entry = m_entries.last();
+
+#ifdef HAVE_ZLIB
+    z_stream_s* stream = m_stream.get();
+    stream->next_in = reinterpret_cast<Bytef*>(m_buffer.data());
+    stream->avail_in = static_cast<uInt>(m_buffer.size());
+    
+    QByteArray out(BufferSize, Qt::Uninitialized);
+    int result = Z_OK;
+    do {
+        stream->next_out = reinterpret_cast<Bytef*>(out.data());
+        stream->avail_out = static_cast<uInt>(out.size());
+        result = deflate(stream, last ? Z_FINISH : Z_NO_FLUSH);
+        if (result == Z_STREAM_ERROR) {
+            return fail("Deflate failed");
+        }
+        int produced = out.size() - static_cast<int>(stream->avail_out);
+        entry.compressedSize += produced;
+        if (produced > 0 && !writeRaw(out.left(produced))) {
+            return false;
+        }
+    } while (stream->avail_out == 0 || (last && result != Z_STREAM_END));
+#else
+    Q_UNUSED(last)
+    entry.compressedSize += m_buffer.size();
+    if (!writeRaw(m_buffer)) {
+        return false;
+    }
+#endif
+    
+    m_buffer.clear();
+    return true;
+}
+
+bool ZipWriter::endEntry()
+{
+    if (!m_inEntry) {
+        return true;
+    }
+    m_inEntry = false;
+    
+    bool flushed = flushBuffer(true);
+#ifdef HAVE_ZLIB
+    deflateEnd(m_stream.get());
+#endif
+    if (!flushed) {
+        return false;
+    }
+    
+    const Entry& entry = m_entries.last();
+    QByteArray sizes;
+    QDataStream stream(&sizes, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream << entry.crc << entry.compressedSize << entry.size;
+    
+    qint64 end = m_device->pos();
+    if (!m_device->seek(entry.headerOffset + LocalHeaderCrcOffset) || !writeRaw(sizes) || !m_device->seek(end)) {
+        return fail(QString("Could not patch entry header: %1").arg(m_device->errorString()));
+    }
+    return true;
+}
+
+bool ZipWriter::finish()
+{
+    if (!endEntry() || !m_error.isEmpty()) {
+        return false;
+    }
+    
+    quint32 directoryOffset = static_cast<quint32>(m_device->pos());
+    QByteArray directory;
+    QDataStream stream(&directory, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    for (const Entry& entry : m_entries) {
+        stream << CentralHeaderSignature << VersionNeeded << VersionNeeded << Utf8NamesFlag << entry.method
+               << m_dosTime << m_dosDate << entry.crc << entry.compressedSize << entry.size
+               << quint16(entry.name.size()) << quint16(0) << quint16(0)  // Extra field, comment
+               << quint16(0) << quint16(0) << quint32(0)                  // Disk, attributes
+               << entry.headerOffset;
+        stream.writeRawData(entry.name.constData(), entry.name.size());
+    }
+    
+    quint32 directorySize = static_cast<quint32>(directory.size());
+    stream << EndOfCentralDirectorySignature << quint16(0) << quint16(0)
+           << quint16(m_entries.size()) << quint16(m_entries.size())
+           << directorySize << directoryOffset << quint16(0);
+    return writeRaw(directory);
+}
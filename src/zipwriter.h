@@ -0,0 +1,63 @@
+#ifndef ZIPWRITER_H
+#define ZIPWRITER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <memory>
+
+class QIODevice;
+struct z_stream_s;
+
+/**
+ * ZipWriter - Writes a ZIP archive one entry at a time without buffering it
+ *
+ * Entry data is appended in pieces through write(); only a small buffer is
+ * kept. CRC and sizes are not known up front, so the local header is
+ * written with zeros and patched when the entry ends, which needs a
+ * seekable device. Entries are deflated when built with zlib and stored
+ * otherwise; both are valid for XLSX readers.
+ */
+class ZipWriter
+{
+public:
+    explicit ZipWriter(QIODevice* device);
+    ~ZipWriter();
+    
+    ZipWriter(const ZipWriter&) = delete;
+    ZipWriter& operator=(const ZipWriter&) = delete;
+    
+    bool beginEntry(const QString& name);
+    bool write(const QByteArray& data);
+    bool endEntry();
+    
+    // Writes the central directory; the device is left open
+    bool finish();
+    
+    QString errorString() const { return m_error; }
+
+private:
+    struct Entry {
+        QByteArray name;
+        quint16 method = 0;
+        quint32 crc = 0;
+        quint32 compressedSize = 0;
+        quint32 size = 0;
+        quint32 headerOffset = 0;
+    };
+    
+    bool flushBuffer(bool last);
+    bool writeRaw(const QByteArray& data);
+    bool fail(const QString& error);
+    
+    QIODevice* m_device;
+    QList<Entry> m_entries;
+    bool m_inEntry;
+    QByteArray m_buffer;   // Entry data not yet compressed and written
+    quint16 m_dosTime;
+    quint16 m_dosDate;
+    QString m_error;
+    std::unique_ptr<z_stream_s> m_stream;
+};
+
+#endif // ZIPWRITER_H
@@ -0,0 +1,444 @@
+#include <QtTest>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTimeZone>
+
+#include "changefeed.h"
+#include "datasetgenerator.h"
+#include "duplicateindex.h"
+#include "firebaseauthservice.h"
+#include "firebasestandin.h"
+#include "firestorequery.h"
+#include "firestoreservice.h"
+#include "networkaccess.h"
+#include "studentimporter.h"
+#include "studentstore.h"
+#include "writeoutbox.h"
+
+/*
+ * tst_firebasestandin - The Firebase services against the local stand-in
+ *
+ * Every test starts a FirebaseStandIn on a free port and points the
+ * services at it, so loads, auth, conflicts and imports run through the
+ * same REST calls they make against the real project.
+ */
+
+namespace {
+const int Timeout = 10000;
+const QString ProjectId = "test";
+
+QByteArray csvRow(const QStringList& fields)
+{
+    QStringList quoted;
+    for (QString field : fields) {
+        quoted.append('"' + field.replace('"', "\"\"") + '"');
+    }
+    return (quoted.join(',') + '\n').toUtf8();
+}
+}
+
+class TestFirebaseStandIn : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    
+    void pagedLoad();
+    void partitionedLoad();
+    void partitionQueryNeedsCollectionGroup();
+    void changeFeedPagesWithinOneSecond();
+    void unauthorizedRequestIsReplayed();
+    void conflictingEditIsReported();
+    void separateEditsAreRebased();
+    void importReachesServer();
+    void nearNameIsReported_data();
+    void nearNameIsReported();
+    void phoneKey_data();
+    void phoneKey();
+
+private:
+    QList<Student> generate(int count);
+    Student fetch(const QString& studentId);
+    
+    FirebaseStandIn* m_standIn = nullptr;
+    FirestoreService* m_service = nullptr;
+};
+
+void TestFirebaseStandIn::init()
+{
+    m_standIn = new FirebaseStandIn(this);
+    QVERIFY2(m_standIn->listen(), qPrintable(m_standIn->errorString()));
+    
+    // The origin is read when the service is configured
+    NetworkAccess::setOriginOverride(m_standIn->origin());
+    m_service = new FirestoreService(this);
+    m_service->setProjectId(ProjectId);
+}
+
+void TestFirebaseStandIn::cleanup()
+{
+    delete m_service;
+    m_service = nullptr;
+    delete m_standIn;
+    m_standIn = nullptr;
+}
+
+QList<Student> TestFirebaseStandIn::generate(int count)
+{
+    DatasetGenerator generator;
+    generator.setProjectId(ProjectId, m_standIn->origin());
+    return generator.generate(count);
+}
+
+Student TestFirebaseStandIn::fetch(const QString& studentId)
+{
+    Student found;
+    bool finished = false;
+    QMetaObject::Connection fetched = connect(m_service, &FirestoreService::studentsFetched, this,
+        [&found](const QString& tag, const QList<Student>& students) {
+        if (tag == "test:fetch" && !students.isEmpty()) {
+            found = students.first();
+        }
+    });
+    QMetaObject::Connection done = connect(m_service, &FirestoreService::studentsFetchFinished, this,
+        [&finished](const QString& tag) {
+        finished = finished || tag == "test:fetch";
+    });
+    m_service->getStudents({studentId}, "test:fetch");
+    QTest::qWaitFor([&finished]() { return finished; }, Timeout);
+    disconnect(fetched);
+    disconnect(done);
+    return found;
+}
+
+void TestFirebaseStandIn::pagedLoad()
+{
+    // More than two list pages of 300
+    m_standIn->setStudents(generate(750));
+    
+    QList<Student> loaded;
+    bool received = false;
+    connect(m_service, &FirestoreService::studentsReceived, this, [&](const QList<Student>& students) {
+        loaded = students;
+        received = true;
+    });
+    m_service->getAllStudents();
+    
+    QTRY_VERIFY_WITH_TIMEOUT(received, Timeout);
+    QCOMPARE(loaded.size(), 750);
+    
+    QSet<QString> ids;
+    for (const Student& student : std::as_const(loaded)) {
+        ids.insert(student.getId());
+    }
+    QCOMPARE(ids.size(), 750);
+}
+
+void TestFirebaseStandIn::partitionedLoad()
+{
+    m_standIn->setStudents(generate(1000));
+    
+    int partitionReplies = 0;
+    connect(m_standIn, &FirebaseStandIn::requestHandled, this,
+            [&partitionReplies](const QString&, const QString& path, int status) {
+        if (path.endsWith(":partitionQuery") && status == 200) {
+            partitionReplies++;
+        }
+    });
+    QList<Student> loaded;
+    int parts = 0;
+    bool received = false;
+    connect(m_service, &FirestoreService::studentsPartitionReceived, this, [&parts]() { parts++; });
+    connect(m_service, &FirestoreService::studentsReceived, this, [&](const QList<Student>& students) {
+        loaded = students;
+        received = true;
+    });
+    m_service->getAllStudentsPartitioned(4);
+    
+    QTRY_VERIFY_WITH_TIMEOUT(received, Timeout);
+    QCOMPARE(loaded.size(), 1000);
+    
+    // Split by the server, not loaded through the paged fallback; three
+    // ranges come as parts, the fourth with the complete list
+    QVERIFY(partitionReplies > 0);
+    QCOMPARE(parts, 3);
+}
+
+void TestFirebaseStandIn::partitionQueryNeedsCollectionGroup()
+{
+    m_standIn->setStudents(generate(100));
+    
+    auto post = [this](const FirestoreQuery& query) {
+        QJsonObject body;
+        body["structuredQuery"] = query.toStructuredQuery();
+        body["partitionCount"] = 4;
+        QNetworkRequest request(QUrl(m_standIn->origin()
+            + QString("/v1/projects/%1/databases/(default)/documents:partitionQuery").arg(ProjectId)));
+        request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+        QNetworkReply* reply = NetworkAccess::shared()->post(request, QJsonDocument(body).toJson());
+        QTest::qWaitFor([reply]() { return reply->isFinished(); }, Timeout);
+        int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        reply->deleteLater();
+        return status;
+    };
+    
+    QCOMPARE(post(FirestoreQuery().orderBy("__name__")), 400);
+    QCOMPARE(post(FirestoreQuery().allDescendants().orderBy("__name__")), 200);
+}
+
+void TestFirebaseStandIn::changeFeedPagesWithinOneSecond()
+{
+    // More than two delta pages of 500, all written in the same second,
+    // which is as precise as lastUpdateTime gets
+    const QDateTime written = QDateTime::fromSecsSinceEpoch(QDateTime::currentSecsSinceEpoch(), QTimeZone::utc());
+    QList<Student> students = generate(1200);
+    for (Student& student : students) {
+        student.setLastUpdateTime(written);
+    }
+    m_standIn->setStudents(students);
+    
+    StudentStore store;
+    ChangeFeed feed(m_service, &store);
+    feed.setInterval(1000);
+    feed.start(written);
+    
+    QTRY_COMPARE_WITH_TIMEOUT(store.size(), 1200, Timeout);
+    QCOMPARE(feed.resumeToken(), written);
+}
+
+void TestFirebaseStandIn::unauthorizedRequestIsReplayed()
+{
+    m_standIn->setStudents(generate(10));
+    m_standIn->addUser("test@example.com", "secret");
+    m_standIn->setRequireAuth(true);
+    
+    FirebaseAuthService auth;
+    auth.setApiKey("test-key");
+    auth.setProjectId(ProjectId);
+    
+    // Without a token the load waits until one is set, then goes through
+    bool required = false;
+    QList<Student> loaded;
+    bool received = false;
+    connect(m_service, &FirestoreService::authenticationRequired, this, [&required]() { required = true; });
+    connect(m_service, &FirestoreService::studentsReceived, this, [&](const QList<Student>& students) {
+        loaded = students;
+        received = true;
+    });
+    m_service->getAllStudents();
+    QTRY_VERIFY_WITH_TIMEOUT(required, Timeout);
+    QVERIFY(!received);
+    
+    bool signedIn = false;
+    connect(&auth, &FirebaseAuthService::authenticationSucceeded, this, [&signedIn]() { signedIn = true; });
+    auth.signInWithEmailAndPassword("test@example.com", "secret");
+    QTRY_VERIFY_WITH_TIMEOUT(signedIn, Timeout);
+    m_service->setAuthToken(auth.getIdToken());
+    
+    QTRY_VERIFY_WITH_TIMEOUT(received, Timeout);
+    QCOMPARE(loaded.size(), 10);
+}
+
+void TestFirebaseStandIn::conflictingEditIsReported()
+{
+    m_standIn->setStudents(generate(1));
+    Student base = fetch(m_standIn->students().first().getId());
+    QVERIFY(!base.getUpdateTime().isEmpty());
+    
+    StudentStore store;
+    store.upsert(base);
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    WriteOutbox outbox(m_service, &store, directory.filePath("outbox.json"));
+    
+    // Someone else changes the school first
+    Student theirs = base;
+    theirs.setSchool("SUNUCU ÜNİVERSİTESİ");
+    bool committed = false;
+    connect(m_service, &FirestoreService::commitSucceeded, this, [&committed](const QString& tag) {
+        committed = committed || tag == "test:other";
+    });
+    m_service->commitWrites({m_service->setWrite(theirs, QString(), {"school"})}, "test:other");
+    QTRY_VERIFY_WITH_TIMEOUT(committed, Timeout);
+    
+    QStringList conflictFields;
+    Student server;
+    bool conflict = false;
+    connect(&outbox, &WriteOutbox::writeConflict, this,
+            [&](WriteOutbox::Operation, const Student&, const Student& serverVersion, const QStringList& fields) {
+        server = serverVersion;
+        conflictFields = fields;
+        conflict = true;
+    });
+    Student local = base;
+    local.clearDirty();
+    local.setSchool("YEREL ÜNİVERSİTESİ");
+    outbox.enqueueSet(local);
+    
+    QTRY_VERIFY_WITH_TIMEOUT(conflict, Timeout);
+    QCOMPARE(conflictFields, QStringList{"school"});
+    QCOMPARE(server.getSchool(), QString("SUNUCU ÜNİVERSİTESİ"));
+    QCOMPARE(store.student(base.getId()).getSchool(), QString("SUNUCU ÜNİVERSİTESİ"));
+    QCOMPARE(outbox.pendingCount(), 0);
+}
+
+void TestFirebaseStandIn::separateEditsAreRebased()
+{
+    m_standIn->setStudents(generate(1));
+    Student base = fetch(m_standIn->students().first().getId());
+    
+    StudentStore store;
+    store.upsert(base);
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    WriteOutbox outbox(m_service, &store, directory.filePath("outbox.json"));
+    
+    Student theirs = base;
+    theirs.setSchool("SUNUCU ÜNİVERSİTESİ");
+    bool committed = false;
+    connect(m_service, &FirestoreService::commitSucceeded, this, [&committed](const QString& tag) {
+        committed = committed || tag == "test:other";
+    });
+    m_service->commitWrites({m_service->setWrite(theirs, QString(), {"school"})}, "test:other");
+    QTRY_VERIFY_WITH_TIMEOUT(committed, Timeout);
+    
+    // A different field: no conflict, ours lands on top of theirs
+    bool conflict = false;
+    bool reconciled = false;
+    connect(&outbox, &WriteOutbox::writeConflict, this, [&conflict]() { conflict = true; });
+    connect(&outbox, &WriteOutbox::reconciled, this, [&reconciled]() { reconciled = true; });
+    Student local = base;
+    local.clearDirty();
+    local.setField("YEREL BÖLÜM");
+    outbox.enqueueSet(local);
+    
+    QTRY_VERIFY_WITH_TIMEOUT(reconciled, Timeout);
+    QVERIFY(!conflict);
+    Student server = m_standIn->students().first();
+    QCOMPARE(server.getSchool(), QString("SUNUCU ÜNİVERSİTESİ"));
+    QCOMPARE(server.getField(), QString("YEREL BÖLÜM"));
+}
+
+void TestFirebaseStandIn::importReachesServer()
+{
+    Student existing = generate(1).first();
+    m_standIn->setStudents({existing});
+    StudentStore store;
+    store.upsert(fetch(existing.getId()));
+    
+    // The existing student again, with the phone number written another way
+    QString phone = "+90 " + DuplicateIndex::phoneKey(existing.getNumber());
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QFile file(directory.filePath("ogrenciler.csv"));
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Text));
+    file.write("name,email,description,field,school,number,year,graduation\n");
+    file.write(csvRow({existing.getName(), existing.getEmail(), existing.getDescription(), existing.getField(),
+                       existing.getSchool(), phone, QString::number(existing.getYear()),
+                       existing.getGraduation() ? "Evet" : "Hayır"}));
+    file.write("AYŞE YILMAZ,ayse@example.com,,BİLGİSAYAR MÜHENDİSLİĞİ,ODTÜ,0532 111 22 33,2020,Hayır\n");
+    file.write("MEHMET KAYA,mehmet@example.com,,TIP,HACETTEPE,0533 444 55 66,2019,Evet\n");
+    file.write(",,,,,,,\n");
+    file.write("ADSIZ YIL,,,,,,abc,Evet\n");
+    file.close();
+    
+    WriteOutbox outbox(m_service, &store, directory.filePath("outbox.json"));
+    StudentImporter importer;
+    connect(&importer, &StudentImporter::studentsParsed, &outbox, &WriteOutbox::enqueueSets);
+    
+    int imported = -1;
+    int unchanged = -1;
+    QStringList errors;
+    connect(&importer, &StudentImporter::finished, this,
+            [&](int importedCount, int unchangedCount, int, const QStringList& rowErrors) {
+        imported = importedCount;
+        unchanged = unchangedCount;
+        errors = rowErrors;
+    });
+    bool reconciled = false;
+    connect(&outbox, &WriteOutbox::reconciled, this, [&reconciled]() { reconciled = true; });
+    importer.start(file.fileName(), store.students());
+    
+    QTRY_COMPARE_WITH_TIMEOUT(imported, 2, Timeout);
+    QCOMPARE(unchanged, 1);
+    QCOMPARE(errors.size(), 1);
+    
+    QTRY_VERIFY_WITH_TIMEOUT(reconciled, Timeout);
+    QCOMPARE(outbox.pendingCount(), 0);
+    QCOMPARE(m_standIn->documentCount(), 3);
+    QCOMPARE(store.size(), 3);
+}
+
+void TestFirebaseStandIn::nearNameIsReported_data()
+{
+    QTest::addColumn<int>("mode");
+    
+    QTest::newRow("add only") << int(StudentImporter::AddOnly);
+    QTest::newRow("upsert") << int(StudentImporter::Upsert);
+}
+
+void TestFirebaseStandIn::nearNameIsReported()
+{
+    QFETCH(int, mode);
+    
+    // Two edits apart and without e-mail or phone: possibly someone else
+    Student existing("existing", "AYŞE YILMAZ", "", "", "TIP", "HACETTEPE", "", 2020, false, "");
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QFile file(directory.filePath("ogrenciler.csv"));
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Text));
+    file.write("name,email,description,field,school,number,year,graduation\n");
+    file.write("AYŞE YILDIZ,,,TIP,ODTÜ,,2020,Hayır\n");
+    file.write("ayşe yılmaz,,,TIP,ODTÜ,,2020,Hayır\n");
+    file.close();
+    
+    StudentImporter importer;
+    int parsed = 0;
+    connect(&importer, &StudentImporter::studentsParsed, this, [&parsed](const QList<Student>& students) {
+        parsed += students.size();
+    });
+    int imported = -1;
+    int changed = -1;
+    QStringList errors;
+    connect(&importer, &StudentImporter::finished, this,
+            [&](int importedCount, int, int changedCount, const QStringList& rowErrors) {
+        imported = importedCount;
+        changed = changedCount;
+        errors = rowErrors;
+    });
+    importer.start(file.fileName(), {existing}, StudentImporter::Mode(mode));
+    
+    // The near name is listed by row; the identical one is the same person
+    QTRY_COMPARE_WITH_TIMEOUT(imported, 0, Timeout);
+    QCOMPARE(changed, 1);
+    QCOMPARE(errors.size(), 1);
+    QVERIFY(errors.first().startsWith("Satır 2:"));
+    QCOMPARE(parsed, mode == StudentImporter::Upsert ? 1 : 0);
+}
+
+void TestFirebaseStandIn::phoneKey_data()
+{
+    QTest::addColumn<QString>("phone");
+    QTest::addColumn<QString>("key");
+    
+    QTest::newRow("dialog") << "0532 123 45 67" << "5321234567";
+    QTest::newRow("international") << "+90 532 1234567" << "5321234567";
+    QTest::newRow("country code") << "905321234567" << "5321234567";
+    QTest::newRow("numeric cell") << "5321234567" << "5321234567";
+    QTest::newRow("punctuation") << "(0532) 123-45-67" << "5321234567";
+    QTest::newRow("empty") << "" << "";
+}
+
+void TestFirebaseStandIn::phoneKey()
+{
+    QFETCH(QString, phone);
+    QFETCH(QString, key);
+    QCOMPARE(DuplicateIndex::phoneKey(phone), key);
+}
+
+QTEST_GUILESS_MAIN(TestFirebaseStandIn)
+#include "tst_firebasestandin.moc"